@@ -30,43 +30,833 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
+#include "arena.h"
+#include "symtab.h"
 #include "adraw_int.h"
 
+/***************************************************************************
+ * Manifest Constants
+ ***************************************************************************/
+
+/** Initial number of slots in a text cache, which must be a power of 2. */
+#define TEXTCACHE_MIN_SIZE    256
+
+/** Number of strings after which a text cache is flushed.
+ * This bounds the memory used when many distinct strings are measured.
+ */
+#define TEXTCACHE_MAX_ENTRIES 65536
+
+/** Number of distinct fonts that may be held in a text cache. */
+#define TEXTCACHE_MAX_FONTS   8
+
+/** Value of ADraw.textCacheFont if the font could not be added to the cache. */
+#define TEXTCACHE_NO_FONT     TEXTCACHE_MAX_FONTS
+
+/***************************************************************************
+ * Types
+ ***************************************************************************/
+
+/** A cached text width.
+ */
+typedef struct
+{
+    /** The measured string, or NULL if the slot is unused. */
+    const char      *str;
+    size_t           len;
+    unsigned int     hash;
+
+    /** Index of the font in the cache, and the font size. */
+    unsigned short   font;
+    unsigned short   size;
+
+    unsigned int     width;
+}
+TextCacheEntry;
+
+/** A font for which widths are cached.
+ * PostScript and SVG widths come from built in metrics, while PNG widths
+ * depend on the font name, so both the type and name identify a font.
+ */
+typedef struct
+{
+    ADrawOutputType  type;
+    char            *name;
+}
+TextCacheFont;
+
+/** Drawing state tracked in front of a backend.
+ * Pen and font changes are recorded here and only passed to the backend
+ * when a drawing function needs them, and then only if they differ from
+ * what the backend last had.
+ */
+struct ADrawStateTag
+{
+    /** The backend's own functions. */
+    ADraw            backend;
+
+    /** State requested by the caller. */
+    ADrawColour      pen;
+    ADrawColour      bgPen;
+    ADrawFontSize    fontSize;
+
+    /** State last passed to the backend. */
+    ADrawColour      backendPen;
+    ADrawColour      backendBgPen;
+    ADrawFontSize    backendFontSize;
+};
+
+struct ADrawTextCacheTag
+{
+    /** Arena holding the table and strings, replaced when flushed. */
+    Arena            arena;
+
+    /** Open addressed table of entries, never more than half full. */
+    TextCacheEntry  *slot;
+    unsigned int     size;
+    unsigned int     used;
+
+    TextCacheFont    font[TEXTCACHE_MAX_FONTS];
+    unsigned int     nFonts;
+
+    unsigned long    hits;
+    unsigned long    misses;
+};
+
+/***************************************************************************
+ * Local Functions
+ ***************************************************************************/
+
+/** Empty some text cache, keeping the fonts and statistics.
+ * If memory can't be allocated for the new table, the cache is left
+ * without one and text is then measured each time.
+ *
+ * \retval false  If the new table could not be allocated.
+ */
+static bool textCacheFlush(ADrawTextCache *cache)
+{
+    if(cache->arena != NULL)
+    {
+        ArenaDestroy(cache->arena);
+    }
+
+    cache->size  = TEXTCACHE_MIN_SIZE;
+    cache->used  = 0;
+    cache->slot  = NULL;
+    cache->arena = ArenaCreate();
+    if(cache->arena != NULL)
+    {
+        cache->slot = ArenaZalloc(cache->arena, sizeof(TextCacheEntry) * cache->size);
+    }
+
+    return cache->slot != NULL;
+}
+
+
+/** Double the size of the table in some text cache.
+ *
+ * \retval false  If the new table could not be allocated, in which case the
+ *                 table is unchanged.
+ */
+static bool textCacheGrow(ADrawTextCache *cache)
+{
+    TextCacheEntry *old     = cache->slot;
+    unsigned int    oldSize = cache->size;
+    TextCacheEntry *slot;
+    unsigned int    i;
+
+    slot = ArenaZalloc(cache->arena, sizeof(TextCacheEntry) * oldSize * 2);
+    if(slot == NULL)
+    {
+        return false;
+    }
+
+    cache->size = oldSize * 2;
+    cache->slot = slot;
+
+    for(i = 0; i < oldSize; i++)
+    {
+        if(old[i].str != NULL)
+        {
+            unsigned int h = old[i].hash & (cache->size - 1);
+
+            while(cache->slot[h].str != NULL)
+            {
+                h = (h + 1) & (cache->size - 1);
+            }
+
+            cache->slot[h] = old[i];
+        }
+    }
+
+    return true;
+}
+
+
+/** Find the index of some font in a text cache, adding it if needed.
+ * \retval TEXTCACHE_NO_FONT  If the font is not known and the cache is full.
+ */
+static unsigned int textCacheFont(ADrawTextCache  *cache,
+                                  ADrawOutputType  type,
+                                  const char      *fontName)
+{
+    unsigned int t;
+
+    if(fontName == NULL)
+    {
+        fontName = "";
+    }
+
+    for(t = 0; t < cache->nFonts; t++)
+    {
+        if(cache->font[t].type == type && strcmp(cache->font[t].name, fontName) == 0)
+        {
+            return t;
+        }
+    }
+
+    if(cache->nFonts < TEXTCACHE_MAX_FONTS)
+    {
+        char *name = strdup(fontName);
+
+        if(name != NULL)
+        {
+            cache->font[cache->nFonts].type = type;
+            cache->font[cache->nFonts].name = name;
+            return cache->nFonts++;
+        }
+    }
+
+    return TEXTCACHE_NO_FONT;
+}
+
+
+/** Measure text, using the cache attached to the metrics.
+ * This is installed in front of the backend textWidth() function.
+ */
+static unsigned int cachedTextWidth(ADrawMetrics *ctx, const char *string)
+{
+    ADrawTextCache    *cache = ctx->textCache;
+    const size_t       len   = strlen(string);
+    const unsigned int hash  = SymTabHash(string, len) ^
+                               (ctx->textCacheFont << 24) ^ (ctx->fontSize << 16);
+    unsigned int       h     = hash & (cache->size - 1);
+    unsigned int       width;
+    TextCacheEntry    *e;
+    char              *str;
+
+    /* Measure each time if memory for the table couldn't be allocated */
+    if(cache->slot == NULL)
+    {
+        cache->misses++;
+        return ctx->uncachedTextWidth(ctx, string);
+    }
+
+    while(cache->slot[h].str != NULL)
+    {
+        e = &cache->slot[h];
+
+        if(e->hash == hash && e->len == len &&
+           e->font == ctx->textCacheFont && e->size == ctx->fontSize &&
+           memcmp(e->str, string, len) == 0)
+        {
+            cache->hits++;
+            return e->width;
+        }
+
+        h = (h + 1) & (cache->size - 1);
+    }
+
+    cache->misses++;
+    width = ctx->uncachedTextWidth(ctx, string);
+
+    /* Flush if full, in which case the slot must be found again */
+    if(cache->used >= TEXTCACHE_MAX_ENTRIES)
+    {
+        if(!textCacheFlush(cache))
+        {
+            return width;
+        }
+
+        h = hash & (cache->size - 1);
+    }
+
+    str = ArenaAlloc(cache->arena, len + 1);
+    if(str == NULL)
+    {
+        return width;
+    }
+
+    memcpy(str, string, len + 1);
+
+    e = &cache->slot[h];
+    e->str   = str;
+    e->len   = len;
+    e->hash  = hash;
+    e->font  = ctx->textCacheFont;
+    e->size  = ctx->fontSize;
+    e->width = width;
+
+    /* Start again with an empty table if it can't grow */
+    if(++cache->used * 2 > cache->size && !textCacheGrow(cache))
+    {
+        textCacheFlush(cache);
+    }
+
+    return width;
+}
+
+
+/** Set the font size, tracking it for the text cache.
+ */
+static void cachedSetFontSize(ADrawMetrics *ctx, ADrawFontSize size)
+{
+    ctx->fontSize = size;
+    ctx->uncachedSetFontSize(ctx, size);
+}
+
+
+/** Pass the pen colour to the backend if it has changed.
+ */
+static void statePen(struct ADrawTag *ctx)
+{
+    struct ADrawStateTag *st = ctx->state;
+
+    if(st->pen != st->backendPen)
+    {
+        st->backend.setPen(ctx, st->pen);
+        st->backendPen = st->pen;
+    }
+}
+
+
+/** Pass the font size to the backend if it has changed.
+ */
+static void stateFont(struct ADrawTag *ctx)
+{
+    struct ADrawStateTag *st = ctx->state;
+
+    if(st->fontSize != st->backendFontSize)
+    {
+        st->backend.setFontSize(ctx, st->fontSize);
+        st->backendFontSize = st->fontSize;
+    }
+}
+
+
+/** Pass all state used to draw text to the backend.
+ */
+static void stateText(struct ADrawTag *ctx)
+{
+    struct ADrawStateTag *st = ctx->state;
+
+    statePen(ctx);
+    stateFont(ctx);
+
+    if(st->bgPen != st->backendBgPen)
+    {
+        st->backend.setBgPen(ctx, st->bgPen);
+        st->backendBgPen = st->bgPen;
+    }
+}
+
+
+static void stateLine(struct ADrawTag *ctx,
+                      unsigned int     x1,
+                      unsigned int     y1,
+                      unsigned int     x2,
+                      unsigned int     y2)
+{
+    statePen(ctx);
+    ctx->state->backend.line(ctx, x1, y1, x2, y2);
+}
+
+
+static void stateDottedLine(struct ADrawTag *ctx,
+                            unsigned int     x1,
+                            unsigned int     y1,
+                            unsigned int     x2,
+                            unsigned int     y2)
+{
+    statePen(ctx);
+    ctx->state->backend.dottedLine(ctx, x1, y1, x2, y2);
+}
+
+
+static void stateTextL(struct ADrawTag *ctx,
+                       unsigned int     x,
+                       unsigned int     y,
+                       const char      *string,
+                       const char      *url)
+{
+    stateText(ctx);
+    ctx->state->backend.textL(ctx, x, y, string, url);
+}
+
+
+static void stateTextC(struct ADrawTag *ctx,
+                       unsigned int     x,
+                       unsigned int     y,
+                       const char      *string,
+                       const char      *url)
+{
+    stateText(ctx);
+    ctx->state->backend.textC(ctx, x, y, string, url);
+}
+
+
+static void stateTextR(struct ADrawTag *ctx,
+                       unsigned int     x,
+                       unsigned int     y,
+                       const char      *string,
+                       const char      *url)
+{
+    stateText(ctx);
+    ctx->state->backend.textR(ctx, x, y, string, url);
+}
+
+
+static unsigned int stateTextWidth(struct ADrawTag *ctx, const char *string)
+{
+    stateFont(ctx);
+    return ctx->state->backend.textWidth(ctx, string);
+}
+
+
+static int stateTextHeight(struct ADrawTag *ctx)
+{
+    stateFont(ctx);
+    return ctx->state->backend.textHeight(ctx);
+}
+
+
+static void stateFilledRectangle(struct ADrawTag *ctx,
+                                 unsigned int     x1,
+                                 unsigned int     y1,
+                                 unsigned int     x2,
+                                 unsigned int     y2)
+{
+    statePen(ctx);
+    ctx->state->backend.filledRectangle(ctx, x1, y1, x2, y2);
+}
+
+
+static void stateFilledTriangle(struct ADrawTag *ctx,
+                                unsigned int     x1,
+                                unsigned int     y1,
+                                unsigned int     x2,
+                                unsigned int     y2,
+                                unsigned int     x3,
+                                unsigned int     y3)
+{
+    statePen(ctx);
+    ctx->state->backend.filledTriangle(ctx, x1, y1, x2, y2, x3, y3);
+}
+
+
+static void stateFilledCircle(struct ADrawTag *ctx,
+                              unsigned int     x,
+                              unsigned int     y,
+                              unsigned int     r)
+{
+    statePen(ctx);
+    ctx->state->backend.filledCircle(ctx, x, y, r);
+}
+
+
+static void stateArc(struct ADrawTag *ctx,
+                     unsigned int     cx,
+                     unsigned int     cy,
+                     unsigned int     w,
+                     unsigned int     h,
+                     unsigned int     s,
+                     unsigned int     e)
+{
+    statePen(ctx);
+    ctx->state->backend.arc(ctx, cx, cy, w, h, s, e);
+}
+
+
+static void stateDottedArc(struct ADrawTag *ctx,
+                           unsigned int     cx,
+                           unsigned int     cy,
+                           unsigned int     w,
+                           unsigned int     h,
+                           unsigned int     s,
+                           unsigned int     e)
+{
+    statePen(ctx);
+    ctx->state->backend.dottedArc(ctx, cx, cy, w, h, s, e);
+}
+
+
+static void stateSetPen(struct ADrawTag *ctx, ADrawColour col)
+{
+    ctx->state->pen = col;
+}
+
+
+static void stateSetBgPen(struct ADrawTag *ctx, ADrawColour col)
+{
+    ctx->state->bgPen = col;
+}
+
+
+static void stateSetFontSize(struct ADrawTag *ctx, ADrawFontSize size)
+{
+    ctx->state->fontSize = size;
+}
+
+
+static bool stateClose(struct ADrawTag *ctx)
+{
+    struct ADrawStateTag *st = ctx->state;
+    bool                  ok;
+
+    ok = st->backend.close(ctx);
+
+    ctx->state = NULL;
+    free(st);
+
+    return ok;
+}
+
+
+/** Put state tracking in front of the backend of some drawing context.
+ * This is only an optimisation, so if it fails the backend is used as is.
+ */
+static void attachState(struct ADrawTag *outContext)
+{
+    struct ADrawStateTag *st = malloc(sizeof(struct ADrawStateTag));
+
+    outContext->state = st;
+    if(st == NULL)
+    {
+        return;
+    }
+
+    st->backend = *outContext;
+
+    /* All backends start with the same state */
+    st->pen             = st->backendPen      = ADRAW_COL_BLACK;
+    st->bgPen           = st->backendBgPen    = ADRAW_COL_WHITE;
+    st->fontSize        = st->backendFontSize = ADRAW_FONT_SMALL;
+
+    outContext->line            = stateLine;
+    outContext->dottedLine      = stateDottedLine;
+    outContext->textL           = stateTextL;
+    outContext->textC           = stateTextC;
+    outContext->textR           = stateTextR;
+    outContext->textWidth       = stateTextWidth;
+    outContext->textHeight      = stateTextHeight;
+    outContext->filledRectangle = stateFilledRectangle;
+    outContext->filledTriangle  = stateFilledTriangle;
+    outContext->filledCircle    = stateFilledCircle;
+    outContext->arc             = stateArc;
+    outContext->dottedArc       = stateDottedArc;
+    outContext->setPen          = stateSetPen;
+    outContext->setBgPen        = stateSetBgPen;
+    outContext->setFontSize     = stateSetFontSize;
+    outContext->close           = stateClose;
+}
+
+
+/** Measure text for a drawing context using its metrics.
+ */
+static unsigned int metricsTextWidth(struct ADrawTag *ctx, const char *string)
+{
+    return ctx->metrics->textWidth(ctx->metrics, string);
+}
+
+
+/** Get the text height for a drawing context from its metrics.
+ */
+static int metricsTextHeight(struct ADrawTag *ctx)
+{
+    return ctx->metrics->textHeight(ctx->metrics);
+}
+
+
+/** Set the font size for both a drawing context and its metrics.
+ */
+static void metricsSetFontSize(struct ADrawTag *ctx, ADrawFontSize size)
+{
+    ctx->metrics->setFontSize(ctx->metrics, size);
+    ctx->backendSetFontSize(ctx, size);
+}
+
+
+/** Make some drawing context measure text using some metrics.
+ */
+static void attachMetrics(ADrawMetrics *metrics, struct ADrawTag *outContext)
+{
+    /* Match the backend's initial small text */
+    metrics->setFontSize(metrics, ADRAW_FONT_SMALL);
+
+    outContext->metrics            = metrics;
+    outContext->backendSetFontSize = outContext->setFontSize;
+    outContext->textWidth          = metricsTextWidth;
+    outContext->textHeight         = metricsTextHeight;
+    outContext->setFontSize        = metricsSetFontSize;
+}
+
 /***************************************************************************
  * Functions
  ***************************************************************************/
 
+bool ADrawInit(void)
+{
+#if !defined(REMOVE_PNG_OUTPUT)
+    return GdoGlobalInit();
+#else
+    return true;
+#endif
+}
+
+
 bool ADrawOpen(unsigned int     w,
                unsigned int     h,
-               const char      *file,
+               Sink             out,
                const char      *fontName,
                ADrawOutputType  type,
+               ADrawMetrics    *metrics,
+               const ADrawOpts *opts,
                struct ADrawTag *outContext)
 {
+    bool ok;
+
     assert(outContext);
 
+    /* Only backends drawing in bands set this */
+    outContext->setBand = NULL;
+
     switch(type)
     {
         case ADRAW_FMT_NULL:
-            return NullInit(outContext);
+            ok = NullInit(outContext);
+            break;
 
         case ADRAW_FMT_PNG:
 #if !defined(REMOVE_PNG_OUTPUT)
-            return GdoInit(w, h, file, fontName, outContext);
+            ok = GdoInit(w, h, out, fontName, opts, outContext);
+            break;
 #else
             fprintf(stderr, "Built with REMOVE_PNG_OUPUT; PNG output is not supported\n");
             return false;
 #endif
         case ADRAW_FMT_EPS:
-            return PsInit(w, h, file, outContext);
+            ok = PsInit(w, h, out, outContext);
+            break;
 
         case ADRAW_FMT_SVG:
-            return SvgInit(w, h, file, outContext);
+        case ADRAW_FMT_SVGZ:
+            ok = SvgInit(w, h, out, opts, type == ADRAW_FMT_SVGZ, outContext);
+            break;
+
+        case ADRAW_FMT_PDF:
+            ok = PdfInit(w, h, out, opts, outContext);
+            break;
 
         default:
             return false;
     }
+
+    outContext->metrics = NULL;
+    outContext->state   = NULL;
+
+    if(ok)
+    {
+        attachState(outContext);
+    }
+
+    /* Measure using the metrics */
+    if(ok && metrics != NULL)
+    {
+        attachMetrics(metrics, outContext);
+    }
+
+    return ok;
+}
+
+
+bool ADrawOpenBand(struct ADrawTag *image,
+                   ADrawMetrics    *metrics,
+                   struct ADrawTag *outContext)
+{
+    assert(image); assert(outContext);
+
+    outContext->setBand = NULL;
+
+#if !defined(REMOVE_PNG_OUTPUT)
+    if(!GdoInitBand(image, outContext))
+    {
+        return false;
+    }
+#else
+    fprintf(stderr, "Built with REMOVE_PNG_OUPUT; PNG output is not supported\n");
+    return false;
+#endif
+
+    outContext->metrics = NULL;
+    outContext->state   = NULL;
+
+    attachState(outContext);
+
+    /* Measure using the metrics */
+    if(metrics != NULL)
+    {
+        attachMetrics(metrics, outContext);
+    }
+
+    return true;
+}
+
+
+bool ADrawOpenList(ADrawList       *list,
+                   ADrawMetrics    *metrics,
+                   struct ADrawTag *outContext)
+{
+    assert(list); assert(metrics); assert(outContext);
+
+    outContext->setBand = NULL;
+
+    if(!ListInit(list, outContext))
+    {
+        return false;
+    }
+
+    /* Redundant state changes needn't be recorded or replayed */
+    attachState(outContext);
+
+    /* The list can't measure text itself */
+    attachMetrics(metrics, outContext);
+
+    return true;
+}
+
+
+bool ADrawOpenMetrics(const char      *fontName,
+                      ADrawOutputType  type,
+                      ADrawTextCache  *textCache,
+                      ADrawMetrics    *outMetrics)
+{
+    bool ok;
+
+    assert(outMetrics);
+
+    switch(type)
+    {
+        case ADRAW_FMT_NULL:
+            ok = NullMetricsInit(outMetrics);
+            break;
+
+        case ADRAW_FMT_PNG:
+#if !defined(REMOVE_PNG_OUTPUT)
+            ok = GdoMetricsInit(fontName, outMetrics);
+            break;
+#else
+            fprintf(stderr, "Built with REMOVE_PNG_OUPUT; PNG output is not supported\n");
+            return false;
+#endif
+        case ADRAW_FMT_EPS:
+            ok = PsMetricsInit(outMetrics);
+            break;
+
+        case ADRAW_FMT_SVG:
+        case ADRAW_FMT_SVGZ:
+            ok = SvgMetricsInit(outMetrics);
+            break;
+
+        case ADRAW_FMT_PDF:
+            ok = PdfMetricsInit(outMetrics);
+            break;
+
+        default:
+            return false;
+    }
+
+    outMetrics->textCache = NULL;
+
+    /* Put the cache in front of the backend, which starts with small text */
+    if(ok && textCache != NULL)
+    {
+        outMetrics->textCacheFont = textCacheFont(textCache, type, fontName);
+
+        if(outMetrics->textCacheFont != TEXTCACHE_NO_FONT)
+        {
+            outMetrics->textCache           = textCache;
+            outMetrics->fontSize            = ADRAW_FONT_SMALL;
+            outMetrics->uncachedTextWidth   = outMetrics->textWidth;
+            outMetrics->uncachedSetFontSize = outMetrics->setFontSize;
+            outMetrics->textWidth           = cachedTextWidth;
+            outMetrics->setFontSize         = cachedSetFontSize;
+        }
+    }
+
+    return ok;
+}
+
+
+ADrawOutputType ADrawGetMetricsType(ADrawOutputType type)
+{
+    /* EPS, SVG and PDF share the same Helvetica metrics */
+    switch(type)
+    {
+        case ADRAW_FMT_SVG:
+        case ADRAW_FMT_SVGZ:
+        case ADRAW_FMT_PDF:
+            return ADRAW_FMT_EPS;
+
+        default:
+            return type;
+    }
+}
+
+
+ADrawTextCache *ADrawTextCacheCreate(void)
+{
+    ADrawTextCache *cache = calloc(1, sizeof(ADrawTextCache));
+
+    if(cache != NULL && !textCacheFlush(cache))
+    {
+        ADrawTextCacheDestroy(cache);
+        cache = NULL;
+    }
+
+    return cache;
+}
+
+
+void ADrawTextCacheDestroy(ADrawTextCache *cache)
+{
+    unsigned int t;
+
+    if(cache == NULL)
+    {
+        return;
+    }
+
+    for(t = 0; t < cache->nFonts; t++)
+    {
+        free(cache->font[t].name);
+    }
+
+    if(cache->arena != NULL)
+    {
+        ArenaDestroy(cache->arena);
+    }
+
+    free(cache);
+}
+
+
+void ADrawTextCacheStats(const ADrawTextCache *cache,
+                         unsigned long        *hits,
+                         unsigned long        *misses)
+{
+    *hits   = cache->hits;
+    *misses = cache->misses;
 }
 
 
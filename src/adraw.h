@@ -24,6 +24,8 @@
 #define ADRAW_H
 
 #include <stdbool.h>
+#include <stdio.h>
+#include "sink.h"
 
 /***************************************************************************
  * Types
@@ -46,7 +48,13 @@ typedef enum
     ADRAW_FMT_EPS,
 
     /** Scalable Vector Graphics. */
-    ADRAW_FMT_SVG
+    ADRAW_FMT_SVG,
+
+    /** Scalable Vector Graphics, gzip compressed. */
+    ADRAW_FMT_SVGZ,
+
+    /** Portable Document Format. */
+    ADRAW_FMT_PDF
 }
 ADrawOutputType;
 
@@ -95,6 +103,150 @@ typedef enum
 ADrawFontSize;
 
 
+/** How PNG output is drawn and stored.
+ */
+typedef enum
+{
+    /** Draw and store in true colour, with anti-aliasing. */
+    ADRAW_PNG_TRUECOLOUR = 0,
+
+    /** Draw to an indexed colour palette, without anti-aliasing.
+     * This needs a quarter of the memory of a true colour image.
+     */
+    ADRAW_PNG_PALETTE,
+
+    /** Draw in true colour with anti-aliasing, then reduce the image to a
+     * palette before it is stored.
+     */
+    ADRAW_PNG_QUANTISED
+}
+ADrawPngColour;
+
+
+/** Row filters for PNG output.
+ */
+typedef enum
+{
+    /** Adaptive filtering for true colour and no filtering for palettes. */
+    ADRAW_PNG_FILTER_DEFAULT = 0,
+    ADRAW_PNG_FILTER_NONE,
+    ADRAW_PNG_FILTER_SUB,
+    ADRAW_PNG_FILTER_UP,
+    ADRAW_PNG_FILTER_AVERAGE,
+    ADRAW_PNG_FILTER_PAETH,
+
+    /** Pick the best filter for each row. */
+    ADRAW_PNG_FILTER_ADAPTIVE
+}
+ADrawPngFilter;
+
+
+/** Options for drawing backends.
+ * Zero initialised options give the defaults.
+ */
+typedef struct ADrawOptsTag
+{
+    /** How PNG output is drawn and stored. */
+    ADrawPngColour  pngColour;
+
+    /** zlib compression level for PNG output from 1 to 9, or 0 for the
+     * zlib default.
+     */
+    unsigned int    pngLevel;
+
+    /** The row filter for PNG output. */
+    ADrawPngFilter  pngFilter;
+
+    /** If non-zero, PNG output is drawn in bands of at most this many rows
+     * selected with setBand(), and only the current band is held in memory.
+     * This is ignored for ADRAW_PNG_QUANTISED, which needs the whole image.
+     */
+    unsigned int    pngBandHeight;
+
+    /** Pen colours that will be used, in the order that they are first
+     * used, or NULL.  Colours are otherwise allocated as they are drawn
+     * with, but a palette image drawn in bands needs its palette before
+     * the first band is written.
+     */
+    const ADrawColour *colours;
+    unsigned int    nColours;
+
+    /** If true, SVG output is written in a compact form.  A style sheet
+     * gives the font and the usual colours, other colours are given by
+     * classes, solid lines are joined into paths with relative co-ordinates
+     * and each shape of arrow head is defined once and then reused.
+     */
+    bool            svgCompact;
+
+    /** The last row of each page of PDF output, or NULL to write the whole
+     * chart on one page.  Pages must cover the chart from top to bottom.
+     */
+    const unsigned int *pdfPageEnd;
+    unsigned int    nPdfPages;
+}
+ADrawOpts;
+
+
+/** A cache of text widths.
+ * This memoises the widths returned by the backends, keyed by the output
+ * type, font name, font size and string.  A cache may be shared by several
+ * metrics contexts in turn, but must not be used by more than one thread
+ * at a time.
+ */
+typedef struct ADrawTextCacheTag ADrawTextCache;
+
+
+/** A recorded list of drawing operations.
+ * A drawing context opened with ADrawOpenList() records each operation into
+ * the list, which can then be replayed into any number of other drawing
+ * contexts with ADrawListReplay().  Text is stored by value, so the list
+ * does not reference any of the strings that were passed to it.
+ */
+typedef struct ADrawListTag ADrawList;
+
+
+/** Text metrics for some output type.
+ * This measures text as a drawing context of the same type and font would,
+ * but without creating any image or output.  This allows a chart to be laid
+ * out before the drawing context is opened with the final dimensions.
+ * ADrawOpenMetrics() returns an instance of this structure, and close()
+ * should be called once measuring is complete.
+ */
+typedef struct ADrawMetricsTag
+{
+    /** Get the width of some text in the current font size.
+     * \param ctx     The metrics context.
+     * \param string  The text to measure.
+     */
+    unsigned int (*textWidth)     (struct ADrawMetricsTag *ctx,
+                                   const char *string);
+
+    /** Get the height of text in the current font size.
+     * \param ctx     The metrics context.
+     */
+    int          (*textHeight)    (struct ADrawMetricsTag *ctx);
+
+    void         (*setFontSize)   (struct ADrawMetricsTag *ctx,
+                                   ADrawFontSize size);
+
+    /** Free the metrics context.
+     * \returns  false if some measurement failed.
+     */
+    bool         (*close)         (struct ADrawMetricsTag *ctx);
+
+    /* Internal context, not accessible by the user */
+    void *internal;
+
+    /* Text width cache state, also internal */
+    ADrawTextCache *textCache;
+    unsigned int    textCacheFont;
+    ADrawFontSize   fontSize;
+    unsigned int  (*uncachedTextWidth)(struct ADrawMetricsTag *ctx, const char *string);
+    void          (*uncachedSetFontSize)(struct ADrawMetricsTag *ctx, ADrawFontSize size);
+}
+ADrawMetrics;
+
+
 /** An ADraw context.
  * This is the main structure used for accessing ADraw functions.
  * ADrawOpen() returns an instance of this structure that can then be used
@@ -241,10 +393,33 @@ typedef struct ADrawTag
     void         (*setFontSize)   (struct ADrawTag *ctx,
                                    ADrawFontSize size);
 
+    /** Select the band of rows to draw to.
+     * This is only set for backends opened to draw in bands, and is NULL
+     * otherwise.  Bands must cover the image from top to bottom, each
+     * starting on the row after the last unless drawn by several contexts
+     * opened with ADrawOpenBand(), and drawing outside the current band is
+     * discarded.  Each band is written out once the next is
+     * selected, or the context is closed.
+     * \param ctx    The drawing context.
+     * \param ymin   The first row of the band.
+     * \param ymax   The last row of the band.
+     * \returns      false if the band could not be selected.
+     */
+    bool         (*setBand)       (struct ADrawTag *ctx,
+                                   unsigned int ymin,
+                                   unsigned int ymax);
+
     bool         (*close)         (struct ADrawTag *context);
 
     /* Internal context, not accessible by the user */
     void *internal;
+
+    /* Metrics used to measure text, also internal */
+    ADrawMetrics   *metrics;
+    void          (*backendSetFontSize)(struct ADrawTag *ctx, ADrawFontSize size);
+
+    /* Pen and font state not yet passed to the backend, also internal */
+    struct ADrawStateTag *state;
 }
 ADraw;
 
@@ -252,28 +427,183 @@ ADraw;
  * Functions
  ***************************************************************************/
 
+/** Perform one time initialisation of the drawing backends.
+ * This must be called before drawing contexts are used concurrently from
+ * multiple threads.
+ *
+ * \returns  On error, \a false will be returned.
+ */
+bool ADrawInit(void);
+
 /** Create a new drawing context.
  * This will create a drawing context with some dimensions, and some format.
  * After this has been called, the function pointers in the returned structure
  * can be called together with a pointer to the structure itself to cause
  * image functions to be executed.
  *
+ * Every context starts with a black pen, white background pen and small
+ * font.  Changes to these are only passed to the backend when they differ
+ * from its current state and some drawing uses them, so redundant changes
+ * cost nothing.
+ *
  * \param[in] w                The width of the output image.
  * \param[in] h                The height of the ouput image.
- * \param[in] file             The file to which the image should be written.
+ * \param[in] out              The sink to which the image should be written.
+ *                              This remains owned by the caller and is not
+ *                              flushed or destroyed by the drawing context.
  * \param[in] fontName         The name of the font to use for rendering.
  * \param[in] type             The output type to generate.
+ * \param[in] metrics          Metrics opened with the same font and type,
+ *                              which are then used to measure text, or NULL.
+ *                              These must remain open until the context is
+ *                              closed.
+ * \param[in] opts             Options for the backend, or NULL for the
+ *                              defaults.
  * \param[in, out] *outContext Pointer to an \a ADraw structure to populate
  *                              with values.
  * \returns                    On error, \a false will be returned.
  */
 bool ADrawOpen(unsigned int     w,
                unsigned int     h,
-               const char      *file,
+               Sink             out,
                const char      *fontName,
                ADrawOutputType  type,
+               ADrawMetrics    *metrics,
+               const ADrawOpts *opts,
                struct ADrawTag *outContext);
 
+/** Create a context drawing bands of a PNG image for another context.
+ * This allows the bands of a large image to be drawn by several threads,
+ * each with its own band context, while \a image writes the PNG.  Each
+ * context may skip the bands drawn by others, and a band is only written
+ * once all the rows above it have been, so setBand() and close() wait for
+ * other contexts to write those rows.
+ *
+ * Bands must therefore be handed out in order, such as by each context
+ * taking the next band from a shared counter.  All band contexts must be
+ * closed before \a image, which should not draw while they are open.
+ *
+ * \param[in] image            A context opened with ADrawOpen() for PNG
+ *                              output and drawn in bands, whose setBand()
+ *                              is set.
+ * \param[in] metrics          Metrics for the PNG output, used as for
+ *                              ADrawOpen().
+ * \param[in, out] *outContext Pointer to an \a ADraw structure to populate
+ *                              with values.
+ * \returns                    On error, \a false will be returned.
+ */
+bool ADrawOpenBand(struct ADrawTag *image,
+                   ADrawMetrics    *metrics,
+                   struct ADrawTag *outContext);
+
+/** Create a text metrics context.
+ * This gives the same text measurements as a drawing context opened with
+ * the same font and type, but without creating any output.
+ *
+ * \param[in] fontName         The name of the font to use for rendering.
+ * \param[in] type             The output type that is to be generated.
+ * \param[in] textCache        Cache to use for text widths, or NULL.  This
+ *                              must remain valid until the context is closed.
+ * \param[in, out] *outMetrics Pointer to an \a ADrawMetrics structure to
+ *                              populate with values.
+ * \returns                    On error, \a false will be returned.
+ */
+bool ADrawOpenMetrics(const char      *fontName,
+                      ADrawOutputType  type,
+                      ADrawTextCache  *textCache,
+                      ADrawMetrics    *outMetrics);
+
+/** Create a drawing context that records to a display list.
+ * The context has no dimensions or output, and measures text using the
+ * passed metrics.  Operations are appended to \a list, which remains owned
+ * by the caller and may be replayed once the context is closed.
+ *
+ * \param[in] list             The list to record into.
+ * \param[in] metrics          Metrics for the output type that the list will
+ *                              be replayed to.  These must remain open until
+ *                              the context is closed.
+ * \param[in, out] *outContext Pointer to an \a ADraw structure to populate
+ *                              with values.
+ * \returns                    On error, \a false will be returned.
+ */
+bool ADrawOpenList(ADrawList       *list,
+                   ADrawMetrics    *metrics,
+                   struct ADrawTag *outContext);
+
+/** Create an empty display list.
+ *
+ * \returns  The list, or NULL on error.
+ */
+ADrawList *ADrawListCreate(void);
+
+/** Free a display list.
+ */
+void ADrawListDestroy(ADrawList *list);
+
+/** Replay a display list into some drawing context.
+ * The operations are made in the order that they were recorded.
+ *
+ * \param[in] list  The list to replay.
+ * \param[in] ctx   The drawing context to replay into.
+ * \returns  false if the list is incomplete because recording failed.
+ */
+bool ADrawListReplay(const ADrawList *list, struct ADrawTag *ctx);
+
+/** Replay the parts of a display list that may draw to some rows.
+ * The list is indexed by the rows each run of operations may touch, so
+ * this skips most of the list when drawing one band of a tall image.
+ * Operations outside the rows may still be replayed, so \a ctx should
+ * discard drawing outside the band.  The pen and font are set as they
+ * were recorded before each run that is replayed.
+ *
+ * \param[in] list  The list to replay.
+ * \param[in] ctx   The drawing context to replay into.
+ * \param[in] ymin  The first row to draw.
+ * \param[in] ymax  The last row to draw.
+ * \returns  false if the list is incomplete because recording failed.
+ */
+bool ADrawListReplayBand(const ADrawList *list,
+                         struct ADrawTag *ctx,
+                         unsigned int     ymin,
+                         unsigned int     ymax);
+
+/** Get the pen colours used by a display list.
+ * The colours are given in the order that they are first set.
+ *
+ * \param[in]     list      The list.
+ * \param[in,out] nColours  Pointer to be filled with the count of colours.
+ * \returns  The colours, which remain owned by the list.
+ */
+const ADrawColour *ADrawListGetColours(const ADrawList *list, unsigned int *nColours);
+
+/** Get the output type whose text metrics are used for some output type.
+ * Output types that measure text identically give the same type, so that
+ * a chart laid out for one may be drawn to any of them.
+ *
+ * \param[in] type  The output type.
+ */
+ADrawOutputType ADrawGetMetricsType(ADrawOutputType type);
+
+/** Create an empty text width cache.
+ *
+ * \returns  The cache, or NULL on error.
+ */
+ADrawTextCache *ADrawTextCacheCreate(void);
+
+/** Free a text width cache.
+ */
+void ADrawTextCacheDestroy(ADrawTextCache *cache);
+
+/** Get the count of cache hits and misses for some text width cache.
+ *
+ * \param[in]     cache   The cache to query.
+ * \param[in,out] hits    Pointer to be filled with the number of hits.
+ * \param[in,out] misses  Pointer to be filled with the number of misses.
+ */
+void ADrawTextCacheStats(const ADrawTextCache *cache,
+                         unsigned long        *hits,
+                         unsigned long        *misses);
+
 /** Given a string name for a colour, return the corresponding ADrawColour.
  *
  * \param[in] colour  The string representation of the colour that is sought.
@@ -44,22 +44,47 @@
 
 bool NullInit(struct ADrawTag *outContext);
 
+bool NullMetricsInit(ADrawMetrics *outMetrics);
+
+bool GdoGlobalInit(void);
+
 bool GdoInit(unsigned int     w,
              unsigned int     h,
-             const char      *file,
+             Sink             out,
              const char      *fontName,
+             const ADrawOpts *opts,
              struct ADrawTag *outContext);
 
+bool GdoInitBand(struct ADrawTag *image, struct ADrawTag *outContext);
+
+bool GdoMetricsInit(const char *fontName, ADrawMetrics *outMetrics);
+
 bool PsInit(unsigned int     w,
             unsigned int     h,
-            const char      *file,
+            Sink             out,
             struct ADrawTag *outContext);
 
+bool PsMetricsInit(ADrawMetrics *outMetrics);
+
 bool SvgInit(unsigned int     w,
              unsigned int     h,
-             const char      *file,
+             Sink             out,
+             const ADrawOpts *opts,
+             bool             gzip,
              struct ADrawTag *outContext);
 
+bool SvgMetricsInit(ADrawMetrics *outMetrics);
+
+bool PdfInit(unsigned int     w,
+             unsigned int     h,
+             Sink             out,
+             const ADrawOpts *opts,
+             struct ADrawTag *outContext);
+
+bool PdfMetricsInit(ADrawMetrics *outMetrics);
+
+bool ListInit(ADrawList *list, struct ADrawTag *outContext);
+
 #endif /* ADRAW_INT_H */
 
 /* END OF FILE */
@@ -0,0 +1,261 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * Arena memory allocator.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "safe.h"
+#include "arena.h"
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/** Size of the first chunk in an arena. */
+#define ARENA_MIN_CHUNK  4096
+
+/** Largest size to which chunks grow, aside from chunks for large requests. */
+#define ARENA_MAX_CHUNK  (1024 * 1024)
+
+/** Round some size up to the arena alignment. */
+#define ARENA_ROUND(s)   (((s) + sizeof(ArenaAlign) - 1) & ~(sizeof(ArenaAlign) - 1))
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/** Union of types with the strictest alignment requirements.
+ */
+typedef union
+{
+    long double ld;
+    long long   ll;
+    void       *p;
+    void      (*fn)(void);
+}
+ArenaAlign;
+
+/** Header at the start of each chunk.
+ */
+typedef struct ArenaChunkTag
+{
+    struct ArenaChunkTag *next;
+
+    /** Total size of the chunk, including this header. */
+    size_t                size;
+}
+ArenaChunk;
+
+struct ArenaTag
+{
+    /** List of chunks, most recent first. */
+    ArenaChunk   *chunks;
+
+    /** Next free byte in the current chunk, and the bytes remaining. */
+    char         *pos;
+    size_t        remaining;
+
+    /** The last allocation, which may be extended in place. */
+    char         *last;
+
+    /** Size of the next chunk to allocate. */
+    size_t        nextChunkSize;
+};
+
+/*****************************************************************************
+ * Local Function Definitions
+ *****************************************************************************/
+
+/** Add a new chunk to some arena, large enough for \a size bytes.
+ *
+ * \retval false  If the chunk could not be allocated.
+ */
+static bool addChunk(Arena a, size_t size)
+{
+    const size_t hdr = ARENA_ROUND(sizeof(ArenaChunk));
+    size_t       chunkSize = a->nextChunkSize;
+    ArenaChunk  *c;
+
+    if(size > SIZE_MAX - hdr)
+    {
+        return false;
+    }
+    else if(chunkSize < hdr + size)
+    {
+        chunkSize = hdr + size;
+    }
+
+    c = blockalloc_s(chunkSize);
+    if(c == NULL)
+    {
+        return false;
+    }
+
+    /* Only grow the chunk size once a chunk of the current size is held */
+    if(chunkSize == a->nextChunkSize && a->nextChunkSize < ARENA_MAX_CHUNK)
+    {
+        a->nextChunkSize *= 2;
+    }
+
+    c->size = chunkSize;
+    c->next = a->chunks;
+
+    a->chunks    = c;
+    a->pos       = (char *)c + hdr;
+    a->remaining = chunkSize - hdr;
+    a->last      = NULL;
+
+    return true;
+}
+
+/*****************************************************************************
+ * Global Function Definitions
+ *****************************************************************************/
+
+Arena ArenaCreate(void)
+{
+    struct ArenaTag proto;
+    Arena           a;
+
+    memset(&proto, 0, sizeof(proto));
+    proto.nextChunkSize = ARENA_MIN_CHUNK;
+
+    /* Place the arena itself in its first chunk */
+    if(!addChunk(&proto, ARENA_ROUND(sizeof(struct ArenaTag))))
+    {
+        return NULL;
+    }
+
+    a = (Arena)proto.pos;
+    *a = proto;
+    a->pos       += ARENA_ROUND(sizeof(struct ArenaTag));
+    a->remaining -= ARENA_ROUND(sizeof(struct ArenaTag));
+
+    return a;
+}
+
+
+void ArenaDestroy(Arena a)
+{
+    ArenaChunk *c = a->chunks;
+
+    /* The arena itself is held in the oldest chunk, which is freed last */
+    while(c != NULL)
+    {
+        ArenaChunk *next = c->next;
+
+        blockfree_s(c, c->size);
+        c = next;
+    }
+}
+
+
+void *ArenaAlloc(Arena a, size_t size)
+{
+    void *r;
+
+    if(size > SIZE_MAX - sizeof(ArenaAlign))
+    {
+        return NULL;
+    }
+
+    size = ARENA_ROUND(size > 0 ? size : 1);
+
+    if(size > a->remaining && !addChunk(a, size))
+    {
+        return NULL;
+    }
+
+    r = a->pos;
+    a->last       = a->pos;
+    a->pos       += size;
+    a->remaining -= size;
+
+    return r;
+}
+
+
+void *ArenaZalloc(Arena a, size_t size)
+{
+    void *r = ArenaAlloc(a, size);
+
+    if(r != NULL)
+    {
+        memset(r, 0, size);
+    }
+
+    return r;
+}
+
+
+void *ArenaRealloc(Arena a, void *ptr, size_t oldSize, size_t newSize)
+{
+    void *r;
+
+    if(ptr == NULL || newSize > SIZE_MAX - sizeof(ArenaAlign))
+    {
+        return ArenaAlloc(a, newSize);
+    }
+
+    /* Extend in place if this was the last allocation and there is room */
+    if(ptr == a->last)
+    {
+        const size_t oldRounded = ARENA_ROUND(oldSize > 0 ? oldSize : 1);
+        const size_t newRounded = ARENA_ROUND(newSize > 0 ? newSize : 1);
+
+        if(newRounded <= oldRounded)
+        {
+            return ptr;
+        }
+        else if(newRounded - oldRounded <= a->remaining)
+        {
+            a->pos       += newRounded - oldRounded;
+            a->remaining -= newRounded - oldRounded;
+            return ptr;
+        }
+    }
+
+    r = ArenaAlloc(a, newSize);
+    if(r != NULL)
+    {
+        memcpy(r, ptr, oldSize < newSize ? oldSize : newSize);
+    }
+
+    return r;
+}
+
+
+char *ArenaStrdup(Arena a, const char *s)
+{
+    const size_t l = strlen(s) + 1;
+    char        *r = ArenaAlloc(a, l);
+
+    return r != NULL ? memcpy(r, s, l) : NULL;
+}
+
+/* END OF FILE */
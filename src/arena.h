@@ -0,0 +1,97 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * Arena memory allocator.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stddef.h>
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/** An arena from which many small allocations can be made.
+ * Memory is handed out from large chunks obtained with blockalloc_s(), and
+ * is only released when the whole arena is destroyed.  An arena is not
+ * thread safe, but different arenas may be used concurrently.
+ */
+typedef struct ArenaTag *Arena;
+
+/*****************************************************************************
+ * Global Variable Declarations
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Global Function Declarations
+ *****************************************************************************/
+
+/** Create a new, empty arena.
+ *
+ * \returns  The arena, or NULL if memory could not be allocated.
+ */
+Arena ArenaCreate(void);
+
+/** Release an arena and all memory allocated from it.
+ */
+void  ArenaDestroy(Arena a);
+
+/** Allocate memory from an arena.
+ * The memory is aligned suitably for any type.
+ *
+ * \returns  The memory, or NULL if no more could be obtained from
+ *            blockalloc_s(), in which case the arena is left unchanged.
+ */
+void *ArenaAlloc(Arena a, size_t size);
+
+/** Allocate zeroed memory from an arena, or return NULL on failure.
+ */
+void *ArenaZalloc(Arena a, size_t size);
+
+/** Resize some memory allocated from an arena.
+ * The contents are copied to a new allocation if the memory can't be
+ * extended in place.
+ *
+ * \param[in] a        The arena from which \a ptr was allocated.
+ * \param[in] ptr      The memory to resize, or NULL.
+ * \param[in] oldSize  The size of the memory at \a ptr.
+ * \param[in] newSize  The size required.
+ * \returns  The resized memory, or NULL on failure in which case \a ptr is
+ *            left intact.
+ */
+void *ArenaRealloc(Arena a, void *ptr, size_t oldSize, size_t newSize);
+
+/** Duplicate a string into an arena, or return NULL on failure.
+ */
+char *ArenaStrdup(Arena a, const char *s);
+
+#endif /* ARENA_H */
+
+/* END OF FILE */
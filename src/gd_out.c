@@ -32,12 +32,16 @@
 #ifdef HAVE_LIMITS_H
 #include <limits.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #include "gd.h"
 #ifndef USE_FREETYPE
 #include "gdfontt.h"  /* Tiny font */
 #include "gdfonts.h"  /* Small font */
 #endif
 #include "adraw_int.h"
+#include "pngenc.h"
 #include "safe.h"
 
 /***************************************************************************
@@ -56,6 +60,12 @@ typedef struct GdoContextTag
 #ifdef USE_FREETYPE
     double      fontPoints;
     const char *fontName;
+
+    /** The current font size. */
+    ADrawFontSize fontSize;
+
+    /** Text height for each font size, or 0 if not yet measured. */
+    int         fontHeight[ADRAW_FONT_SMALL + 1];
 #else
     gdFontPtr   font;
 #endif
@@ -77,7 +87,59 @@ typedef struct GdoContextTag
     /** Background colour for rendering text. */
     int         bgpen;
 
-    FILE       *outFile;
+    /** The pen for which the dashed style was last set. */
+    int         stylePen;
+
+    Sink        out;
+
+    /** How the image is drawn and stored. */
+    ADrawPngColour colourMode;
+
+    /** zlib compression level, or -1 for the default. */
+    int         level;
+
+    /** Row filter used when storing the image. */
+    ADrawPngFilter filter;
+
+    /** The context that writes the PNG, which is this context unless it
+     *  was opened with GdoInitBand() to draw bands for another.
+     */
+    struct GdoContextTag *image;
+
+    /** The encoder, once the first rows have been written. */
+    PngEnc      enc;
+
+    /** The next row to be given to the encoder. */
+    unsigned int nextRow;
+
+#ifdef HAVE_PTHREAD_H
+    /** Guards the encoder when bands are drawn by several contexts, each of
+     *  which waits on \a written until the rows above its band are written.
+     */
+    pthread_mutex_t lock;
+    pthread_cond_t  written;
+#endif
+
+    /** Rows held in memory when drawing in bands, or 0 if the whole image
+     *  is held.
+     */
+    unsigned int bandHeight;
+
+    /** Rows of the current band, and the row at which the next starts. */
+    unsigned int bandMin, bandMax, bandNext;
+    bool        haveBand;
+
+    /** Memory for the rows of a band.
+     * While drawing in bands, the image has a row pointer for every row of
+     *  the output so that drawing is unchanged.  The rows of the current
+     *  band point into this memory, and all others at a scratch row which
+     *  absorbs anything drawn outside of the band.
+     */
+    void      **bandRows;
+    void       *sinkRow;
+
+    /** Set if a rendering error has occurred. */
+    bool        failed;
 }
 GdoContext;
 
@@ -120,6 +182,23 @@ static int getGdoPen(struct ADrawTag *ctx)
 }
 
 
+/** Get the pen for drawing anti-aliased shapes from an ADraw structure.
+ * Palette images can't be anti-aliased, so use the plain pen for them.
+ */
+static int getGdoAaPen(struct ADrawTag *ctx)
+{
+    GdoContext *context = getGdoCtx(ctx);
+
+    if(!gdImageTrueColor(context->img))
+    {
+        return context->pen;
+    }
+
+    gdImageSetAntiAliased(context->img, context->pen);
+    return gdAntiAliased;
+}
+
+
 /** Given a colour value, convert to a gd colour reference.
  * This searches the current pallette of colours for the passed colour and
  * returns an existing reference if possible.  Otherwise a new colour reference
@@ -160,6 +239,22 @@ static int getColourRef(GdoContext *context, ADrawColour col)
 }
 
 
+#ifdef USE_FREETYPE
+/** Record a FreeType rendering error.
+ * The first error is reported on stderr and causes gdoClose() to fail; later
+ * errors are suppressed since they are likely to have the same cause.
+ */
+static void ftFail(GdoContext *context, const char *func, const char *r)
+{
+    if(!context->failed)
+    {
+        fprintf(stderr, "Error: %s: %s (GDFONTPATH=%s)\n", func, r, getenv_s("GDFONTPATH"));
+        context->failed = true;
+    }
+}
+#endif
+
+
 /** Set the dashed style.
  */
 static void setStyle(struct ADrawTag *ctx)
@@ -167,6 +262,15 @@ static void setStyle(struct ADrawTag *ctx)
     GdoContext *context = getGdoCtx(ctx);
     int         style[4];
 
+    /* The pattern only changes with the pen, but always restarts */
+    if(context->img->style != NULL && context->stylePen == context->pen)
+    {
+        context->img->stylePos = 0;
+        return;
+    }
+
+    context->stylePen = context->pen;
+
     /* Create dash pattern */
     style[0] = style[1] = context->pen;
     style[2] = style[3] = getColourRef(context, ADRAW_COL_WHITE);
@@ -174,12 +278,9 @@ static void setStyle(struct ADrawTag *ctx)
     gdImageSetStyle(context->img, style, 4);
 }
 
-/***************************************************************************
- * API Functions
- ***************************************************************************/
-
-unsigned int gdoTextWidth(struct ADrawTag *ctx,
-                          const char *string)
+/** Measure the width of some text in the current font.
+ */
+static unsigned int measureWidth(GdoContext *context, const char *string)
 {
 #ifndef USE_FREETYPE
     const unsigned int l = strlen(string);
@@ -188,9 +289,8 @@ unsigned int gdoTextWidth(struct ADrawTag *ctx,
      *  the right of the last character for the fixed width
      *  font.
      */
-    return l == 0 ? 0 : (getGdoCtx(ctx)->font->w * l) - 1;
+    return l == 0 ? 0 : (context->font->w * l) - 1;
 #else
-    GdoContext *context = getGdoCtx(ctx);
     int         rect[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
     const char *r;
 
@@ -204,8 +304,8 @@ unsigned int gdoTextWidth(struct ADrawTag *ctx,
                         (char *)string);
     if(r)
     {
-        fprintf(stderr, "Error: gdoTextWidth: %s (GDFONTPATH=%s)\n", r, getenv_s("GDFONTPATH"));
-        exit(EXIT_FAILURE);
+        ftFail(context, "gdoTextWidth", r);
+        return 0;
     }
 
     /* Remove 1 pixel since there is usually an uneven gap at
@@ -217,15 +317,22 @@ unsigned int gdoTextWidth(struct ADrawTag *ctx,
 }
 
 
-int gdoTextHeight(struct ADrawTag *ctx)
+/** Measure the height of text in the current font.
+ */
+static int measureHeight(GdoContext *context)
 {
 #ifndef USE_FREETYPE
-    return getGdoCtx(ctx)->font->h;
+    return context->font->h;
 #else
-    GdoContext *context = getGdoCtx(ctx);
     int         rect[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
     const char *r;
 
+    /* The font is fixed for the context, so only measure each size once */
+    if(context->fontHeight[context->fontSize] != 0)
+    {
+        return context->fontHeight[context->fontSize];
+    }
+
     r = gdImageStringFT(NULL,
                         rect,
                         context->pen,
@@ -236,12 +343,467 @@ int gdoTextHeight(struct ADrawTag *ctx)
                         "gHELLOWt");
     if(r)
     {
-        fprintf(stderr, "Error: gdoTextHeight: %s (GDFONTPATH=%s)\n", r, getenv_s("GDFONTPATH"));
-        exit(EXIT_FAILURE);
+        ftFail(context, "gdoTextHeight", r);
+        return 0;
+    }
+
+    context->fontHeight[context->fontSize] = (-rect[5]) + 1;
+
+    return context->fontHeight[context->fontSize];
+#endif
+}
+
+
+/** Select the font for some size.
+ */
+static void selectFont(GdoContext *context, ADrawFontSize size)
+{
+#ifdef USE_FREETYPE
+    context->fontSize = size;
+#endif
+
+    switch(size)
+    {
+#ifdef USE_FREETYPE
+        case ADRAW_FONT_TINY:
+            context->fontPoints = 9.0;
+            break;
+
+        case ADRAW_FONT_SMALL:
+            context->fontPoints = 11.0;
+            break;
+#else
+        case ADRAW_FONT_TINY:
+            context->font = gdFontGetTiny();
+            break;
+
+        case ADRAW_FONT_SMALL:
+            context->font = gdFontGetSmall();
+            break;
+#endif
+        default:
+            assert(0);
+    }
+}
+
+/** Get the rows of the image that drawing can change.
+ * When drawing in bands, this is the current band.
+ * \retval false  If no rows can be changed.
+ */
+static bool getDrawRows(GdoContext *context, unsigned int *ymin, unsigned int *ymax)
+{
+    if(context->bandHeight == 0)
+    {
+        *ymin = 0;
+        *ymax = gdImageSY(context->img) - 1;
+        return true;
+    }
+
+    *ymin = context->bandMin;
+    *ymax = context->bandMax;
+    return context->haveBand;
+}
+
+
+/** Order the ends of a span and clip it to some limits.
+ * \retval false  If none of the span is within the limits.
+ */
+static bool clipSpan(unsigned int *a, unsigned int *b, unsigned int lo, unsigned int hi)
+{
+    if(*a > *b)
+    {
+        swap(a, b);
+    }
+
+    if(*b < lo || *a > hi)
+    {
+        return false;
+    }
+
+    if(*a < lo) *a = lo;
+    if(*b > hi) *b = hi;
+
+    return true;
+}
+
+
+/** Set a pixel, as gdImageSetPixel() does for an opaque colour.
+ */
+static void setPixel(gdImagePtr img, unsigned int x, unsigned int y, int col)
+{
+    if(gdImageTrueColor(img))
+    {
+        img->tpixels[y][x] = col;
+    }
+    else
+    {
+        img->pixels[y][x] = col;
+    }
+}
+
+
+/** Fill part of a row with a colour.
+ * The simple loop is vectorised by the compiler for full colour images.
+ */
+static void fillSpan(gdImagePtr img, unsigned int y, unsigned int x1, unsigned int x2, int col)
+{
+    if(gdImageTrueColor(img))
+    {
+        int *const   row = img->tpixels[y];
+        unsigned int x;
+
+        for(x = x1; x <= x2; x++)
+        {
+            row[x] = col;
+        }
+    }
+    else
+    {
+        memset(&img->pixels[y][x1], col, x2 - x1 + 1);
+    }
+}
+
+
+/** Draw a horizontal line, solid or with the dashed style.
+ * This gives the same pixels as gdImageLine(), which draws axis aligned
+ *  lines without anti-aliasing and starts the dashes from the left most
+ *  pixel in the image, but without the cost of setting each pixel.
+ */
+static void drawHLine(GdoContext  *context,
+                      unsigned int y,
+                      unsigned int x1,
+                      unsigned int x2,
+                      bool         dotted)
+{
+    gdImagePtr   img = context->img;
+    unsigned int ymin, ymax, x;
+
+    if(!getDrawRows(context, &ymin, &ymax) || y < ymin || y > ymax ||
+       !clipSpan(&x1, &x2, 0, gdImageSX(img) - 1))
+    {
+        return;
+    }
+
+    if(!dotted)
+    {
+        fillSpan(img, y, x1, x2, context->pen);
+    }
+    else
+    {
+        const int white = getColourRef(context, ADRAW_COL_WHITE);
+
+        for(x = x1; x <= x2; x++)
+        {
+            setPixel(img, x, y, ((x - x1) & 2) == 0 ? context->pen : white);
+        }
     }
+}
+
+
+/** Draw a vertical line, solid or with the dashed style.
+ * As drawHLine(), with dashes starting from the top most pixel in the image.
+ */
+static void drawVLine(GdoContext  *context,
+                      unsigned int x,
+                      unsigned int y1,
+                      unsigned int y2,
+                      bool         dotted)
+{
+    gdImagePtr   img = context->img;
+    const int    off = dotted ? getColourRef(context, ADRAW_COL_WHITE) : context->pen;
+    unsigned int ymin, ymax, start, y;
+
+    if(x >= (unsigned)gdImageSX(img) || !clipSpan(&y1, &y2, 0, gdImageSY(img) - 1))
+    {
+        return;
+    }
+
+    start = y1;
+
+    if(!getDrawRows(context, &ymin, &ymax) || !clipSpan(&y1, &y2, ymin, ymax))
+    {
+        return;
+    }
+
+    for(y = y1; y <= y2; y++)
+    {
+        setPixel(img, x, y, ((y - start) & 2) == 0 ? context->pen : off);
+    }
+}
+
+
+/** Check if a line is horizontal or vertical, but not a single point.
+ */
+static bool isAxisAligned(unsigned int x1, unsigned int y1, unsigned int x2, unsigned int y2)
+{
+    return (x1 == x2) != (y1 == y2);
+}
+
+
+/** Get the encoder filter for some filter option.
+ */
+static PngEncFilter getPngFilter(ADrawPngFilter filter, bool rgb)
+{
+    switch(filter)
+    {
+        case ADRAW_PNG_FILTER_NONE:     return PNGENC_FILTER_NONE;
+        case ADRAW_PNG_FILTER_SUB:      return PNGENC_FILTER_SUB;
+        case ADRAW_PNG_FILTER_UP:       return PNGENC_FILTER_UP;
+        case ADRAW_PNG_FILTER_AVERAGE:  return PNGENC_FILTER_AVERAGE;
+        case ADRAW_PNG_FILTER_PAETH:    return PNGENC_FILTER_PAETH;
+        case ADRAW_PNG_FILTER_ADAPTIVE: return PNGENC_FILTER_ADAPTIVE;
+        default:
+            /* Palette indices don't predict well, so aren't filtered */
+            return rgb ? PNGENC_FILTER_ADAPTIVE : PNGENC_FILTER_NONE;
+    }
+}
+
+
+/** Start writing the image as a PNG.
+ */
+static bool startPng(GdoContext *context)
+{
+    gdImagePtr         img = context->img;
+    const bool         rgb = gdImageTrueColor(img);
+    unsigned char      palette[PNGENC_MAX_COLOURS * 3];
+    unsigned int       nColours = 0, t;
+
+    if(!rgb)
+    {
+        nColours = gdImageColorsTotal(img);
+        for(t = 0; t < nColours; t++)
+        {
+            palette[t * 3 + 0] = gdImageRed(img, t);
+            palette[t * 3 + 1] = gdImageGreen(img, t);
+            palette[t * 3 + 2] = gdImageBlue(img, t);
+        }
+    }
+
+    context->enc = PngEncCreate(context->out, gdImageSX(img), gdImageSY(img),
+                                rgb ? NULL : palette, nColours,
+                                context->level, getPngFilter(context->filter, rgb));
+
+    return context->enc != NULL;
+}
+
+
+/** Write some rows drawn by a context to the PNG of its image.
+ * The rows must be the next that the image needs.
+ */
+static bool writeRows(GdoContext *context, unsigned int ymin, unsigned int ymax)
+{
+    GdoContext        *image = context->image;
+    gdImagePtr         img = context->img;
+    const unsigned int w   = gdImageSX(img);
+    unsigned char     *row = NULL;
+    unsigned int       x, y;
+    bool               ok = true;
+
+    if(ymin != image->nextRow)
+    {
+        fprintf(stderr, "writeRows: Rows from %u written out of order\n", ymin);
+        return false;
+    }
+
+    if(image->enc == NULL && !startPng(image))
+    {
+        return false;
+    }
+
+    if(gdImageTrueColor(img))
+    {
+        row = malloc(w * 3);
+        if(row == NULL)
+        {
+            fprintf(stderr, "writeRows: Failed to allocate row\n");
+            return false;
+        }
+    }
+
+    for(y = ymin; y <= ymax && ok; y++)
+    {
+        if(row != NULL)
+        {
+            const int *p = img->tpixels[y];
+
+            for(x = 0; x < w; x++)
+            {
+                row[x * 3 + 0] = gdTrueColorGetRed(p[x]);
+                row[x * 3 + 1] = gdTrueColorGetGreen(p[x]);
+                row[x * 3 + 2] = gdTrueColorGetBlue(p[x]);
+            }
+
+            ok = PngEncRow(image->enc, row);
+        }
+        else
+        {
+            ok = PngEncRow(image->enc, img->pixels[y]);
+        }
+    }
+
+    free(row);
+
+    image->nextRow = ymax + 1;
+
+    return ok;
+}
+
+
+/** Point some row of a banded image at some memory.
+ */
+static void setRow(gdImagePtr img, unsigned int y, void *row)
+{
+    if(gdImageTrueColor(img))
+    {
+        img->tpixels[y] = row;
+    }
+    else
+    {
+        img->pixels[y] = row;
+    }
+}
+
+
+/** Prepare an image to be drawn in bands.
+ * The image is created with the rows of one band, which are then swapped
+ *  for a table of row pointers covering the full height.
+ */
+static bool bandInit(GdoContext *context, unsigned int h)
+{
+    gdImagePtr         img = context->img;
+    const bool         rgb = gdImageTrueColor(img);
+    void             **rows;
+    unsigned int       y;
+
+    rows             = malloc(h * sizeof(void *));
+    context->sinkRow = calloc(gdImageSX(img), rgb ? sizeof(int) : 1);
+    if(rows == NULL || context->sinkRow == NULL)
+    {
+        free(rows);
+        free(context->sinkRow);
+        return false;
+    }
+
+    context->bandRows = rgb ? (void **)img->tpixels : (void **)img->pixels;
+    if(rgb)
+    {
+        img->tpixels = (int **)rows;
+    }
+    else
+    {
+        img->pixels = (unsigned char **)rows;
+    }
+    img->sy = h;
+
+    for(y = 0; y < h; y++)
+    {
+        setRow(img, y, context->sinkRow);
+    }
+
+    /* Anti-aliased lines are clipped before drawing, which could move them
+     *  if clipped to a band, so draw to the full image
+     */
+    gdImageSetClip(img, 0, 0, gdImageSX(img) - 1, h - 1);
+
+    return true;
+}
+
+
+/** Write out the current band and return its rows to the scratch row.
+ */
+static bool bandFlush(GdoContext *context)
+{
+    GdoContext  *image = context->image;
+    unsigned int y;
+    bool         ok;
+
+    if(!context->haveBand)
+    {
+        return true;
+    }
+
+#ifdef HAVE_PTHREAD_H
+    /* Other contexts may still be drawing the rows above */
+    pthread_mutex_lock(&image->lock);
+    while(image->nextRow < context->bandMin && !image->failed)
+    {
+        pthread_cond_wait(&image->written, &image->lock);
+    }
+#endif
+
+    ok = !image->failed && writeRows(context, context->bandMin, context->bandMax);
+    if(!ok)
+    {
+        image->failed = true;
+    }
+
+#ifdef HAVE_PTHREAD_H
+    pthread_cond_broadcast(&image->written);
+    pthread_mutex_unlock(&image->lock);
+#endif
+
+    for(y = context->bandMin; y <= context->bandMax; y++)
+    {
+        setRow(context->img, y, context->sinkRow);
+    }
+
+    context->haveBand = false;
+
+    return ok;
+}
+
+
+/** Note that the PNG of some image has failed.
+ * Any contexts waiting to write bands of the image are woken to give up.
+ */
+static void imageFail(GdoContext *image)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&image->lock);
+    image->failed = true;
+    pthread_cond_broadcast(&image->written);
+    pthread_mutex_unlock(&image->lock);
+#else
+    image->failed = true;
+#endif
+}
+
+
+/** Restore the image's own rows, ready for it to be destroyed.
+ */
+static void bandFree(GdoContext *context)
+{
+    gdImagePtr img = context->img;
+
+    if(gdImageTrueColor(img))
+    {
+        free(img->tpixels);
+        img->tpixels = (int **)context->bandRows;
+    }
+    else
+    {
+        free(img->pixels);
+        img->pixels = (unsigned char **)context->bandRows;
+    }
+    img->sy = context->bandHeight;
+
+    free(context->sinkRow);
+}
+
+/***************************************************************************
+ * API Functions
+ ***************************************************************************/
 
-    return (-rect[5]) + 1;
-#endif
+unsigned int gdoTextWidth(struct ADrawTag *ctx,
+                          const char *string)
+{
+    return measureWidth(getGdoCtx(ctx), string);
+}
+
+
+int gdoTextHeight(struct ADrawTag *ctx)
+{
+    return measureHeight(getGdoCtx(ctx));
 }
 
 
@@ -254,6 +816,20 @@ void gdoLine(struct ADrawTag *ctx,
     /* Range check since gdImageLine() takes signed values */
     if(x1 <= INT_MAX && y1 <= INT_MAX && x2 <= INT_MAX && y2 <= INT_MAX)
     {
+        /* Lifelines and most arcs and boxes need no anti-aliasing */
+        if(isAxisAligned(x1, y1, x2, y2))
+        {
+            if(x1 == x2)
+            {
+                drawVLine(getGdoCtx(ctx), x1, y1, y2, false);
+            }
+            else
+            {
+                drawHLine(getGdoCtx(ctx), y1, x1, x2, false);
+            }
+            return;
+        }
+
         /* Anti-aliasing fails if drawing 'backwards' for some octants */
         if(x1 > x2 && abs(x1 - x2) > abs(y1 - y2))
         {
@@ -261,9 +837,8 @@ void gdoLine(struct ADrawTag *ctx,
             swap(&y1, &y2);
         }
 
-        gdImageSetAntiAliased(getGdoImg(ctx), getGdoPen(ctx));
         gdImageLine(getGdoImg(ctx),
-                    x1, y1, x2, y2, gdAntiAliased);
+                    x1, y1, x2, y2, getGdoAaPen(ctx));
     }
 }
 
@@ -274,12 +849,25 @@ void gdoDottedLine(struct ADrawTag *ctx,
                    unsigned int     x2,
                    unsigned int     y2)
 {
-    setStyle(ctx);
-
     /* Range check since gdImageLine() takes signed values */
     if(x1 <= INT_MAX && y1 <= INT_MAX && x2 <= INT_MAX && y2 <= INT_MAX)
     {
-        gdImageLine(getGdoImg(ctx), x1, y1, x2, y2, gdStyled);
+        if(isAxisAligned(x1, y1, x2, y2))
+        {
+            if(x1 == x2)
+            {
+                drawVLine(getGdoCtx(ctx), x1, y1, y2, true);
+            }
+            else
+            {
+                drawHLine(getGdoCtx(ctx), y1, x1, x2, true);
+            }
+        }
+        else
+        {
+            setStyle(ctx);
+            gdImageLine(getGdoImg(ctx), x1, y1, x2, y2, gdStyled);
+        }
     }
 }
 
@@ -297,7 +885,7 @@ void gdoTextR(struct ADrawTag *ctx,
 #endif
     int         textWidth;
 
-    textWidth = gdoTextWidth(ctx, string);
+    textWidth = ctx->textWidth(ctx, string);
 
     /* Range check since gdImageFilledRectangle() takes signed values */
     if(x + textWidth <= INT_MAX && y <= INT_MAX)
@@ -321,8 +909,7 @@ void gdoTextR(struct ADrawTag *ctx,
 
         if(r)
         {
-            fprintf(stderr, "Error: gdoTextR: %s (GDFONTPATH=%s)\n", r, getenv_s("GDFONTPATH"));
-            exit(EXIT_FAILURE);
+            ftFail(context, "gdoTextR", r);
         }
 #else
         gdImageString(getGdoImg(ctx),
@@ -343,7 +930,7 @@ void gdoTextL(struct ADrawTag *ctx,
               const char      *string,
               const char      *url)
 {
-    x -= gdoTextWidth(ctx, string);
+    x -= ctx->textWidth(ctx, string);
 
     /* Range check since gdImageFilledRectangle() takes signed values */
     if(x <= INT_MAX && y <= INT_MAX)
@@ -358,7 +945,7 @@ void gdoTextC(struct ADrawTag *ctx,
               const char      *string,
               const char      *url)
 {
-    gdoTextR(ctx, x - (gdoTextWidth(ctx, string) / 2), y, string, url);
+    gdoTextR(ctx, x - (ctx->textWidth(ctx, string) / 2), y, string, url);
 }
 
 void gdoFilledRectangle(struct ADrawTag *ctx,
@@ -367,18 +954,22 @@ void gdoFilledRectangle(struct ADrawTag *ctx,
                         unsigned int x2,
                         unsigned int y2)
 {
-    gdPoint p[4];
+    GdoContext  *context = getGdoCtx(ctx);
+    gdImagePtr   img = context->img;
+    unsigned int ymin, ymax, y;
 
-    /* Range check since gdPoint contains signed values */
-    if(x1 <= INT_MAX && y1 <= INT_MAX && x2 <= INT_MAX && y2 <= INT_MAX)
+    /* Fill the rows that are drawn, as gdImageFilledPolygon() would fill
+     *  the inclusive rectangle, after the range check it needs since
+     *  gdPoint contains signed values
+     */
+    if(x1 <= INT_MAX && y1 <= INT_MAX && x2 <= INT_MAX && y2 <= INT_MAX &&
+       clipSpan(&x1, &x2, 0, gdImageSX(img) - 1) &&
+       getDrawRows(context, &ymin, &ymax) && clipSpan(&y1, &y2, ymin, ymax))
     {
-        p[0].x = x1; p[0].y = y1;
-        p[1].x = x2; p[1].y = y1;
-        p[2].x = x2; p[2].y = y2;
-        p[3].x = x1; p[3].y = y2;
-
-
-        gdImageFilledPolygon(getGdoImg(ctx), p, 4, getGdoPen(ctx));
+        for(y = y1; y <= y2; y++)
+        {
+            fillSpan(img, y, x1, x2, context->pen);
+        }
     }
 }
 
@@ -401,8 +992,7 @@ void gdoFilledTriangle(struct ADrawTag *ctx,
         p[1].x = x2; p[1].y = y2;
         p[2].x = x3; p[2].y = y3;
 
-        gdImageSetAntiAliased(getGdoImg(ctx), getGdoPen(ctx));
-        gdImageFilledPolygon(getGdoImg(ctx), p, 3, gdAntiAliased);
+        gdImageFilledPolygon(getGdoImg(ctx), p, 3, getGdoAaPen(ctx));
     }
 }
 
@@ -412,8 +1002,7 @@ void gdoFilledCircle(struct ADrawTag *ctx,
                      unsigned int y,
                      unsigned int r)
 {
-    gdImageSetAntiAliased(getGdoImg(ctx), getGdoPen(ctx));
-    gdImageFilledEllipse(getGdoImg(ctx), x, y, r * 2, r * 2, gdAntiAliased);
+    gdImageFilledEllipse(getGdoImg(ctx), x, y, r * 2, r * 2, getGdoAaPen(ctx));
 }
 
 
@@ -472,61 +1061,193 @@ void gdoSetBgPen(struct ADrawTag *ctx,
 void gdoSetFontSize(struct ADrawTag *ctx,
                     ADrawFontSize    size)
 {
-    switch(size)
+    selectFont(getGdoCtx(ctx), size);
+}
+
+
+bool gdoSetBand(struct ADrawTag *ctx,
+                unsigned int     ymin,
+                unsigned int     ymax)
+{
+    GdoContext  *context = getGdoCtx(ctx);
+    gdImagePtr   img = context->img;
+    unsigned int x, y;
+
+    /* Contexts drawing bands of another image may skip the bands of others */
+    if((context->image == context ? ymin != context->bandNext : ymin < context->bandNext) ||
+       ymax < ymin || ymax - ymin >= context->bandHeight || ymax >= (unsigned)gdImageSY(img))
     {
-#ifdef USE_FREETYPE
-        case ADRAW_FONT_TINY:
-            getGdoCtx(ctx)->fontPoints = 9.0;
-            break;
+        fprintf(stderr, "gdoSetBand: Bad band of rows %u to %u\n", ymin, ymax);
+        context->failed = true;
+        imageFail(context->image);
+        return false;
+    }
 
-        case ADRAW_FONT_SMALL:
-            getGdoCtx(ctx)->fontPoints = 11.0;
-            break;
-#else
-        case ADRAW_FONT_TINY:
-            getGdoCtx(ctx)->font = gdFontGetTiny();
-            break;
+    /* Write out the previous band */
+    if(!bandFlush(context))
+    {
+        context->failed = true;
+        return false;
+    }
 
-        case ADRAW_FONT_SMALL:
-            getGdoCtx(ctx)->font = gdFontGetSmall();
-            break;
-#endif
-        default:
-            assert(0);
+    /* Give the band its rows and clear them to the background */
+    for(y = ymin; y <= ymax; y++)
+    {
+        void *row = context->bandRows[y - ymin];
+
+        setRow(img, y, row);
+
+        if(gdImageTrueColor(img))
+        {
+            const int white = getColourRef(context, ADRAW_COL_WHITE);
+
+            for(x = 0; x < (unsigned)gdImageSX(img); x++)
+            {
+                ((int *)row)[x] = white;
+            }
+        }
+        else
+        {
+            memset(row, getColourRef(context, ADRAW_COL_WHITE), gdImageSX(img));
+        }
     }
+
+    context->bandMin  = ymin;
+    context->bandMax  = ymax;
+    context->bandNext = ymax + 1;
+    context->haveBand = true;
+
+    return true;
 }
 
 
 bool gdoClose(struct ADrawTag *ctx)
 {
     GdoContext *context = getGdoCtx(ctx);
+    bool        ok = !context->failed;
+
+    /* Output the image to the file in PNG format */
+    if(ok)
+    {
+        if(context->bandHeight > 0)
+        {
+            ok = bandFlush(context);
+        }
+        else
+        {
+            if(context->colourMode == ADRAW_PNG_QUANTISED)
+            {
+                gdImageTrueColorToPalette(context->img, 0, PNGENC_MAX_COLOURS);
+            }
+
+            ok = writeRows(context, 0, gdImageSY(context->img) - 1);
+        }
+    }
 
-    /* Output the image to the disk file in PNG format. */
-    gdImagePng(getGdoImg(ctx), context->outFile);
-    if(context->outFile != stdout)
+    if(context->image != context)
+    {
+        /* Bands drawn for another image are now written, or never will be */
+        if(!ok)
+        {
+            imageFail(context->image);
+        }
+    }
+    else
     {
-        fclose(context->outFile);
+        /* Finish the PNG, which checks that all the rows were written */
+        if(context->enc != NULL)
+        {
+            ok = PngEncFinish(context->enc) && ok;
+        }
+        else if(ok)
+        {
+            fprintf(stderr, "gdoClose: No bands were drawn\n");
+            ok = false;
+        }
+
+#ifdef HAVE_PTHREAD_H
+        if(context->bandHeight > 0)
+        {
+            pthread_cond_destroy(&context->written);
+            pthread_mutex_destroy(&context->lock);
+        }
+#endif
     }
 
     /* Destroy the image in memory */
+    if(context->bandHeight > 0)
+    {
+        bandFree(context);
+    }
     gdImageDestroy(context->img);
 
     /* Free and destroy context */
     free(context);
     ctx->internal = NULL;
 
-    return true;
+    return ok;
+}
+
+
+/** Fill in the function pointers of a drawing context.
+ */
+static void setFunctions(GdoContext *context, struct ADrawTag *outContext)
+{
+    outContext->line            = gdoLine;
+    outContext->dottedLine      = gdoDottedLine;
+    outContext->textL           = gdoTextL;
+    outContext->textC           = gdoTextC;
+    outContext->textR           = gdoTextR;
+    outContext->textWidth       = gdoTextWidth;
+    outContext->textHeight      = gdoTextHeight;
+    outContext->filledRectangle = gdoFilledRectangle;
+    outContext->filledTriangle  = gdoFilledTriangle;
+    outContext->filledCircle    = gdoFilledCircle;
+    outContext->arc             = gdoArc;
+    outContext->dottedArc       = gdoDottedArc;
+    outContext->setPen          = gdoSetPen;
+    outContext->setBgPen        = gdoSetBgPen;
+    outContext->setFontSize     = gdoSetFontSize;
+    outContext->close           = gdoClose;
+
+    if(context->bandHeight > 0)
+    {
+        outContext->setBand = gdoSetBand;
+    }
 }
 
 
+bool GdoGlobalInit(void)
+{
+#ifdef USE_FREETYPE
+    /* Setup the font cache now since libgd doesn't do this thread safely */
+    gdFTUseFontConfig(1);
+    if(gdFontCacheSetup() != 0)
+    {
+        fprintf(stderr, "GdoGlobalInit: Failed to setup font cache\n");
+        return false;
+    }
+#endif
+
+    return true;
+}
+
 
 bool GdoInit(unsigned int     w,
              unsigned int     h,
-             const char      *file,
+             Sink             out,
              const char      *fontName UNUSED,
+             const ADrawOpts *opts,
              struct ADrawTag *outContext)
 {
-    GdoContext *context;
+    static const ADrawOpts defOpts;
+    GdoContext  *context;
+    unsigned int imgH, t;
+
+    if(opts == NULL)
+    {
+        opts = &defOpts;
+    }
 
     /* Range check the size */
     if(w > INT_MAX || h > INT_MAX)
@@ -540,26 +1261,34 @@ bool GdoInit(unsigned int     w,
     if(h > INT_MAX) h = INT_MAX;
 
     /* Create context */
-    context = outContext->internal = zalloc_s(sizeof(GdoContext));
+    context = outContext->internal = calloc(1, sizeof(GdoContext));
     if(context == NULL)
     {
+        fprintf(stderr, "GdoInit: Failed to allocate context\n");
         return false;
     }
 
-    /* Open the output file */
-    if(strcmp(file, "-") == 0)
+    context->image      = context;
+    context->out        = out;
+    context->colourMode = opts->pngColour;
+    context->level      = opts->pngLevel > 0 && opts->pngLevel <= 9 ? (int)opts->pngLevel : -1;
+    context->filter     = opts->pngFilter;
+
+    /* Quantising needs the whole image, and small images fit in one band */
+    if(opts->pngColour != ADRAW_PNG_QUANTISED && opts->pngBandHeight < h)
     {
-        context->outFile = stdout;
+        context->bandHeight = opts->pngBandHeight;
     }
-    else
+
+#ifdef USE_FREETYPE
+    /* Anti-aliased text allocates palette colours as it is drawn, in an
+     *  order that drawing in bands would change
+     */
+    if(opts->pngColour == ADRAW_PNG_PALETTE)
     {
-        context->outFile = fopen(file, "wb");
-        if(!context->outFile)
-        {
-            fprintf(stderr, "GdoInit: Failed to open output file '%s': %s\n", file, strerror(errno));
-            return false;
-        }
+        context->bandHeight = 0;
     }
+#endif
 
 #ifdef USE_FREETYPE
     /* Request that we use font config strings and store font name */
@@ -569,39 +1298,203 @@ bool GdoInit(unsigned int     w,
     assert(fontName != NULL);
 #endif
 
-    /* Allocate the image */
-    context->img = gdImageCreateTrueColor(w, h);
+    /* Allocate the image, which for a palette needs a byte per pixel */
+    imgH = context->bandHeight > 0 ? context->bandHeight : h;
+    if(opts->pngColour == ADRAW_PNG_PALETTE)
+    {
+        context->img = gdImageCreate(w, imgH);
+    }
+    else
+    {
+        context->img = gdImageCreateTrueColor(w, imgH);
+    }
+    if(context->img == NULL)
+    {
+        fprintf(stderr, "GdoInit: Failed to create %ux%u image\n", w, imgH);
+        free(context);
+        outContext->internal = NULL;
+        return false;
+    }
+
+    if(context->bandHeight > 0 && !bandInit(context, h))
+    {
+        fprintf(stderr, "GdoInit: Failed to allocate %u rows\n", h);
+        gdImageDestroy(context->img);
+        free(context);
+        outContext->internal = NULL;
+        return false;
+    }
 
-    /* Allocate first colour and clear background */
-    gdImageFilledRectangle(context->img,
-                           0, 0,
-                           w, h,
-                           getColourRef(context, ADRAW_COL_WHITE));
+#ifdef HAVE_PTHREAD_H
+    /* Bands may also be drawn by other contexts opened with GdoInitBand() */
+    if(context->bandHeight > 0)
+    {
+        pthread_mutex_init(&context->lock, NULL);
+        pthread_cond_init(&context->written, NULL);
+    }
+#endif
 
-    /* Set pen colour to black and background to white */
-    context->pen   = getColourRef(context, ADRAW_COL_BLACK);
+    /* Allocate first colour and clear background, though bands are instead
+     *  cleared as each is selected
+     */
     context->bgpen = getColourRef(context, ADRAW_COL_WHITE);
+    if(context->bandHeight == 0)
+    {
+        gdImageFilledRectangle(context->img, 0, 0, w, h, context->bgpen);
+    }
+
+    /* Set pen colour to black, with the background already white */
+    context->pen = getColourRef(context, ADRAW_COL_BLACK);
+
+    /* When drawing in bands, allocate colours that are known to be needed
+     *  in the order they are used, giving the same palette as if they were
+     *  allocated when drawn
+     */
+    for(t = 0; context->bandHeight > 0 && t < opts->nColours; t++)
+    {
+        getColourRef(context, opts->colours[t]);
+    }
 
     /* Get the default font size */
-    gdoSetFontSize(outContext, ADRAW_FONT_SMALL);
+    selectFont(context, ADRAW_FONT_SMALL);
 
-    /* Now fill in the function pointers */
-    outContext->line            = gdoLine;
-    outContext->dottedLine      = gdoDottedLine;
-    outContext->textL           = gdoTextL;
-    outContext->textC           = gdoTextC;
-    outContext->textR           = gdoTextR;
-    outContext->textWidth       = gdoTextWidth;
-    outContext->textHeight      = gdoTextHeight;
-    outContext->filledRectangle = gdoFilledRectangle;
-    outContext->filledTriangle  = gdoFilledTriangle;
-    outContext->filledCircle    = gdoFilledCircle;
-    outContext->arc             = gdoArc;
-    outContext->dottedArc       = gdoDottedArc;
-    outContext->setPen          = gdoSetPen;
-    outContext->setBgPen        = gdoSetBgPen;
-    outContext->setFontSize     = gdoSetFontSize;
-    outContext->close           = gdoClose;
+    setFunctions(context, outContext);
+
+    return true;
+}
+
+
+bool GdoInitBand(struct ADrawTag *image, struct ADrawTag *outContext)
+{
+    GdoContext  *owner, *context;
+    gdImagePtr   ownerImg;
+    unsigned int w, h, t;
+
+    if(image->setBand != gdoSetBand)
+    {
+        fprintf(stderr, "GdoInitBand: Image is not a PNG drawn in bands\n");
+        return false;
+    }
+
+    owner    = getGdoCtx(image);
+    ownerImg = owner->img;
+    w        = gdImageSX(ownerImg);
+    h        = gdImageSY(ownerImg);
+
+    /* Create context */
+    context = outContext->internal = calloc(1, sizeof(GdoContext));
+    if(context == NULL)
+    {
+        fprintf(stderr, "GdoInitBand: Failed to allocate context\n");
+        return false;
+    }
+
+    context->image      = owner;
+    context->colourMode = owner->colourMode;
+    context->bandHeight = owner->bandHeight;
+#ifdef USE_FREETYPE
+    context->fontName   = owner->fontName;
+#endif
+
+    /* Allocate the rows of one band */
+    if(gdImageTrueColor(ownerImg))
+    {
+        context->img = gdImageCreateTrueColor(w, context->bandHeight);
+    }
+    else
+    {
+        context->img = gdImageCreate(w, context->bandHeight);
+    }
+    if(context->img == NULL)
+    {
+        fprintf(stderr, "GdoInitBand: Failed to create %ux%u image\n", w, context->bandHeight);
+        free(context);
+        outContext->internal = NULL;
+        return false;
+    }
+
+    if(!bandInit(context, h))
+    {
+        fprintf(stderr, "GdoInitBand: Failed to allocate %u rows\n", h);
+        gdImageDestroy(context->img);
+        free(context);
+        outContext->internal = NULL;
+        return false;
+    }
+
+    /* Allocate the same colours as the image, so the palettes match */
+    for(t = 0; t < (unsigned)owner->colourCount; t++)
+    {
+        getColourRef(context, owner->colour[t].col);
+    }
+
+    context->bgpen = getColourRef(context, ADRAW_COL_WHITE);
+    context->pen   = getColourRef(context, ADRAW_COL_BLACK);
+
+    /* Get the default font size */
+    selectFont(context, ADRAW_FONT_SMALL);
+
+    setFunctions(context, outContext);
+
+    return true;
+}
+
+
+static unsigned int gdoMetricsTextWidth(ADrawMetrics *ctx, const char *string)
+{
+    return measureWidth(ctx->internal, string);
+}
+
+
+static int gdoMetricsTextHeight(ADrawMetrics *ctx)
+{
+    return measureHeight(ctx->internal);
+}
+
+
+static void gdoMetricsSetFontSize(ADrawMetrics *ctx, ADrawFontSize size)
+{
+    selectFont(ctx->internal, size);
+}
+
+
+static bool gdoMetricsClose(ADrawMetrics *ctx)
+{
+    GdoContext *context = ctx->internal;
+    bool        ok = !context->failed;
+
+    free(context);
+    ctx->internal = NULL;
+
+    return ok;
+}
+
+
+bool GdoMetricsInit(const char *fontName UNUSED, ADrawMetrics *outMetrics)
+{
+    GdoContext *context;
+
+    /* Create a context without an image, with the default black pen */
+    context = outMetrics->internal = calloc(1, sizeof(GdoContext));
+    if(context == NULL)
+    {
+        fprintf(stderr, "GdoMetricsInit: Failed to allocate context\n");
+        return false;
+    }
+
+#ifdef USE_FREETYPE
+    gdFTUseFontConfig(1);
+    context->fontName = fontName;
+
+    assert(fontName != NULL);
+#endif
+
+    selectFont(context, ADRAW_FONT_SMALL);
+
+    outMetrics->textWidth   = gdoMetricsTextWidth;
+    outMetrics->textHeight  = gdoMetricsTextHeight;
+    outMetrics->setFontSize = gdoMetricsSetFontSize;
+    outMetrics->close       = gdoMetricsClose;
 
     return true;
 }
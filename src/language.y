@@ -25,30 +25,40 @@
  ***************************************************************************/
 
 #include <stdio.h>
-#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "lexer.h"
 #include "safe.h"
+#include "arena.h"
+#include "symtab.h"
 #include "msc.h"
 
 /* Lexer prototypes to prevent compiler warnings */
-int yylex(void);
-int yylex_destroy(void);
+int  yylex_init_extra(LexState *state, yyscan_t *yyscanner);
+void yyset_in(FILE *in, yyscan_t yyscanner);
+int  yylex_destroy(yyscan_t yyscanner);
 
 /* Use verbose error reporting such that the expected token names are dumped */
 #define YYERROR_VERBOSE
 
-/* Name of parameter that is passed to yyparse() */
-#define YYPARSE_PARAM yyparse_result
+/* Let the parser stack fail to grow, which Bison reports as an error */
+#define YYMALLOC malloc
 
-#define YYMALLOC malloc_s
+/* Abort the parse if some allocation from the chart arena failed */
+#define CHECK_ALLOC(p)                                              \
+    if((p) == NULL)                                                 \
+    {                                                               \
+        fprintf(stderr, "Out of memory at line %lu\n",              \
+                lex_getlinenum(yyscanner));                         \
+        YYABORT;                                                    \
+    }
 
 /* yyerror
  *  Error handling function.  The TOK_XXX names are substituted for more
  *  understandable values that make more sense to the user.
  */
-void yyerror(void *unused, const char *str)
+void yyerror(yyscan_t yyscanner, Msc *unused, const char *str)
 {
     static const char *tokNames[] = { "TOK_OCBRACKET",          "TOK_CCBRACKET",
                                       "TOK_OSBRACKET",          "TOK_CSBRACKET",
@@ -108,7 +118,7 @@ void yyerror(void *unused, const char *str)
     int   t;
 
     /* Print standard message part */
-    fprintf(stderr, "Error detected at line %lu: ", lex_getlinenum());
+    fprintf(stderr, "Error detected at line %lu: ", lex_getlinenum(yyscanner));
 
     /* Search for TOK */
     s = strstr(str, "TOK_");
@@ -152,7 +162,7 @@ void yyerror(void *unused, const char *str)
 
     fprintf(stderr, "%s.\n", str);
 
-    line = lex_getline();
+    line = lex_getline(yyscanner);
     if(line != NULL)
     {
         fprintf(stderr, "> %s\n", line);
@@ -175,60 +185,11 @@ void yyerror(void *unused, const char *str)
     }
 }
 
-int yywrap()
-{
-    return 1;
-}
-
-
-char *removeEscapes(char *in)
-{
-    const uint16_t l = strlen(in);
-    char          *r = malloc_s(l + 1);
-    uint16_t       t, u;
-
-    for(t = u = 0; t < l; t++)
-    {
-        r[u] = in[t];
-        if(in[t] != '\\' || in[t + 1] != '\"')
-        {
-            u++;
-        }
-    }
-
-    r[u] = '\0';
-
-    free(in);
-
-    return r;
-}
-
-extern FILE *yyin;
-extern int   yyparse (void *YYPARSE_PARAM);
-
-
-Msc MscParse(FILE *in)
-{
-    Msc m;
-
-    yyin = in;
-
-    /* Parse, and check that no errors are found */
-    if(yyparse((void *)&m) != 0)
-    {
-        m = NULL;
-    }
-
-    lex_destroy();
-    yylex_destroy();
-
-    return m;
-}
-
-
 %}
 
-%parse-param {void *YYPARSE_PARAM}
+%define api.pure full
+%parse-param {yyscan_t yyscanner} {Msc *yyparse_result}
+%lex-param   {yyscan_t yyscanner}
 
 %token TOK_STRING TOK_QSTRING TOK_EQUAL TOK_COMMA TOK_SEMICOLON TOK_OCBRACKET TOK_CCBRACKET
        TOK_OSBRACKET TOK_CSBRACKET TOK_MSC
@@ -253,7 +214,7 @@ Msc MscParse(FILE *in)
 
 %union
 {
-    char         *string;
+    const char   *string;
     Msc           msc;
     MscOpt        opt;
     MscOptType    optType;
@@ -290,18 +251,25 @@ Msc MscParse(FILE *in)
                    TOK_ATTR_ARC_SKIP
 %type <string>     string TOK_STRING TOK_QSTRING
 
+%code
+{
+/* Lexer prototype, which needs YYSTYPE */
+int yylex(YYSTYPE *yylval_param, yyscan_t yyscanner);
+}
 
 %%
 msc:          TOK_MSC TOK_OCBRACKET optlist TOK_SEMICOLON entitylist TOK_SEMICOLON arclist TOK_SEMICOLON TOK_CCBRACKET
 {
-    $$ = MscAlloc($3, $5, $7);
-    *(Msc *)yyparse_result = $$;
+    $$ = MscAlloc(lex_getarena(yyscanner), $3, $5, $7);
+    CHECK_ALLOC($$);
+    *yyparse_result = $$;
 
 }
            | TOK_MSC TOK_OCBRACKET entitylist TOK_SEMICOLON arclist TOK_SEMICOLON TOK_CCBRACKET
 {
-    $$ = MscAlloc(NULL, $3, $5);
-    *(Msc *)yyparse_result = $$;
+    $$ = MscAlloc(lex_getarena(yyscanner), NULL, $3, $5);
+    CHECK_ALLOC($$);
+    *yyparse_result = $$;
 
 };
 
@@ -313,25 +281,29 @@ optlist:     opt
 
 opt:         optval TOK_EQUAL string
 {
-    $$ = MscAllocOpt($1, $3);
+    $$ = MscAllocOpt(lex_getarena(yyscanner), $1, $3);
+    CHECK_ALLOC($$);
 };
 
 optval:      TOK_OPT_HSCALE | TOK_OPT_WIDTH | TOK_OPT_ARCGRADIENT | TOK_OPT_WORDWRAPARCS;
 
 entitylist:   entity
 {
-    $$ = MscLinkEntity(NULL, $1);   /* Create new list */
+    $$ = MscLinkEntity(lex_getarena(yyscanner), NULL, $1);   /* Create new list */
+    CHECK_ALLOC($$);
 }
             | entitylist TOK_COMMA entity
 {
-    $$ = MscLinkEntity($1, $3);     /* Add to existing list */
+    $$ = MscLinkEntity(lex_getarena(yyscanner), $1, $3);     /* Add to existing list */
+    CHECK_ALLOC($$);
 };
 
 
 
 entity:       string
 {
-    $$ = MscAllocEntity($1);
+    $$ = MscAllocEntity(lex_getarena(yyscanner), $1);
+    CHECK_ALLOC($$);
 }
             | entity TOK_OSBRACKET attrlist TOK_CSBRACKET
 {
@@ -341,16 +313,23 @@ entity:       string
 
 arclist:      arc
 {
-    $$ = MscLinkArc(NULL, $1);      /* Create new list */
+    $$ = MscLinkArc(lex_getarena(yyscanner), NULL, $1);      /* Create new list */
+    CHECK_ALLOC($$);
 }
               | arclist TOK_SEMICOLON arc
 {
-    $$ = MscLinkArc($1, $3);     /* Add to existing list */
+    $$ = MscLinkArc(lex_getarena(yyscanner), $1, $3);     /* Add to existing list */
+    CHECK_ALLOC($$);
 }
               | arclist TOK_COMMA arc
 {
     /* Add a special 'parallel' arc */
-    $$ = MscLinkArc(MscLinkArc($1, MscAllocArc(NULL, NULL, MSC_ARC_PARALLEL, lex_getlinenum())), $3);
+    Arena  arena = lex_getarena(yyscanner);
+    MscArc par   = MscAllocArc(arena, NULL, NULL, MSC_ARC_PARALLEL, lex_getlinenum(yyscanner));
+
+    CHECK_ALLOC(par);
+    $$ = MscLinkArc(arena, MscLinkArc(arena, $1, par), $3);
+    CHECK_ALLOC($$);
 };
 ;
 
@@ -364,43 +343,54 @@ arc:          arcrel TOK_OSBRACKET attrlist TOK_CSBRACKET
 
 arcrel:       TOK_SPECIAL_ARC
 {
-    $$ = MscAllocArc(NULL, NULL, $1, lex_getlinenum());
+    $$ = MscAllocArc(lex_getarena(yyscanner), NULL, NULL, $1, lex_getlinenum(yyscanner));
+    CHECK_ALLOC($$);
 }
             | life_event string
 {
-    $$ = MscAllocArc($2, $2, $1, lex_getlinenum());
+    $$ = MscAllocArc(lex_getarena(yyscanner), $2, $2, $1, lex_getlinenum(yyscanner));
+    CHECK_ALLOC($$);
 }
             | string relation_box string
 {
-    $$ = MscAllocArc($1, $3, $2, lex_getlinenum());
+    $$ = MscAllocArc(lex_getarena(yyscanner), $1, $3, $2, lex_getlinenum(yyscanner));
+    CHECK_ALLOC($$);
 }
             | string relation_bi string
 {
-    MscArc arc = MscAllocArc($1, $3, $2, lex_getlinenum());
-    MscArcLinkAttrib(arc, MscAllocAttrib(MSC_ATTR_BI_ARROWS, strdup_s("true")));
+    Arena  arena = lex_getarena(yyscanner);
+    MscArc arc   = MscAllocArc(arena, $1, $3, $2, lex_getlinenum(yyscanner));
+    CHECK_ALLOC(arc);
+    MscArcLinkAttrib(arc, MscAllocAttrib(arena, MSC_ATTR_BI_ARROWS, "true"));
     $$ = arc;
 }
             | string relation_to string
 {
-    $$ = MscAllocArc($1, $3, $2, lex_getlinenum());
+    $$ = MscAllocArc(lex_getarena(yyscanner), $1, $3, $2, lex_getlinenum(yyscanner));
+    CHECK_ALLOC($$);
 }
             | string relation_line string
 {
-    MscArc arc = MscAllocArc($1, $3, $2, lex_getlinenum());
-    MscArcLinkAttrib(arc, MscAllocAttrib(MSC_ATTR_NO_ARROWS, strdup_s("true")));
+    Arena  arena = lex_getarena(yyscanner);
+    MscArc arc   = MscAllocArc(arena, $1, $3, $2, lex_getlinenum(yyscanner));
+    CHECK_ALLOC(arc);
+    MscArcLinkAttrib(arc, MscAllocAttrib(arena, MSC_ATTR_NO_ARROWS, "true"));
     $$ = arc;
 }
             | string relation_from string
 {
-    $$ = MscAllocArc($3, $1, $2, lex_getlinenum());
+    $$ = MscAllocArc(lex_getarena(yyscanner), $3, $1, $2, lex_getlinenum(yyscanner));
+    CHECK_ALLOC($$);
 }
             | string relation_to TOK_ASTERISK
 {
-    $$ = MscAllocArc($1, strdup_s("*"), $2, lex_getlinenum());
+    $$ = MscAllocArc(lex_getarena(yyscanner), $1, "*", $2, lex_getlinenum(yyscanner));
+    CHECK_ALLOC($$);
 }
             | TOK_ASTERISK relation_from string
 {
-    $$ = MscAllocArc($3, strdup_s("*"), $2, lex_getlinenum());
+    $$ = MscAllocArc(lex_getarena(yyscanner), $3, "*", $2, lex_getlinenum(yyscanner));
+    CHECK_ALLOC($$);
 };
 
 life_event:    TOK_LIFE_ACT | TOK_LIFE_DEACT | TOK_LIFE_DESTR;
@@ -418,7 +408,8 @@ attrlist:    attr
 
 attr:         attrval TOK_EQUAL string
 {
-    $$ = MscAllocAttrib($1, $3);
+    $$ = MscAllocAttrib(lex_getarena(yyscanner), $1, $3);
+    CHECK_ALLOC($$);
 };
 
 attrval:      TOK_ATTR_LABEL | TOK_ATTR_URL | TOK_ATTR_ID | TOK_ATTR_IDURL |
@@ -427,15 +418,119 @@ attrval:      TOK_ATTR_LABEL | TOK_ATTR_URL | TOK_ATTR_ID | TOK_ATTR_IDURL |
               TOK_ATTR_ARC_SKIP;
 
 
-string: TOK_QSTRING
+/* Token strings are NULL if they couldn't be copied into the arena */
+string:       TOK_QSTRING
 {
-    $$ = removeEscapes($1);
+    CHECK_ALLOC($1);
+    $$ = $1;
 }
-      | TOK_STRING
+            | TOK_STRING
 {
+    CHECK_ALLOC($1);
     $$ = $1;
 };
 %%
 
 
+/** Create the arena and symbol table for a parse.
+ *
+ * \retval false  If memory could not be allocated, which has been reported.
+ */
+static bool createArena(LexState *state)
+{
+    state->arena = ArenaCreate();
+    if(state->arena != NULL)
+    {
+        state->symtab = SymTabCreate(state->arena);
+        if(state->symtab != NULL)
+        {
+            return true;
+        }
+
+        ArenaDestroy(state->arena);
+    }
+
+    fprintf(stderr, "Out of memory creating parser\n");
+
+    return false;
+}
+
+
+/** Parse input that has been attached to some scanner.
+ * The scanner is destroyed before returning.  On success the arena in
+ * \a state is owned by the returned MSC, otherwise it is destroyed.
+ */
+static Msc parse(yyscan_t scanner, const LexState *state)
+{
+    Msc m = NULL;
+
+    /* Parse, and check that no errors are found */
+    if(yyparse(scanner, &m) != 0)
+    {
+        /* Partially built charts are in the arena, so free in one go */
+        ArenaDestroy(state->arena);
+        m = NULL;
+    }
+    else
+    {
+        MscSetUtf8(m, state->utf8);
+    }
+
+    lex_destroy(scanner);
+    yylex_destroy(scanner);
+
+    return m;
+}
+
+
+Msc MscParse(FILE *in)
+{
+    LexState state = { 1, NULL, false, NULL, NULL };
+    yyscan_t scanner;
+
+    if(yylex_init_extra(&state, &scanner) != 0)
+    {
+        fprintf(stderr, "Failed to create lexer: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    if(!createArena(&state))
+    {
+        yylex_destroy(scanner);
+        return NULL;
+    }
+
+    yyset_in(in, scanner);
+
+    return parse(scanner, &state);
+}
+
+
+Msc MscParseBuffer(const char *buf, size_t len)
+{
+    LexState state = { 1, NULL, false, NULL, NULL };
+    yyscan_t scanner;
+
+    if(yylex_init_extra(&state, &scanner) != 0)
+    {
+        fprintf(stderr, "Failed to create lexer: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    if(!createArena(&state))
+    {
+        yylex_destroy(scanner);
+        return NULL;
+    }
+
+    if(!lex_scanbuffer(scanner, buf, len))
+    {
+        ArenaDestroy(state.arena);
+        yylex_destroy(scanner);
+        return NULL;
+    }
+
+    return parse(scanner, &state);
+}
+
 /* END OF FILE */
@@ -28,6 +28,9 @@
  *****************************************************************************/
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
+#include "symtab.h"
 
 /*****************************************************************************
  * Preprocessor Macros & Constants
@@ -37,6 +40,35 @@
  * Typedefs
  *****************************************************************************/
 
+/* Opaque scanner handle, as also declared by the flex generated code */
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+/** State kept by the lexer for a single parse.
+ * This is attached to the scanner as its extra data so that each parse has
+ * its own line count and error context.
+ */
+typedef struct LexStateTag
+{
+    /** Current input line number, for error reporting. */
+    unsigned long linenum;
+
+    /** Copy of the current input line, for error reporting. */
+    char         *line;
+
+    /** Set if a UTF-8 byte-order-mark was found at the start of input. */
+    bool          utf8;
+
+    /** Arena holding the chart being parsed. */
+    Arena         arena;
+
+    /** Symbol table in which token strings are interned. */
+    SymTab        symtab;
+}
+LexState;
+
 /*****************************************************************************
  * Global Variable Declarations
  *****************************************************************************/
@@ -46,10 +78,12 @@
  *****************************************************************************/
 
 
-unsigned long  lex_getlinenum(void);
-char          *lex_getline(void);
-bool           lex_getutf8(void);
-void           lex_destroy(void);
+unsigned long  lex_getlinenum(yyscan_t yyscanner);
+char          *lex_getline(yyscan_t yyscanner);
+bool           lex_getutf8(yyscan_t yyscanner);
+Arena          lex_getarena(yyscan_t yyscanner);
+void           lex_destroy(yyscan_t yyscanner);
+bool           lex_scanbuffer(yyscan_t yyscanner, const char *buf, size_t len);
 
 #endif /* LEXER_H */
 
@@ -0,0 +1,899 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * This file is part of mscgen, a message sequence chart renderer.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+/***************************************************************************
+ * Include Files
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+
+#include "adraw_int.h"
+
+/***************************************************************************
+ * Manifest Constants
+ ***************************************************************************/
+
+/** Number of operations in each run of the list index. */
+#define LIST_RUN_OPS 32
+
+/** Maximum number of distinct pen colours that are tracked. */
+#define LIST_MAX_COLOURS 256
+
+/** Rows either side of a shape that anti-aliasing may touch. */
+#define LIST_Y_MARGIN 2
+
+#define M_Max(a, b) (((a) > (b)) ? (a) : (b))
+#define M_Min(a, b) (((a) < (b)) ? (a) : (b))
+
+/***************************************************************************
+ * Types
+ ***************************************************************************/
+
+/** Operations that can be recorded in a display list.
+ * Each operation is stored as a word giving the operation, followed by a
+ * fixed number of argument words.
+ */
+typedef enum
+{
+    LIST_OP_LINE = 0,
+    LIST_OP_DOTTED_LINE,
+    LIST_OP_TEXT_L,
+    LIST_OP_TEXT_C,
+    LIST_OP_TEXT_R,
+    LIST_OP_FILLED_RECTANGLE,
+    LIST_OP_FILLED_TRIANGLE,
+    LIST_OP_FILLED_CIRCLE,
+    LIST_OP_ARC,
+    LIST_OP_DOTTED_ARC,
+    LIST_OP_SET_PEN,
+    LIST_OP_SET_BG_PEN,
+    LIST_OP_SET_FONT_SIZE,
+
+    LIST_OP_COUNT
+}
+ListOp;
+
+
+/** A run of consecutive operations in a display list.
+ * Runs index the list by the rows that each may draw to, so that only the
+ * runs touching some band of rows need be replayed to draw it.
+ */
+typedef struct
+{
+    /** Offset of the first word of the run. */
+    size_t        start;
+
+    /** Pen, background pen and font size at the start of the run. */
+    ADrawColour   pen, bgPen;
+    ADrawFontSize fontSize;
+
+    /** Rows that the run may draw to, with ymin > ymax if none. */
+    unsigned int  ymin, ymax;
+
+    /** Least ymin of this and later runs, and greatest ymax of this and
+     *  earlier runs, which are both in increasing order.
+     */
+    unsigned int  laterYmin, earlierYmax;
+}
+ListRun;
+
+
+/** A recorded display list.
+ * Strings are copied into a single buffer and referenced from the words
+ * by their offset + 1, with 0 used for a NULL string.
+ */
+struct ADrawListTag
+{
+    /** The recorded operations and their arguments. */
+    unsigned int *word;
+    size_t        nWords, nAllocWords;
+
+    /** Index of runs of operations, and the count of operations in the
+     *  last run.
+     */
+    ListRun      *run;
+    size_t        nRuns, nAllocRuns;
+    unsigned int  nRunOps;
+
+    /** Current pen, background pen and font size while recording. */
+    ADrawColour   pen, bgPen;
+    ADrawFontSize fontSize;
+
+    /** Distinct pen colours in the order they are first set. */
+    ADrawColour   colour[LIST_MAX_COLOURS];
+    unsigned int  nColours;
+
+    /** Strings referenced by the operations. */
+    char         *str;
+    size_t        nStr, nAllocStr;
+
+    /** Reference to the last URL added, or 0. */
+    unsigned int  lastUrlRef;
+
+    /** Set if memory could not be allocated while recording. */
+    bool          failed;
+};
+
+/***************************************************************************
+ * Local Variables.
+ ***************************************************************************/
+
+/** Count of argument words that follow each operation. */
+static const unsigned int gOpArgs[LIST_OP_COUNT] =
+{
+    4,  /* LIST_OP_LINE */
+    4,  /* LIST_OP_DOTTED_LINE */
+    4,  /* LIST_OP_TEXT_L */
+    4,  /* LIST_OP_TEXT_C */
+    4,  /* LIST_OP_TEXT_R */
+    4,  /* LIST_OP_FILLED_RECTANGLE */
+    6,  /* LIST_OP_FILLED_TRIANGLE */
+    3,  /* LIST_OP_FILLED_CIRCLE */
+    6,  /* LIST_OP_ARC */
+    6,  /* LIST_OP_DOTTED_ARC */
+    1,  /* LIST_OP_SET_PEN */
+    1,  /* LIST_OP_SET_BG_PEN */
+    1   /* LIST_OP_SET_FONT_SIZE */
+};
+
+/***************************************************************************
+ * Helper functions
+ ***************************************************************************/
+
+/** Get the list from some drawing context.
+ */
+static ADrawList *getList(struct ADrawTag *ctx)
+{
+    return (ADrawList *)ctx->internal;
+}
+
+
+/** Start a new run in the list index.
+ */
+static void addRun(ADrawList *list)
+{
+    ListRun *r;
+
+    if(list->nRuns == list->nAllocRuns)
+    {
+        size_t newAlloc = list->nAllocRuns == 0 ? 64 : list->nAllocRuns * 2;
+
+        r = realloc(list->run, newAlloc * sizeof(ListRun));
+        if(r == NULL)
+        {
+            list->failed = true;
+            return;
+        }
+
+        list->run        = r;
+        list->nAllocRuns = newAlloc;
+    }
+
+    r = &list->run[list->nRuns];
+    r->start       = list->nWords;
+    r->pen         = list->pen;
+    r->bgPen       = list->bgPen;
+    r->fontSize    = list->fontSize;
+    r->ymin        = UINT_MAX;
+    r->ymax        = 0;
+    r->earlierYmax = list->nRuns == 0 ? 0 : list->run[list->nRuns - 1].earlierYmax;
+
+    list->nRuns++;
+    list->nRunOps = 0;
+}
+
+
+/** Get the rows that some operation may draw to.
+ * Text is drawn above its position, but glyphs may rise above the font
+ *  height or descend below the line, so a generous range is given.  All
+ *  ranges are widened slightly to allow for anti-aliasing.
+ *
+ * \param[in]  op          The operation.
+ * \param[in]  w           The arguments of the operation.
+ * \param[in]  textHeight  Height of text in the current font.
+ * \param[out] ymin, ymax  Pointers to be filled with the rows.
+ * \retval false  If the operation doesn't draw.
+ */
+static bool getOpRows(ListOp              op,
+                      const unsigned int *w,
+                      unsigned int        textHeight,
+                      unsigned int       *ymin,
+                      unsigned int       *ymax)
+{
+    unsigned int y1, y2;
+
+    switch(op)
+    {
+        case LIST_OP_LINE:
+        case LIST_OP_DOTTED_LINE:
+        case LIST_OP_FILLED_RECTANGLE:
+            y1 = M_Min(w[1], w[3]);
+            y2 = M_Max(w[1], w[3]);
+            break;
+
+        case LIST_OP_FILLED_TRIANGLE:
+            y1 = M_Min(M_Min(w[1], w[3]), w[5]);
+            y2 = M_Max(M_Max(w[1], w[3]), w[5]);
+            break;
+
+        case LIST_OP_TEXT_L:
+        case LIST_OP_TEXT_C:
+        case LIST_OP_TEXT_R:
+            y1 = w[1] > 2 * textHeight ? w[1] - 2 * textHeight : 0;
+            y2 = w[1] + textHeight;
+            break;
+
+        case LIST_OP_FILLED_CIRCLE:
+            y1 = w[1] > w[2] ? w[1] - w[2] : 0;
+            y2 = w[1] + w[2];
+            break;
+
+        case LIST_OP_ARC:
+        case LIST_OP_DOTTED_ARC:
+            y1 = w[1] > w[3] / 2 ? w[1] - w[3] / 2 : 0;
+            y2 = w[1] + w[3] / 2;
+            break;
+
+        default:
+            return false;
+    }
+
+    *ymin = y1 > LIST_Y_MARGIN ? y1 - LIST_Y_MARGIN : 0;
+    *ymax = y2 < UINT_MAX - LIST_Y_MARGIN ? y2 + LIST_Y_MARGIN : UINT_MAX;
+
+    return true;
+}
+
+
+/** Note the rows that an operation just recorded may draw to.
+ */
+static void addExtent(ADrawList          *list,
+                      ListOp              op,
+                      const unsigned int *w,
+                      unsigned int        textHeight)
+{
+    ListRun     *r;
+    unsigned int y1, y2;
+
+    if(list->nRuns == 0 || !getOpRows(op, w, textHeight, &y1, &y2))
+    {
+        return;
+    }
+
+    r = &list->run[list->nRuns - 1];
+
+    if(y1 < r->ymin)        r->ymin = y1;
+    if(y2 > r->ymax)        r->ymax = y2;
+    if(y2 > r->earlierYmax) r->earlierYmax = y2;
+}
+
+
+/** Reserve space for an operation and its arguments.
+ * \returns  Pointer to the words to fill, or NULL if memory was exhausted.
+ */
+static unsigned int *addOp(ADrawList *list, ListOp op)
+{
+    const size_t  n = 1 + gOpArgs[op];
+    unsigned int *w;
+
+    if(list->nRuns == 0 || list->nRunOps == LIST_RUN_OPS)
+    {
+        addRun(list);
+    }
+    list->nRunOps++;
+
+    if(list->nWords + n > list->nAllocWords)
+    {
+        size_t newAlloc = list->nAllocWords == 0 ? 1024 : list->nAllocWords * 2;
+
+        w = realloc(list->word, newAlloc * sizeof(unsigned int));
+        if(w == NULL)
+        {
+            list->failed = true;
+            return NULL;
+        }
+
+        list->word        = w;
+        list->nAllocWords = newAlloc;
+    }
+
+    w = &list->word[list->nWords];
+    list->nWords += n;
+
+    w[0] = op;
+
+    return &w[1];
+}
+
+
+/** Copy a string into the list.
+ * \returns  The reference for the string, or 0 for NULL.
+ */
+static unsigned int addString(ADrawList *list, const char *s)
+{
+    size_t       l;
+    unsigned int ref;
+
+    if(s == NULL)
+    {
+        return 0;
+    }
+
+    l = strlen(s) + 1;
+
+    if(list->nStr + l > list->nAllocStr)
+    {
+        size_t newAlloc = list->nAllocStr == 0 ? 4096 : list->nAllocStr;
+        char  *str;
+
+        while(list->nStr + l > newAlloc)
+        {
+            newAlloc *= 2;
+        }
+
+        str = realloc(list->str, newAlloc);
+        if(str == NULL)
+        {
+            list->failed = true;
+            return 0;
+        }
+
+        list->str       = str;
+        list->nAllocStr = newAlloc;
+    }
+
+    memcpy(&list->str[list->nStr], s, l);
+    ref = list->nStr + 1;
+    list->nStr += l;
+
+    return ref;
+}
+
+
+/** Get a string from its reference.
+ */
+static const char *getString(const ADrawList *list, unsigned int ref)
+{
+    return ref == 0 ? NULL : &list->str[ref - 1];
+}
+
+
+/** Record a pen colour, noting it if it hasn't been seen before.
+ */
+static void addColour(ADrawList *list, ADrawColour col)
+{
+    unsigned int t;
+
+    for(t = 0; t < list->nColours; t++)
+    {
+        if(list->colour[t] == col)
+        {
+            return;
+        }
+    }
+
+    if(t < LIST_MAX_COLOURS)
+    {
+        list->colour[t] = col;
+        list->nColours++;
+    }
+}
+
+
+/** Record some text operation.
+ */
+static void addText(struct ADrawTag *ctx,
+                    ListOp           op,
+                    unsigned int     x,
+                    unsigned int     y,
+                    const char      *string,
+                    const char      *url)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, op);
+
+    if(w)
+    {
+        w[0] = x;
+        w[1] = y;
+        w[2] = addString(list, string);
+
+        /* Each line of a label repeats the URL, so only store it once */
+        if(url == NULL)
+        {
+            w[3] = 0;
+        }
+        else
+        {
+            if(list->lastUrlRef == 0 || strcmp(url, getString(list, list->lastUrlRef)) != 0)
+            {
+                list->lastUrlRef = addString(list, url);
+            }
+
+            w[3] = list->lastUrlRef;
+        }
+
+        addExtent(list, op, w, ctx->textHeight(ctx));
+    }
+}
+
+/** Replay the operations between some offsets in a list.
+ * If \a band is set, drawing operations that can't reach the rows from
+ *  \a ymin to \a ymax are skipped.
+ */
+static void replayOps(const ADrawList *list,
+                      struct ADrawTag *ctx,
+                      size_t           t,
+                      size_t           end,
+                      bool             band,
+                      unsigned int     ymin,
+                      unsigned int     ymax)
+{
+    while(t < end)
+    {
+        const ListOp        op = (ListOp)list->word[t];
+        const unsigned int *w = &list->word[t + 1];
+        unsigned int        y1, y2;
+
+        t += 1 + gOpArgs[op];
+
+        if(band)
+        {
+            const bool text = op == LIST_OP_TEXT_L || op == LIST_OP_TEXT_C || op == LIST_OP_TEXT_R;
+
+            if(getOpRows(op, w, text ? ctx->textHeight(ctx) : 0, &y1, &y2) &&
+               (y2 < ymin || y1 > ymax))
+            {
+                continue;
+            }
+        }
+
+        switch(op)
+        {
+            case LIST_OP_LINE:
+                ctx->line(ctx, w[0], w[1], w[2], w[3]);
+                break;
+
+            case LIST_OP_DOTTED_LINE:
+                ctx->dottedLine(ctx, w[0], w[1], w[2], w[3]);
+                break;
+
+            case LIST_OP_TEXT_L:
+                ctx->textL(ctx, w[0], w[1], getString(list, w[2]), getString(list, w[3]));
+                break;
+
+            case LIST_OP_TEXT_C:
+                ctx->textC(ctx, w[0], w[1], getString(list, w[2]), getString(list, w[3]));
+                break;
+
+            case LIST_OP_TEXT_R:
+                ctx->textR(ctx, w[0], w[1], getString(list, w[2]), getString(list, w[3]));
+                break;
+
+            case LIST_OP_FILLED_RECTANGLE:
+                ctx->filledRectangle(ctx, w[0], w[1], w[2], w[3]);
+                break;
+
+            case LIST_OP_FILLED_TRIANGLE:
+                ctx->filledTriangle(ctx, w[0], w[1], w[2], w[3], w[4], w[5]);
+                break;
+
+            case LIST_OP_FILLED_CIRCLE:
+                ctx->filledCircle(ctx, w[0], w[1], w[2]);
+                break;
+
+            case LIST_OP_ARC:
+                ctx->arc(ctx, w[0], w[1], w[2], w[3], w[4], w[5]);
+                break;
+
+            case LIST_OP_DOTTED_ARC:
+                ctx->dottedArc(ctx, w[0], w[1], w[2], w[3], w[4], w[5]);
+                break;
+
+            case LIST_OP_SET_PEN:
+                ctx->setPen(ctx, (ADrawColour)w[0]);
+                break;
+
+            case LIST_OP_SET_BG_PEN:
+                ctx->setBgPen(ctx, (ADrawColour)w[0]);
+                break;
+
+            case LIST_OP_SET_FONT_SIZE:
+                ctx->setFontSize(ctx, (ADrawFontSize)w[0]);
+                break;
+
+            default:
+                assert(0);
+                return;
+        }
+    }
+}
+
+/***************************************************************************
+ * API Functions
+ ***************************************************************************/
+
+static unsigned int ListTextWidth(struct ADrawTag *ctx UNUSED,
+                                  const char *string UNUSED)
+{
+    /* Only used if no metrics are attached */
+    return 0;
+}
+
+
+static int ListTextHeight(struct ADrawTag *ctx UNUSED)
+{
+    return 0;
+}
+
+
+static void ListLine(struct ADrawTag *ctx,
+                     unsigned int     x1,
+                     unsigned int     y1,
+                     unsigned int     x2,
+                     unsigned int     y2)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, LIST_OP_LINE);
+
+    if(w)
+    {
+        w[0] = x1; w[1] = y1; w[2] = x2; w[3] = y2;
+        addExtent(list, LIST_OP_LINE, w, 0);
+    }
+}
+
+
+static void ListDottedLine(struct ADrawTag *ctx,
+                           unsigned int     x1,
+                           unsigned int     y1,
+                           unsigned int     x2,
+                           unsigned int     y2)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, LIST_OP_DOTTED_LINE);
+
+    if(w)
+    {
+        w[0] = x1; w[1] = y1; w[2] = x2; w[3] = y2;
+        addExtent(list, LIST_OP_DOTTED_LINE, w, 0);
+    }
+}
+
+
+static void ListTextL(struct ADrawTag *ctx,
+                      unsigned int     x,
+                      unsigned int     y,
+                      const char      *string,
+                      const char      *url)
+{
+    addText(ctx, LIST_OP_TEXT_L, x, y, string, url);
+}
+
+
+static void ListTextC(struct ADrawTag *ctx,
+                      unsigned int     x,
+                      unsigned int     y,
+                      const char      *string,
+                      const char      *url)
+{
+    addText(ctx, LIST_OP_TEXT_C, x, y, string, url);
+}
+
+
+static void ListTextR(struct ADrawTag *ctx,
+                      unsigned int     x,
+                      unsigned int     y,
+                      const char      *string,
+                      const char      *url)
+{
+    addText(ctx, LIST_OP_TEXT_R, x, y, string, url);
+}
+
+
+static void ListFilledRectangle(struct ADrawTag *ctx,
+                                unsigned int x1,
+                                unsigned int y1,
+                                unsigned int x2,
+                                unsigned int y2)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, LIST_OP_FILLED_RECTANGLE);
+
+    if(w)
+    {
+        w[0] = x1; w[1] = y1; w[2] = x2; w[3] = y2;
+        addExtent(list, LIST_OP_FILLED_RECTANGLE, w, 0);
+    }
+}
+
+
+static void ListFilledTriangle(struct ADrawTag *ctx,
+                               unsigned int x1,
+                               unsigned int y1,
+                               unsigned int x2,
+                               unsigned int y2,
+                               unsigned int x3,
+                               unsigned int y3)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, LIST_OP_FILLED_TRIANGLE);
+
+    if(w)
+    {
+        w[0] = x1; w[1] = y1; w[2] = x2; w[3] = y2; w[4] = x3; w[5] = y3;
+        addExtent(list, LIST_OP_FILLED_TRIANGLE, w, 0);
+    }
+}
+
+
+static void ListFilledCircle(struct ADrawTag *ctx,
+                             unsigned int x,
+                             unsigned int y,
+                             unsigned int r)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, LIST_OP_FILLED_CIRCLE);
+
+    if(w)
+    {
+        w[0] = x; w[1] = y; w[2] = r;
+        addExtent(list, LIST_OP_FILLED_CIRCLE, w, 0);
+    }
+}
+
+
+static void ListArc(struct ADrawTag *ctx,
+                    unsigned int cx,
+                    unsigned int cy,
+                    unsigned int w,
+                    unsigned int h,
+                    unsigned int s,
+                    unsigned int e)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *a = addOp(list, LIST_OP_ARC);
+
+    if(a)
+    {
+        a[0] = cx; a[1] = cy; a[2] = w; a[3] = h; a[4] = s; a[5] = e;
+        addExtent(list, LIST_OP_ARC, a, 0);
+    }
+}
+
+
+static void ListDottedArc(struct ADrawTag *ctx,
+                          unsigned int cx,
+                          unsigned int cy,
+                          unsigned int w,
+                          unsigned int h,
+                          unsigned int s,
+                          unsigned int e)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *a = addOp(list, LIST_OP_DOTTED_ARC);
+
+    if(a)
+    {
+        a[0] = cx; a[1] = cy; a[2] = w; a[3] = h; a[4] = s; a[5] = e;
+        addExtent(list, LIST_OP_DOTTED_ARC, a, 0);
+    }
+}
+
+
+static void ListSetPen(struct ADrawTag *ctx,
+                       ADrawColour      col)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, LIST_OP_SET_PEN);
+
+    if(w)
+    {
+        w[0] = col;
+        list->pen = col;
+        addColour(list, col);
+    }
+}
+
+
+static void ListSetBgPen(struct ADrawTag *ctx,
+                         ADrawColour      col)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, LIST_OP_SET_BG_PEN);
+
+    if(w)
+    {
+        w[0] = col;
+        list->bgPen = col;
+        addColour(list, col);
+    }
+}
+
+
+static void ListSetFontSize(struct ADrawTag *ctx,
+                            ADrawFontSize    size)
+{
+    ADrawList    *list = getList(ctx);
+    unsigned int *w = addOp(list, LIST_OP_SET_FONT_SIZE);
+
+    if(w)
+    {
+        w[0] = size;
+        list->fontSize = size;
+    }
+}
+
+
+static bool ListClose(struct ADrawTag *ctx)
+{
+    ADrawList   *list = getList(ctx);
+    unsigned int laterYmin = UINT_MAX;
+    size_t       t;
+
+    /* Complete the index, which needs the runs that follow each run */
+    for(t = list->nRuns; t > 0; t--)
+    {
+        ListRun *r = &list->run[t - 1];
+
+        if(r->ymin < laterYmin)
+        {
+            laterYmin = r->ymin;
+        }
+        r->laterYmin = laterYmin;
+    }
+
+    /* The list is kept for replay, so only report the status */
+    return !list->failed;
+}
+
+
+bool ListInit(ADrawList *list, struct ADrawTag *outContext)
+{
+    assert(list != NULL);
+
+    outContext->internal = list;
+
+    /* Match the initial state of the drawing backends */
+    list->pen      = ADRAW_COL_BLACK;
+    list->bgPen    = ADRAW_COL_WHITE;
+    list->fontSize = ADRAW_FONT_SMALL;
+
+    /* Fill in the function pointers */
+    outContext->line            = ListLine;
+    outContext->dottedLine      = ListDottedLine;
+    outContext->textL           = ListTextL;
+    outContext->textC           = ListTextC;
+    outContext->textR           = ListTextR;
+    outContext->textWidth       = ListTextWidth;
+    outContext->textHeight      = ListTextHeight;
+    outContext->filledRectangle = ListFilledRectangle;
+    outContext->filledTriangle  = ListFilledTriangle;
+    outContext->filledCircle    = ListFilledCircle;
+    outContext->arc             = ListArc;
+    outContext->dottedArc       = ListDottedArc;
+    outContext->setPen          = ListSetPen;
+    outContext->setBgPen        = ListSetBgPen;
+    outContext->setFontSize     = ListSetFontSize;
+    outContext->close           = ListClose;
+
+    return true;
+}
+
+
+ADrawList *ADrawListCreate(void)
+{
+    return calloc(1, sizeof(ADrawList));
+}
+
+
+void ADrawListDestroy(ADrawList *list)
+{
+    if(list)
+    {
+        free(list->word);
+        free(list->run);
+        free(list->str);
+        free(list);
+    }
+}
+
+
+bool ADrawListReplay(const ADrawList *list, struct ADrawTag *ctx)
+{
+    /* Strings may be missing if recording failed */
+    if(list->failed)
+    {
+        return false;
+    }
+
+    replayOps(list, ctx, 0, list->nWords, false, 0, 0);
+
+    return true;
+}
+
+
+bool ADrawListReplayBand(const ADrawList *list,
+                         struct ADrawTag *ctx,
+                         unsigned int     ymin,
+                         unsigned int     ymax)
+{
+    size_t lo = 0, hi = list->nRuns, t;
+
+    if(list->failed)
+    {
+        return false;
+    }
+
+    /* Find the first run that could reach the band */
+    while(lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if(list->run[mid].earlierYmax < ymin)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    /* Replay runs until no later run can reach the band */
+    for(t = lo; t < list->nRuns && list->run[t].laterYmin <= ymax; t++)
+    {
+        const ListRun *r = &list->run[t];
+
+        if(r->ymin <= ymax && r->ymax >= ymin)
+        {
+            const size_t end = t + 1 < list->nRuns ? list->run[t + 1].start : list->nWords;
+
+            /* Earlier runs may have been skipped, so restore the state */
+            ctx->setPen(ctx, r->pen);
+            ctx->setBgPen(ctx, r->bgPen);
+            ctx->setFontSize(ctx, r->fontSize);
+
+            replayOps(list, ctx, r->start, end, true, ymin, ymax);
+        }
+    }
+
+    return true;
+}
+
+
+const ADrawColour *ADrawListGetColours(const ADrawList *list, unsigned int *nColours)
+{
+    *nColours = list->nColours;
+    return list->colour;
+}
+
+/* END OF FILE */
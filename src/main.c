@@ -30,116 +30,77 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#ifdef  HAVE_LIMITS_H
-#include <limits.h>
-#endif
+#include <errno.h>
+#include <assert.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
-#include <errno.h>
-#include <ctype.h>
-#include <assert.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#endif
 #include "cmdparse.h"
-#include "lexer.h"
 #include "usage.h"
-#include "adraw.h"
-#include "safe.h"
+#include "render.h"
+#include "serve.h"
 #include "msc.h"
 
 /***************************************************************************
  * Macro definitions
  ***************************************************************************/
 
-#define M_Max(a, b) (((a) > (b)) ? (a) : (b))
-#define M_Min(a, b) (((a) < (b)) ? (a) : (b))
+/** Maximum number of output types that can be given with -T. */
+#define MAX_OUT_TYPES 6
 
 /***************************************************************************
  * Types
  ***************************************************************************/
 
-/** Structure for holding global options.
- * This structure groups all the options that affect the text output into
- * one structure.
+/** A single chart to be rendered in batch mode.
  */
-typedef struct GlobalOptionsTag
+typedef struct BatchJobTag
 {
-    /** Ideal width of output canvas.
-     * If this value allows the entitySpacing to be increased, then
-     * entitySpacing will be set to the larger value of it's original
-     * value and idealCanvasWidth / number of entities.
-     */
-    unsigned int idealCanvasWidth;
-
-    /** Horizontal spacing between entities. */
-    unsigned int entitySpacing;
+    /** The input filename. */
+    char *inFile;
 
-    /** Gap at the top of the page. */
-    unsigned int entityHeadGap;
-
-    /** Vertical spacing between arcs. */
-    unsigned int arcSpacing;
-
-    /** Arc gradient.
-     * Y offset of arc head, relative to tail, in pixels.
+    /** The output filename, derived from the input filename.
+     * If there are several output types, this gives the name from which
+     * each output filename is formed.
      */
-    int          arcGradient;
-
-    /** Gap between adjacent boxes. */
-    unsigned int boxSpacing;
-
-    /** Minimum distance between box edges and text. */
-    unsigned int boxInternalBorder;
-
-    /** Radius of rounded box corner arcs. */
-    unsigned int rboxArc;
-
-    /** Size of 'corner' added to note boxes. */
-    unsigned int noteCorner;
-
-    /** Anguluar box slope in pixels. */
-    unsigned int aboxSlope;
-
-    /** If true, wrap arc text as well as box contents. */
-    bool         wordWrapArcLabels;
-
-    /** Horizontal width of the arrow heads. */
-    unsigned int arrowWidth;
-
-    /** Vertical depth of the arrow heads. */
-    unsigned int arrowHeight;
-
-    /** Height of an arc which loops back to itself. */
-    unsigned int loopArcHeight;
-
-    /** Horizontal gap between text and horizontal lines. */
-    unsigned int textHGapPre;
-
-    /** Horizontal gap between text and horizontal lines. */
-    unsigned int textHGapPost;
-
-    /** Horizontal width of activation boxes. */
-    unsigned int activationWidth;
+    char  outFile[4096];
 }
-GlobalOptions;
+BatchJob;
 
 
-/** Information about each out row.
+/** State shared between the batch mode worker threads.
  */
-typedef struct
+typedef struct BatchTag
 {
-    /** Minimum Y value. */
-    unsigned int ymin;
+    /** Array of all jobs. */
+    BatchJob            *job;
+
+    /** Count of jobs in \a job[]. */
+    unsigned int         nJobs;
 
-    /** Y position of the arc on the row. */
-    unsigned int arcliney;
+    /** Index of the next job to be started. */
+    unsigned int         nextJob;
 
-    /** Maximum Y value. */
-    unsigned int ymax;
+    /** Count of jobs that failed. */
+    unsigned int         nFailed;
 
-    /** Maximum lines of text on the row. */
-    unsigned int maxTextLines;
+    /** Options used for all renders. */
+    const MscRenderOpts *opts;
+
+    /** GNU make jobserver file descriptors, or -1 if not in use. */
+    int                  jsRead, jsWrite;
+
+#ifdef HAVE_PTHREAD_H
+    /** Lock protecting \a nextJob, \a nFailed and status output. */
+    pthread_mutex_t      lock;
+#endif
 }
-RowInfo;
+Batch;
 
 /***************************************************************************
  * Local Variables.
@@ -152,7 +113,12 @@ static bool gOutputFilePresent = false;
 static char gOutputFile[4096];
 
 static bool gOutTypePresent = false;
-static char gOutType[10];
+static char gOutType[64];
+
+/** The output types given by -T, which may list several separated by ','. */
+static unsigned int    gNumOutTypes = 0;
+static const char     *gOutTypeName[MAX_OUT_TYPES];
+static MscRenderFormat gOutFormat[MAX_OUT_TYPES];
 
 static bool gDumpLicencePresent = false;
 
@@ -161,97 +127,142 @@ static bool gPrintParsePresent = false;
 static bool gOutputFontPresent = false;
 static char gOutputFont[256];
 
-/** Command line switches.
- * This gives the command line switches that can be interpreted by mscgen.
- */
-static CmdSwitch gClSwitches[] =
-{
-    {"-i",     &gInputFilePresent,  "%4096[^?]", gInputFile },
-    {"-o",     &gOutputFilePresent, "%4096[^?]", gOutputFile },
-    {"-T",     &gOutTypePresent,    "%10[^?]",   gOutType },
-    {"-l",     &gDumpLicencePresent,NULL,        NULL },
-    {"-p",     &gPrintParsePresent, NULL,        NULL },
-    {"-F",     &gOutputFontPresent, "%256[^?]",  gOutputFont }
-};
+static bool gBatchFilePresent = false;
+static char gBatchFile[4096];
 
+static bool         gJobsPresent = false;
+static unsigned int gJobs;
 
-static GlobalOptions gOpts =
-{
-    600,    /* idealCanvasWidth */
+static bool gServePresent = false;
+static char gServeAddr[4096];
 
-    80,     /* entitySpacing */
-    20,     /* entityHeadGap */
-    6,      /* arcSpacing */
-    0,      /* arcGradient */
-    8,      /* boxSpacing */
-    4,      /* boxInternalBorder */
-    6,      /* rboxArc */
-    12,     /* noteCorner */
-    6,      /* aboxSlope */
-    false,  /* wordWrapArcLabels */
+static bool gPngPalettePresent = false;
 
-    /* Arrow options */
-    10, 6,
+static bool gPngQuantisePresent = false;
 
-    /* loopArcHeight */
-    12,
+static bool         gPngLevelPresent = false;
+static unsigned int gPngLevel;
 
-    /* textHGapPre, textHGapPost */
-    2, 2,
+static bool gPngFilterPresent = false;
+static char gPngFilter[16];
 
-    12      /* activationWidth */
-};
+static bool         gPngBandPresent = false;
+static unsigned int gPngBand;
 
-/** The drawing. */
-static ADraw drw;
+static bool gSvgCompactPresent = false;
+
+/** Names of the PNG row filters accepted by --png-filter. */
+static const struct
+{
+    const char         *name;
+    MscRenderPngFilter  filter;
+}
+gPngFilterMap[] =
+{
+    { "none",     MSC_RENDER_PNG_FILTER_NONE },
+    { "sub",      MSC_RENDER_PNG_FILTER_SUB },
+    { "up",       MSC_RENDER_PNG_FILTER_UP },
+    { "average",  MSC_RENDER_PNG_FILTER_AVERAGE },
+    { "paeth",    MSC_RENDER_PNG_FILTER_PAETH },
+    { "adaptive", MSC_RENDER_PNG_FILTER_ADAPTIVE }
+};
 
-/** Name of a file to be removed by deleteTmp(). */
-static char *deleteTmpFilename = NULL;
+/** Command line switches.
+ * This gives the command line switches that can be interpreted by mscgen.
+ */
+static CmdSwitch gClSwitches[] =
+{
+    {"-i",      &gInputFilePresent,  "%4095[^?]", gInputFile },
+    {"-o",      &gOutputFilePresent, "%4095[^?]", gOutputFile },
+    {"-T",      &gOutTypePresent,    "%63[^?]",   gOutType },
+    {"-l",      &gDumpLicencePresent,NULL,        NULL },
+    {"-p",      &gPrintParsePresent, NULL,        NULL },
+    {"-F",      &gOutputFontPresent, "%255[^?]",  gOutputFont },
+    {"--batch", &gBatchFilePresent,  "%4095[^?]", gBatchFile },
+    {"-j",      &gJobsPresent,       "%u",        &gJobs },
+    {"--serve", &gServePresent,      "%4095[^?]", gServeAddr },
+    {"--png-palette",  &gPngPalettePresent,  NULL,       NULL },
+    {"--png-quantise", &gPngQuantisePresent, NULL,       NULL },
+    {"--png-level",    &gPngLevelPresent,    "%u",       &gPngLevel },
+    {"--png-filter",   &gPngFilterPresent,   "%15[^?]",  gPngFilter },
+    {"--png-band",     &gPngBandPresent,     "%u",       &gPngBand },
+    {"--svg-compact",  &gSvgCompactPresent,  NULL,       NULL }
+};
 
 /***************************************************************************
  * Functions
  ***************************************************************************/
 
-/** Delete the file named in deleteTmpFilename.
- * This function is registered with atexit() to delete a possible temporary
- * file used when generating image map files.
+/** Check the PNG options and store them in some render options.
+ * \retval false  If the options are not valid.
  */
-static void deleteTmp()
+static bool parsePngOpts(MscRenderOpts *opts)
 {
-    if(deleteTmpFilename)
+    if(gPngPalettePresent && gPngQuantisePresent)
     {
-        unlink(deleteTmpFilename);
+        fprintf(stderr, "--png-palette and --png-quantise cannot be used together\n");
+        return false;
     }
-}
 
+    if(gPngPalettePresent)
+    {
+        opts->pngColour = MSC_RENDER_PNG_PALETTE;
+    }
+    else if(gPngQuantisePresent)
+    {
+        opts->pngColour = MSC_RENDER_PNG_QUANTISED;
+    }
 
-/** Find the next newline in some string.
- * This returns a pointer to the start of the next newline in a
- * string, roughly equivalent to strstr(line, "\n"), but ignoring
- * escaped newlines such as "\\n".
- */
-static char *strnl(const char *line)
-{
-    const char *nl = line;
+    if(gPngLevelPresent)
+    {
+        if(gPngLevel < 1 || gPngLevel > 9)
+        {
+            fprintf(stderr, "--png-level must be from 1 to 9\n");
+            return false;
+        }
+
+        opts->pngLevel = gPngLevel;
+    }
 
-    do
+    if(gPngFilterPresent)
     {
-        nl = strstr(nl, "\\n");
-        if(nl)
+        unsigned int t;
+
+        for(t = 0; t < sizeof(gPngFilterMap) / sizeof(gPngFilterMap[0]); t++)
         {
-            if(nl == line || nl[-1] != '\\')
-            {
-                return (char *)nl;
-            }
-            else
+            if(strcmp(gPngFilter, gPngFilterMap[t].name) == 0)
             {
-                nl += 2;
+                break;
             }
         }
+
+        if(t == sizeof(gPngFilterMap) / sizeof(gPngFilterMap[0]))
+        {
+            fprintf(stderr, "Unknown PNG filter '%s'\n", gPngFilter);
+            return false;
+        }
+
+        opts->pngFilter = gPngFilterMap[t].filter;
+    }
+
+    if(gPngBandPresent)
+    {
+        if(gPngBand == 0)
+        {
+            fprintf(stderr, "--png-band must give at least 1 row\n");
+            return false;
+        }
+
+        if(gPngQuantisePresent)
+        {
+            fprintf(stderr, "--png-band and --png-quantise cannot be used together\n");
+            return false;
+        }
+
+        opts->pngBandHeight = gPngBand;
     }
-    while(nl);
 
-	return NULL;
+    return true;
 }
 
 
@@ -281,1375 +292,672 @@ static void trimExtension(char *s)
 }
 
 
-/** Check if some arc type indicates a box.
- */
-static bool isBoxArc(const MscArcType a)
-{
-    return a == MSC_ARC_BOX || a == MSC_ARC_RBOX  ||
-           a == MSC_ARC_ABOX || a== MSC_ARC_NOTE;
-}
-
-
-/** Count the number of lines in some string.
- * This counts line breaks that are written as a literal '\n' in the line to
- * determine how many lines of output are needed.
- *
- * \param[in] l  Pointer to the input string to inspect.
- * \returns      The count of '\n' characters appearing in the input string + 1.
+/** Form an output filename from an input filename and the output type.
  */
-static unsigned int countLines(const char *l)
+static void makeOutputName(char *out, size_t outLen, const char *inFile, const char *type)
 {
-    unsigned int c = 1;
-
-    do
-    {
-        c++;
-
-        l = strstr(l, "\\n");
-        if(l) l += 2;
-    }
-    while(l != NULL);
-
-    return c;
+    snprintf(out, outLen, "%s", inFile);
+    trimExtension(out);
+    strncat(out, ".", outLen - (strlen(out) + 1));
+    strncat(out, type, outLen - (strlen(out) + 1));
 }
 
 
-/** Word wrap a line of text until the first line is less than \a width wide.
- * This removes words from the input line and builds them into a 2nd new
- * string until the input line is shorter than the supplied width.  The
- * input string is directly truncated, while the remaining characters are
- * returned in a new memory allocation.  On return, the input line of text
- * will be shorter than \a width, while the newly returned string will contain
- * all the remaining characters.
- *
- * If the input line is already shorter than \a width, the function returns
- * NULL and does not modify the input line of text.
- *
- * \param[in,out] l     Input line of text which maybe modified if needed.
- * \param[in]     width Maximum allowable text line width.
- * \returns       NULL if \a l was already less then \a width long,
- *                 otherwise a new string giving the remained of the string.
+/** Split the -T option into the list of output types.
+ * \retval true  If each type is known and only given once.
  */
-static char *splitStringToWidth(char *l, unsigned int width)
+static bool parseOutTypes(void)
 {
-    char *p = l + strlen(l);
-    char *orig = NULL;
-    int   m, n;
+    char *s = gOutType;
 
-    if(drw.textWidth(&drw, l) > width)
+    for(;;)
     {
-        /* Duplicate the original string */
-        orig = strdup_s(l);
+        char        *comma = strchr(s, ',');
+        unsigned int t;
 
-        /* Now remove words from the line until it fits the available width */
-        do
+        if(comma)
         {
-            /* Skip back 1 word */
-            while(!isspace(*p) && p > l)
-            {
-                p--;
-            }
-
-            if(p > l)
-            {
-                *p = '\0';
-            }
+            *comma = '\0';
         }
-        while(drw.textWidth(&drw, l) > width && p > l);
 
-        /* Check if the first word is bigger than the available space;
-         *  we need to hyphenate in this case.
-         */
-        if(p == l)
+        if(gNumOutTypes == MAX_OUT_TYPES)
         {
-            const unsigned int hyphenWidth = drw.textWidth(&drw, "-");
+            fprintf(stderr, "Too many output types (at most %d may be given)\n", MAX_OUT_TYPES);
+            return false;
+        }
 
-            /* Find the end of the first word */
-            while(!isspace(*p) && *p != '\0')
-            {
-                p++;
-            }
+        if(!MscRenderGetFormat(s, &gOutFormat[gNumOutTypes]))
+        {
+            fprintf(stderr, "Unknown output format '%s'\n", s);
+            return false;
+        }
 
-            /* Start removing characters from the word */
-            do
+        for(t = 0; t < gNumOutTypes; t++)
+        {
+            if(gOutFormat[t] == gOutFormat[gNumOutTypes])
             {
-                *p = '\0';
-                p--;
+                fprintf(stderr, "Output format '%s' given more than once\n", s);
+                return false;
             }
-            while(drw.textWidth(&drw, l) + hyphenWidth > width && p > l);
-
-            /* Add a hyphen */
-            *p = '-';
         }
 
-        /* Copy the remaining line to the start of the string */
-        m = 0;
-        n = (p - l);
+        gOutTypeName[gNumOutTypes++] = s;
 
-        while(isspace(orig[n]) && orig[n] != '\0')
+        if(!comma)
         {
-            n++;
+            return true;
         }
 
-        do
-        {
-            orig[m++] = orig[n++];
-        }
-        while(orig[m - 1] != '\0');
+        s = comma + 1;
     }
-
-    return orig;
 }
 
 
-/** Split an input arc label into lines, word-wrapping if needed.
- * This takes the literal label supplied from the input and splits it into an
- * array of char * text lines.  Splitting is first done according to literal
- * '\n' character sequences added by the user, then according to word wrapping
- * to fit available space, if appropriate.
- *
- * \param[in]     m         The MSC for which the lines are to be split.
- * \param[in]     arcType   The type of the arc being labelled.
- * \param[in,out] lines     Pointer to be filled with output line array.
- * \param[in]     label     Original arc label from input file.
- * \param[in]     startCol  Column in which the arc starts.
- * \param[in]     endCol    Column in which the arc ends, or -1 for broadcast arcs.
+/** Close the output files opened by renderFile().
  *
- * \note The returned strings and array must be free()'d.  freeLabelLines() can
- *        be used for this purpose.
+ * \param outName    The names of the outputs.
+ * \param outStream  The files to close.
+ * \param out        The outputs writing to \a outStream, whose sinks are
+ *                     destroyed.
+ * \param n          The count of outputs.
+ * \param ok         If false, the outputs are removed.
+ * \retval true  If \a ok and all the outputs were closed successfully.
  */
-static unsigned int computeLabelLines(Msc               m,
-                                      const MscArcType  arcType,
-                                      char           ***lines,
-                                      const char       *label,
-                                      int               startCol,
-                                      int               endCol)
+static bool closeOutputs(char             outName[][4096],
+                         FILE           **outStream,
+                         MscRenderOutput *out,
+                         unsigned int     n,
+                         bool             ok)
 {
-    unsigned int  width;
-    unsigned int  nAllocLines = 8;
-    char        **retLines = malloc_s(sizeof(char *) * nAllocLines);
-    unsigned int  c = 0;
-
-    assert(startCol >= 0 && startCol < (signed)MscGetNumEntities(m));
-    assert(startCol >= -1 && startCol < (signed)MscGetNumEntities(m));
+    unsigned int t;
 
-    /* Compute available width for text */
-    if(isBoxArc(arcType) || gOpts.wordWrapArcLabels)
+    for(t = 0; t < n; t++)
     {
-        if(endCol == -1)
+        if(!SinkDestroy(out[t].out))
         {
-            /* This is a special case for a broadcast arc */
-            width = gOpts.entitySpacing * MscGetNumEntities(m);
+            ok = false;
         }
-        else if(startCol < endCol)
-        {
-            width = gOpts.entitySpacing * (1 + (endCol - startCol));
-        }
-        else
+
+        if(outStream[t] != stdout)
         {
-            width = gOpts.entitySpacing * (1 + (startCol - endCol));
+            if(fclose(outStream[t]) != 0)
+            {
+                fprintf(stderr, "Failed to close output file '%s': %s\n", outName[t], strerror(errno));
+                ok = false;
+            }
         }
+    }
 
-        /* Reduce the width due to the box borders */
-        if(isBoxArc(arcType))
+    /* Don't leave partial output behind */
+    if(!ok)
+    {
+        for(t = 0; t < n; t++)
         {
-            width -= (gOpts.boxSpacing + gOpts.boxInternalBorder) * 2;
+            if(outStream[t] != stdout)
+            {
+                remove(outName[t]);
+            }
         }
+    }
+
+    return ok;
+}
+
+
+/** Parse and render a single chart to each of the output types.
+ *
+ * \param inFile   The input filename, or "-" for stdin.
+ * \param outFile  The output filename, or "-" for stdout.  If there are
+ *                   several output types, each output is named by replacing
+ *                   the extension of this with the type.
+ * \param opts     Options for the render.
+ * \retval true  If the chart was rendered successfully.
+ */
+static bool renderFile(const char *inFile, const char *outFile, const MscRenderOpts *opts)
+{
+    char            outName[MAX_OUT_TYPES][4096];
+    FILE           *outStream[MAX_OUT_TYPES];
+    MscRenderOutput out[MAX_OUT_TYPES];
+    unsigned int    t;
+    Msc             m;
+    bool            r;
+
+    /* Parse input, either from a file, or stdin */
+    if(strcmp(inFile, "-") != 0)
+    {
+        FILE *in = fopen(inFile, "r");
 
-        if(arcType == MSC_ARC_NOTE)
+        if(!in)
         {
-            width -= gOpts.noteCorner;
+            fprintf(stderr, "Failed to open input file '%s'\n", inFile);
+            return false;
         }
+        m = MscParse(in);
+        fclose(in);
     }
     else
     {
-        width = UINT_MAX;
+        m = MscParse(stdin);
     }
 
-    /* Split the input label into lines */
-    while(label != NULL)
+    /* Check if the parse was okay */
+    if(!m)
     {
-        /* First split around user specified lines with literal '\n' */
-        char *nextLine = strnl(label);
-        if(nextLine)
-        {
-            const int lineLen = nextLine - label;
+        return false;
+    }
+
+    /* Print the parse output if requested */
+    if(gPrintParsePresent)
+    {
+        MscPrint(m);
+    }
 
-            /* Allocate storage and duplicate the line */
-            retLines[c] = malloc_s(lineLen + 1);
-            memcpy(retLines[c], label, lineLen);
-            retLines[c][lineLen] = '\0';
+#ifndef USE_FREETYPE
+    for(t = 0; t < gNumOutTypes; t++)
+    {
+        if(gOutFormat[t] == MSC_RENDER_PNG && MscGetUtf8(m))
+        {
+            fprintf(stderr, "Warning: Optional UTF-8 byte-order-mark detected at start of input, but mscgen\n"
+                            "         was not configured to use FreeType for text rendering.  Rendering of\n"
+                            "         UTF-8 characters in PNG output may be incorrect.\n");
+        }
+    }
+#endif
 
-            /* Advance the label */
-            label = nextLine + 2;
+    /* Open the outputs */
+    for(t = 0; t < gNumOutTypes; t++)
+    {
+        if(gNumOutTypes == 1)
+        {
+            snprintf(outName[t], sizeof(outName[t]), "%s", outFile);
         }
         else
         {
-            /* Duplicate the final line */
-            retLines[c] = strdup_s(label);
-            label = NULL;
+            makeOutputName(outName[t], sizeof(outName[t]), outFile, gOutTypeName[t]);
         }
 
-        /* Now split the line as required to wrap into the space available */
-        do
+        out[t].format = gOutFormat[t];
+
+        if(strcmp(outName[t], "-") == 0)
+        {
+            outStream[t] = stdout;
+        }
+        else
         {
-            /* Check if more storage maybe needed */
-            if(c + 2 >= nAllocLines)
+            outStream[t] = fopen(outName[t], "wb");
+            if(!outStream[t])
             {
-                nAllocLines += 8;
-                retLines = realloc_s(retLines, sizeof(char *) * nAllocLines);
+                fprintf(stderr, "Failed to open output file '%s': %s\n", outName[t], strerror(errno));
+                closeOutputs(outName, outStream, out, t, false);
+                MscFree(m);
+                return false;
             }
+        }
 
-            retLines[c + 1] = splitStringToWidth(retLines[c], width);
-            c++;
+        /* Output is gathered in the sink's buffer and written in large blocks */
+        out[t].out = SinkCreateFile(outStream[t]);
+        if(!out[t].out)
+        {
+            fprintf(stderr, "Out of memory opening output file '%s'\n", outName[t]);
+            if(outStream[t] != stdout)
+            {
+                fclose(outStream[t]);
+                remove(outName[t]);
+            }
+            closeOutputs(outName, outStream, out, t, false);
+            MscFree(m);
+            return false;
         }
-        while(retLines[c] != NULL);
     }
 
-    /* Return the array of lines and the count */
-    *lines = retLines;
+    r = MscRenderMulti(m, opts, out, gNumOutTypes);
+    r = closeOutputs(outName, outStream, out, gNumOutTypes, r);
+
+    MscFree(m);
 
-    return c;
+    return r;
 }
 
 
-/** Free memory allocated for the label lines.
+/** Read the list of input files for batch mode.
+ * The batch file lists one input filename per line.  Blank lines and lines
+ * starting with '#' are ignored.
+ *
+ * \param[in]     batchFile  The file to read, or "-" for stdin.
+ * \param[in,out] b          Batch to be filled with the jobs.
+ * \retval true  If the file was read successfully.
  */
-static void freeLabelLines(unsigned int n, char **lines)
+static bool readBatchFile(const char *batchFile, Batch *b)
 {
-    while(n > 0)
+    unsigned int jobsLen = 0, lineNum = 0;
+    char         line[4096];
+    FILE        *in;
+    bool         ok;
+
+    if(strcmp(batchFile, "-") == 0)
+    {
+        in = stdin;
+    }
+    else
     {
-        n--;
-        free(lines[n]);
+        in = fopen(batchFile, "r");
+        if(!in)
+        {
+            fprintf(stderr, "Failed to open batch file '%s': %s\n", batchFile, strerror(errno));
+            return false;
+        }
     }
 
-    free(lines);
-}
+    while(fgets(line, sizeof(line), in) != NULL)
+    {
+        size_t l = strlen(line);
 
+        lineNum++;
 
-/** Get some line from a string containing '\n' delimiters.
- * Given a string that contains literal '\n' delimiters, return a subset in
- * a passed buffer that gives the nth line.
- *
- * \param[in] string  The string to parse.
- * \param[in] line    The line number to return from the string, which should
- *                     count from 0.
- * \param[in] out     Pointer to a buffer to fill with line data.
- * \param[in] outLen  The length of the buffer pointed to by \a out, in bytes.
- * \returns  A pointer to \a out.
- */
-static char *getLine(const char        *string,
-                     unsigned int       line,
-                     char *const        out,
-                     const unsigned int outLen)
-{
-    const char  *lineStart, *lineEnd;
-    unsigned int lineLen;
+        /* A full buffer without a newline is only complete at the end */
+        if(l == sizeof(line) - 1 && line[l - 1] != '\n')
+        {
+            const int c = getc(in);
 
-    /* Setup for the loop */
-    lineEnd = NULL;
-    line++;
+            if(c != EOF && c != '\n')
+            {
+                fprintf(stderr, "Line %u of batch file '%s' is too long\n",
+                        lineNum, batchFile);
+                break;
+            }
+        }
 
-    do
-    {
-        /* Check if this is the first or a repeat iteration */
-        if(lineEnd)
+        l = strcspn(line, "\r\n");
+        line[l] = '\0';
+        if(l == 0 || line[0] == '#')
         {
-            lineStart = lineEnd + 2;
+            continue;
         }
-        else
+
+        /* Grow the job array if needed */
+        if(b->nJobs == jobsLen)
         {
-            lineStart = string;
-        }
+            BatchJob *job;
 
-        /* Search for next delimited */
-        lineEnd = strnl(lineStart);
+            jobsLen = jobsLen ? jobsLen * 2 : 64;
+            job = realloc(b->job, jobsLen * sizeof(BatchJob));
+            if(!job)
+            {
+                fprintf(stderr, "Out of memory reading batch file\n");
+                break;
+            }
+            b->job = job;
+        }
 
-        line--;
+        b->job[b->nJobs].inFile = strdup(line);
+        if(!b->job[b->nJobs].inFile)
+        {
+            fprintf(stderr, "Out of memory reading batch file\n");
+            break;
+        }
+        if(gNumOutTypes == 1)
+        {
+            makeOutputName(b->job[b->nJobs].outFile, sizeof(b->job[b->nJobs].outFile),
+                           line, gOutTypeName[0]);
+        }
+        else
+        {
+            snprintf(b->job[b->nJobs].outFile, sizeof(b->job[b->nJobs].outFile), "%s", line);
+        }
+        b->nJobs++;
     }
-    while(line > 0 && lineEnd != NULL);
 
-    /* Determine the length of the line */
-    if(lineEnd != NULL)
+    ok = !ferror(in) && feof(in);
+    if(ferror(in))
     {
-        lineLen = lineEnd - lineStart;
-    }
-    else
-    {
-        lineLen = strlen(string) - (lineStart - string);
+        fprintf(stderr, "Failed to read batch file '%s': %s\n", batchFile, strerror(errno));
     }
 
-    /* Clamp the length to the buffer */
-    if(lineLen > outLen - 1)
+    if(in != stdin)
     {
-        lineLen = outLen - 1;
+        fclose(in);
     }
 
-    /* Copy desired characters */
-    memcpy(out, lineStart, lineLen);
-
-    /* NULL terminate */
-    out[lineLen] = '\0';
-
-    return out;
+    return ok;
 }
 
+#ifdef HAVE_PTHREAD_H
 
-/** Check if some arc name indicates a broadcast entity.
+/** Find any GNU make jobserver passed in the environment.
+ * If mscgen is run from a recipe of 'make -j', MAKEFLAGS gives the
+ * jobserver, which is either a pair of pipe file descriptors or a named
+ * FIFO.  Each token read from the jobserver permits one extra job to run in
+ * parallel, and must be written back once the job is complete.
+ *
+ * \param[in,out] b     Batch whose \a jsRead and \a jsWrite are to be set.
+ * \param[in]     jobs  The number of workers, for warning messages.
  */
-static bool isBroadcastArc(const char *entity)
+static void findJobserver(Batch *b, unsigned int jobs)
 {
-    return entity != NULL && (strcmp(entity, "*") == 0);
-}
+    const char *flags = getenv("MAKEFLAGS");
+    const char *auth;
 
+    b->jsRead = b->jsWrite = -1;
 
-/** Get the skip value in pixels for some the current arc in the Msc.
- */
-static int getArcGradient(Msc m, MscArcIter *ai, const RowInfo *rowInfo, unsigned int row)
-{
-    const char   *s = MscGetArcAttrib(ai, MSC_ATTR_ARC_SKIP);
-    unsigned int  v = gOpts.arcGradient;
+    if(!flags)
+    {
+        return;
+    }
 
-    if(s != NULL && rowInfo != NULL)
+    /* Newer make uses --jobserver-auth, older --jobserver-fds */
+    auth = strstr(flags, "--jobserver-auth=");
+    if(auth)
     {
-        const unsigned int rowCount = MscGetNumArcs(m) - MscGetNumParallelArcs(m);
-        unsigned int       skip;
+        auth += strlen("--jobserver-auth=");
+    }
+    else if((auth = strstr(flags, "--jobserver-fds=")) != NULL)
+    {
+        auth += strlen("--jobserver-fds=");
+    }
+    else
+    {
+        return;
+    }
 
-        if(sscanf(s, "%u", &skip) == 1)
-        {
-            unsigned int ystart = rowInfo[row].arcliney;
-            unsigned int yend   = rowInfo[M_Min(rowCount - 1, row + skip)].arcliney;
+    if(strncmp(auth, "fifo:", 5) == 0)
+    {
+        char path[4096];
 
-            v += yend - ystart;
+        if(sscanf(auth + 5, "%4095s", path) == 1)
+        {
+            b->jsRead = b->jsWrite = open(path, O_RDWR);
         }
-        else
+    }
+    else if(sscanf(auth, "%d,%d", &b->jsRead, &b->jsWrite) == 2)
+    {
+        /* The descriptors are only inherited if the recipe is marked '+' */
+        if(b->jsRead < 0 || b->jsWrite < 0 ||
+           fcntl(b->jsRead, F_GETFD) == -1 || fcntl(b->jsWrite, F_GETFD) == -1)
         {
-            fprintf(stderr, "Warning: Non-integer arcskip value: %s\n", s);
+            b->jsRead = b->jsWrite = -1;
         }
     }
-
-    return v;
-}
-
-
-/** Add a point to the output imagemap.
- * If \a ismap and \a url are non-NULL, this function will add a rectangle
- * to the imagemap according to the parameters passed.
- *
- * \param ismap  The file to which the imagemap should be rendered.
- * \param url    The URL to which the imagemap area should link.
- * \param x1     The x coordinate for the upper left point.
- * \param y2     The y coordinate for the upper left point.
- * \param x2     The x coordinate for the lower right point.
- * \param y2     The y coordinate for the lower right point.
- */
-static void ismapRect(FILE        *ismap,
-                      const char  *url,
-                      unsigned int x1,
-                      unsigned int y1,
-                      unsigned int x2,
-                      unsigned int y2)
-{
-    if(ismap && url)
+    else
     {
-        assert(x1 <= x2); assert(y1 <= y2);
+        b->jsRead = b->jsWrite = -1;
+    }
 
-        fprintf(ismap,
-                "rect %s %d,%d %d,%d\n",
-                url,
-                x1, y1,
-                x2, y2);
+    if(b->jsRead == -1)
+    {
+        fprintf(stderr, "Warning: make jobserver is not accessible; running %u jobs regardless\n",
+                jobs);
     }
-#if 0
-    /* For debug render a cross onto the output */
-    drw.line(&drw, x1, y1, x2, y2);
-    drw.line(&drw, x2, y1, x1, y2);
-#endif
 }
 
 
-/** Draw an arrow pointing to the right.
- * \param x     The x co-ordinate for the end point for the arrow head.
- * \param y     The y co-ordinate for the end point for the arrow head.
- * \param type  The arc type, which controls the format of the arrow head.
+/** Take a token from the jobserver, blocking until one is available.
+ * \retval true  If a token was taken.
  */
-static void arrowR(unsigned int x,
-                   unsigned int y,
-                   MscArcType   type)
+static bool jobserverAcquire(Batch *b)
 {
-    switch(type)
+    for(;;)
     {
-        case MSC_ARC_SIGNAL: /* Unfilled half */
-            drw.line(&drw,
-                     x, y,
-                     x - gOpts.arrowWidth, y + gOpts.arrowHeight);
-            break;
+        struct pollfd pfd;
+        char          c;
+        ssize_t       r;
 
-        case MSC_ARC_DOUBLE:
-        case MSC_ARC_METHOD: /* Filled */
-        case MSC_ARC_RETVAL: /* Filled, dotted arc (not rendered here) */
-            drw.filledTriangle(&drw,
-                               x, y,
-                               x - gOpts.arrowWidth, y + gOpts.arrowHeight,
-                               x - gOpts.arrowWidth, y - gOpts.arrowHeight);
-            break;
+        pfd.fd     = b->jsRead;
+        pfd.events = POLLIN;
 
-        case MSC_ARC_CALLBACK: /* Non-filled */
-            drw.line(&drw,
-                     x, y,
-                     x - gOpts.arrowWidth, y + gOpts.arrowHeight);
-            drw.line(&drw,
-                     x - gOpts.arrowWidth, y - gOpts.arrowHeight,
-                     x, y);
-            break;
+        if(poll(&pfd, 1, -1) == -1 && errno != EINTR)
+        {
+            return false;
+        }
 
-        default:
-            assert(0);
-            break;
+        /* Another process may win the token, so the read may fail */
+        r = read(b->jsRead, &c, 1);
+        if(r == 1)
+        {
+            return true;
+        }
+        else if(r == 0 || (errno != EINTR && errno != EAGAIN))
+        {
+            return false;
+        }
     }
 }
 
 
-/** Draw an arrow pointing to the left.
- * \param x     The x co-ordinate for the end point for the arrow head.
- * \param y     The y co-ordinate for the end point for the arrow head.
- * \param type  The arc type, which controls the format of the arrow head.
+/** Return a token to the jobserver.
  */
-static void arrowL(unsigned int x,
-                   unsigned int y,
-                   MscArcType   type)
+static void jobserverRelease(Batch *b)
 {
-    switch(type)
-    {
-        case MSC_ARC_SIGNAL: /* Unfilled half */
-            drw.line(&drw,
-                     x, y,
-                     x + gOpts.arrowWidth, y + gOpts.arrowHeight);
-            break;
-
-        case MSC_ARC_DOUBLE:
-        case MSC_ARC_METHOD: /* Filled */
-        case MSC_ARC_RETVAL: /* Filled, dotted arc (not rendered here) */
-            drw.filledTriangle(&drw,
-                               x, y,
-                               x + gOpts.arrowWidth, y + gOpts.arrowHeight,
-                               x + gOpts.arrowWidth, y - gOpts.arrowHeight);
-            break;
-
-        case MSC_ARC_CALLBACK: /* Non-filled */
-            drw.line(&drw,
-                     x, y,
-                     x + gOpts.arrowWidth, y + gOpts.arrowHeight);
-            drw.line(&drw,
-                     x, y,
-                     x + gOpts.arrowWidth, y - gOpts.arrowHeight);
-            break;
+    const char c = '+';
 
-        default:
-            assert(0);
-            break;
-    }
+    while(write(b->jsWrite, &c, 1) == -1 && errno == EINTR)
+        ;
 }
 
+#endif /* HAVE_PTHREAD_H */
 
-/** Render some entity text.
- * Draw the text for some entity.
- * \param  ismap       If not \a NULL, write an ismap description here.
- * \param  x           The x position at which the entity text should be centered.
- * \param  y           The y position where the text should be placed.
- * \param  entLabel    The label to render, which maybe \a NULL in which case
- *                       no ouput is produced.
- * \param  entUrl      The URL for rendering the label as a hyperlink.  This
- *                       maybe \a NULL if not required.
- * \param  entId       The text identifier for the arc.
- * \param  entIdUrl    The URL for rendering the test identifier as a hyperlink.
- *                       This maybe \a NULL if not required.
- * \param  entColour   The text colour name or specification for the entity text.
- *                      If NULL, use default colouring scheme.
- * \param  entBgColour The text background colour name or specification for the
- *                      entity text. If NULL, use default colouring scheme.
+/** Worker for rendering batch jobs.
+ * Each worker takes jobs from the batch until all jobs have been started.
+ * The first worker runs on the token make implicitly grants to mscgen,
+ * while others must hold a jobserver token, if there is one, for each job.
+ *
+ * \param b       The batch to process.
+ * \param worker  Index of the worker.
  */
-static void entityText(FILE             *ismap,
-                       unsigned int      x,
-                       unsigned int      y,
-                       const char       *entLabel,
-                       const char       *entUrl,
-                       const char       *entId,
-                       const char       *entIdUrl,
-                       const char       *entColour,
-                       const char       *entBgColour)
+static void batchWorker(Batch *b, unsigned int worker)
 {
-    if(entLabel)
-    {
-        const unsigned int lines = countLines(entLabel);
-        unsigned int       l;
-        char               lineBuffer[1024];
+#ifdef HAVE_PTHREAD_H
+    const bool useToken = worker > 0 && b->jsRead != -1;
+#endif
 
-        /* Adjust y to be above the writing line */
-        y -= drw.textHeight(&drw) * (lines - 1);
+    for(;;)
+    {
+        unsigned int j;
+        bool         ok;
 
-        for(l = 0; l < lines - 1; l++)
+#ifdef HAVE_PTHREAD_H
+        if(useToken && !jobserverAcquire(b))
         {
-            char         *lineLabel = getLine(entLabel, l, lineBuffer, sizeof(lineBuffer));
-            unsigned int  width     = drw.textWidth(&drw, lineLabel);
-
-            /* Push text down one line */
-            y += drw.textHeight(&drw);
+            return;
+        }
 
-            /* Check if a URL is associated */
-            if(entUrl)
-            {
-                /* If no explict colour has been set, make URLS blue */
-                drw.setPen(&drw, ADRAW_COL_BLUE);
-
-                /* Image map output */
-                ismapRect(ismap,
-                          entUrl,
-                          x - (width / 2), y - drw.textHeight(&drw),
-                          x + (width / 2), y);
-            }
-
-            /* Set to the explicit colours if directed */
-            if(entColour != NULL)
-            {
-                drw.setPen(&drw, ADrawGetColour(entColour));
-            }
-
-            if(entBgColour != NULL)
-            {
-                drw.setBgPen(&drw, ADrawGetColour(entBgColour));
-            }
-
-            /* Render text and restore pen */
-            drw.textC (&drw, x, y, lineLabel, entUrl);
-            drw.setPen(&drw, ADRAW_COL_BLACK);
-            drw.setBgPen(&drw, ADRAW_COL_WHITE);
-
-            /* Render the Id of the title, if specified and for first line only */
-            if(entId && l == 0)
-            {
-                unsigned int idwidth;
-                int          idx, idy;
-
-                idy = y - drw.textHeight(&drw);
-                idx = x + (width / 2);
-
-                drw.setFontSize(&drw, ADRAW_FONT_TINY);
-
-                idwidth = drw.textWidth(&drw, entId);
-                idy    += (drw.textHeight(&drw) + 1) / 2;
-
-                if(entIdUrl)
-                {
-                    drw.setPen(&drw, ADRAW_COL_BLUE);
-                    drw.textR (&drw, idx, idy, entId, entIdUrl);
-                    drw.setPen(&drw, ADRAW_COL_BLACK);
-
-                    /* Image map output */
-                    ismapRect(ismap,
-                              entIdUrl,
-                              idx, idy - drw.textHeight(&drw),
-                              idx + idwidth, idy);
-                }
-                else
-                {
-                    drw.textR(&drw, idx, idy, entId, NULL);
-                }
-
-                drw.setFontSize(&drw, ADRAW_FONT_SMALL);
-            }
-        }
-    }
-}
-
-
-/** Compute the output canvas size required for some MSC.
- * This computes the dimensions for the canvas as well as the height for each
- * row.
- *
- * \param[in]     m    The MSC to analyse.
- * \param[in,out] w    Pointer to be filled with the output width.
- * \param[in,out] h    Pointer to be filled with the output height.
- * \returns  An array giving the height of each row.
- */
-static RowInfo *computeCanvasSize(Msc           m,
-                                  unsigned int *w,
-                                  unsigned int *h)
-{
-    const unsigned int rowCount = MscGetNumArcs(m) - MscGetNumParallelArcs(m);
-    const unsigned int textHeight = drw.textHeight(&drw);
-    RowInfo      *rowHeight;
-    unsigned int  nextYmin, ymin, ymax, yskipmax, row;
-    MscArcIter    ai;
-
-    /* Allocate storage for the height of each row */
-    rowHeight = zalloc_s(sizeof(RowInfo) * rowCount);
-    row = 0;
-
-    nextYmin = ymin = gOpts.entityHeadGap;
-    yskipmax = 0;
-    ymax = 0;
-
-    for(ai = MscArcIterBegin(m); !MscArcIterEnd(&ai); MscNextArc(&ai))
-    {
-        const MscArcType   arcType           = MscGetArcType(&ai);
-        const int          arcGradient       = isBoxArc(arcType) ? 0 : getArcGradient(m, &ai, NULL, 0);
-        char             **arcLabelLines     = NULL;
-        unsigned int       arcLabelLineCount = 0;
-        int                startCol = -1, endCol = -1;
-
-        if(arcType == MSC_ARC_PARALLEL)
+        pthread_mutex_lock(&b->lock);
+#endif
+        j = b->nextJob;
+        if(j < b->nJobs)
         {
-            assert(row > 0);
-
-            row--;
-
-            ymin = rowHeight[row].ymin;
-            nextYmin = rowHeight[row].ymax;
+            b->nextJob++;
         }
-        else
-        {
-            /* Get the entity indices */
-            if(arcType != MSC_ARC_DISCO && arcType != MSC_ARC_DIVIDER && arcType != MSC_ARC_SPACE)
-            {
-                startCol = MscGetEntityIndex(m, MscGetArcSource(&ai));
-                endCol   = MscGetEntityIndex(m, MscGetArcDest(&ai));
-            }
-            else
-            {
-                /* Discontinuity or parallel arc spans whole chart */
-                startCol = 0;
-                endCol   = MscGetNumEntities(m) - 1;
-            }
-
-            /* Work out how the label fits the gap between entities */
-            arcLabelLineCount = computeLabelLines(m, arcType, &arcLabelLines,
-                                                  MscGetArcAttrib(&ai, MSC_ATTR_LABEL),
-                                                  startCol, endCol);
-
-            assert(row < rowCount);
-
-            /* Update the max line count for the row */
-            if(arcLabelLineCount > rowHeight[row].maxTextLines)
-            {
-                rowHeight[row].maxTextLines = arcLabelLineCount;
-            }
-
-            freeLabelLines(arcLabelLineCount, arcLabelLines);
-
-            /* Compute the height of this arc */
-            if(arcType != MSC_ARC_DISCO && arcType != MSC_ARC_DIVIDER && arcType != MSC_ARC_SPACE)
-            {
-                ymax = ymin + gOpts.arcSpacing;
-                ymax += (M_Max(rowHeight[row].maxTextLines, 2) * textHeight);
-            }
-            else
-            {
-                ymax = ymin + gOpts.arcSpacing;
-                ymax += (M_Max(rowHeight[row].maxTextLines, 1) * textHeight);
-            }
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_unlock(&b->lock);
+#endif
 
-            /* Update next potential row start */
-            if(ymax > nextYmin)
+        /* Check if all jobs have been started */
+        if(j >= b->nJobs)
+        {
+#ifdef HAVE_PTHREAD_H
+            if(useToken)
             {
-                nextYmin = ymax;
+                jobserverRelease(b);
             }
+#endif
+            return;
+        }
 
-            /* Compute the dimensions for the completed row */
-            rowHeight[row].ymin     = ymin;
-            rowHeight[row].ymax     = nextYmin - gOpts.arcSpacing;
-            rowHeight[row].arcliney = rowHeight[row].ymin + (rowHeight[row].ymax - rowHeight[row].ymin) / 2;
-            row++;
+        ok = renderFile(b->job[j].inFile, b->job[j].outFile, b->opts);
 
-            /* Start new row */
-            ymin = nextYmin;
+#ifdef HAVE_PTHREAD_H
+        if(useToken)
+        {
+            jobserverRelease(b);
         }
+#endif
 
-        /* Keep a track of where the gradient may cause the graph to end */
-        if(ymax + arcGradient > ymax)
+        /* Report the status of the job */
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_lock(&b->lock);
+#endif
+        if(!ok)
         {
-            yskipmax = ymax + arcGradient;
+            b->nFailed++;
         }
-
+        printf("%s: %s\n", b->job[j].inFile, ok ? "ok" : "failed");
+        fflush(stdout);
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_unlock(&b->lock);
+#endif
     }
-
-    if(ymax < yskipmax)
-        ymax = yskipmax;
-
-    /* Set the return values */
-    *w = MscGetNumEntities(m) * gOpts.entitySpacing;
-    *h = ymax;
-
-    return rowHeight;
 }
 
+#ifdef HAVE_PTHREAD_H
 
-/** Draw vertical lines stemming from entities.
- * This function will draw a single segment of the vertical line that
- * drops from an entity.
- *
- * \param m          The \a Msc for which the lines are drawn
- * \param ymin       Top of the row.
- * \param ymax       Bottom of the row.
- * \param dotted     If \a true, produce a dotted line, otherwise solid.
- * \param colourRefs Colour references for each entity.
+/** Argument passed to batchThread().
  */
-static void entityLines(Msc                m,
-                        const unsigned int ymin,
-                        const unsigned int ymax,
-                        bool               dotted,
-                        const ADrawColour *colourRefs,
-                        int               *activations)
+typedef struct
 {
-    unsigned int t;
-
-    for(t = 0; t < MscGetNumEntities(m); t++)
-    {
-        unsigned int x = (gOpts.entitySpacing / 2) + (gOpts.entitySpacing * t);
-
-        if (activations[t] > 0)
-        {
-            int a;
-
-            for (a = 0; a < activations[t]; a++)
-            {
-                drw.setPen(&drw, ADRAW_COL_WHITE);
-                drw.filledRectangle(&drw, x + a * (gOpts.activationWidth - 1) / 2, ymin, x + a * gOpts.activationWidth / 2, ymax);
-
-                drw.setPen(&drw, colourRefs[t]);
-                if(dotted)
-                {
-                    drw.dottedLine(&drw, (a * gOpts.activationWidth / 2) + (x - gOpts.activationWidth / 2), ymin, (a * gOpts.activationWidth / 2) + (x - gOpts.activationWidth / 2), ymax);
-                    drw.dottedLine(&drw, (a * gOpts.activationWidth / 2) + (x + gOpts.activationWidth / 2), ymin, (a * gOpts.activationWidth / 2) + (x + gOpts.activationWidth / 2), ymax);
-                }
-                else
-                {
-                    drw.line(&drw, (a * gOpts.activationWidth / 2) + (x - gOpts.activationWidth / 2), ymin, (a * gOpts.activationWidth / 2) + (x - gOpts.activationWidth / 2), ymax);
-                    drw.line(&drw, (a * gOpts.activationWidth / 2) + (x + gOpts.activationWidth / 2), ymin, (a * gOpts.activationWidth / 2) + (x + gOpts.activationWidth / 2), ymax);
-                }
-            }
-        }
-        else if (activations[t] == 0)
-        {
-            drw.setPen(&drw, colourRefs[t]);
-
-            if(dotted)
-            {
-                drw.dottedLine(&drw, x, ymin, x, ymax);
-            }
-            else
-            {
-                drw.line(&drw, x, ymin, x, ymax);
-            }
-        }
-    }
-
-    drw.setPen(&drw, ADRAW_COL_BLACK);
-
+    Batch       *b;
+    unsigned int worker;
 }
+BatchThreadArg;
 
 
-
-/** Draw vertical lines and boxes stemming from entities.
- * \param ymin          Top of the row.
- * \param ymax          Bottom of the row.
- * \param boxStart      Column in which the box starts.
- * \param boxEnd        Column in which the box ends.
- * \param boxType       The type of box to draw, MSC_ARC_BOX, MSC_ARC_RBOX etc.
- * \param lineColour    Colour of the lines to use for rendering the box.
- * \param bgColour      Background colour for rendering the box.
+/** pthread entry point for batchWorker().
  */
-static void arcBox(unsigned int       ymin,
-                   unsigned int       ymax,
-                   unsigned int       boxStart,
-                   unsigned int       boxEnd,
-                   MscArcType         boxType,
-                   const char        *lineColour,
-                   const char        *bgColour)
+static void *batchThread(void *arg)
 {
-    unsigned int t;
+    BatchThreadArg *a = arg;
 
-    /* Ensure the start is less than or equal to the end */
-    if(boxStart > boxEnd)
-    {
-        t = boxEnd;
-        boxEnd = boxStart;
-        boxStart = t;
-    }
-
-    /* Now draw the box */
-    unsigned int x1 = (gOpts.entitySpacing * boxStart) + gOpts.boxSpacing;
-    unsigned int x2 = gOpts.entitySpacing * (boxEnd + 1) - gOpts.boxSpacing;
-    unsigned int ymid = (ymin + ymax) / 2;
-
-    /* Set colour for the background area */
-    if(bgColour != NULL)
-    {
-        drw.setPen(&drw, ADrawGetColour(bgColour));
-    }
-    else
-    {
-        drw.setPen(&drw, ADRAW_COL_WHITE);
-    }
+    batchWorker(a->b, a->worker);
 
-    /* Draw the background to overwrite the entity lines */
-    switch(boxType)
-    {
-        case MSC_ARC_BOX:
-            drw.filledRectangle(&drw, x1, ymin, x2, ymax);
-            break;
-
-        case MSC_ARC_RBOX:
-            drw.filledRectangle(&drw, x1 + gOpts.rboxArc, ymin, x2 - gOpts.rboxArc, ymax);
-            drw.filledRectangle(&drw, x1, ymin + gOpts.rboxArc, x2, ymax - gOpts.rboxArc);
-            drw.filledCircle(&drw, x1 + gOpts.rboxArc, ymin + gOpts.rboxArc, gOpts.rboxArc);
-            drw.filledCircle(&drw, x2 - gOpts.rboxArc, ymin + gOpts.rboxArc, gOpts.rboxArc);
-            drw.filledCircle(&drw, x1 + gOpts.rboxArc, ymax - gOpts.rboxArc, gOpts.rboxArc);
-            drw.filledCircle(&drw, x2 - gOpts.rboxArc, ymax - gOpts.rboxArc, gOpts.rboxArc);
-            break;
-
-        case MSC_ARC_NOTE:
-            drw.filledRectangle(&drw, x1, ymin, x2 - gOpts.noteCorner, ymax);
-            drw.filledRectangle(&drw, x1, ymin + gOpts.noteCorner, x2, ymax);
-            drw.filledTriangle(&drw, x2 - gOpts.noteCorner, ymin,
-                                     x2, ymin + gOpts.noteCorner,
-                                     x2 - gOpts.noteCorner, ymin + gOpts.noteCorner);
-            break;
-
-        case MSC_ARC_ABOX:
-            drw.filledRectangle(&drw, x1 + gOpts.aboxSlope, ymin, x2 - gOpts.aboxSlope, ymax);
-            drw.filledTriangle(&drw, x1 + gOpts.aboxSlope, ymin,
-                                     x1 + gOpts.aboxSlope, ymax,
-                                     x1, ymid);
-            drw.filledTriangle(&drw, x2 - gOpts.aboxSlope, ymin,
-                                     x2 - gOpts.aboxSlope, ymax,
-                                     x2, ymid);
-            break;
-
-        default:
-            assert(0);
-    }
-
-    /* Setup the colour for rendering the boxes */
-    if(lineColour)
-    {
-        drw.setPen(&drw, ADrawGetColour(lineColour));
-    }
-    else
-    {
-        drw.setPen(&drw, ADRAW_COL_BLACK);
-    }
-
-    /* Draw the outline */
-    switch(boxType)
-    {
-        case MSC_ARC_BOX:
-            drw.line(&drw, x1, ymin, x2, ymin);
-            drw.line(&drw, x1, ymax, x2, ymax);
-            drw.line(&drw, x1, ymin, x1, ymax);
-            drw.line(&drw, x2, ymin, x2, ymax);
-            break;
-
-        case MSC_ARC_NOTE:
-            drw.line(&drw, x1, ymin, x2 - gOpts.noteCorner, ymin);
-            drw.line(&drw, x1, ymax, x2, ymax);
-            drw.line(&drw, x1, ymin, x1, ymax);
-            drw.line(&drw, x2, ymin + gOpts.noteCorner, x2, ymax);
-            drw.line(&drw, x2 - gOpts.noteCorner, ymin,
-                           x2, ymin + gOpts.noteCorner);
-            drw.line(&drw, x2 - gOpts.noteCorner, ymin,
-                           x2 - gOpts.noteCorner, ymin + gOpts.noteCorner);
-            drw.line(&drw, x2, ymin + gOpts.noteCorner,
-                           x2 - gOpts.noteCorner, ymin + gOpts.noteCorner);
-            break;
-
-        case MSC_ARC_RBOX:
-            drw.line(&drw, x1 + gOpts.rboxArc, ymin, x2 - gOpts.rboxArc, ymin);
-            drw.line(&drw, x1 + gOpts.rboxArc, ymax, x2 - gOpts.rboxArc, ymax);
-            drw.line(&drw, x1, ymin + gOpts.rboxArc, x1, ymax - gOpts.rboxArc);
-            drw.line(&drw, x2, ymin + gOpts.rboxArc, x2, ymax - gOpts.rboxArc);
-
-            drw.arc(&drw, x1 + gOpts.rboxArc,
-                    ymin + gOpts.rboxArc, gOpts.rboxArc * 2, gOpts.rboxArc * 2,
-                    180, 270);
-            drw.arc(&drw, x2 - gOpts.rboxArc,
-                    ymin + gOpts.rboxArc, gOpts.rboxArc * 2, gOpts.rboxArc * 2,
-                    270, 0);
-            drw.arc(&drw, x2 - gOpts.rboxArc,
-                    ymax - gOpts.rboxArc, gOpts.rboxArc * 2, gOpts.rboxArc * 2,
-                    0, 90);
-            drw.arc(&drw, x1 + gOpts.rboxArc,
-                    ymax - gOpts.rboxArc, gOpts.rboxArc * 2, gOpts.rboxArc * 2,
-                    90, 180);
-            break;
-
-        case MSC_ARC_ABOX:
-            drw.line(&drw, x1 + gOpts.aboxSlope, ymin, x2 - gOpts.aboxSlope, ymin);
-            drw.line(&drw, x1 + gOpts.aboxSlope, ymax, x2 - gOpts.aboxSlope, ymax);
-            drw.line(&drw, x1 + gOpts.aboxSlope, ymin, x1, ymid);
-            drw.line(&drw, x1, ymid, x1 + gOpts.aboxSlope, ymax);
-            drw.line(&drw, x2 - gOpts.aboxSlope, ymin, x2, ymid);
-            drw.line(&drw, x2, ymid, x2 - gOpts.aboxSlope, ymax);
-            break;
-
-        default:
-            assert(0);
-    }
-
-    /* Restore the pen colour if needed */
-    if(lineColour)
-    {
-        drw.setPen(&drw, ADRAW_COL_BLACK);
-    }
+    return NULL;
 }
 
+#endif /* HAVE_PTHREAD_H */
 
-/** Render text on an arc.
- * Draw the text on some arc.
- * \param m              The Msc for which the text is being rendered.
- * \param ismap          If not \a NULL, write an ismap description here.
- * \param outwidth       Width of the output image.
- * \param ymid           Co-ordinate of the row on which the text should be aligned.
- * \param startCol       The column at which the arc being labelled starts.
- * \param endCol         The column at which the arc being labelled ends.
- * \param arcLabelLineCount  Count of lines of text in arcLabelLines.
- * \param arcLabelLines  Array of lines of text from 0 to arcLabelLineCount - 1.
- * \param arcUrl         The URL for rendering the label as a hyperlink.  This
- *                        maybe \a NULL if not required.
- * \param arcId          The text identifier for the arc.
- * \param arcIdUrl       The URL for rendering the test identifier as a hyperlink.
- *                        This maybe \a NULL if not required.
- * \param arcTextColour  Colour for the arc text, or NULL to use default.
- * \param arcTextColour  Colour for the arc text backgroun, or NULL to use default.
- * \param arcType        The type of arc, used to control output semantics.
+/** Render all the charts listed in a batch file.
+ *
+ * \param batchFile  The file listing inputs, or "-" for stdin.
+ * \param opts       Options used for every chart.
+ * \param jobs       The maximum number of charts to render in parallel.
+ * \retval true  If all charts were rendered successfully.
  */
-static void arcText(Msc                m,
-                    FILE              *ismap,
-                    unsigned int       outwidth,
-                    unsigned int       ymid,
-                    int                ygradient,
-                    unsigned int       startCol,
-                    unsigned int       endCol,
-                    const unsigned int arcLabelLineCount,
-                    char             **arcLabelLines,
-                    const char        *arcUrl,
-                    const char        *arcId,
-                    const char        *arcIdUrl,
-                    const char        *arcTextColour,
-                    const char        *arcTextBgColour,
-                    const MscArcType   arcType)
+static bool runBatch(const char *batchFile, const MscRenderOpts *opts, unsigned int jobs)
 {
-    unsigned int l;
-    unsigned int y;
+    Batch        b;
+    unsigned int t;
 
-    /* A single line of normal text is above the midline */
-    if(arcLabelLineCount == 1 && !isBoxArc(arcType) &&
-       arcType != MSC_ARC_DISCO && arcType != MSC_ARC_DIVIDER &&
-       arcType != MSC_ARC_SPACE)
-    {
-        y = ymid + (ygradient / 2) - drw.textHeight(&drw);
-    }
-    else /* Text is vertically centered on the midline */
-    {
-        int yoff = ygradient - (drw.textHeight(&drw) * arcLabelLineCount);
-        y = ymid + (yoff / 2);
-    }
+    memset(&b, 0, sizeof(b));
+    b.opts   = opts;
+    b.jsRead = b.jsWrite = -1;
 
-    for(l = 0; l < arcLabelLineCount; l++)
+    if(!readBatchFile(batchFile, &b))
     {
-        const char *lineLabel = arcLabelLines[l];
-        unsigned int width = drw.textWidth(&drw, lineLabel);
-        int x = ((startCol + endCol + 1) * gOpts.entitySpacing) / 2;
-
-        y += drw.textHeight(&drw);
-
-        if(startCol != endCol || isBoxArc(arcType))
-        {
-            /* Produce central aligned text */
-            x -= width / 2;
-        }
-        else if(startCol < (MscGetNumEntities(m) / 2))
+        for(t = 0; t < b.nJobs; t++)
         {
-            /* Form text to the right */
-            x += gOpts.textHGapPre;
-        }
-        else
-        {
-            /* Form text to the left */
-            x -= width + gOpts.textHGapPost;
-        }
-
-        /* Clip against edges of image */
-        if(x + width > outwidth)
-        {
-            x = outwidth - width;
-        }
-
-        if(x < 0)
-        {
-            x = 0;
-        }
-
-        /* Check if a URL is associated */
-        if(arcUrl)
-        {
-            /* Default to blue */
-            drw.setPen(&drw, ADRAW_COL_BLUE);
-
-            /* Image map output */
-            ismapRect(ismap,
-                      arcUrl,
-                      x, y - drw.textHeight(&drw),
-                      x + width, y);
-        }
-
-
-        /* Set to the explicit colours if directed */
-        if(arcTextColour != NULL)
-        {
-            drw.setPen(&drw, ADrawGetColour(arcTextColour));
-        }
-
-        if(arcTextBgColour != NULL)
-        {
-            drw.setBgPen(&drw, ADrawGetColour(arcTextBgColour));
-        }
-
-        /* Render text and restore pen */
-        drw.textR (&drw, x, y, lineLabel, arcUrl);
-        drw.setPen(&drw, ADRAW_COL_BLACK);
-        drw.setBgPen(&drw, ADRAW_COL_WHITE);
-
-        /* Render the Id of the arc, if specified and for the first line*/
-        if(arcId && l == 0)
-        {
-            unsigned int idwidth;
-            int          idx, idy;
-
-            idy = y - drw.textHeight(&drw);
-            idx = x + width;
-
-            drw.setFontSize(&drw, ADRAW_FONT_TINY);
-
-            idwidth = drw.textWidth(&drw, arcId);
-            idy    += (drw.textHeight(&drw) + 1) / 2;
-
-            if(arcIdUrl)
-            {
-                drw.setPen(&drw, ADRAW_COL_BLUE);
-
-                /* Image map output */
-                ismapRect(ismap,
-                          arcIdUrl,
-                          idx, idy - drw.textHeight(&drw),
-                          idx + idwidth, idy);
-            }
-
-            /* Render text and restore pen and font */
-            drw.textR (&drw, idx, idy, arcId, arcIdUrl);
-            drw.setPen(&drw, ADRAW_COL_BLACK);
-            drw.setFontSize(&drw, ADRAW_FONT_SMALL);
+            free(b.job[t].inFile);
         }
+        free(b.job);
+        return false;
     }
-}
-
 
-/** Render the line and arrow head for some arc.
- * This will draw the arc line and arrow head between two columns,
- * noting that if the start and end column are the same, an arc is
- * rendered.
- * \param  m           The Msc for which the text is being rendered.
- * \param  ymin        Top of row.
- * \param  ymax        Bottom of row.
- * \param  ygradient   The gradient of the arc which alters the y position a
- *                      the ending column.
- * \param  startCol    Starting column for the arc.
- * \param  endCol      Column at which the arc terminates.
- * \param  startColAct Activation for starting column.
- * \param  endColAct   Activation for ending column.
- * \param  hasArrows   If true, draw arc arrows, otherwise omit them.
- * \param  hasBiArrows If true, has arrows in both directions.
- * \param  arcType     The type of the arc, which dictates its rendered style.
- */
-static void arcLine(Msc               m,
-                    unsigned int      y,
-                    unsigned int      ygradient,
-                    unsigned int      startCol,
-                    unsigned int      endCol,
-                    int               startColAct,
-                    int               endColAct,
-                    const char       *arcLineCol,
-                    bool              hasArrows,
-                    const int         hasBiArrows,
-                    const MscArcType  arcType)
-{
-    unsigned int sx = (startCol * gOpts.entitySpacing) + (gOpts.entitySpacing / 2);
-    unsigned int dx = (endCol * gOpts.entitySpacing) + (gOpts.entitySpacing / 2);
-
-    if(startColAct > 0)
+    if(jobs > b.nJobs)
     {
-        sx += (startColAct - 1) * gOpts.activationWidth / 2 + (sx < dx ? gOpts.activationWidth / 2 : -(gOpts.activationWidth / 2));
+        jobs = b.nJobs;
     }
 
-    if(endColAct > 0)
-    {
-        dx += (endColAct - 1) * gOpts.activationWidth / 2 + (sx > dx ? gOpts.activationWidth / 2 : -(gOpts.activationWidth / 2));
-    }
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_init(&b.lock, NULL);
 
-    /* Check if an explicit line colour is requested */
-    if(arcLineCol != NULL)
+    if(jobs > 1)
     {
-        drw.setPen(&drw, ADrawGetColour(arcLineCol));
-    }
+        pthread_t      *thread = malloc(sizeof(pthread_t) * jobs);
+        BatchThreadArg *arg    = malloc(sizeof(BatchThreadArg) * jobs);
+        unsigned int    started = 1;
 
-    if(startCol != endCol)
-    {
-        /* Draw the line */
-        if(arcType == MSC_ARC_RETVAL)
+        if(!thread || !arg || !MscRenderInit())
         {
-            drw.dottedLine(&drw, sx, y, dx, y + ygradient);
-        }
-        else if(arcType == MSC_ARC_DOUBLE)
-        {
-            drw.line(&drw, sx, y - 1, dx, y - 1 + ygradient);
-            drw.line(&drw, sx, y + 1, dx, y + 1 + ygradient);
-        }
-        else if(arcType == MSC_ARC_LOSS)
-        {
-            signed int   span = dx - sx;
-            unsigned int mx = sx + (span / 4) * 3;
-
-            drw.line(&drw, sx, y, mx, y + ygradient);
-            hasArrows = 0;
-
-            drw.line(&drw, mx - 4, y + ygradient - 4, mx + 4, y + ygradient + 4);
-            drw.line(&drw, mx + 4, y + ygradient - 4, mx - 4, y + ygradient + 4);
+            fprintf(stderr, "Warning: Failed to initialise parallel rendering; running 1 job\n");
         }
         else
         {
-            drw.line(&drw, sx, y, dx, y + ygradient);
-        }
+            findJobserver(&b, jobs);
 
-        /* Now the arrow heads */
-        if(hasArrows)
-        {
-            if(startCol < endCol)
+            /* Start the extra workers, the first runs on this thread */
+            for(started = 1; started < jobs; started++)
             {
-                arrowR(dx, y + ygradient, arcType);
-            }
-            else
-            {
-                arrowL(dx, y + ygradient, arcType);
-            }
+                int r;
 
-            if(hasBiArrows)
-            {
-                if(startCol < endCol)
-                {
-                    arrowL(sx, y + ygradient, arcType);
-                }
-                else
+                arg[started].b      = &b;
+                arg[started].worker = started;
+
+                r = pthread_create(&thread[started], NULL, batchThread, &arg[started]);
+                if(r != 0)
                 {
-                    arrowR(sx, y + ygradient, arcType);
+                    fprintf(stderr, "Warning: Failed to start worker thread: %s\n", strerror(r));
+                    break;
                 }
             }
         }
-    }
-    else if(startCol < (MscGetNumEntities(m) / 2))
-    {
-        /* Arc looping to the left */
-        if(arcType == MSC_ARC_RETVAL)
-        {
-            drw.dottedArc(&drw,
-                          sx, y + ygradient/2,
-                          gOpts.entitySpacing,
-                          gOpts.loopArcHeight + ygradient,
-                          90,
-                          270);
-        }
-        else if(arcType == MSC_ARC_DOUBLE)
-        {
-            drw.arc(&drw,
-                    sx, y - 1 + ygradient/2,
-                    gOpts.entitySpacing,
-                    gOpts.loopArcHeight + ygradient,
-                    90,
-                    270);
-            drw.arc(&drw,
-                    sx, y + 1 + ygradient/2,
-                    gOpts.entitySpacing,
-                    gOpts.loopArcHeight + ygradient,
-                    90,
-                    270);
-        }
-        else if(arcType == MSC_ARC_LOSS)
-        {
-            unsigned int px, py;
 
-            drw.arc(&drw,
-                    sx, y - 1 + ygradient/2,
-                    gOpts.entitySpacing - 8,
-                    gOpts.loopArcHeight + ygradient,
-                    180 - 45,
-                    270);
+        batchWorker(&b, 0);
 
-            hasArrows = false;
-
-            /* Get co-ordinates of the arc end-point */
-            ADrawComputeArcPoint(sx, y - 1 + ygradient/2, gOpts.entitySpacing - 8,
-                                 gOpts.loopArcHeight + ygradient, 180 - 45,
-                                 &px, &py);
-
-            /* Draw a cross */
-            drw.line(&drw, px - 4, py - 4, px + 4, py + 4);
-            drw.line(&drw, px + 4, py - 4, px - 4, py + 4);
-        }
-        else
+        for(t = 1; t < started; t++)
         {
-            drw.arc(&drw,
-                    sx, y + ygradient/2,
-                    gOpts.entitySpacing - 4,
-                    gOpts.loopArcHeight + ygradient,
-                    90,
-                    270);
+            pthread_join(thread[t], NULL);
         }
 
-        if(hasArrows)
+        /* Close the jobserver if it was opened as a FIFO */
+        if(b.jsRead != -1 && b.jsRead == b.jsWrite)
         {
-            arrowR(dx, y + ygradient + (gOpts.loopArcHeight / 2), arcType);
+            close(b.jsRead);
         }
+
+        free(thread);
+        free(arg);
     }
     else
+#endif
     {
-        /* Arc looping to right */
-        if(arcType == MSC_ARC_RETVAL)
-        {
-            drw.dottedArc(&drw,
-                          sx, y + ygradient/2,
-                          gOpts.entitySpacing,
-                          gOpts.loopArcHeight + ygradient,
-                          270,
-                          90);
-        }
-        else if(arcType == MSC_ARC_DOUBLE)
-        {
-            drw.arc(&drw,
-                    sx, y - 1 + ygradient/2,
-                    gOpts.entitySpacing,
-                    gOpts.loopArcHeight + ygradient,
-                    270,
-                    90);
-            drw.arc(&drw,
-                    sx, y + 1 + ygradient/2,
-                    gOpts.entitySpacing,
-                    gOpts.loopArcHeight + ygradient,
-                    270,
-                    90);
-        }
-        else if(arcType == MSC_ARC_LOSS)
-        {
-            unsigned int px, py;
-
-            drw.arc(&drw,
-                    sx, y - 1 + ygradient/2,
-                    gOpts.entitySpacing - 8,
-                    gOpts.loopArcHeight + ygradient,
-                    270,
-                    45);
-
-            hasArrows = false;
-
-            /* Get co-ordinates of the arc end-point */
-            ADrawComputeArcPoint(sx, y - 1 + ygradient/2, gOpts.entitySpacing - 8,
-                                 gOpts.loopArcHeight + ygradient, 45,
-                                 &px, &py);
+        batchWorker(&b, 0);
+    }
 
-            /* Draw a cross */
-            drw.line(&drw, px - 4, py - 4, px + 4, py + 4);
-            drw.line(&drw, px + 4, py - 4, px - 4, py + 4);
-        }
-        else
-        {
-            drw.arc(&drw,
-                    sx, y + ygradient/2,
-                    gOpts.entitySpacing,
-                    gOpts.loopArcHeight + ygradient,
-                    270,
-                    90);
-        }
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_destroy(&b.lock);
+#endif
 
-        if(hasArrows)
-        {
-            arrowL(dx, y + ygradient + (gOpts.loopArcHeight / 2), arcType);
-        }
+    for(t = 0; t < b.nJobs; t++)
+    {
+        free(b.job[t].inFile);
     }
+    free(b.job);
 
-    /* Restore pen if needed */
-    if(arcLineCol != NULL)
+    if(b.nFailed > 0)
     {
-        drw.setPen(&drw, ADRAW_COL_BLACK);
+        fprintf(stderr, "%u of %u charts failed to render\n", b.nFailed, b.nJobs);
     }
+
+    return b.nFailed == 0;
 }
 
 
-/** Perform post-parsing validation of the MSC.
- * This checks the passed MSC for various rules which can't easily be tested
- * at parse time.
+/** Get the default number of parallel jobs for batch mode.
  */
-bool checkMsc(Msc m)
+static unsigned int defaultJobs(void)
 {
-    MscArcIter ai;
+#if defined(HAVE_PTHREAD_H) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
 
-    /* Check all arc entites are known */
-    for(ai = MscArcIterBegin(m); !MscArcIterEnd(&ai); MscNextArc(&ai))
+    if(n > 0)
     {
-        const MscArcType arcType  = MscGetArcType(&ai);
-
-        if(arcType != MSC_ARC_PARALLEL && arcType != MSC_ARC_DISCO &&
-           arcType != MSC_ARC_DIVIDER && arcType != MSC_ARC_SPACE)
-        {
-            const char *src = MscGetArcSource(&ai);
-            const char *dst = MscGetArcDest(&ai);
-            const int   startCol = MscGetEntityIndex(m, src);
-            const int   endCol   = MscGetEntityIndex(m, dst);
-
-            /* Check the start column is valid */
-            if(startCol == -1)
-            {
-                fprintf(stderr, "Error detected at line %u: Unknown source entity '%s'.\n",
-                        MscGetArcInputLine(&ai), src);
-                return false;
-            }
-
-            if(endCol == -1 && !isBroadcastArc(dst))
-            {
-                fprintf(stderr, "Error detected at line %u: Unknown destination entity '%s'.\n",
-                        MscGetArcInputLine(&ai), dst);
-                return false;
-            }
-        }
+        return (unsigned int)n;
     }
-
-    return true;
+#endif
+    return 1;
 }
 
 
 int main(const int argc, const char *argv[])
 {
-    FILE            *ismap = NULL;
-    ADrawOutputType  outType;
-    ADrawColour     *entColourRef;
-    int             *entActivation;
-    int             *entActivationMin;
-    int             *entActivationMax;
-    char            *outImage;
-    Msc              m;
-    unsigned int     w, h, row, col;
-    RowInfo         *rowInfo;
-    bool             addLines;
-    float            f;
-    MscEntityIter    ei;
-    MscArcIter       ai;
+    MscRenderOpts opts;
 
     /* Parse the command line options */
     if(!CmdParse(gClSwitches, sizeof(gClSwitches) / sizeof(CmdSwitch), argc - 1, &argv[1], "-i"))
@@ -1664,16 +972,46 @@ int main(const int argc, const char *argv[])
         return EXIT_SUCCESS;
     }
 
+    if(gServePresent)
+    {
+        /* The type and input are given in each request */
+        if(gOutTypePresent || gInputFilePresent || gOutputFilePresent ||
+           gPrintParsePresent || gBatchFilePresent)
+        {
+            fprintf(stderr, "-T, -i, -o, -p and --batch cannot be used with --serve\n");
+            Usage();
+            return EXIT_FAILURE;
+        }
+    }
     /* Check that the output type was specified */
-    if(!gOutTypePresent)
+    else if(!gOutTypePresent)
     {
         fprintf(stderr, "-T <type> must be specified on the command line\n");
         Usage();
         return EXIT_FAILURE;
     }
+    else if(!parseOutTypes())
+    {
+        Usage();
+        return EXIT_FAILURE;
+    }
+    else if(gBatchFilePresent)
+    {
+        /* Batch mode names each output after its input */
+        if(gInputFilePresent || gOutputFilePresent || gPrintParsePresent)
+        {
+            fprintf(stderr, "-i, -o and -p cannot be used with --batch\n");
+            Usage();
+            return EXIT_FAILURE;
+        }
 
+        if(!gJobsPresent)
+        {
+            gJobs = defaultJobs();
+        }
+    }
     /* Check that the output filename was specified */
-    if(!gOutputFilePresent)
+    else if(!gOutputFilePresent)
     {
         if(!gInputFilePresent || strcmp(gInputFile, "-") == 0)
         {
@@ -1683,598 +1021,98 @@ int main(const int argc, const char *argv[])
         }
 
         gOutputFilePresent = true;
-        snprintf(gOutputFile, sizeof(gOutputFile), "%s", gInputFile);
-        trimExtension(gOutputFile);
-        strncat(gOutputFile, ".", sizeof(gOutputFile) - (strlen(gOutputFile) + 1));
-        strncat(gOutputFile, gOutType, sizeof(gOutputFile) - (strlen(gOutputFile) + 1));
-    }
-#ifdef USE_FREETYPE
-    /* Check for an output font name from the environment */
-    if(!gOutputFontPresent)
-    {
-        const char *envFont = getenv("MSCGEN_FONT");
-        const int   bufLen  = sizeof(gOutputFont);
-
-        if(!envFont)
+        if(gNumOutTypes == 1)
         {
-            /* Pick a default font */
-            snprintf(gOutputFont, bufLen, "helvetica");
+            makeOutputName(gOutputFile, sizeof(gOutputFile), gInputFile, gOutTypeName[0]);
         }
-        else if(snprintf(gOutputFont, bufLen, "%s", envFont) >= bufLen)
+        else
         {
-            fprintf(stderr, "MSCGEN_FONT font name too long (must be < %d characters)\n",
-                    bufLen);
-            return EXIT_FAILURE;
+            snprintf(gOutputFile, sizeof(gOutputFile), "%s", gInputFile);
         }
     }
-#else
-    if(gOutputFontPresent)
+    else if(gNumOutTypes > 1 && strcmp(gOutputFile, "-") == 0)
     {
-      fprintf(stderr, "Note: -F option specified but ignored since mscgen was not built\n"
-                      "      with USE_FREETYPE.\n");
-    }
-#endif
-
-#ifdef __WIN32__
-    /* On Windows, create a temporary file */
-    deleteTmpFilename = tempnam(NULL, "mscgen");
-    if(!deleteTmpFilename)
-    {
-        perror("tempnam() failed");
+        fprintf(stderr, "-o - cannot be used with more than one output type\n");
+        Usage();
         return EXIT_FAILURE;
     }
 
-    /* Schedule the temp file to be deleted */
-    atexit(deleteTmp);
-#endif
-
-    /* Determine the output type */
-    if(strcmp(gOutType, "png") == 0)
-    {
-        outType  = ADRAW_FMT_PNG;
-        outImage = gOutputFile;
-    }
-    else if(strcmp(gOutType, "eps") == 0)
+    if(gJobsPresent && gJobs == 0)
     {
-        outType  = ADRAW_FMT_EPS;
-        outImage = gOutputFile;
-    }
-    else if(strcmp(gOutType, "svg") == 0)
-    {
-        outType  = ADRAW_FMT_SVG;
-        outImage = gOutputFile;
+        fprintf(stderr, "-j must specify at least 1 job\n");
+        return EXIT_FAILURE;
     }
-    else if(strcmp(gOutType, "ismap") == 0)
-    {
-#ifdef __WIN32__
-        /* Use the temp file */
-        outType  = ADRAW_FMT_PNG;
-        outImage = deleteTmpFilename;
-#else
-        static char tmpTemplate[] = "/tmp/mscgenXXXXXX";
-        int h;
-
-        outType  = ADRAW_FMT_PNG;
-        outImage = tmpTemplate;
-
-        /* Create temporary file */
-        h = mkstemp(tmpTemplate);
-        if(h == -1)
-        {
-            perror("mkstemp() failed");
-            return EXIT_FAILURE;
-        }
 
-        /* Close the file handle */
-        close(h);
+    memset(&opts, 0, sizeof(opts));
+    opts.printRowInfo = gPrintParsePresent;
+    opts.svgCompact   = gSvgCompactPresent;
 
-        /* Schedule the temp file to be deleted */
-        deleteTmpFilename = outImage;
-        atexit(deleteTmp);
-#endif
-    }
-    else
+    if(!parsePngOpts(&opts))
     {
-        fprintf(stderr, "Unknown output format '%s'\n", gOutType);
         Usage();
         return EXIT_FAILURE;
     }
 
-    /* Parse input, either from a file, or stdin */
-    if(gInputFilePresent && !strcmp(gInputFile, "-") == 0)
+#ifdef USE_FREETYPE
+    /* Check for an output font name from the environment */
+    if(!gOutputFontPresent)
     {
-        FILE *in = fopen(gInputFile, "r");
+        const char *envFont = getenv("MSCGEN_FONT");
+        const int   bufLen  = sizeof(gOutputFont);
 
-        if(!in)
+        if(!envFont)
         {
-            fprintf(stderr, "Failed to open input file '%s'\n", gInputFile);
-            return EXIT_FAILURE;
+            /* Pick a default font */
+            snprintf(gOutputFont, bufLen, "helvetica");
         }
-        m = MscParse(in);
-        fclose(in);
-    }
-    else
-    {
-        m = MscParse(stdin);
-    }
-
-    /* Check if the parse was okay and the MSC good */
-    if(!m || !checkMsc(m))
-    {
-        return EXIT_FAILURE;
-    }
-
-    /* Print the parse output if requested */
-    if(gPrintParsePresent)
-    {
-        MscPrint(m);
-    }
-
-#ifndef USE_FREETYPE
-    if(outType == ADRAW_FMT_PNG && lex_getutf8())
-    {
-        fprintf(stderr, "Warning: Optional UTF-8 byte-order-mark detected at start of input, but mscgen\n"
-                        "         was not configured to use FreeType for text rendering.  Rendering of\n"
-                        "         UTF-8 characters in PNG output may be incorrect.\n");
-    }
-#endif
-
-    /* Check if an ismap file should also be generated */
-    if(strcmp(gOutType, "ismap") == 0)
-    {
-        ismap = fopen(gOutputFile, "w");
-        if(!ismap)
+        else if(snprintf(gOutputFont, bufLen, "%s", envFont) >= bufLen)
         {
-            fprintf(stderr, "Failed to open output file '%s': %s\n", gOutputFile, strerror(errno));
+            fprintf(stderr, "MSCGEN_FONT font name too long (must be < %d characters)\n",
+                    bufLen);
             return EXIT_FAILURE;
         }
     }
 
-    /* Open the drawing context with dummy dimensions */
-#ifdef __WIN32__
-    if(!ADrawOpen(10, 10, deleteTmpFilename, gOutputFont, outType, &drw))
+    opts.fontName = gOutputFont;
 #else
-    if(!ADrawOpen(10, 10, "/dev/null", gOutputFont, outType, &drw))
-#endif
-    {
-        fprintf(stderr, "Failed to create output context\n");
-        return EXIT_FAILURE;
-    }
-
-    /* Now compute ideal canvas size, which may use text metrics */
-    if(MscGetOptAsFloat(m, MSC_OPT_WIDTH, &f))
-    {
-        gOpts.idealCanvasWidth = f;
-    }
-    else if(MscGetOptAsFloat(m, MSC_OPT_HSCALE, &f))
-    {
-        gOpts.idealCanvasWidth *= f;
-    }
-
-    /* Set the arc gradient if needed */
-    if(MscGetOptAsFloat(m, MSC_OPT_ARCGRADIENT, &f))
-    {
-        gOpts.arcGradient = (int)f;
-        gOpts.arcSpacing += gOpts.arcGradient;
-    }
-
-    /* Check if word wrapping on arcs other than boxes should be used */
-    MscGetOptAsBoolean(m, MSC_OPT_WORDWRAPARCS, &gOpts.wordWrapArcLabels);
-
-    /* Work out the entitySpacing */
-    if(gOpts.idealCanvasWidth / MscGetNumEntities(m) > gOpts.entitySpacing)
-    {
-        gOpts.entitySpacing = gOpts.idealCanvasWidth / MscGetNumEntities(m);
-    }
-
-    /* Work out the entityHeadGap */
-    ei = MscEntityIterBegin(m);
-    for(col = 0; col < MscGetNumEntities(m); col++)
+    if(gOutputFontPresent)
     {
-        unsigned int lines = countLines(MscGetEntAttrib(&ei, MSC_ATTR_LABEL));
-        unsigned int gap;
-
-        /* Get the required gap */
-        gap = lines * drw.textHeight(&drw);
-        if(gap > gOpts.entityHeadGap)
-        {
-            gOpts.entityHeadGap = gap;
-        }
-
-        MscNextEntity(&ei);
+      fprintf(stderr, "Note: -F option specified but ignored since mscgen was not built\n"
+                      "      with USE_FREETYPE.\n");
     }
+#endif
 
-    /* Work out the width and height of the canvas */
-    rowInfo = computeCanvasSize(m, &w , &h);
-
-    if(gPrintParsePresent)
+    if(gServePresent)
     {
-        unsigned int t;
-
-        printf("\nRow heights:\n");
-
-        for(t = 0; t < MscGetNumArcs(m) - MscGetNumParallelArcs(m); t++)
-        {
-            printf(" %3u: min=%u arcliney=%u max=%u maxTextLines=%u\n",
-                   t, rowInfo[t].ymin, rowInfo[t].arcliney, rowInfo[t].ymax, rowInfo[t].maxTextLines);
-        }
+        return Serve(gServeAddr, &opts) ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    /* Close the temporary output file */
-    drw.close(&drw);
+    opts.format = gOutFormat[0];
 
-    /* Open the output */
-    if(!ADrawOpen(w, h, outImage, gOutputFont, outType, &drw))
+    if(gBatchFilePresent)
     {
-        fprintf(stderr, "Failed to create output context\n");
-        return EXIT_FAILURE;
+        return runBatch(gBatchFile, &opts, gJobs) ? EXIT_SUCCESS : EXIT_FAILURE;
     }
-
-    /* Allocate storage for entity heading colours */
-    entColourRef = malloc_s(MscGetNumEntities(m) * sizeof(ADrawColour));
-
-    /* Allocate storage for entity activation */
-    entActivation = malloc_s(MscGetNumEntities(m) * sizeof(int));
-    entActivationMin = malloc_s(MscGetNumEntities(m) * sizeof(int));
-    entActivationMax = malloc_s(MscGetNumEntities(m) * sizeof(int));
-
-    /* Draw the entity headings */
-    ei = MscEntityIterBegin(m);
-    for(col = 0; col < MscGetNumEntities(m); col++)
-    {
-        unsigned int x = (gOpts.entitySpacing / 2) + (gOpts.entitySpacing * col);
-        const char  *line;
-
-        /* Titles */
-        entityText(ismap,
-                   x,
-                   gOpts.entityHeadGap - (drw.textHeight(&drw) / 2),
-                   MscGetEntAttrib(&ei, MSC_ATTR_LABEL),
-                   MscGetEntAttrib(&ei, MSC_ATTR_URL),
-                   MscGetEntAttrib(&ei, MSC_ATTR_ID),
-                   MscGetEntAttrib(&ei, MSC_ATTR_IDURL),
-                   MscGetEntAttrib(&ei, MSC_ATTR_TEXT_COLOUR),
-                   MscGetEntAttrib(&ei, MSC_ATTR_TEXT_BGCOLOUR));
-
-        /* Get the colours */
-        line = MscGetEntAttrib(&ei, MSC_ATTR_LINE_COLOUR);
-        if(line != NULL)
-        {
-            entColourRef[col] = ADrawGetColour(line);
-        }
-        else
-        {
-            entColourRef[col] = ADRAW_COL_BLACK;
-        }
-
-        /* Initialize activations */
-        entActivation[col] = 0;
-
-        MscNextEntity(&ei);
-    }
-
-    /* Draw the arcs */
-    addLines = true;
-    row = 0;
-
-    for(ai = MscArcIterBegin(m); !MscArcIterEnd(&ai); MscNextArc(&ai))
+    else
     {
-        const MscArcType   arcType           = MscGetArcType(&ai);
-        const char        *arcUrl            = MscGetArcAttrib(&ai, MSC_ATTR_URL);
-        const char        *arcId             = MscGetArcAttrib(&ai, MSC_ATTR_ID);
-        const char        *arcIdUrl          = MscGetArcAttrib(&ai, MSC_ATTR_IDURL);
-        const char        *arcTextColour     = MscGetArcAttrib(&ai, MSC_ATTR_TEXT_COLOUR);
-        const char        *arcTextBgColour   = MscGetArcAttrib(&ai, MSC_ATTR_TEXT_BGCOLOUR);
-        const char        *arcLineColour     = MscGetArcAttrib(&ai, MSC_ATTR_LINE_COLOUR);
-        const int          arcGradient       = isBoxArc(arcType) ? 0 : getArcGradient(m, &ai, rowInfo, row);
-        const int          arcHasArrows      = MscGetArcAttrib(&ai, MSC_ATTR_NO_ARROWS) == NULL;
-        const int          arcHasBiArrows    = MscGetArcAttrib(&ai, MSC_ATTR_BI_ARROWS) != NULL;
-        char             **arcLabelLines     = NULL;
-        unsigned int       arcLabelLineCount = 0;
-        int                startCol = -1, endCol = -1;
-
-        if(arcType == MSC_ARC_PARALLEL)
-        {
-            addLines = false;
-
-            /* Rewind the row */
-            assert(row > 0);
-            row--;
-        }
-        else
+        /* Draw the outputs or PNG bands of a single chart in parallel if
+         *  requested
+         */
+        if(gJobsPresent && gJobs > 1)
         {
-            const unsigned int ymin = rowInfo[row].ymin;
-            const unsigned int ymid = rowInfo[row].arcliney;
-            const unsigned int ymax = rowInfo[row].ymax;
-
-            /* Lookahead to find all activations and deactivations in a row */
-            if(addLines)
-            {
-                unsigned int ent;
-                MscArcIter   peek;
-
-                for(ent = 0; ent < MscGetNumEntities(m); ent++)
-                {
-                    entActivationMin[ent] = entActivation[ent];
-                    entActivationMax[ent] = entActivation[ent];
-                }
-
-                peek = ai;
-                while(!MscArcIterEnd(&peek))
-                {
-                    if(MscGetArcType(&peek) == MSC_ARC_ACT)
-                    {
-                        int col = MscGetEntityIndex(m, MscGetArcSource(&peek));
-                        assert(col != -1);
-                        if(entActivation[ent] >= 0)
-                        {
-                            entActivationMax[col]++;
-                        }
-                    }
-                    else if(MscGetArcType(&peek) == MSC_ARC_DEACT)
-                    {
-                        int col = MscGetEntityIndex(m, MscGetArcSource(&peek));
-                        assert(col != -1);
-                        if(entActivation[ent] > 0)
-                        {
-                            entActivationMin[col]--;
-                        }
-                    }
-                    else if(MscGetArcType(&peek) == MSC_ARC_DESTR)
-                    {
-                        int col = MscGetEntityIndex(m, MscGetArcSource(&peek));
-                        assert(col != -1);
-                        entActivationMin[col] = -1;
-                    }
-
-                    MscNextArc(&peek);
-                    if(MscArcIterEnd(&peek))
-                        break;
-                    if(MscGetArcType(&peek) != MSC_ARC_PARALLEL)
-                        break;
-                    MscNextArc(&peek);
-                }
-            }
-
-#if 0
-            /* For debug, mark the row spacing */
-            drw.line(&drw, 0, ymin, 10, ymin);
-            drw.line(&drw, 0, ymid, 5, ymid);
-            drw.line(&drw, 0, ymax, 10, ymax);
-#endif
-            /* Get the entity indices */
-            if(arcType != MSC_ARC_DISCO && arcType != MSC_ARC_DIVIDER && arcType != MSC_ARC_SPACE)
-            {
-                startCol = MscGetEntityIndex(m, MscGetArcSource(&ai));
-                endCol   = MscGetEntityIndex(m, MscGetArcDest(&ai));
-
-                /* Check that the start column is known and the end column is
-                 *  known, or that it's a broadcast arc
-                 */
-                assert(startCol != -1);
-                assert(endCol != -1 || isBroadcastArc(MscGetArcDest(&ai)));
-
-                /* Check for entity colouring if not set explicity on the arc */
-                if(arcTextColour == NULL)
-                {
-                    arcTextColour = MscGetEntIdxAttrib(m, startCol, MSC_ATTR_ARC_TEXT_COLOUR);
-                }
-
-                if(arcTextBgColour == NULL)
-                {
-                    arcTextBgColour = MscGetEntIdxAttrib(m, startCol, MSC_ATTR_ARC_TEXT_BGCOLOUR);
-                }
-
-                if(arcLineColour == NULL)
-                {
-                    arcLineColour = MscGetEntIdxAttrib(m, startCol, MSC_ATTR_ARC_LINE_COLOUR);
-                }
-
-            }
-            else
+            if(MscRenderInit())
             {
-                /* Discontinuity or parallel arc spans whole chart */
-                startCol = 0;
-                endCol   = MscGetNumEntities(m) - 1;
-            }
-
-            /* Work out how the label fits the gap between entities */
-            arcLabelLineCount = computeLabelLines(m, arcType, &arcLabelLines,
-                                                  MscGetArcAttrib(&ai, MSC_ATTR_LABEL),
-                                                  startCol, endCol);
-
-            /* Check if this is a broadcast message */
-            if(isBroadcastArc(MscGetArcDest(&ai)))
-            {
-                unsigned int t;
-
-                /* Add in the entity lines */
-                if(addLines)
-                {
-                    entityLines(m, ymin, ymax + gOpts.arcSpacing, false, entColourRef, entActivationMin);
-                }
-
-                /* Draw arcs to each entity */
-                for(t = 0; t < MscGetNumEntities(m); t++)
-                {
-                    if((signed)t != startCol)
-                    {
-                        arcLine(m, ymid, arcGradient, startCol, t,
-                                entActivationMax[startCol], entActivationMax[t],
-                                arcLineColour, arcHasArrows,
-                                arcHasBiArrows, arcType);
-                    }
-                }
-
-                /* Fix up the start/end columns to span chart */
-                startCol = 0;
-                endCol   = MscGetNumEntities(m) - 1;
+                opts.jobs = gJobs;
             }
             else
             {
-                /* Check if it is a box, discontinuity arc etc... */
-                if(isBoxArc(arcType))
-                {
-                    if(addLines)
-                    {
-                        entityLines(m, ymin, ymax + gOpts.arcSpacing, false, entColourRef, entActivationMin);
-                    }
-                    arcBox(ymin, ymax, startCol, endCol, arcType, arcLineColour, arcTextBgColour);
-                }
-                else if(arcType == MSC_ARC_DISCO)
-                {
-                    if(addLines)
-                    {
-                        entityLines(m, ymin, ymax + gOpts.arcSpacing, true /* dotted */, entColourRef, entActivationMin);
-                    }
-                }
-                else if(arcType == MSC_ARC_DIVIDER || arcType == MSC_ARC_SPACE)
-                {
-                    if(addLines)
-                    {
-                        entityLines(m, ymin, ymax + gOpts.arcSpacing, false, entColourRef, entActivationMin);
-                    }
-
-                    /* Dividers also have a horizontal line at the middle */
-                    if(arcType == MSC_ARC_DIVIDER)
-                    {
-                        const unsigned int margin = gOpts.entitySpacing / 4;
-
-                        if(arcLineColour != NULL)
-                        {
-                            drw.setPen(&drw, ADrawGetColour(arcLineColour));
-                        }
-
-                        /* Draw line through middle of text */
-                        drw.dottedLine(&drw,
-                                        margin, ymid,
-                                        (MscGetNumEntities(m) * gOpts.entitySpacing) - margin,  ymid);
-
-                        if(arcLineColour != NULL)
-                        {
-                            drw.setPen(&drw, ADRAW_COL_BLACK);
-                        }
-                    }
-                }
-                else if(arcType == MSC_ARC_ACT)
-                {
-                    unsigned int x;
-
-                    if(addLines)
-                    {
-                        entityLines(m, ymin, ymax + gOpts.arcSpacing, false, entColourRef, entActivationMin);
-                    }
-
-                    if(entActivation[startCol] >= 0)
-                    {
-                        entActivation[startCol]++;
-                    }
-
-                    x = (startCol * gOpts.entitySpacing) + (gOpts.entitySpacing / 2) + ((entActivation[startCol] - 1) * gOpts.activationWidth / 2);
-
-                    drw.setPen(&drw, ADRAW_COL_WHITE);
-                    drw.filledRectangle(&drw, x - gOpts.activationWidth / 2, ymid, x + gOpts.activationWidth / 2, ymax + gOpts.arcSpacing);
-
-                    drw.setPen(&drw, entColourRef[startCol]);
-                    drw.line(&drw, x - gOpts.activationWidth / 2, ymid, x + gOpts.activationWidth / 2, ymid);
-                    drw.line(&drw, x - gOpts.activationWidth / 2, ymid, x - gOpts.activationWidth / 2, ymax + gOpts.arcSpacing);
-                    drw.line(&drw, x + gOpts.activationWidth / 2, ymid, x + gOpts.activationWidth / 2, ymax + gOpts.arcSpacing);
-                }
-                else if(arcType == MSC_ARC_DEACT)
-                {
-                    unsigned int x;
-
-                    if(entActivation[startCol] > 0)
-                    {
-                        entActivation[startCol]--;
-                    }
-
-                    if(addLines)
-                    {
-                        entityLines(m, ymin, ymax + gOpts.arcSpacing, false, entColourRef, entActivationMin);
-                    }
-
-                    x = (startCol * gOpts.entitySpacing) + (gOpts.entitySpacing / 2) + (entActivation[startCol] * gOpts.activationWidth / 2);
-
-                    drw.setPen(&drw, ADRAW_COL_WHITE);
-                    drw.filledRectangle(&drw, x - gOpts.activationWidth / 2, ymin, x + gOpts.activationWidth / 2, ymid);
-
-                    drw.setPen(&drw, entColourRef[startCol]);
-                    drw.line(&drw, x - gOpts.activationWidth / 2, ymid, x + gOpts.activationWidth / 2, ymid);
-                    drw.line(&drw, x - gOpts.activationWidth / 2, ymin, x - gOpts.activationWidth / 2, ymid);
-                    drw.line(&drw, x + gOpts.activationWidth / 2, ymin, x + gOpts.activationWidth / 2, ymid);
-                }
-                else if(arcType == MSC_ARC_DESTR)
-                {
-                    unsigned int x = (startCol * gOpts.entitySpacing) + (gOpts.entitySpacing / 2);
-
-                    entActivation[startCol] = -1;
-
-                    if(addLines)
-                    {
-                        entityLines(m, ymin, ymax + gOpts.arcSpacing, false, entColourRef, entActivationMin);
-                    }
-
-                    drw.setPen(&drw, entColourRef[startCol]);
-                    drw.line(&drw, x, ymin, x, ymid);
-                    drw.line(&drw, x - gOpts.activationWidth / 2, ymid - gOpts.activationWidth / 2, x + gOpts.activationWidth / 2, ymid + gOpts.activationWidth / 2);
-                    drw.line(&drw, x - gOpts.activationWidth / 2, ymid + gOpts.activationWidth / 2, x + gOpts.activationWidth / 2, ymid - gOpts.activationWidth / 2);
-                }
-                else
-                {
-                    if(addLines)
-                    {
-                        entityLines(m, ymin, ymax + gOpts.arcSpacing, false, entColourRef, entActivationMin);
-                    }
-                    arcLine(m, ymid, arcGradient, startCol, endCol,
-                            entActivationMax[startCol], entActivationMax[endCol],
-                            arcLineColour, arcHasArrows, arcHasBiArrows, arcType);
-                }
-            }
-
-            /* All may have text */
-            if(arcLabelLineCount > 0)
-            {
-                arcText(m, ismap, w, ymid, arcGradient,
-                        startCol, endCol,
-                        arcLabelLineCount, arcLabelLines,
-                        arcUrl, arcId, arcIdUrl,
-                        arcTextColour, arcTextBgColour, arcType);
+                fprintf(stderr, "Warning: Failed to initialise parallel rendering; running 1 job\n");
             }
-
-            freeLabelLines(arcLabelLineCount, arcLabelLines);
-
-            /* Advance the row */
-            row++;
-            addLines = true;
         }
-    }
 
-    /* Skip arcs may require the entity lines to be extended */
-    entityLines(m,
-                rowInfo[(MscGetNumArcs(m) - MscGetNumParallelArcs(m)) - 1].ymax,
-                h, false, entColourRef, entActivation);
-
-    /* Close the image map if needed */
-    if(ismap)
-    {
-        fclose(ismap);
+        return renderFile(gInputFilePresent ? gInputFile : "-", gOutputFile, &opts) ?
+                 EXIT_SUCCESS : EXIT_FAILURE;
     }
-
-#ifndef NDEBUG
-    /* Free the allocated memory to allow leak detection */
-    free(entActivation);
-    free(entActivationMin);
-    free(entActivationMax);
-    free(entColourRef);
-    free(rowInfo);
-    MscFree(m);
-#endif
-
-    /* Close the context */
-    drw.close(&drw);
-
-    return EXIT_SUCCESS;
 }
 
 /* END OF FILE */
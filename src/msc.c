@@ -26,31 +26,55 @@
 #include <string.h>
 #include <stdlib.h>
 #include "safe.h"
+#include "arena.h"
+#include "symtab.h"
 #include "msc.h"
 
 /***************************************************************************
  * Structures
  ***************************************************************************/
 
+/** A set of attributes, indexed by attribute type.
+ * Each value is held in the arena of the MSC, or NULL if not present.
+ */
+struct MscAttribSetTag
+{
+    const char          *value[MSC_ATTR_COUNT];
+};
+
 struct MscEntityTag
 {
-    char                *label;
-    struct MscAttribTag *attr;
-    struct MscEntityTag *next;
+    const char            *label;
+    struct MscAttribSetTag attr;
 };
 
 struct MscEntityListTag
 {
     unsigned int         elements;
-    struct MscEntityTag *head, *tail;
+
+    /** Number of entities for which storage is allocated. */
+    unsigned int         allocated;
+
+    /** Contiguous array of entities, in column order. */
+    struct MscEntityTag *entities;
 };
 
 struct MscArcTag
 {
-    char                *src, *dst;
+    /** Names of the source and destination entities.
+     * These are interned when parsed, so equal names share one string.
+     */
+    const char          *src, *dst;
+
+    /** Column indices of the source and destination entities.
+     * These are resolved when the MSC is allocated, and will be
+     * MSC_INVALID_ENTITY for unknown entities or arcs that are not between
+     * entities, or MSC_BROADCAST_ENTITY for the destination of a broadcast.
+     */
+    int                  srcIdx, dstIdx;
     MscArcType           type;
     unsigned int         inputLine;
-    struct MscAttribTag *attr;
+    struct MscAttribSetTag attr;
     struct MscArcTag    *next;
 };
 
@@ -65,75 +89,185 @@ struct MscArcListTag
 struct MscAttribTag
 {
     MscAttribType       type;
-    char                *value;
+    const char          *value;
     struct MscAttribTag *next;
 };
 
 struct MscOptTag
 {
     MscOptType          type;
-    char               *value;
+    const char         *value;
     struct MscOptTag   *next;
 };
 
 struct MscTag
 {
+    /** Arena holding the MSC and everything in it. */
+    Arena                    arena;
+
     struct MscOptTag        *optList;
     struct MscEntityListTag *entityList;
     struct MscArcListTag    *arcList;
+
+    /** Open addressed hash table of entity names.
+     * Each slot holds 1 + the column index of an entity, or 0 if unused.
+     * The table size is always a power of 2 and at least double the number
+     * of entities, so that lookups are short and always terminate.
+     */
+    unsigned int            *entityHash;
+    unsigned int             entityHashSize;
+
+    /** Set if the input started with a UTF-8 byte-order-mark. */
+    bool                     utf8;
 };
 
 /***************************************************************************
  * Local Functions
  ***************************************************************************/
 
-/** Find come attrbute in an attribute list.
+/** Find some attribute in an attribute set.
  *
- * \param[in] attr  Head of the linked list to search.
- * \param[in] a     The attribute type to find.
- * \retval  NULL    If the attribute was not found or the passed list was NULL.
+ * \param[in] set  The set to search.
+ * \param[in] a    The attribute type to find.
+ * \retval  NULL   If the attribute was not present.
+ */
+static const char *findAttrib(const struct MscAttribSetTag *set, MscAttribType a)
+{
+    return set->value[a];
+}
+
+
+/** Copy a parsed list of attributes into some attribute set.
+ * Attribute lists are built with the most recently parsed attribute at the
+ * head, and that attribute takes precedence if an attribute is repeated.
+ * Values in \a set are replaced by those in \a att.
  */
-static const char *findAttrib(const struct MscAttribTag *attr, MscAttribType a)
+static void linkAttribSet(struct MscAttribSetTag *set, const struct MscAttribTag *att)
 {
-    while(attr != NULL && attr->type != a)
+    unsigned int seen = 0;
+
+    while(att)
     {
-        attr = attr->next;
+        if((seen & (1u << att->type)) == 0)
+        {
+            set->value[att->type] = att->value;
+            seen |= 1u << att->type;
+        }
+
+        att = att->next;
     }
+}
+
 
-    if(attr != NULL)
+/** Print a set of attributes to stdout.
+ */
+static void printAttribSet(const struct MscAttribSetTag *set)
+{
+    unsigned int t;
+
+    for(t = 0; t < MSC_ATTR_COUNT; t++)
     {
-        return attr->value;
+        const char *v = findAttrib(set, t);
+
+        if(v != NULL)
+        {
+            printf("  %s = %s\n", MscPrettyAttribType(t), v);
+        }
     }
-    else
+}
+
+
+/** Build the entity array and hash index for some MSC.
+ * Where entity names are duplicated, the first entity takes the index.
+ *
+ * \retval false  If the index could not be allocated.
+ */
+static bool buildEntityIndex(struct MscTag *m)
+{
+    const unsigned int   n = m->entityList->elements;
+    struct MscEntityTag *entities = m->entityList->entities;
+    unsigned int         c;
+
+    m->entityHashSize = 16;
+    while(m->entityHashSize < n * 2)
     {
-        return NULL;
+        m->entityHashSize *= 2;
+    }
+
+    m->entityHash = ArenaZalloc(m->arena, sizeof(unsigned int) * m->entityHashSize);
+    if(m->entityHash == NULL)
+    {
+        return false;
+    }
+
+    for(c = 0; c < n; c++)
+    {
+        const char  *label = entities[c].label;
+        unsigned int h     = SymTabHash(label, strlen(label)) & (m->entityHashSize - 1);
+
+        while(m->entityHash[h] != 0 &&
+              strcmp(entities[m->entityHash[h] - 1].label, label) != 0)
+        {
+            h = (h + 1) & (m->entityHashSize - 1);
+        }
+
+        if(m->entityHash[h] == 0)
+        {
+            m->entityHash[h] = c + 1;
+        }
     }
+
+    return true;
 }
 
 
-/** Free the memory underlying a list of attributes.
+/** Resolve the source and destination column of every arc in some MSC.
+ * This must be called after buildEntityIndex().
  */
-static void freeAttribList(struct MscAttribTag *attr)
+static void resolveArcEntities(struct MscTag *m)
 {
-    while(attr)
+    struct MscArcTag *arc;
+
+    for(arc = m->arcList->head; arc != NULL; arc = arc->next)
     {
-        struct MscAttribTag *next = attr->next;
-        free(attr->value);
-        free(attr);
-        attr = next;
+        arc->srcIdx = arc->dstIdx = MSC_INVALID_ENTITY;
+
+        if(arc->src != NULL)
+        {
+            arc->srcIdx = MscGetEntityIndex(m, arc->src);
+        }
+
+        if(arc->dst != NULL)
+        {
+            if(strcmp(arc->dst, "*") == 0)
+            {
+                arc->dstIdx = MSC_BROADCAST_ENTITY;
+            }
+            else
+            {
+                arc->dstIdx = MscGetEntityIndex(m, arc->dst);
+            }
+        }
     }
 }
 
+
 /***************************************************************************
  * Option Functions
  ***************************************************************************/
 
 /* Allocate some option and set it's value.
  */
-struct MscOptTag *MscAllocOpt(MscOptType  type,
-                              char       *value)
+struct MscOptTag *MscAllocOpt(Arena       arena,
+                              MscOptType  type,
+                              const char *value)
 {
-    struct MscOptTag *a = malloc_s(sizeof(struct MscOptTag));
+    struct MscOptTag *a = ArenaAlloc(arena, sizeof(struct MscOptTag));
+
+    if(a == NULL)
+    {
+        return NULL;
+    }
 
     a->type  = type;
     a->value = value;
@@ -214,42 +348,60 @@ void MscPrintOptList(struct MscOptTag *list)
 /* MscAllocEntity
  *  Allocate some entity and set it's name.
  */
-struct MscEntityTag *MscAllocEntity(char *entityName)
+struct MscEntityTag *MscAllocEntity(Arena arena, const char *entityName)
 {
-    struct MscEntityTag *e = malloc_s(sizeof(struct MscEntityListTag));
+    struct MscEntityTag *e = ArenaZalloc(arena, sizeof(struct MscEntityTag));
+
+    if(e == NULL)
+    {
+        return NULL;
+    }
 
     e->label = entityName;
-    e->attr  = NULL;
-    e->next  = NULL;
 
     return e;
 }
 
 
 /* MscLinkEntity
- *  Link some entity onto a list, possibly producing a new head element.
+ *  Append some entity to a list, possibly allocating the list.
+ *  The entity is copied into the list's array.
  */
-struct MscEntityListTag *MscLinkEntity(struct MscEntityListTag *list,
+struct MscEntityListTag *MscLinkEntity(Arena                    arena,
+                                       struct MscEntityListTag *list,
                                        struct MscEntityTag     *elem)
 {
     /* Check if the list has been allocated or not */
     if(list == NULL)
     {
-        list = zalloc_s(sizeof(struct MscEntityListTag));
+        list = ArenaZalloc(arena, sizeof(struct MscEntityListTag));
+        if(list == NULL)
+        {
+            return NULL;
+        }
     }
 
-    /* Check for an empty list */
-    if(list->head == NULL)
+    /* Grow the array if needed */
+    if(list->elements == list->allocated)
     {
-        list->head = list->tail = elem;
-    }
-    else
-    {
-        /* Add to tail */
-        list->tail->next = elem;
-        list->tail = elem;
+        const unsigned int   n = list->allocated == 0 ? 8 : list->allocated * 2;
+        struct MscEntityTag *entities;
+
+        entities = ArenaRealloc(arena, list->entities,
+                                sizeof(struct MscEntityTag) * list->allocated,
+                                sizeof(struct MscEntityTag) * n);
+        if(entities == NULL)
+        {
+            return NULL;
+        }
+
+        list->entities  = entities;
+        list->allocated = n;
     }
 
+    /* Add to tail */
+    list->entities[list->elements] = *elem;
+
     /* Increment count of elements */
     list->elements++;
 
@@ -259,13 +411,14 @@ struct MscEntityListTag *MscLinkEntity(struct MscEntityListTag *list,
 
 void MscPrintEntityList(struct MscEntityListTag *list)
 {
-    struct MscEntityTag *elem = list->head;
+    unsigned int t;
 
-    while(elem)
+    for(t = 0; t < list->elements; t++)
     {
+        const struct MscEntityTag *elem = &list->entities[t];
+
         printf("%p: %s\n", elem, elem->label);
-        MscPrintAttrib(elem->attr);
-        elem = elem->next;
+        printAttribSet(&elem->attr);
     }
 }
 
@@ -276,12 +429,18 @@ void MscPrintEntityList(struct MscEntityListTag *list)
 /* MscAllocArc
  *  Allocate an arc, filling in the src and dst entities.
  */
-struct MscArcTag *MscAllocArc(char        *srcEntity,
-                              char        *dstEntity,
+struct MscArcTag *MscAllocArc(Arena        arena,
+                              const char  *srcEntity,
+                              const char  *dstEntity,
                               MscArcType   type,
                               unsigned int inputLine)
 {
-    struct MscArcTag *a = malloc_s(sizeof(struct MscArcTag));
+    struct MscArcTag *a = ArenaZalloc(arena, sizeof(struct MscArcTag));
+
+    if(a == NULL)
+    {
+        return NULL;
+    }
 
     /* A discontinuity arcs are not between entities */
     if(type == MSC_ARC_DISCO)
@@ -292,9 +451,10 @@ struct MscArcTag *MscAllocArc(char        *srcEntity,
     a->inputLine = inputLine;
     a->src  = srcEntity;
     a->dst  = dstEntity;
+    a->srcIdx = MSC_INVALID_ENTITY;
+    a->dstIdx = MSC_INVALID_ENTITY;
     a->type = type;
     a->next = NULL;
-    a->attr = NULL;
 
     return a;
 }
@@ -303,13 +463,18 @@ struct MscArcTag *MscAllocArc(char        *srcEntity,
 /* MscLinkArc
  *  Link some entity onto a list, possibly producing a new head element.
  */
-struct MscArcListTag *MscLinkArc(struct MscArcListTag *list,
+struct MscArcListTag *MscLinkArc(Arena                 arena,
+                                 struct MscArcListTag *list,
                                  struct MscArcTag     *elem)
 {
     /* Check if the list has been allocated or not */
     if(list == NULL)
     {
-        list = zalloc_s(sizeof(struct MscArcListTag));
+        list = ArenaZalloc(arena, sizeof(struct MscArcListTag));
+        if(list == NULL)
+        {
+            return NULL;
+        }
     }
 
     /* Check for an empty list */
@@ -349,7 +514,7 @@ void MscPrintArcList(struct MscArcListTag *list)
     while(elem)
     {
         printf("%p: '%s' -> '%s'\n", elem, elem->src, elem->dst);
-        MscPrintAttrib(elem->attr);
+        printAttribSet(&elem->attr);
 
         elem = elem->next;
     }
@@ -363,10 +528,16 @@ void MscPrintArcList(struct MscArcListTag *list)
 /* MscAllocAttrib
  *  Allocate some attribute.
  */
-struct MscAttribTag *MscAllocAttrib(MscAttribType  type,
-                                    char          *value)
+struct MscAttribTag *MscAllocAttrib(Arena          arena,
+                                    MscAttribType  type,
+                                    const char    *value)
 {
-    struct MscAttribTag *a = malloc_s(sizeof(struct MscAttribTag));
+    struct MscAttribTag *a = ArenaAlloc(arena, sizeof(struct MscAttribTag));
+
+    if(a == NULL)
+    {
+        return NULL;
+    }
 
     a->type  = type;
     a->value = value;
@@ -404,14 +575,7 @@ struct MscAttribTag *MscLinkAttrib(struct MscAttribTag *head,
 void MscArcLinkAttrib(struct MscArcTag    *arc,
                       struct MscAttribTag *att)
 {
-    if(arc->attr)
-    {
-        arc->attr = MscLinkAttrib(arc->attr, att);
-    }
-    else
-    {
-        arc->attr = att;
-    }
+    linkAttribSet(&arc->attr, att);
 }
 
 
@@ -421,14 +585,7 @@ void MscArcLinkAttrib(struct MscArcTag    *arc,
 void MscEntityLinkAttrib(struct MscEntityTag *ent,
                          struct MscAttribTag *att)
 {
-    if(ent->attr)
-    {
-        ent->attr = MscLinkAttrib(ent->attr, att);
-    }
-    else
-    {
-        ent->attr = att;
-    }
+    linkAttribSet(&ent->attr, att);
 }
 
 
@@ -467,6 +624,7 @@ const char *MscPrettyAttribType(MscAttribType t)
         case MSC_ATTR_NO_ARROWS:         return "noarrows";
         case MSC_ATTR_BI_ARROWS:         return "biarrows";
         case MSC_ATTR_ARC_SKIP:          return "arcskip";
+        case MSC_ATTR_COUNT:             break;
     }
 
     return "<unknown>";
@@ -477,69 +635,45 @@ const char *MscPrettyAttribType(MscAttribType t)
  * MSC Functions
  ***************************************************************************/
 
-struct MscTag *MscAlloc(struct MscOptTag        *optList,
+struct MscTag *MscAlloc(Arena                    arena,
+                        struct MscOptTag        *optList,
                         struct MscEntityListTag *entityList,
                         struct MscArcListTag    *arcList)
 {
-    struct MscTag *m = malloc_s(sizeof(struct MscTag));
+    struct MscTag *m = ArenaAlloc(arena, sizeof(struct MscTag));
+
+    if(m == NULL)
+    {
+        return NULL;
+    }
 
     /* Copy the lists */
+    m->arena      = arena;
     m->optList    = optList;
     m->entityList = entityList;
     m->arcList    = arcList;
+    m->utf8       = false;
 
-    return m;
-}
-
-void MscFree(struct MscTag *m)
-{
-    struct MscOptTag    *opt    = m->optList;
-    struct MscEntityTag *entity = m->entityList->head;
-    struct MscArcTag    *arc    = m->arcList->head;
-
-    while(opt)
+    /* Index the entities and resolve arc end points once */
+    if(!buildEntityIndex(m))
     {
-        struct MscOptTag *next = opt->next;
-
-        free(opt->value);
-        free(opt);
-
-        opt = next;
-    }
-
-    while(entity)
-    {
-        struct MscEntityTag *next = entity->next;
-
-        freeAttribList(entity->attr);
-        free(entity->label);
-        free(entity);
-
-        entity = next;
+        return NULL;
     }
 
-    while(arc)
-    {
-        struct MscArcTag *next = arc->next;
+    resolveArcEntities(m);
 
-        freeAttribList(arc->attr);
-        if(arc->src != arc->dst)
-        {
-            free(arc->dst);
-            free(arc->src);
-        }
-        else
-        {
-            free(arc->src);
-        }
-        free(arc);
+    return m;
+}
 
-        arc = next;
-    }
+void MscSetUtf8(struct MscTag *m, bool utf8)
+{
+    m->utf8 = utf8;
+}
 
-    free(m->entityList);
-    free(m->arcList);
-    free(m);
+void MscFree(struct MscTag *m)
+{
+    /* Everything is in the arena, including the MSC itself */
+    ArenaDestroy(m->arena);
 }
 
 void MscPrint(struct MscTag *m)
@@ -584,71 +718,82 @@ unsigned int MscGetNumOpts(Msc m)
     return count;
 }
 
+bool MscGetUtf8(Msc m)
+{
+    return m->utf8;
+}
+
 int MscGetEntityIndex(struct MscTag *m, const char *label)
 {
-    struct MscEntityTag *entity = m->entityList->head;
-    int                  c      = 0;
+    unsigned int h;
 
     assert(label);
 
-    while(entity != NULL && strcmp(entity->label, label) != 0)
-    {
-        entity = entity->next;
-        c++;
-    }
+    h = SymTabHash(label, strlen(label)) & (m->entityHashSize - 1);
 
-    if(entity == NULL)
-    {
-        return -1;
-    }
-    else
+    while(m->entityHash[h] != 0)
     {
-        return c;
+        const unsigned int c = m->entityHash[h] - 1;
+
+        /* Names from the parser are interned, so usually match by pointer */
+        if(m->entityList->entities[c].label == label ||
+           strcmp(m->entityList->entities[c].label, label) == 0)
+        {
+            return c;
+        }
+
+        h = (h + 1) & (m->entityHashSize - 1);
     }
+
+    return MSC_INVALID_ENTITY;
+}
+
+
+/** Get some attribute for an entity.
+ * If the entity label is sought but not set, the entity name is returned.
+ */
+static const char *getEntAttrib(const struct MscEntityTag *entity, MscAttribType a)
+{
+    const char *r = findAttrib(&entity->attr, a);
+
+    return r == NULL && a == MSC_ATTR_LABEL ? entity->label : r;
 }
 
 
 MscEntityIter MscEntityIterBegin(struct MscTag *m)
 {
-    MscEntityIter i = { m->entityList->head };
+    MscEntityIter i = { m->entityList->entities,
+                        m->entityList->entities + m->entityList->elements };
     return i;
 }
 
 
 bool MscEntityIterEnd(MscEntityIter *i)
 {
-    return i->entity == NULL;
+    return i->entity == i->end;
 }
 
 
 void MscNextEntity(MscEntityIter *i)
 {
-    i->entity = i->entity->next;
+    i->entity++;
 }
 
 
 const char *MscGetEntAttrib(MscEntityIter *i, MscAttribType a)
 {
-    const char *r = findAttrib(i->entity->attr, a);
-
-    /* If the entity label was sought but not found, return entity name */
-    return r == NULL && a == MSC_ATTR_LABEL ? i->entity->label : r;
+    return getEntAttrib(i->entity, a);
 }
 
 
 const char *MscGetEntIdxAttrib(Msc m, unsigned int entIdx, MscAttribType a)
 {
-    MscEntityIter i = MscEntityIterBegin(m);
-
-    /* Find the entity */
-    while(entIdx > 0 && !MscEntityIterEnd(&i))
+    if(entIdx >= m->entityList->elements)
     {
-        MscNextEntity(&i);
-        entIdx--;
+        return NULL;
     }
 
-    /* Search the attribute list if the entity was found */
-    return !MscEntityIterEnd(&i) ? MscGetEntAttrib(&i, a) : NULL;
+    return getEntAttrib(&m->entityList->entities[entIdx], a);
 }
 
 
@@ -683,6 +828,18 @@ const char *MscGetArcDest(MscArcIter *i)
 }
 
 
+int MscGetArcSourceIndex(MscArcIter *i)
+{
+    return i->arc->srcIdx;
+}
+
+
+int MscGetArcDestIndex(MscArcIter *i)
+{
+    return i->arc->dstIdx;
+}
+
+
 MscArcType MscGetArcType(MscArcIter *i)
 {
     return i->arc->type;
@@ -691,14 +848,7 @@ MscArcType MscGetArcType(MscArcIter *i)
 
 const char *MscGetArcAttrib(MscArcIter *i, MscAttribType a)
 {
-    struct MscAttribTag *attr = i->arc->attr;
-
-    while(attr != NULL && attr->type != a)
-    {
-        attr = attr->next;
-    }
-
-    return attr != NULL ? attr->value : NULL;
+    return findAttrib(&i->arc->attr, a);
 }
 
 
@@ -24,6 +24,8 @@
 #define MSC_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
 
 /***************************************************************************
  * Types
@@ -60,7 +62,10 @@ typedef enum MscAttribTypeTag
     MSC_ATTR_ARC_TEXT_BGCOLOUR,
     MSC_ATTR_NO_ARROWS,
     MSC_ATTR_BI_ARROWS,
-    MSC_ATTR_ARC_SKIP
+    MSC_ATTR_ARC_SKIP,
+
+    /** Number of attribute types, not itself an attribute. */
+    MSC_ATTR_COUNT
 }
 MscAttribType;
 
@@ -90,6 +95,15 @@ typedef enum
 MscArcType;
 
 
+/** Entity index for an unknown entity, or an arc not between entities.
+ */
+#define MSC_INVALID_ENTITY   (-1)
+
+/** Entity index for the destination of a broadcast arc.
+ */
+#define MSC_BROADCAST_ENTITY (-2)
+
+
 /***************************************************************************
  * Abstract types
  ***************************************************************************/
@@ -115,7 +129,7 @@ typedef struct MscAttribTag     *MscAttrib;
 
 typedef struct
 {
-    MscEntity entity;
+    MscEntity entity, end;
 }
 MscEntityIter;
 
@@ -133,34 +147,52 @@ MscArcIter;
  * This will parse characters from \a in and build a message sequence chart
  * ADT.
  * \retval Msc  The message sequence chart, which may equal \a NULL is a
- *               parse error occurred.
+ *               parse error occurred or memory could not be allocated.
  */
 Msc           MscParse(FILE *in);
 
-MscEntity     MscAllocEntity(char *entityName);
+/** Parse some input from memory to build a message sequence chart.
+ * This is as MscParse(), but parses the \a len bytes at \a buf.
+ * \retval Msc  The message sequence chart, which may equal \a NULL is a
+ *               parse error occurred.
+ */
+Msc           MscParseBuffer(const char *buf, size_t len);
+
+/* The following are used by the parser to build an MSC.  Everything is
+ *  allocated from the passed arena, which is owned by the MSC once
+ *  MscAlloc() has been called, and otherwise must be destroyed by the caller.
+ *  The allocating and list linking functions return NULL if the arena is
+ *  exhausted, leaving what was already built in the arena.
+ */
 
-MscEntityList MscLinkEntity(MscEntityList list, MscEntity elem);
+MscEntity     MscAllocEntity(Arena arena, const char *entityName);
+
+MscEntityList MscLinkEntity(Arena arena, MscEntityList list, MscEntity elem);
 
 void          MscPrintEntityList(MscEntityList list);
 
-MscOpt        MscAllocOpt(MscOptType  type,
-                          char       *value);
+MscOpt        MscAllocOpt(Arena       arena,
+                          MscOptType  type,
+                          const char *value);
 
 MscOpt        MscLinkOpt(MscOpt head,
                          MscOpt newHead);
 
-MscArc        MscAllocArc(char        *srcEntity,
-                          char        *dstEntity,
+MscArc        MscAllocArc(Arena        arena,
+                          const char  *srcEntity,
+                          const char  *dstEntity,
                           MscArcType   type,
                           unsigned int inputLine);
 
-MscArcList    MscLinkArc (MscArcList list,
+MscArcList    MscLinkArc (Arena      arena,
+                          MscArcList list,
                           MscArc     elem);
 
 void          MscPrintArcList(struct MscArcListTag *list);
 
-MscAttrib     MscAllocAttrib(MscAttribType  type,
-                             char          *value);
+MscAttrib     MscAllocAttrib(Arena          arena,
+                             MscAttribType  type,
+                             const char    *value);
 
 MscAttrib     MscLinkAttrib(MscAttrib head,
                             MscAttrib newHead);
@@ -175,10 +207,17 @@ void          MscPrintAttrib(const struct MscAttribTag *att);
 
 const char   *MscPrettyAttribType(MscAttribType t);
 
-Msc           MscAlloc(MscOpt        optList,
+Msc           MscAlloc(Arena         arena,
+                       MscOpt        optList,
                        MscEntityList entityList,
                        MscArcList    arcList);
 
+/** Record whether the input for an MSC started with a UTF-8 byte-order-mark.
+ */
+void          MscSetUtf8(Msc m, bool utf8);
+
+/** Free an MSC, releasing its arena and everything allocated from it.
+ */
 void          MscFree(struct MscTag *m);
 
 /** Print the passed msc in textual form to stdout.
@@ -195,6 +234,11 @@ unsigned int  MscGetNumParallelArcs(Msc m);
 
 unsigned int  MscGetNumOpts(Msc m);
 
+/** Check if the input for an MSC started with a UTF-8 byte-order-mark.
+ * This indicates that text in the MSC may contain UTF-8 characters.
+ */
+bool          MscGetUtf8(Msc m);
+
 /** Get an MSC option, returning the value as a float.
  *
  * \param[in]     m      The MSC to analyse.
@@ -219,9 +263,12 @@ bool         MscGetOptAsBoolean(struct MscTag *m, MscOptType type, bool *const b
  * This returns the column index for the entity identified by the passed
  * label.
  *
+ * This uses a hash index built when the MSC was allocated.
+ *
  * \param  m      The MSC to analyse.
  * \param  label  The label to find.
- * \retval -1     If the label was not found, otherwise the columnn index.
+ * \retval MSC_INVALID_ENTITY  If the label was not found, otherwise the
+ *                              column index.
  */
 int           MscGetEntityIndex(struct MscTag *m, const char *label);
 
@@ -298,6 +345,19 @@ const char  *MscGetArcSource(MscArcIter *i);
  */
 const char  *MscGetArcDest(MscArcIter *i);
 
+/** Get the column index of the entity from which the current arc originates.
+ * \retval MSC_INVALID_ENTITY  If the source entity is unknown, or the arc
+ *                              is not between entities.
+ */
+int          MscGetArcSourceIndex(MscArcIter *i);
+
+/** Get the column index of the entity at which the current arc terminates.
+ * \retval MSC_BROADCAST_ENTITY  If the arc is a broadcast arc.
+ * \retval MSC_INVALID_ENTITY    If the destination entity is unknown, or the
+ *                                arc is not between entities.
+ */
+int          MscGetArcDestIndex(MscArcIter *i);
+
 /** Get the type for some arc.
  *
  */
@@ -108,6 +108,14 @@ static void NullFilledTriangle(struct ADrawTag *ctx UNUSED,
 }
 
 
+static void NullFilledCircle(struct ADrawTag *ctx UNUSED,
+                             unsigned int     x UNUSED,
+                             unsigned int     y UNUSED,
+                             unsigned int     r UNUSED)
+{
+}
+
+
 static void NullArc(struct ADrawTag *ctx UNUSED,
                     unsigned int cx UNUSED,
                     unsigned int cy UNUSED,
@@ -160,6 +168,7 @@ bool NullInit(struct ADrawTag *outContext)
     outContext->textHeight      = NullTextHeight;
     outContext->filledRectangle = NullFilledRectangle;
     outContext->filledTriangle  = NullFilledTriangle;
+    outContext->filledCircle    = NullFilledCircle;
     outContext->arc             = NullArc;
     outContext->dottedArc       = NullDottedArc;
     outContext->setPen          = NullSetPen;
@@ -170,4 +179,40 @@ bool NullInit(struct ADrawTag *outContext)
     return true;
 }
 
+
+static unsigned int NullMetricsTextWidth(ADrawMetrics *ctx UNUSED,
+                                         const char   *string UNUSED)
+{
+    return 0;
+}
+
+
+static int NullMetricsTextHeight(ADrawMetrics *ctx UNUSED)
+{
+    return 0;
+}
+
+
+static void NullMetricsSetFontSize(ADrawMetrics *ctx UNUSED,
+                                   ADrawFontSize size UNUSED)
+{
+}
+
+
+static bool NullMetricsClose(ADrawMetrics *ctx UNUSED)
+{
+    return true;
+}
+
+
+bool NullMetricsInit(ADrawMetrics *outMetrics)
+{
+    outMetrics->textWidth   = NullMetricsTextWidth;
+    outMetrics->textHeight  = NullMetricsTextHeight;
+    outMetrics->setFontSize = NullMetricsSetFontSize;
+    outMetrics->close       = NullMetricsClose;
+
+    return true;
+}
+
 /* END OF FILE */
@@ -0,0 +1,1092 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * This file is part of mscgen, a message sequence chart renderer.
+ * Copyright (C) 2005 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <zlib.h>
+#include "adraw_int.h"
+#include "utf8.h"
+#include "safe.h"
+
+/***************************************************************************
+ * Manifest Constants
+ ***************************************************************************/
+
+/** Overall scaling of the PDF output, as for Postscript.
+ */
+#define PDF_OUT_SCALE  0.7f
+
+/** Size of the buffer in which content is gathered before compression. */
+#define PDF_BUF_SIZE   16384
+
+/** Object numbers.
+ * The chart is drawn once as a form XObject, whose length is only known
+ * once it has been written, and each page then shows a slice of it.  Each
+ * page object is followed by the object giving its content.
+ */
+#define PDF_OBJ_CATALOG  1
+#define PDF_OBJ_PAGES    2
+#define PDF_OBJ_FONT     3
+#define PDF_OBJ_CHART    4
+#define PDF_OBJ_LENGTH   5
+#define PDF_OBJ_PAGE     6
+
+/***************************************************************************
+ * Local types
+ ***************************************************************************/
+
+typedef struct PdfContextTag
+{
+    /** Output sink. */
+    Sink           out;
+
+    /** Set if writing to \a out has failed. */
+    bool           failed;
+
+    /** Count of bytes written to \a out, giving the offset of objects. */
+    unsigned long  offset;
+
+    /** Offset of each object, indexed by object number. */
+    unsigned long *objOffset;
+
+    /** Dimensions of the chart. */
+    unsigned int   w, h;
+
+    /** The last row of each page. */
+    unsigned int  *pageEnd;
+    unsigned int   nPages;
+
+    /** Count of bytes in \a buf. */
+    size_t         bufLen;
+
+    /** Content waiting to be compressed. */
+    char           buf[PDF_BUF_SIZE];
+
+    /** Compressor for the chart content, written through \a zbuf. */
+    z_stream       z;
+    unsigned char  zbuf[PDF_BUF_SIZE];
+
+    /** Count of compressed bytes of chart content. */
+    unsigned long  streamLen;
+
+    /** Point size of the current font. */
+    int            fontPoints;
+
+    /** Point size selected in the content, or 0 if none has been. */
+    int            textPoints;
+
+    /** Current pen colour. */
+    ADrawColour    penColour;
+
+    /** Background colour for the pen. */
+    ADrawColour    penBgColour;
+
+    /** Stroke and fill colours selected in the content. */
+    ADrawColour    strokeColour, fillColour;
+
+    /** If true, the content is drawing dashed lines. */
+    bool           dashed;
+
+    /** If true, a path of lines is open, which lines of the same colour
+     *  and dash are added to until something else is drawn.
+     */
+    bool           pathOpen;
+
+    /** If true, the current point of the open path is \a pathX, \a pathY. */
+    bool           pathAt;
+    unsigned int   pathX, pathY;
+}
+PdfContext;
+
+/** State for measuring text without producing output.
+ */
+typedef struct PdfMetricsTag
+{
+    /** Point size of the current font. */
+    int          fontPoints;
+}
+PdfMetrics;
+
+typedef struct
+{
+    int capheight, xheight, ascender, descender;
+    int widths[256];
+}
+PdfCharMetric;
+
+/** Helvetica character widths.
+ * This gives the width of each character is 1/1000ths of a point.
+ * The values are taken from the Adobe Font Metric file for Hevletica, and
+ * are the same as used for Postscript output.
+ */
+static const PdfCharMetric PdfHelvetica =
+{
+    718, 523, 718, -207,
+    {
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      278,  278,  355,  556,  556,  889,  667,  222,
+      333,  333,  389,  584,  278,  333,  278,  278,
+      556,  556,  556,  556,  556,  556,  556,  556,
+      556,  556,  278,  278,  584,  584,  584,  556,
+     1015,  667,  667,  722,  722,  667,  611,  778,
+      722,  278,  500,  667,  556,  833,  722,  778,
+      667,  778,  722,  667,  611,  722,  667,  944,
+      667,  667,  611,  278,  278,  278,  469,  556,
+      222,  556,  556,  500,  556,  556,  278,  556,
+      556,  222,  222,  500,  222,  833,  556,  556,
+      556,  556,  333,  500,  278,  556,  500,  722,
+      500,  500,  500,  334,  260,  334,  584,   -1,
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1,  333,  556,  556,  167,  556,  556,  556,
+      556,  191,  333,  556,  333,  333,  500,  500,
+       -1,  556,  556,  556,  278,   -1,  537,  350,
+      222,  333,  333,  556, 1000, 1000,   -1,  611,
+       -1,  333,  333,  333,  333,  333,  333,  333,
+      333,   -1,  333,  333,   -1,  333,  333,  333,
+     1000,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+       -1, 1000,   -1,  370,   -1,   -1,   -1,   -1,
+      556,  778, 1000,  365,   -1,   -1,   -1,   -1,
+       -1,  889,   -1,   -1,   -1,  278,   -1,   -1,
+      222,  611,  944,  611,   -1,   -1,   -1,   -1
+    }
+};
+
+/***************************************************************************
+ * Helper functions
+ ***************************************************************************/
+
+/** Get the context pointer from an ADraw structure.
+ */
+static PdfContext *getPdfCtx(struct ADrawTag *ctx)
+{
+    return (PdfContext *)ctx->internal;
+}
+
+
+/** Given a font metric measurement, return device dependent units.
+ * Font metric data is stored as 1/1000th of a point, and therefore
+ * needs to be multiplied by the font point size and divided by
+ * 1000 to give a value in device dependent units.
+ */
+static int pointSpace(int fontPoints, long thousanths)
+{
+    return ((thousanths * fontPoints) + 500) / 1000;
+}
+
+
+/** Given a font metric measurement, return device dependent units.
+ * This scales the measurement by the current font size of the context.
+ */
+static int getSpace(struct ADrawTag *ctx, long thousanths)
+{
+    return pointSpace(getPdfCtx(ctx)->fontPoints, thousanths);
+}
+
+
+/** Get the point size of some font size.
+ */
+static int getFontPoints(ADrawFontSize size)
+{
+    switch(size)
+    {
+        case ADRAW_FONT_TINY:
+            return 8;
+
+        case ADRAW_FONT_SMALL:
+            return 12;
+
+        default:
+            assert(0);
+            return 12;
+    }
+}
+
+
+/** Measure the width of some text at some point size.
+ */
+static unsigned int measureWidth(int fontPoints, const char *string)
+{
+    unsigned long width = 0;
+
+    while(*string != '\0')
+    {
+        int           i = *string & 0xff;
+        unsigned long w = PdfHelvetica.widths[i];
+
+        /* Ignore undefined characters */
+        width += w > 0 ? w : 0;
+
+        string++;
+    }
+
+    return pointSpace(fontPoints, width);
+}
+
+
+/** Write uncompressed output, such as the objects around the content.
+ */
+static void pdfRawf(PdfContext *context, const char *fmt, ...)
+{
+    va_list ap;
+    int     r;
+
+    va_start(ap, fmt);
+    r = SinkVPrintf(context->out, fmt, ap);
+    va_end(ap);
+
+    if(r < 0)
+    {
+        context->failed = true;
+    }
+    else
+    {
+        context->offset += r;
+    }
+}
+
+
+/** Start an object, recording its offset for the cross-reference table.
+ */
+static void pdfBeginObj(PdfContext *context, unsigned int obj)
+{
+    context->objOffset[obj] = context->offset;
+    pdfRawf(context, "%u 0 obj\n", obj);
+}
+
+
+/** Compress some content, writing the compressed data as it is produced.
+ */
+static void pdfDeflate(PdfContext *context, const char *s, size_t n, int flush)
+{
+    context->z.next_in  = (Bytef *)s;
+    context->z.avail_in = n;
+
+    do
+    {
+        size_t len;
+        int    r;
+
+        context->z.next_out  = context->zbuf;
+        context->z.avail_out = sizeof(context->zbuf);
+
+        r = deflate(&context->z, flush);
+        if(r == Z_STREAM_ERROR)
+        {
+            context->failed = true;
+            return;
+        }
+
+        len = sizeof(context->zbuf) - context->z.avail_out;
+        if(!SinkWrite(context->out, context->zbuf, len))
+        {
+            context->failed = true;
+        }
+
+        context->offset    += len;
+        context->streamLen += len;
+    }
+    while(context->z.avail_out == 0);
+}
+
+
+/** Compress any buffered content.
+ */
+static void pdfFlush(PdfContext *context)
+{
+    if(context->bufLen > 0)
+    {
+        pdfDeflate(context, context->buf, context->bufLen, Z_NO_FLUSH);
+        context->bufLen = 0;
+    }
+}
+
+
+/** Add some number of bytes to the content.
+ */
+static void pdfPutN(PdfContext *context, const char *s, size_t n)
+{
+    if(context->bufLen + n > PDF_BUF_SIZE)
+    {
+        pdfFlush(context);
+
+        /* Large strings bypass the buffer */
+        if(n > PDF_BUF_SIZE)
+        {
+            pdfDeflate(context, s, n, Z_NO_FLUSH);
+            return;
+        }
+    }
+
+    memcpy(&context->buf[context->bufLen], s, n);
+    context->bufLen += n;
+}
+
+
+/** Add a nul terminated string to the content.
+ */
+static void pdfPuts(PdfContext *context, const char *s)
+{
+    pdfPutN(context, s, strlen(s));
+}
+
+
+/** Add an integer to the content, followed by a space.
+ */
+static void pdfPutI(PdfContext *context, int v)
+{
+    char         digits[14];
+    unsigned int n = sizeof(digits), u = v < 0 ? -v : v;
+
+    digits[--n] = ' ';
+    do
+    {
+        digits[--n] = '0' + (u % 10);
+        u /= 10;
+    }
+    while(u != 0);
+
+    if(v < 0)
+    {
+        digits[--n] = '-';
+    }
+
+    pdfPutN(context, &digits[n], sizeof(digits) - n);
+}
+
+
+/** Add a real number to the content, followed by a space.
+ * Up to three decimal places are given, without trailing zeros.
+ */
+static void pdfPutF(PdfContext *context, double v)
+{
+    char  s[32];
+    int   n = snprintf(s, sizeof(s), "%.3f", v);
+
+    while(s[n - 1] == '0')
+    {
+        n--;
+    }
+
+    if(s[n - 1] == '.')
+    {
+        n--;
+    }
+
+    /* Avoid writing -0 */
+    if(n == 2 && s[0] == '-' && s[1] == '0')
+    {
+        s[0] = '0';
+        n = 1;
+    }
+
+    s[n++] = ' ';
+    pdfPutN(context, s, n);
+}
+
+
+/** Add a point in chart co-ordinates to the content.
+ * The chart y-axis is inverted for PDF, which has its origin at the bottom.
+ */
+static void pdfPutPoint(PdfContext *context, unsigned int x, unsigned int y)
+{
+    pdfPutI(context, x);
+    pdfPutI(context, (int)context->h - (int)y);
+}
+
+
+/** Add a point given as real numbers in chart co-ordinates to the content.
+ */
+static void pdfPutPointF(PdfContext *context, double x, double y)
+{
+    pdfPutF(context, x);
+    pdfPutF(context, context->h - y);
+}
+
+
+/** Add a colour, as RGB components, to the content.
+ */
+static void pdfPutColour(PdfContext *context, ADrawColour col)
+{
+    pdfPutF(context, ((col & 0xff0000) >> 16) / 255.0);
+    pdfPutF(context, ((col & 0x00ff00) >>  8) / 255.0);
+    pdfPutF(context, ((col & 0x0000ff) >>  0) / 255.0);
+}
+
+
+/** Stroke the open path, if any.
+ */
+static void pdfEndPath(PdfContext *context)
+{
+    if(context->pathOpen)
+    {
+        pdfPutN(context, "S\n", 2);
+        context->pathOpen = false;
+    }
+}
+
+
+/** Select a fill colour, closing the open path first.
+ */
+static void pdfSetFill(PdfContext *context, ADrawColour col)
+{
+    pdfEndPath(context);
+
+    if(context->fillColour != col)
+    {
+        pdfPutColour(context, col);
+        pdfPutN(context, "rg\n", 3);
+        context->fillColour = col;
+    }
+}
+
+
+/** Open a path to be stroked with the pen, optionally dashed.
+ * An open path is continued if it is drawn in the same way.
+ */
+static void pdfBeginPath(PdfContext *context, bool dashed)
+{
+    if(context->pathOpen &&
+       (context->strokeColour != context->penColour || context->dashed != dashed))
+    {
+        pdfEndPath(context);
+    }
+
+    if(context->strokeColour != context->penColour)
+    {
+        pdfPutColour(context, context->penColour);
+        pdfPutN(context, "RG\n", 3);
+        context->strokeColour = context->penColour;
+    }
+
+    if(context->dashed != dashed)
+    {
+        pdfPuts(context, dashed ? "[2] 0 d\n" : "[] 0 d\n");
+        context->dashed = dashed;
+    }
+
+    if(!context->pathOpen)
+    {
+        context->pathOpen = true;
+        context->pathAt   = false;
+    }
+}
+
+
+/** Draw a line, optionally dashed.
+ */
+static void pdfLine(PdfContext   *context,
+                    unsigned int  x1,
+                    unsigned int  y1,
+                    unsigned int  x2,
+                    unsigned int  y2,
+                    bool          dashed)
+{
+    pdfBeginPath(context, dashed);
+
+    /* Only start a new subpath if the line does not continue the last */
+    if(!context->pathAt || context->pathX != x1 || context->pathY != y1)
+    {
+        pdfPutPoint(context, x1, y1);
+        pdfPutN(context, "m ", 2);
+    }
+
+    pdfPutPoint(context, x2, y2);
+    pdfPutN(context, "l\n", 2);
+
+    context->pathAt = true;
+    context->pathX  = x2;
+    context->pathY  = y2;
+}
+
+
+/** Add Bezier curves approximating an elliptical arc to the content.
+ * Angles are in degrees clockwise from 3 o'clock, as for gdImageArc(), and
+ * the arc is split into curves of at most 90 degrees.
+ *
+ * \param[in] move  If true, a subpath is started at the start of the arc.
+ */
+static void pdfPutArc(PdfContext *context,
+                      double      cx,
+                      double      cy,
+                      double      rx,
+                      double      ry,
+                      double      s,
+                      double      e,
+                      bool        move)
+{
+    unsigned int n, t;
+    double       step, k;
+
+    while(e <= s)
+    {
+        e += 360;
+    }
+
+    n    = (unsigned int)ceil((e - s) / 90.0);
+    step = ((e - s) / n) * M_PI / 180.0;
+    k    = 4.0 / 3.0 * tan(step / 4);
+    s    = s * M_PI / 180.0;
+
+    if(move)
+    {
+        pdfPutPointF(context, cx + rx * cos(s), cy + ry * sin(s));
+        pdfPutN(context, "m\n", 2);
+    }
+
+    for(t = 0; t < n; t++)
+    {
+        const double a0 = s + step * t, a1 = a0 + step;
+
+        pdfPutPointF(context, cx + rx * (cos(a0) - k * sin(a0)),
+                              cy + ry * (sin(a0) + k * cos(a0)));
+        pdfPutPointF(context, cx + rx * (cos(a1) + k * sin(a1)),
+                              cy + ry * (sin(a1) - k * cos(a1)));
+        pdfPutPointF(context, cx + rx * cos(a1), cy + ry * sin(a1));
+        pdfPutN(context, "c\n", 2);
+    }
+}
+
+
+/** Draw an elliptical arc, optionally dashed.
+ */
+static void pdfArc(PdfContext   *context,
+                   unsigned int  cx,
+                   unsigned int  cy,
+                   unsigned int  w,
+                   unsigned int  h,
+                   unsigned int  s,
+                   unsigned int  e,
+                   bool          dashed)
+{
+    pdfBeginPath(context, dashed);
+    pdfPutArc(context, cx, cy, w / 2.0, h / 2.0, s, e, true);
+    context->pathAt = false;
+}
+
+
+/** Add a string to the content, escaping special characters.
+ * UTF-8 characters are given by their code in the WinAnsiEncoding of the
+ * font, which matches ISO-8859-1 for the characters it has.
+ */
+static void pdfPutString(PdfContext *context, const char *string)
+{
+    pdfPutN(context, "(", 1);
+
+    while(*string != '\0')
+    {
+        unsigned int code, bytes;
+        char         oct[5];
+
+        switch(*string)
+        {
+            case '(':  pdfPutN(context, "\\(", 2); break;
+            case ')':  pdfPutN(context, "\\)", 2); break;
+            case '\\': pdfPutN(context, "\\\\", 2); break;
+            default:
+                if(Utf8Decode(string, &code, &bytes))
+                {
+                    snprintf(oct, sizeof(oct), "\\%03o", code < 256 ? code : '?');
+                    pdfPutN(context, oct, 4);
+                    string += bytes - 1;
+                }
+                else if((*string & 0xff) < ' ')
+                {
+                    pdfPutN(context, "?", 1);
+                }
+                else
+                {
+                    pdfPutN(context, string, 1);
+                }
+                break;
+        }
+
+        string++;
+    }
+
+    pdfPutN(context, ") ", 2);
+}
+
+
+/** Draw some text over its background.
+ * The text is placed from \a x, with the background box covering \a x1 to
+ * \a x2, as for SVG output.
+ */
+static void pdfText(struct ADrawTag *ctx,
+                    unsigned int     x1,
+                    unsigned int     x2,
+                    unsigned int     x,
+                    unsigned int     y,
+                    const char      *string)
+{
+    PdfContext *context = getPdfCtx(ctx);
+    const int   height = getSpace(ctx, PdfHelvetica.ascender - PdfHelvetica.descender);
+
+    /* Draw the background box */
+    pdfSetFill(context, context->penBgColour);
+    pdfPutPoint(context, x1, y - 1);
+    pdfPutI(context, x2 - x1);
+    pdfPutI(context, height - 2);
+    pdfPutN(context, "re f\n", 5);
+
+    /* Restore pen and show the string */
+    pdfSetFill(context, context->penColour);
+
+    if(context->textPoints != context->fontPoints)
+    {
+        pdfPutN(context, "/F1 ", 4);
+        pdfPutI(context, context->fontPoints);
+        pdfPutN(context, "Tf\n", 3);
+        context->textPoints = context->fontPoints;
+    }
+
+    pdfPutN(context, "BT ", 3);
+    pdfPutPoint(context, x, y + getSpace(ctx, PdfHelvetica.descender));
+    pdfPutN(context, "Td ", 3);
+    pdfPutString(context, string);
+    pdfPutN(context, "Tj ET\n", 6);
+}
+
+/***************************************************************************
+ * API Functions
+ ***************************************************************************/
+
+unsigned int PdfTextWidth(struct ADrawTag *ctx,
+                          const char *string)
+{
+    return measureWidth(getPdfCtx(ctx)->fontPoints, string);
+}
+
+
+int PdfTextHeight(struct ADrawTag *ctx)
+{
+    return getSpace(ctx, PdfHelvetica.ascender - PdfHelvetica.descender);
+}
+
+
+void PdfLine(struct ADrawTag *ctx,
+             unsigned int     x1,
+             unsigned int     y1,
+             unsigned int     x2,
+             unsigned int     y2)
+{
+    pdfLine(getPdfCtx(ctx), x1, y1, x2, y2, false);
+}
+
+
+void PdfDottedLine(struct ADrawTag *ctx,
+                   unsigned int     x1,
+                   unsigned int     y1,
+                   unsigned int     x2,
+                   unsigned int     y2)
+{
+    pdfLine(getPdfCtx(ctx), x1, y1, x2, y2, true);
+}
+
+
+void PdfFilledRectangle(struct ADrawTag *ctx,
+                        unsigned int     x1,
+                        unsigned int     y1,
+                        unsigned int     x2,
+                        unsigned int     y2)
+{
+    PdfContext *context = getPdfCtx(ctx);
+
+    pdfSetFill(context, context->penColour);
+    pdfPutPoint(context, x1, y2);
+    pdfPutI(context, x2 - x1);
+    pdfPutI(context, y2 - y1);
+    pdfPutN(context, "re f\n", 5);
+}
+
+
+void PdfTextR(struct ADrawTag *ctx,
+              unsigned int     x,
+              unsigned int     y,
+              const char      *string,
+              const char      *url UNUSED)
+{
+    pdfText(ctx, x - 2, x + ctx->textWidth(ctx, string), x, y, string);
+}
+
+
+void PdfTextL(struct ADrawTag *ctx,
+              unsigned int     x,
+              unsigned int     y,
+              const char      *string,
+              const char      *url UNUSED)
+{
+    const unsigned int w = ctx->textWidth(ctx, string);
+
+    pdfText(ctx, x - (w + 2), x, x - w, y, string);
+}
+
+
+void PdfTextC(struct ADrawTag *ctx,
+              unsigned int     x,
+              unsigned int     y,
+              const char      *string,
+              const char      *url UNUSED)
+{
+    const unsigned int w = ctx->textWidth(ctx, string);
+
+    pdfText(ctx, x - (w / 2 + 2), x + w / 2, x - w / 2, y, string);
+}
+
+
+void PdfFilledTriangle(struct ADrawTag *ctx,
+                       unsigned int x1,
+                       unsigned int y1,
+                       unsigned int x2,
+                       unsigned int y2,
+                       unsigned int x3,
+                       unsigned int y3)
+{
+    PdfContext *context = getPdfCtx(ctx);
+
+    pdfSetFill(context, context->penColour);
+    pdfPutPoint(context, x1, y1);
+    pdfPutN(context, "m ", 2);
+    pdfPutPoint(context, x2, y2);
+    pdfPutN(context, "l ", 2);
+    pdfPutPoint(context, x3, y3);
+    pdfPutN(context, "l f\n", 4);
+}
+
+
+void PdfFilledCircle(struct ADrawTag *ctx,
+                     unsigned int x,
+                     unsigned int y,
+                     unsigned int r)
+{
+    PdfContext *context = getPdfCtx(ctx);
+
+    pdfSetFill(context, context->penColour);
+    pdfPutArc(context, x, y, r, r, 0, 360, true);
+    pdfPutN(context, "f\n", 2);
+}
+
+
+void PdfArc(struct ADrawTag *ctx,
+            unsigned int cx,
+            unsigned int cy,
+            unsigned int w,
+            unsigned int h,
+            unsigned int s,
+            unsigned int e)
+{
+    pdfArc(getPdfCtx(ctx), cx, cy, w, h, s, e, false);
+}
+
+
+void PdfDottedArc(struct ADrawTag *ctx,
+                  unsigned int cx,
+                  unsigned int cy,
+                  unsigned int w,
+                  unsigned int h,
+                  unsigned int s,
+                  unsigned int e)
+{
+    pdfArc(getPdfCtx(ctx), cx, cy, w, h, s, e, true);
+}
+
+
+void PdfSetPen(struct ADrawTag *ctx,
+               ADrawColour      col)
+{
+    PdfContext *context = getPdfCtx(ctx);
+
+    assert(col != ADRAW_COL_INVALID);
+
+    context->penColour = col;
+}
+
+
+void PdfSetBgPen(struct ADrawTag *ctx,
+                 ADrawColour      col)
+{
+    PdfContext *context = getPdfCtx(ctx);
+
+    context->penBgColour = col;
+}
+
+
+void PdfSetFontSize(struct ADrawTag *ctx,
+                    ADrawFontSize    size)
+{
+    PdfContext *context = getPdfCtx(ctx);
+
+    context->fontPoints = getFontPoints(size);
+}
+
+
+bool PdfClose(struct ADrawTag *ctx)
+{
+    PdfContext   *context = getPdfCtx(ctx);
+    const float   pw = context->w * PDF_OUT_SCALE;
+    unsigned int  nObjs = PDF_OBJ_PAGE + context->nPages * 2, p, top;
+    unsigned long xref;
+    bool          ok;
+
+    /* Finish the chart content */
+    pdfEndPath(context);
+    pdfFlush(context);
+    pdfDeflate(context, NULL, 0, Z_FINISH);
+    deflateEnd(&context->z);
+
+    pdfRawf(context, "\nendstream\nendobj\n");
+
+    pdfBeginObj(context, PDF_OBJ_LENGTH);
+    pdfRawf(context, "%lu\nendobj\n", context->streamLen);
+
+    pdfBeginObj(context, PDF_OBJ_FONT);
+    pdfRawf(context, "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica"
+                     " /Encoding /WinAnsiEncoding >>\nendobj\n");
+
+    /* Each page shows its rows of the chart, clipped to the page */
+    for(p = 0, top = 0; p < context->nPages; p++)
+    {
+        const unsigned int ph = context->pageEnd[p] + 1 - top;
+        char               content[128];
+        int                len;
+
+        len = snprintf(content, sizeof(content),
+                       "q %g 0 0 %g 0 0 cm 0 0 %u %u re W n 1 0 0 1 0 %d cm /X1 Do Q\n",
+                       PDF_OUT_SCALE, PDF_OUT_SCALE, context->w, ph,
+                       -(int)(context->h - (top + ph)));
+
+        pdfBeginObj(context, PDF_OBJ_PAGE + p * 2);
+        pdfRawf(context, "<< /Type /Page /Parent %u 0 R /MediaBox [0 0 %.2f %.2f]\n"
+                         "   /Resources << /XObject << /X1 %u 0 R >> >>\n"
+                         "   /Contents %u 0 R >>\nendobj\n",
+                PDF_OBJ_PAGES, pw, ph * PDF_OUT_SCALE,
+                PDF_OBJ_CHART, PDF_OBJ_PAGE + p * 2 + 1);
+
+        pdfBeginObj(context, PDF_OBJ_PAGE + p * 2 + 1);
+        pdfRawf(context, "<< /Length %d >>\nstream\n%sendstream\nendobj\n", len, content);
+
+        top = context->pageEnd[p] + 1;
+    }
+
+    pdfBeginObj(context, PDF_OBJ_PAGES);
+    pdfRawf(context, "<< /Type /Pages /Count %u /Kids [", context->nPages);
+    for(p = 0; p < context->nPages; p++)
+    {
+        pdfRawf(context, " %u 0 R", PDF_OBJ_PAGE + p * 2);
+    }
+    pdfRawf(context, " ] >>\nendobj\n");
+
+    pdfBeginObj(context, PDF_OBJ_CATALOG);
+    pdfRawf(context, "<< /Type /Catalog /Pages %u 0 R >>\nendobj\n", PDF_OBJ_PAGES);
+
+    /* Cross-reference table, whose entries must each be 20 bytes */
+    xref = context->offset;
+    pdfRawf(context, "xref\n0 %u\n0000000000 65535 f \n", nObjs);
+    for(p = 1; p < nObjs; p++)
+    {
+        pdfRawf(context, "%010lu 00000 n \n", context->objOffset[p]);
+    }
+
+    pdfRawf(context, "trailer\n<< /Size %u /Root %u 0 R >>\n"
+                     "startxref\n%lu\n%%%%EOF\n", nObjs, PDF_OBJ_CATALOG, xref);
+
+    ok = !context->failed;
+
+    /* Free and destroy context */
+    free(context->objOffset);
+    free(context->pageEnd);
+    free(context);
+    ctx->internal = NULL;
+
+    return ok;
+}
+
+
+bool PdfInit(unsigned int     w,
+             unsigned int     h,
+             Sink             out,
+             const ADrawOpts *opts,
+             struct ADrawTag *outContext)
+{
+    PdfContext  *context;
+    unsigned int nPages = 1;
+
+    if(opts != NULL && opts->pdfPageEnd != NULL)
+    {
+        nPages = opts->nPdfPages;
+    }
+
+    /* Create context */
+    context = outContext->internal = malloc(sizeof(PdfContext));
+    if(context == NULL)
+    {
+        fprintf(stderr, "PdfInit: Failed to allocate context\n");
+        return false;
+    }
+
+    context->objOffset = malloc(sizeof(unsigned long) * (PDF_OBJ_PAGE + nPages * 2));
+    context->pageEnd   = malloc(sizeof(unsigned int) * nPages);
+    if(context->objOffset == NULL || context->pageEnd == NULL)
+    {
+        fprintf(stderr, "PdfInit: Failed to allocate context\n");
+        free(context->objOffset);
+        free(context->pageEnd);
+        free(context);
+        outContext->internal = NULL;
+        return false;
+    }
+
+    memset(&context->z, 0, sizeof(context->z));
+    if(deflateInit(&context->z, Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        fprintf(stderr, "PdfInit: Failed to initialise zlib\n");
+        free(context->objOffset);
+        free(context->pageEnd);
+        free(context);
+        outContext->internal = NULL;
+        return false;
+    }
+
+    /* The whole chart is one page unless split by the caller */
+    if(opts != NULL && opts->pdfPageEnd != NULL)
+    {
+        memcpy(context->pageEnd, opts->pdfPageEnd, sizeof(unsigned int) * nPages);
+    }
+    else
+    {
+        context->pageEnd[0] = h - 1;
+    }
+
+    context->out          = out;
+    context->failed       = false;
+    context->offset       = 0;
+    context->w            = w;
+    context->h            = h;
+    context->nPages       = nPages;
+    context->bufLen       = 0;
+    context->streamLen    = 0;
+    context->textPoints   = 0;
+    context->strokeColour = ADRAW_COL_BLACK;
+    context->fillColour   = ADRAW_COL_BLACK;
+    context->dashed       = false;
+    context->pathOpen     = false;
+
+    /* Set the current pen colours and font */
+    PdfSetPen(outContext, ADRAW_COL_BLACK);
+    PdfSetBgPen(outContext, ADRAW_COL_WHITE);
+    PdfSetFontSize(outContext, ADRAW_FONT_SMALL);
+
+    /* Write the header, marked as binary by the second line */
+    pdfRawf(context, "%%PDF-1.4\n%%\xe2\xe3\xcf\xd3\n");
+
+    /* Start the chart, whose content is written as it is drawn */
+    pdfBeginObj(context, PDF_OBJ_CHART);
+    pdfRawf(context, "<< /Type /XObject /Subtype /Form /BBox [0 0 %u %u]\n"
+                     "   /Resources << /Font << /F1 %u 0 R >> >>\n"
+                     "   /Filter /FlateDecode /Length %u 0 R >>\nstream\n",
+            w, h, PDF_OBJ_FONT, PDF_OBJ_LENGTH);
+
+    /* Now fill in the function pointers */
+    outContext->line            = PdfLine;
+    outContext->dottedLine      = PdfDottedLine;
+    outContext->textL           = PdfTextL;
+    outContext->textC           = PdfTextC;
+    outContext->textR           = PdfTextR;
+    outContext->textWidth       = PdfTextWidth;
+    outContext->textHeight      = PdfTextHeight;
+    outContext->filledRectangle = PdfFilledRectangle;
+    outContext->filledTriangle  = PdfFilledTriangle;
+    outContext->filledCircle    = PdfFilledCircle;
+    outContext->arc             = PdfArc;
+    outContext->dottedArc       = PdfDottedArc;
+    outContext->setPen          = PdfSetPen;
+    outContext->setBgPen        = PdfSetBgPen;
+    outContext->setFontSize     = PdfSetFontSize;
+    outContext->close           = PdfClose;
+
+    return true;
+}
+
+
+static unsigned int PdfMetricsTextWidth(ADrawMetrics *ctx, const char *string)
+{
+    return measureWidth(((PdfMetrics *)ctx->internal)->fontPoints, string);
+}
+
+
+static int PdfMetricsTextHeight(ADrawMetrics *ctx)
+{
+    return pointSpace(((PdfMetrics *)ctx->internal)->fontPoints,
+                      PdfHelvetica.ascender - PdfHelvetica.descender);
+}
+
+
+static void PdfMetricsSetFontSize(ADrawMetrics *ctx, ADrawFontSize size)
+{
+    ((PdfMetrics *)ctx->internal)->fontPoints = getFontPoints(size);
+}
+
+
+static bool PdfMetricsClose(ADrawMetrics *ctx)
+{
+    free(ctx->internal);
+    ctx->internal = NULL;
+
+    return true;
+}
+
+
+bool PdfMetricsInit(ADrawMetrics *outMetrics)
+{
+    PdfMetrics *metrics;
+
+    metrics = outMetrics->internal = malloc(sizeof(PdfMetrics));
+    if(metrics == NULL)
+    {
+        fprintf(stderr, "PdfMetricsInit: Failed to allocate context\n");
+        return false;
+    }
+
+    metrics->fontPoints = getFontPoints(ADRAW_FONT_SMALL);
+
+    outMetrics->textWidth   = PdfMetricsTextWidth;
+    outMetrics->textHeight  = PdfMetricsTextHeight;
+    outMetrics->setFontSize = PdfMetricsSetFontSize;
+    outMetrics->close       = PdfMetricsClose;
+
+    return true;
+}
+
+/* END OF FILE */
@@ -0,0 +1,516 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * PNG encoder.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifndef REMOVE_PNG_OUTPUT
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <zlib.h>
+#include "pngenc.h"
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/** Largest IDAT chunk written, and the size of the compressed data buffer. */
+#define PNGENC_IDAT_SIZE  65536
+
+/** Number of filters defined by the PNG specification. */
+#define PNGENC_NUM_FILTERS 5
+
+#define M_Min(a, b) (((a) < (b)) ? (a) : (b))
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+struct PngEncTag
+{
+    Sink           out;
+
+    /** Set if an error has occurred. */
+    bool           failed;
+
+    z_stream       z;
+
+    unsigned int   w, h;
+
+    /** Count of rows written so far. */
+    unsigned int   y;
+
+    /** Bits per pixel for palette images, or 8 for RGB. */
+    unsigned int   bitDepth;
+
+    /** Bytes in each row of the image, excluding the filter type. */
+    size_t         rowBytes;
+
+    /** Bytes per pixel, rounded up to 1, as used by the filters. */
+    unsigned int   bpp;
+
+    PngEncFilter   filter;
+
+    /** The previous and current rows, before filtering. */
+    unsigned char *prev, *cur;
+
+    /** Filtered rows, each starting with the filter type. */
+    unsigned char *filtered[PNGENC_NUM_FILTERS];
+
+    /** Compressed data waiting to be written as an IDAT chunk. */
+    unsigned char  idat[PNGENC_IDAT_SIZE];
+};
+
+/*****************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+/** Store a 32 bit value in network byte order.
+ */
+static void putU32(unsigned char *b, unsigned long v)
+{
+    b[0] = (v >> 24) & 0xff;
+    b[1] = (v >> 16) & 0xff;
+    b[2] = (v >>  8) & 0xff;
+    b[3] = (v >>  0) & 0xff;
+}
+
+
+/** Write a complete chunk.
+ */
+static void writeChunk(PngEnc               e,
+                       const char          *type,
+                       const unsigned char *data,
+                       size_t               len)
+{
+    unsigned char b[8];
+    uLong         crc;
+
+    putU32(&b[0], len);
+    memcpy(&b[4], type, 4);
+
+    /* crc32() returns 0 if passed NULL, so only add data if there is some */
+    crc = crc32(0, Z_NULL, 0);
+    crc = crc32(crc, &b[4], 4);
+    if(len > 0)
+    {
+        crc = crc32(crc, data, len);
+    }
+
+    if(!SinkWrite(e->out, b, 8) || !SinkWrite(e->out, data, len))
+    {
+        e->failed = true;
+    }
+
+    putU32(b, crc);
+    if(!SinkWrite(e->out, b, 4))
+    {
+        e->failed = true;
+    }
+}
+
+
+/** Write any compressed data as an IDAT chunk.
+ */
+static void writeIdat(PngEnc e)
+{
+    const size_t len = PNGENC_IDAT_SIZE - e->z.avail_out;
+
+    if(len > 0)
+    {
+        writeChunk(e, "IDAT", e->idat, len);
+    }
+
+    e->z.next_out  = e->idat;
+    e->z.avail_out = PNGENC_IDAT_SIZE;
+}
+
+
+/** Compress some data, writing IDAT chunks as the buffer fills.
+ */
+static void deflateData(PngEnc e, unsigned char *data, size_t len, int flush)
+{
+    e->z.next_in  = data;
+    e->z.avail_in = len;
+
+    for(;;)
+    {
+        int r = deflate(&e->z, flush);
+
+        if(r == Z_STREAM_ERROR)
+        {
+            e->failed = true;
+            return;
+        }
+
+        if(e->z.avail_out == 0)
+        {
+            writeIdat(e);
+        }
+        else if(flush == Z_FINISH ? r == Z_STREAM_END : e->z.avail_in == 0)
+        {
+            return;
+        }
+        else if(r == Z_BUF_ERROR)
+        {
+            e->failed = true;
+            return;
+        }
+    }
+}
+
+
+/** The Paeth predictor from the PNG specification.
+ */
+static unsigned char paeth(int a, int b, int c)
+{
+    const int p  = a + b - c;
+    const int pa = abs(p - a);
+    const int pb = abs(p - b);
+    const int pc = abs(p - c);
+
+    if(pa <= pb && pa <= pc)
+    {
+        return a;
+    }
+    else if(pb <= pc)
+    {
+        return b;
+    }
+    else
+    {
+        return c;
+    }
+}
+
+
+/** Cost of a filtered byte, taken as signed, for picking filters. */
+#define FILTER_COST(v) ((v) < 128 ? (v) : 256 - (v))
+
+/** Apply one filter to the current row, measuring the result.
+ * The cost is the sum of the filtered bytes taken as signed values, which
+ * is the heuristic suggested by the PNG specification.  Filtering stops
+ * early once the cost reaches \a limit, since the row then can't be the
+ * best, leaving \a out incomplete.
+ *
+ * \param[in]  e       The encoder, giving the current and previous rows.
+ * \param[in]  filter  The filter to apply.
+ * \param[out] out     Buffer for the filter type and filtered row.
+ * \param[in]  limit   Cost at which to give up.
+ * \returns  The cost of the filtered row, or at least \a limit.
+ */
+static unsigned long filterRow(PngEnc         e,
+                               PngEncFilter   filter,
+                               unsigned char *out,
+                               unsigned long  limit)
+{
+    const unsigned char *cur = e->cur, *prev = e->prev;
+    const size_t         n   = e->rowBytes;
+    const size_t         bpp = M_Min(e->bpp, n);
+    unsigned long        sum = 0;
+    unsigned char        v;
+    size_t               t;
+
+    *out++ = filter;
+
+    /* The first pixel has no left neighbour, which is taken as 0 */
+    switch(filter)
+    {
+        case PNGENC_FILTER_NONE:
+            for(t = 0; t < n && sum < limit; t++)
+            {
+                v = out[t] = cur[t];
+                sum += FILTER_COST(v);
+            }
+            break;
+
+        case PNGENC_FILTER_SUB:
+            for(t = 0; t < bpp; t++)
+            {
+                v = out[t] = cur[t];
+                sum += FILTER_COST(v);
+            }
+            for(t = bpp; t < n && sum < limit; t++)
+            {
+                v = out[t] = cur[t] - cur[t - bpp];
+                sum += FILTER_COST(v);
+            }
+            break;
+
+        case PNGENC_FILTER_UP:
+            for(t = 0; t < n && sum < limit; t++)
+            {
+                v = out[t] = cur[t] - prev[t];
+                sum += FILTER_COST(v);
+            }
+            break;
+
+        case PNGENC_FILTER_AVERAGE:
+            for(t = 0; t < bpp; t++)
+            {
+                v = out[t] = cur[t] - (prev[t] / 2);
+                sum += FILTER_COST(v);
+            }
+            for(t = bpp; t < n && sum < limit; t++)
+            {
+                v = out[t] = cur[t] - ((cur[t - bpp] + prev[t]) / 2);
+                sum += FILTER_COST(v);
+            }
+            break;
+
+        case PNGENC_FILTER_PAETH:
+            for(t = 0; t < bpp; t++)
+            {
+                v = out[t] = cur[t] - prev[t];
+                sum += FILTER_COST(v);
+            }
+            for(t = bpp; t < n && sum < limit; t++)
+            {
+                v = out[t] = cur[t] - paeth(cur[t - bpp], prev[t], prev[t - bpp]);
+                sum += FILTER_COST(v);
+            }
+            break;
+
+        default:
+            assert(0);
+    }
+
+    return sum;
+}
+
+
+/** Free an encoder and its buffers.
+ */
+static void freeEnc(PngEnc e)
+{
+    unsigned int t;
+
+    for(t = 0; t < PNGENC_NUM_FILTERS; t++)
+    {
+        free(e->filtered[t]);
+    }
+
+    free(e->prev);
+    free(e->cur);
+    free(e);
+}
+
+/*****************************************************************************
+ * Global Functions
+ *****************************************************************************/
+
+PngEnc PngEncCreate(Sink                 out,
+                    unsigned int         w,
+                    unsigned int         h,
+                    const unsigned char *palette,
+                    unsigned int         nColours,
+                    int                  level,
+                    PngEncFilter         filter)
+{
+    unsigned char hdr[13];
+    unsigned int  nBuffers, t;
+    PngEnc        e;
+
+    assert(out != NULL); assert(w > 0); assert(h > 0);
+    assert(palette == NULL || (nColours > 0 && nColours <= PNGENC_MAX_COLOURS));
+
+    e = calloc(1, sizeof(struct PngEncTag));
+    if(e == NULL)
+    {
+        fprintf(stderr, "PngEncCreate: Failed to allocate encoder\n");
+        return NULL;
+    }
+
+    e->out    = out;
+    e->w      = w;
+    e->h      = h;
+    e->filter = filter;
+
+    /* Use the fewest bits per pixel that can index the palette */
+    if(palette != NULL)
+    {
+        e->bitDepth = nColours <= 2 ? 1 : nColours <= 4 ? 2 : nColours <= 16 ? 4 : 8;
+        e->rowBytes = ((size_t)w * e->bitDepth + 7) / 8;
+        e->bpp      = 1;
+    }
+    else
+    {
+        e->bitDepth = 8;
+        e->rowBytes = (size_t)w * 3;
+        e->bpp      = 3;
+    }
+
+    /* Only the adaptive filter needs a buffer for every filter */
+    nBuffers = filter == PNGENC_FILTER_ADAPTIVE ? PNGENC_NUM_FILTERS : 1;
+
+    e->prev = calloc(1, e->rowBytes);
+    e->cur  = malloc(e->rowBytes);
+    for(t = 0; t < nBuffers; t++)
+    {
+        e->filtered[t] = malloc(e->rowBytes + 1);
+        if(e->filtered[t] == NULL)
+        {
+            break;
+        }
+    }
+
+    if(e->prev == NULL || e->cur == NULL || t < nBuffers)
+    {
+        fprintf(stderr, "PngEncCreate: Failed to allocate %u byte rows\n", (unsigned int)e->rowBytes);
+        freeEnc(e);
+        return NULL;
+    }
+
+    /* Filtered data compresses better favouring Huffman coding over matches */
+    if(deflateInit2(&e->z, level, Z_DEFLATED, 15, 8,
+                    filter == PNGENC_FILTER_NONE ? Z_DEFAULT_STRATEGY : Z_FILTERED) != Z_OK)
+    {
+        fprintf(stderr, "PngEncCreate: Failed to initialise zlib\n");
+        freeEnc(e);
+        return NULL;
+    }
+
+    e->z.next_out  = e->idat;
+    e->z.avail_out = PNGENC_IDAT_SIZE;
+
+    /* Signature and header */
+    if(!SinkWrite(out, "\x89PNG\r\n\x1a\n", 8))
+    {
+        e->failed = true;
+    }
+
+    putU32(&hdr[0], w);
+    putU32(&hdr[4], h);
+    hdr[8]  = e->bitDepth;
+    hdr[9]  = palette != NULL ? 3 : 2;   /* Colour type: indexed or RGB */
+    hdr[10] = 0;                         /* Deflate compression */
+    hdr[11] = 0;                         /* Adaptive filtering */
+    hdr[12] = 0;                         /* No interlace */
+    writeChunk(e, "IHDR", hdr, sizeof(hdr));
+
+    if(palette != NULL)
+    {
+        writeChunk(e, "PLTE", palette, nColours * 3);
+    }
+
+    return e;
+}
+
+
+bool PngEncRow(PngEnc e, const unsigned char *row)
+{
+    unsigned char *best;
+    unsigned char *swap;
+
+    assert(e->y < e->h);
+
+    /* Pack palette indices into bytes, most significant bits first */
+    if(e->bitDepth < 8)
+    {
+        const unsigned int perByte = 8 / e->bitDepth;
+        unsigned int       x;
+
+        memset(e->cur, 0, e->rowBytes);
+        for(x = 0; x < e->w; x++)
+        {
+            const unsigned int shift = 8 - e->bitDepth * ((x % perByte) + 1);
+
+            e->cur[x / perByte] |= row[x] << shift;
+        }
+    }
+    else
+    {
+        memcpy(e->cur, row, e->rowBytes);
+    }
+
+    if(e->filter == PNGENC_FILTER_ADAPTIVE)
+    {
+        unsigned long bestCost = ULONG_MAX;
+        unsigned int  t;
+
+        /* Try each filter in turn, stopping if a row filters to nothing */
+        best = NULL;
+        for(t = 0; t < PNGENC_NUM_FILTERS && bestCost > 0; t++)
+        {
+            const unsigned long cost = filterRow(e, t, e->filtered[t], bestCost);
+
+            if(cost < bestCost)
+            {
+                best     = e->filtered[t];
+                bestCost = cost;
+            }
+        }
+    }
+    else
+    {
+        best = e->filtered[0];
+        filterRow(e, e->filter, best, ULONG_MAX);
+    }
+
+    deflateData(e, best, e->rowBytes + 1, Z_NO_FLUSH);
+
+    /* The current row becomes the previous */
+    swap    = e->prev;
+    e->prev = e->cur;
+    e->cur  = swap;
+
+    e->y++;
+
+    return !e->failed;
+}
+
+
+bool PngEncFinish(PngEnc e)
+{
+    bool ok;
+
+    if(e->y < e->h)
+    {
+        fprintf(stderr, "PngEncFinish: Only %u of %u rows written\n", e->y, e->h);
+        e->failed = true;
+    }
+    else
+    {
+        deflateData(e, NULL, 0, Z_FINISH);
+        writeIdat(e);
+        writeChunk(e, "IEND", NULL, 0);
+    }
+
+    deflateEnd(&e->z);
+
+    ok = !e->failed;
+    freeEnc(e);
+
+    return ok;
+}
+
+#endif /* REMOVE_PNG_OUTPUT */
+
+/* END OF FILE */
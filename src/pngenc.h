@@ -0,0 +1,116 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * PNG encoder.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+
+#ifndef PNGENC_H
+#define PNGENC_H
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "sink.h"
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/** Maximum number of colours in a palette image. */
+#define PNGENC_MAX_COLOURS 256
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/** Row filters, as defined by the PNG specification.
+ */
+typedef enum PngEncFilterTag
+{
+    PNGENC_FILTER_NONE = 0,
+    PNGENC_FILTER_SUB,
+    PNGENC_FILTER_UP,
+    PNGENC_FILTER_AVERAGE,
+    PNGENC_FILTER_PAETH,
+
+    /** Pick the filter for each row that gives the smallest sum of
+     * absolute differences, as recommended by the specification.
+     */
+    PNGENC_FILTER_ADAPTIVE
+}
+PngEncFilter;
+
+/** An encoder writing a PNG image one row at a time.
+ * Rows are compressed and written as they are given, so the image need
+ * never be held in memory as a whole.
+ */
+typedef struct PngEncTag *PngEnc;
+
+/*****************************************************************************
+ * Global Variable Declarations
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Global Function Declarations
+ *****************************************************************************/
+
+/** Start writing a PNG image.
+ * The image is either 8 bit RGB, or if \a palette is given, an indexed
+ * colour image using the fewest bits per pixel that can index the palette.
+ *
+ * \param[in] out       The sink to write to.
+ * \param[in] w, h      The image dimensions, which must be non-zero.
+ * \param[in] palette   RGB triples for each palette colour, or NULL.
+ * \param[in] nColours  The number of colours in \a palette.
+ * \param[in] level     zlib compression level from 0 to 9, or -1 for the
+ *                       zlib default.
+ * \param[in] filter    The row filter to use.
+ * \returns  The encoder, or NULL on error.
+ */
+PngEnc PngEncCreate(Sink                 out,
+                    unsigned int         w,
+                    unsigned int         h,
+                    const unsigned char *palette,
+                    unsigned int         nColours,
+                    int                  level,
+                    PngEncFilter         filter);
+
+/** Write the next row of the image.
+ *
+ * \param[in] e    The encoder.
+ * \param[in] row  The pixels, as 3 bytes of RGB per pixel, or a byte per
+ *                  pixel giving the palette index.
+ * \retval false  If an error has occurred.
+ */
+bool PngEncRow(PngEnc e, const unsigned char *row);
+
+/** Finish writing the image and free the encoder.
+ * All rows must have been written for the image to be complete.
+ *
+ * \retval false  If any error occurred while encoding or writing.
+ */
+bool PngEncFinish(PngEnc e);
+
+#endif /* PNGENC_H */
+
+/* END OF FILE */
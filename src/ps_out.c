@@ -46,8 +46,8 @@
 
 typedef struct PsContextTag
 {
-    /** Output file. */
-    FILE        *of;
+    /** Output sink. */
+    Sink         out;
 
     /** Point size of the current font. */
     int          fontPoints;
@@ -60,6 +60,15 @@ typedef struct PsContextTag
 }
 PsContext;
 
+/** State for measuring text without producing output.
+ */
+typedef struct PsMetricsTag
+{
+    /** Point size of the current font. */
+    int          fontPoints;
+}
+PsMetrics;
+
 typedef struct
 {
     int capheight, xheight, ascender, descender;
@@ -122,11 +131,11 @@ static PsContext *getPsCtx(struct ADrawTag *ctx)
     return (PsContext *)ctx->internal;
 }
 
-/** Get the context pointer from an ADraw structure.
+/** Get the output sink from an ADraw structure.
  */
-static FILE *getPsFile(struct ADrawTag *ctx)
+static Sink getPsSink(struct ADrawTag *ctx)
 {
-    return getPsCtx(ctx)->of;
+    return getPsCtx(ctx)->out;
 }
 
 /** Given a font metric measurement, return device dependent units.
@@ -134,16 +143,65 @@ static FILE *getPsFile(struct ADrawTag *ctx)
  * needs to be multiplied by the font point size and divided by
  * 1000 to give a value in device dependent units.
  */
+static int pointSpace(int fontPoints, long thousanths)
+{
+    return ((thousanths * fontPoints) + 500) / 1000;
+}
+
+
+/** Given a font metric measurement, return device dependent units.
+ * This scales the measurement by the current font size of the context.
+ */
 static int getSpace(struct ADrawTag *ctx, long thousanths)
 {
-    return ((thousanths * getPsCtx(ctx)->fontPoints) + 500) / 1000;
+    return pointSpace(getPsCtx(ctx)->fontPoints, thousanths);
+}
+
+
+/** Get the point size of some font size.
+ */
+static int getFontPoints(ADrawFontSize size)
+{
+    switch(size)
+    {
+        case ADRAW_FONT_TINY:
+            return 8;
+
+        case ADRAW_FONT_SMALL:
+            return 12;
+
+        default:
+            assert(0);
+            return 12;
+    }
+}
+
+
+/** Measure the width of some text at some point size.
+ */
+static unsigned int measureWidth(int fontPoints, const char *string)
+{
+    unsigned long width = 0;
+
+    while(*string != '\0')
+    {
+        int           i = *string & 0xff;
+        unsigned long w = PsHelvetica.widths[i];
+
+        /* Ignore undefined characters */
+        width += w > 0 ? w : 0;
+
+        string++;
+    }
+
+    return pointSpace(fontPoints, width);
 }
 
 /** Write out a line of text, escaping special characters.
  */
 static void writeEscaped(struct ADrawTag *ctx, const char *string)
 {
-    FILE *f = getPsFile(ctx);
+    Sink f = getPsSink(ctx);
 
     while(*string != '\0')
     {
@@ -151,17 +209,17 @@ static void writeEscaped(struct ADrawTag *ctx, const char *string)
 
         switch(*string)
         {
-            case '(': fprintf(f, "\\("); break;
-            case ')': fprintf(f, "\\)"); break;
+            case '(': SinkPrintf(f, "\\("); break;
+            case ')': SinkPrintf(f, "\\)"); break;
             default:
                 if(Utf8Decode(string, &code, &bytes))
                 {
-                    fprintf(f, "\\%o", code);
+                    SinkPrintf(f, "\\%o", code);
                     string += bytes - 1;
                 }
                 else
                 {
-                    fputc(*string, f);
+                    SinkWrite(f, string, 1);
                 }
                 break;
         }
@@ -186,7 +244,7 @@ static void setColour(struct ADrawTag *ctx,
     b /= 255.0f;
 
     /* Generate output command */
-    fprintf(getPsFile(ctx), "%f %f %f setrgbcolor\n", r ,g ,b);
+    SinkPrintf(getPsSink(ctx), "%f %f %f setrgbcolor\n", r ,g ,b);
 }
 
 /***************************************************************************
@@ -196,20 +254,7 @@ static void setColour(struct ADrawTag *ctx,
 unsigned int PsTextWidth(struct ADrawTag *ctx,
                           const char *string)
 {
-    unsigned long width = 0;
-
-    while(*string != '\0')
-    {
-        int           i = *string & 0xff;
-        unsigned long w = PsHelvetica.widths[i];
-
-        /* Ignore undefined characters */
-        width += w > 0 ? w : 0;
-
-        string++;
-    }
-
-    return getSpace(ctx, width);
+    return measureWidth(getPsCtx(ctx)->fontPoints, string);
 }
 
 
@@ -225,7 +270,7 @@ void PsLine(struct ADrawTag *ctx,
              unsigned int     x2,
              unsigned int     y2)
 {
-    fprintf(getPsFile(ctx),
+    SinkPrintf(getPsSink(ctx),
             "newpath %d %d moveto %d %d lineto stroke\n",
             x1, -y1, x2, -y2);
 
@@ -238,9 +283,9 @@ void PsDottedLine(struct ADrawTag *ctx,
                    unsigned int     x2,
                    unsigned int     y2)
 {
-    fprintf(getPsFile(ctx), "[2] 0 setdash\n");
+    SinkPrintf(getPsSink(ctx), "[2] 0 setdash\n");
     PsLine(ctx, x1, y1, x2, y2);
-    fprintf(getPsFile(ctx), "[] 0 setdash\n");
+    SinkPrintf(getPsSink(ctx), "[] 0 setdash\n");
 }
 
 
@@ -250,7 +295,7 @@ void PsFilledRectangle(struct ADrawTag *ctx,
                        unsigned int     x2,
                        unsigned int     y2)
 {
-    fprintf(getPsFile(ctx),
+    SinkPrintf(getPsSink(ctx),
             "newpath "
             "%d %d moveto "
             "%d %d lineto "
@@ -274,27 +319,27 @@ void PsTextR(struct ADrawTag *ctx,
     PsContext *context = getPsCtx(ctx);
 
     /* Push the string and get its width */
-    fprintf(getPsFile(ctx), "(");
+    SinkPrintf(getPsSink(ctx), "(");
     writeEscaped(ctx, string);
-    fprintf(getPsFile(ctx), ") dup stringwidth\n");
+    SinkPrintf(getPsSink(ctx), ") dup stringwidth\n");
 
     /* Draw the background box */
     setColour(ctx, context->penBgColour);
-    fprintf(getPsFile(ctx), "pop "                /* Ignore y-value */
-                            "dup "                /* Duplicate string width */
-                            "newpath "
-                            "%d %d moveto "       /* Bottom left of the box */
-                            "0 rlineto "          /* Move to bottom right of the box */
-                            "0 %d rlineto "       /* To top right */
-                            "neg 0 rlineto "      /* Back to bottom left */
-                            "closepath fill\n",   /* Done */
-                            x, -y - getSpace(ctx, PsHelvetica.descender),
-                            getSpace(ctx, PsHelvetica.ascender));
+    SinkPrintf(getPsSink(ctx), "pop "                /* Ignore y-value */
+                               "dup "                /* Duplicate string width */
+                               "newpath "
+                               "%d %d moveto "       /* Bottom left of the box */
+                               "0 rlineto "          /* Move to bottom right of the box */
+                               "0 %d rlineto "       /* To top right */
+                               "neg 0 rlineto "      /* Back to bottom left */
+                               "closepath fill\n",   /* Done */
+                               x, -y - getSpace(ctx, PsHelvetica.descender),
+                               getSpace(ctx, PsHelvetica.ascender));
 
     /* Restore pen and show the string */
     setColour(ctx, context->penColour);
-    fprintf(getPsFile(ctx), "%d %d moveto show\n",
-                             x, -y - getSpace(ctx, PsHelvetica.descender));
+    SinkPrintf(getPsSink(ctx), "%d %d moveto show\n",
+                                x, -y - getSpace(ctx, PsHelvetica.descender));
 }
 
 
@@ -311,12 +356,12 @@ void PsTextL(struct ADrawTag *ctx,
     PsFilledRectangle(ctx, x, -y, x + 10, -y + 10);
     setColour(ctx, context->penColour);
 
-    fprintf(getPsFile(ctx),
+    SinkPrintf(getPsSink(ctx),
             "%d %d moveto "
             "(",
             x, -y - getSpace(ctx, PsHelvetica.descender));
     writeEscaped(ctx, string);
-    fprintf(getPsFile(ctx),
+    SinkPrintf(getPsSink(ctx),
             ") dup stringwidth "
             "pop "  /* Ignore y value */
             "neg "  /* Invert x value */
@@ -335,28 +380,28 @@ void PsTextC(struct ADrawTag *ctx,
     PsContext *context = getPsCtx(ctx);
 
     /* Push the string and get its width */
-    fprintf(getPsFile(ctx), "(");
+    SinkPrintf(getPsSink(ctx), "(");
     writeEscaped(ctx, string);
-    fprintf(getPsFile(ctx), ") dup stringwidth\n");
+    SinkPrintf(getPsSink(ctx), ") dup stringwidth\n");
 
     /* Draw the background box */
     setColour(ctx, context->penBgColour);
-    fprintf(getPsFile(ctx), "pop "                     /* Ignore y-value */
-                            "dup dup "                 /* Duplicate string width twice */
-                            "newpath "
-                            "%d %d moveto "            /* Starting point, centre bottom of box */
-                            "2 div neg 0 rmoveto "     /* Move to bottom left */
-                            "0 rlineto "               /* Move to bottom right of the box */
-                            "0 %d rlineto "            /* To top right */
-                            "neg 0 rlineto "           /* Back to bottom left */
-                            "closepath fill\n",        /* Done */
-                            x, -y,
-                            getSpace(ctx, PsHelvetica.ascender));
+    SinkPrintf(getPsSink(ctx), "pop "                     /* Ignore y-value */
+                               "dup dup "                 /* Duplicate string width twice */
+                               "newpath "
+                               "%d %d moveto "            /* Starting point, centre bottom of box */
+                               "2 div neg 0 rmoveto "     /* Move to bottom left */
+                               "0 rlineto "               /* Move to bottom right of the box */
+                               "0 %d rlineto "            /* To top right */
+                               "neg 0 rlineto "           /* Back to bottom left */
+                               "closepath fill\n",        /* Done */
+                               x, -y,
+                               getSpace(ctx, PsHelvetica.ascender));
 
     /* Restore pen and show the string */
     setColour(ctx, context->penColour);
-    fprintf(getPsFile(ctx), "%d %d moveto dup stringwidth pop 2 div neg 0 rmoveto show\n",
-                             x, -y - getSpace(ctx, PsHelvetica.descender));
+    SinkPrintf(getPsSink(ctx), "%d %d moveto dup stringwidth pop 2 div neg 0 rmoveto show\n",
+                                x, -y - getSpace(ctx, PsHelvetica.descender));
 }
 
 
@@ -368,7 +413,7 @@ void PsFilledTriangle(struct ADrawTag *ctx,
                        unsigned int x3,
                        unsigned int y3)
 {
-    fprintf(getPsFile(ctx),
+    SinkPrintf(getPsSink(ctx),
             "newpath "
             "%d %d moveto "
             "%d %d lineto "
@@ -386,7 +431,7 @@ void PsFilledCircle(struct ADrawTag *ctx,
                      unsigned int y,
                      unsigned int r)
 {
-    fprintf(getPsFile(ctx),
+    SinkPrintf(getPsSink(ctx),
             "newpath "
             "%d %d %d 0 360 arc "
             "closepath "
@@ -403,7 +448,7 @@ void PsArc(struct ADrawTag *ctx,
             unsigned int s,
             unsigned int e)
 {
-    fprintf(getPsFile(ctx),
+    SinkPrintf(getPsSink(ctx),
             "newpath "
             "%d %d %d %d %d %d ellipse "
             "stroke\n",
@@ -419,9 +464,9 @@ void PsDottedArc(struct ADrawTag *ctx,
                   unsigned int s,
                   unsigned int e)
 {
-    fprintf(getPsFile(ctx), "[2] 0 setdash\n");
+    SinkPrintf(getPsSink(ctx), "[2] 0 setdash\n");
     PsArc(ctx, cx, cy, w, h, s, e);
-    fprintf(getPsFile(ctx), "[] 0 setdash\n");
+    SinkPrintf(getPsSink(ctx), "[] 0 setdash\n");
 }
 
 
@@ -457,23 +502,11 @@ void PsSetFontSize(struct ADrawTag *ctx,
 {
     PsContext *context = getPsCtx(ctx);
 
-    switch(size)
-    {
-        case ADRAW_FONT_TINY:
-            getPsCtx(ctx)->fontPoints = 8;
-            break;
-
-        case ADRAW_FONT_SMALL:
-            getPsCtx(ctx)->fontPoints = 12;
-            break;
+    context->fontPoints = getFontPoints(size);
 
-        default:
-            assert(0);
-    }
-
-    fprintf(context->of, "/Helvetica findfont\n");
-    fprintf(context->of, "%d scalefont\n", getPsCtx(ctx)->fontPoints);
-    fprintf(context->of, "setfont\n");
+    SinkPrintf(context->out, "/Helvetica findfont\n");
+    SinkPrintf(context->out, "%d scalefont\n", getPsCtx(ctx)->fontPoints);
+    SinkPrintf(context->out, "setfont\n");
 }
 
 
@@ -481,12 +514,6 @@ bool PsClose(struct ADrawTag *ctx)
 {
     PsContext *context = getPsCtx(ctx);
 
-    /* Close the output file */
-    if(context->of != stdout)
-    {
-        fclose(context->of);
-    }
-
     /* Free and destroy context */
     free(context);
     ctx->internal = NULL;
@@ -497,79 +524,67 @@ bool PsClose(struct ADrawTag *ctx)
 
 bool PsInit(unsigned int     w,
             unsigned int     h,
-            const char      *file,
+            Sink             out,
             struct ADrawTag *outContext)
 {
     PsContext *context;
 
     /* Create context */
-    context = outContext->internal = malloc_s(sizeof(PsContext));
+    context = outContext->internal = malloc(sizeof(PsContext));
     if(context == NULL)
     {
+        fprintf(stderr, "PsInit: Failed to allocate context\n");
         return false;
     }
 
-    /* Open the output file */
-    if(strcmp(file, "-") == 0)
-    {
-        context->of = stdout;
-    }
-    else
-    {
-        context->of = fopen(file, "wb");
-        if(!context->of)
-        {
-            fprintf(stderr, "PsInit: Failed to open output file '%s': %s\n", file, strerror(errno));
-            return false;
-        }
-    }
+    context->out = out;
 
     /* Write the header */
-    fprintf(context->of, "%%!PS-Adobe-3.0 EPSF-2.0\n"
-                         "%%%%BoundingBox: 0 0 %.0f %.0f\n", w * PS_OUT_SCALE, h * PS_OUT_SCALE);
-    fprintf(context->of, "%%%%Creator: mscgen %s\n", PACKAGE_VERSION);
-    fprintf(context->of, "%%%%EndComments\n");
+    SinkPrintf(context->out, "%%!PS-Adobe-3.0 EPSF-2.0\n"
+                             "%%%%BoundingBox: 0 0 %.0f %.0f\n", w * PS_OUT_SCALE, h * PS_OUT_SCALE);
+    SinkPrintf(context->out, "%%%%Creator: mscgen %s\n", PACKAGE_VERSION);
+    SinkPrintf(context->out, "%%%%EndComments\n");
 
     /* Shrink everything by 70% */
-    fprintf(context->of, "%f %f scale\n", PS_OUT_SCALE, PS_OUT_SCALE);
+    SinkPrintf(context->out, "%f %f scale\n", PS_OUT_SCALE, PS_OUT_SCALE);
 
     /* Create clipping rectangle to constrain dimensions */
-    fprintf(context->of, "0 0 moveto\n");
-    fprintf(context->of, "0 %u lineto\n", h);
-    fprintf(context->of, "%u %u lineto\n", w, h);
-    fprintf(context->of, "%u 0 lineto\n", w);
-    fprintf(context->of, "closepath\n");
-    fprintf(context->of, "clip\n");
-    fprintf(context->of, "%%PageTrailer\n");
-    fprintf(context->of, "%%Page: 1 1\n");
+    SinkPrintf(context->out, "0 0 moveto\n");
+    SinkPrintf(context->out, "0 %u lineto\n", h);
+    SinkPrintf(context->out, "%u %u lineto\n", w, h);
+    SinkPrintf(context->out, "%u 0 lineto\n", w);
+    SinkPrintf(context->out, "closepath\n");
+    SinkPrintf(context->out, "clip\n");
+    SinkPrintf(context->out, "%%PageTrailer\n");
+    SinkPrintf(context->out, "%%Page: 1 1\n");
 
     /* Set default font */
-    fprintf(context->of, "/Helvetica findfont\n");
-    fprintf(context->of, "10 scalefont\n");
-    fprintf(context->of, "setfont\n");
+    SinkPrintf(context->out, "/Helvetica findfont\n");
+    SinkPrintf(context->out, "10 scalefont\n");
+    SinkPrintf(context->out, "setfont\n");
 
     /* Get the default font size */
     PsSetFontSize(outContext, ADRAW_FONT_SMALL);
 
     /* Translate up by the height, y-axis will be inverted */
-    fprintf(context->of, "0 %d translate\n", h);
+    SinkPrintf(context->out, "0 %d translate\n", h);
 
     /* Arc drawing function */
-    fprintf(context->of, "/mtrx matrix def\n"
-                         "/ellipse\n"
-                         "  { /endangle exch def\n"
-                         "    /startangle exch def\n"
-                         "    /ydia exch def\n"
-                         "    /xdia exch def\n"
-                         "    /y exch def\n"
-                         "    /x exch def\n"
-                         "    /savematrix mtrx currentmatrix def\n"
-                         "    x y translate\n"
-                         "    xdia 2 div ydia 2 div scale\n"
-                         "    1 -1 scale\n"
-                         "    0 0 1 startangle endangle arc\n"
-                         "    savematrix setmatrix\n"
-                         "} def\n");
+    SinkPrintf(context->out, "/mtrx matrix def\n"
+                             "/ellipse\n"
+                             "  { /endangle exch def\n"
+                             "    /startangle exch def\n"
+                             "    /ydia exch def\n"
+                             "    /xdia exch def\n"
+                             "    /y exch def\n"
+                             "    /x exch def\n"
+                             "    /savematrix mtrx currentmatrix def\n"
+                             "    x y translate\n"
+                             "    xdia 2 div ydia 2 div scale\n"
+                             "    1 -1 scale\n"
+                             "    0 0 1 startangle endangle arc\n"
+                             "    savematrix setmatrix\n"
+                             "} def\n");
 
     /* Set the current pen colours */
     context->penColour = ADRAW_COL_BLACK;
@@ -596,4 +611,54 @@ bool PsInit(unsigned int     w,
     return true;
 }
 
+
+static unsigned int PsMetricsTextWidth(ADrawMetrics *ctx, const char *string)
+{
+    return measureWidth(((PsMetrics *)ctx->internal)->fontPoints, string);
+}
+
+
+static int PsMetricsTextHeight(ADrawMetrics *ctx)
+{
+    return pointSpace(((PsMetrics *)ctx->internal)->fontPoints,
+                      PsHelvetica.ascender - PsHelvetica.descender);
+}
+
+
+static void PsMetricsSetFontSize(ADrawMetrics *ctx, ADrawFontSize size)
+{
+    ((PsMetrics *)ctx->internal)->fontPoints = getFontPoints(size);
+}
+
+
+static bool PsMetricsClose(ADrawMetrics *ctx)
+{
+    free(ctx->internal);
+    ctx->internal = NULL;
+
+    return true;
+}
+
+
+bool PsMetricsInit(ADrawMetrics *outMetrics)
+{
+    PsMetrics *metrics;
+
+    metrics = outMetrics->internal = malloc(sizeof(PsMetrics));
+    if(metrics == NULL)
+    {
+        fprintf(stderr, "PsMetricsInit: Failed to allocate context\n");
+        return false;
+    }
+
+    metrics->fontPoints = getFontPoints(ADRAW_FONT_SMALL);
+
+    outMetrics->textWidth   = PsMetricsTextWidth;
+    outMetrics->textHeight  = PsMetricsTextHeight;
+    outMetrics->setFontSize = PsMetricsSetFontSize;
+    outMetrics->close       = PsMetricsClose;
+
+    return true;
+}
+
 /* END OF FILE */
@@ -0,0 +1,3647 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * This file is part of mscgen, a message sequence chart renderer.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+/***************************************************************************
+ * Include Files
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifdef  HAVE_LIMITS_H
+#include <limits.h>
+#endif
+#include <ctype.h>
+#include <assert.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include "adraw.h"
+#include "render.h"
+#include "msc.h"
+#include "arena.h"
+
+/***************************************************************************
+ * Macro definitions
+ ***************************************************************************/
+
+#define M_Max(a, b) (((a) > (b)) ? (a) : (b))
+#define M_Min(a, b) (((a) < (b)) ? (a) : (b))
+
+/** Rows in each band when a PNG is only drawn in bands so that several
+ * threads can share the drawing.
+ */
+#define PARALLEL_BAND_HEIGHT 256
+
+/** The most rows on a page of PDF output.  At the scale PDF is drawn this
+ * is a little less than the height of an A4 page.
+ */
+#define PDF_PAGE_HEIGHT 1150
+
+/***************************************************************************
+ * Types
+ ***************************************************************************/
+
+/** Structure for holding layout options.
+ * This structure groups all the options that affect the text output into
+ * one structure.
+ */
+typedef struct LayoutOptionsTag
+{
+    /** Ideal width of output canvas.
+     * If this value allows the entitySpacing to be increased, then
+     * entitySpacing will be set to the larger value of it's original
+     * value and idealCanvasWidth / number of entities.
+     */
+    unsigned int idealCanvasWidth;
+
+    /** Horizontal spacing between entities. */
+    unsigned int entitySpacing;
+
+    /** Gap at the top of the page. */
+    unsigned int entityHeadGap;
+
+    /** Vertical spacing between arcs. */
+    unsigned int arcSpacing;
+
+    /** Arc gradient.
+     * Y offset of arc head, relative to tail, in pixels.
+     */
+    int          arcGradient;
+
+    /** Gap between adjacent boxes. */
+    unsigned int boxSpacing;
+
+    /** Minimum distance between box edges and text. */
+    unsigned int boxInternalBorder;
+
+    /** Radius of rounded box corner arcs. */
+    unsigned int rboxArc;
+
+    /** Size of 'corner' added to note boxes. */
+    unsigned int noteCorner;
+
+    /** Anguluar box slope in pixels. */
+    unsigned int aboxSlope;
+
+    /** If true, wrap arc text as well as box contents. */
+    bool         wordWrapArcLabels;
+
+    /** Horizontal width of the arrow heads. */
+    unsigned int arrowWidth;
+
+    /** Vertical depth of the arrow heads. */
+    unsigned int arrowHeight;
+
+    /** Height of an arc which loops back to itself. */
+    unsigned int loopArcHeight;
+
+    /** Horizontal gap between text and horizontal lines. */
+    unsigned int textHGapPre;
+
+    /** Horizontal gap between text and horizontal lines. */
+    unsigned int textHGapPost;
+
+    /** Horizontal width of activation boxes. */
+    unsigned int activationWidth;
+}
+LayoutOptions;
+
+
+/** Information about each out row.
+ */
+typedef struct
+{
+    /** Minimum Y value. */
+    unsigned int ymin;
+
+    /** Y position of the arc on the row. */
+    unsigned int arcliney;
+
+    /** Maximum Y value. */
+    unsigned int ymax;
+
+    /** Maximum lines of text on the row. */
+    unsigned int maxTextLines;
+}
+RowInfo;
+
+
+/** A line of text within an arc label.
+ */
+typedef struct
+{
+    /** Offset of the line in the label. */
+    unsigned int start;
+
+    /** Length of the line in bytes. */
+    unsigned int len;
+
+    /** If true, the line ends in a hyphenated word. */
+    bool         hyphen;
+}
+LabelSpan;
+
+
+/** The retained layout of a single arc.
+ * This is computed once by layoutMsc() and is then only read by drawMsc().
+ */
+typedef struct
+{
+    /** Row on which the arc is drawn, unused for parallel arc markers. */
+    unsigned int  row;
+
+    /** Column in which the arc starts. */
+    int           startCol;
+
+    /** Column in which the arc ends, or MSC_BROADCAST_ENTITY.
+     * Discontinuities, dividers and spaces span the whole chart.
+     */
+    int           endCol;
+
+    /** Gradient of the arc in pixels, including any arc skip. */
+    int           gradient;
+
+    /** Lines of label text and the width of each line. */
+    unsigned int  nLines;
+    char        **lines;
+    unsigned int *lineWidth;
+}
+ArcLayout;
+
+
+/** The retained layout of an entity heading.
+ */
+typedef struct
+{
+    /** Lines of label text and the width of each line. */
+    unsigned int  nLines;
+    char        **lines;
+    unsigned int *lineWidth;
+}
+EntityLayout;
+
+
+/** An uninterrupted run of an entity lifeline.
+ * Consecutive rows in which the solid lifeline of an entity keeps the same
+ * activation depth are drawn as a single run, rather than as one segment
+ * per row.
+ */
+typedef struct
+{
+    /** Entity to which the lifeline belongs. */
+    unsigned int  entity;
+
+    /** Row at which the run is drawn, or the row count for runs that extend
+     *  the lifelines below the last row.
+     */
+    unsigned int  row;
+
+    /** Vertical extent of the run. */
+    unsigned int  ymin, ymax;
+
+    /** Activation depth of the lifeline over the run. */
+    int           activation;
+
+    /** If true, the lifeline is dotted over the run. */
+    bool          dotted;
+}
+LifelineRun;
+
+
+/** The complete layout of an MSC, as computed by layoutMsc().
+ */
+typedef struct
+{
+    /** Arena from which all of the layout is allocated. */
+    Arena         arena;
+
+    /** Output width and height. */
+    unsigned int  w, h;
+
+    /** Information for each row. */
+    RowInfo      *rowInfo;
+
+    /** Layout for each arc, including parallel arc markers. */
+    ArcLayout    *arcs;
+
+    /** Layout and lifeline colour for each entity. */
+    EntityLayout *entities;
+    ADrawColour  *entColourRef;
+
+    /** Lifeline runs in the order that they are drawn. */
+    LifelineRun  *lifelines;
+    unsigned int  nLifelines;
+
+    /** Scratch space to track entity activations over the rows. */
+    int          *entActivation;
+    int          *entActivationMin;
+    int          *entActivationMax;
+}
+ChartLayout;
+
+
+/** State for a single call to MscRender().
+ */
+typedef struct RenderContextTag
+{
+    /** Layout options, adjusted according to the MSC being rendered. */
+    LayoutOptions opts;
+
+    /** Text metrics, used for layout and drawing. */
+    ADrawMetrics  mtr;
+
+    /** The drawing, which is only open once the layout is complete. */
+    ADraw         drw;
+
+    /** Font name used for measuring and drawing text. */
+    const char   *fontName;
+
+    /** Cache of text widths used by the metrics, or NULL. */
+    ADrawTextCache *textCache;
+
+    /** If not NULL, the sink to which an image map is written. */
+    Sink          ismap;
+
+    /** Set if some part of the rendering has failed. */
+    bool          failed;
+}
+RenderContext;
+
+
+/** An output to be drawn from a display list by MscRenderMulti().
+ */
+typedef struct
+{
+    /** The sink to write, and the type of output to write to it. */
+    Sink             out;
+    ADrawOutputType  type;
+
+    /** Font name and backend options used for the output. */
+    const char      *fontName;
+    const ADrawOpts *drawOpts;
+
+    /** The recorded drawing and its dimensions. */
+    const ADrawList *list;
+    unsigned int     w, h;
+
+    /** Last row of each band if the output is drawn in bands, or NULL. */
+    const unsigned int *bandEnd;
+    unsigned int     nBands;
+
+    /** Count of threads that may draw the bands. */
+    unsigned int     threads;
+
+    /** Set if the output was drawn successfully. */
+    bool             ok;
+}
+ReplayJob;
+
+
+/** State for word wrapping an arc label.
+ */
+typedef struct
+{
+    RenderContext *ctx;
+
+    /** Working copy of the label text. */
+    char          *text;
+
+    /** Width available for each line. */
+    unsigned int   width;
+
+    /** Scratch array of offsets at which lines may be broken. */
+    unsigned int  *breaks;
+    unsigned int   nAllocBreaks;
+
+    /** The lines found so far. */
+    LabelSpan     *lines;
+    unsigned int   nLines, nAllocLines;
+}
+LineWrapper;
+
+/***************************************************************************
+ * Local Variables.
+ ***************************************************************************/
+
+/** Default layout options.
+ * This is copied into each RenderContext before being adjusted to suit the
+ * MSC that is to be rendered.
+ */
+static const LayoutOptions gDefaultOpts =
+{
+    600,    /* idealCanvasWidth */
+
+    80,     /* entitySpacing */
+    20,     /* entityHeadGap */
+    6,      /* arcSpacing */
+    0,      /* arcGradient */
+    8,      /* boxSpacing */
+    4,      /* boxInternalBorder */
+    6,      /* rboxArc */
+    12,     /* noteCorner */
+    6,      /* aboxSlope */
+    false,  /* wordWrapArcLabels */
+
+    /* Arrow options */
+    10, 6,
+
+    /* loopArcHeight */
+    12,
+
+    /* textHGapPre, textHGapPost */
+    2, 2,
+
+    12      /* activationWidth */
+};
+
+/***************************************************************************
+ * Functions
+ ***************************************************************************/
+
+/** Record a failure that occurred during rendering.
+ * Rendering continues where possible so that resources are released in the
+ * normal way, but MscRender() will return an error.
+ */
+static void renderFail(RenderContext *ctx, const char *message)
+{
+    fprintf(stderr, "Error: %s\n", message);
+    ctx->failed = true;
+}
+
+
+/** Find the next newline in some string.
+ * This returns a pointer to the start of the next newline in a
+ * string, roughly equivalent to strstr(line, "\n"), but ignoring
+ * escaped newlines such as "\\n".
+ */
+static char *strnl(const char *line)
+{
+    const char *nl = line;
+
+    do
+    {
+        nl = strstr(nl, "\\n");
+        if(nl)
+        {
+            if(nl == line || nl[-1] != '\\')
+            {
+                return (char *)nl;
+            }
+            else
+            {
+                nl += 2;
+            }
+        }
+    }
+    while(nl);
+
+	return NULL;
+}
+
+
+/** Check if some arc type indicates a box.
+ */
+static bool isBoxArc(const MscArcType a)
+{
+    return a == MSC_ARC_BOX || a == MSC_ARC_RBOX  ||
+           a == MSC_ARC_ABOX || a== MSC_ARC_NOTE;
+}
+
+
+/** Check if some span of the wrapper text fits the available width.
+ * The span is measured in place by briefly terminating the text at its end.
+ *
+ * \param[in] w      The wrapper.
+ * \param[in] start  Offset of the first character in the span.
+ * \param[in] end    Offset one beyond the last character in the span.
+ * \param[in] extra  Additional width to allow for, e.g. for a hyphen.
+ */
+static bool wrapFits(LineWrapper *w, unsigned int start, unsigned int end, unsigned int extra)
+{
+    const char   c = w->text[end];
+    unsigned int width;
+
+    w->text[end] = '\0';
+    width = w->ctx->mtr.textWidth(&w->ctx->mtr, &w->text[start]);
+    w->text[end] = c;
+
+    return width + extra <= w->width;
+}
+
+
+/** Find the longest span of text that fits the available width.
+ * Spans start at \a start and may end at any break after it, up to and
+ * including \a end.  When breaking on words, a span may end before any
+ * whitespace character or at \a end, otherwise a span may end after any
+ * character.
+ *
+ * Text widths only grow as characters are added, so the breaks are probed
+ * at exponentially increasing distances until one doesn't fit, and then
+ * a binary search finds the last break that does fit.  Breaks are found
+ * as they are needed, so only text that is close to the final span length
+ * is inspected or measured.
+ *
+ * \param[in] w      The wrapper.
+ * \param[in] start  Offset at which the span starts.
+ * \param[in] end    Offset beyond which the span may not extend.
+ * \param[in] words  If true, only break the span at whitespace.
+ * \param[in] extra  Additional width to allow for, e.g. for a hyphen.
+ * \returns  The end offset of the longest span that fits, or \a start
+ *            if no span fits.
+ */
+static unsigned int wrapLongestFit(LineWrapper *w,
+                                   unsigned int start,
+                                   unsigned int end,
+                                   bool         words,
+                                   unsigned int extra)
+{
+    unsigned int nBreaks = 0, probe = 0;
+    int          lo = -1, hi = -1;
+
+    while(hi < 0)
+    {
+        /* Find breaks up to the probe */
+        while(nBreaks <= probe &&
+              (nBreaks == 0 || w->breaks[nBreaks - 1] < end))
+        {
+            unsigned int p = nBreaks == 0 ? start : w->breaks[nBreaks - 1];
+
+            if(nBreaks == w->nAllocBreaks)
+            {
+                unsigned int  n = w->nAllocBreaks == 0 ? 64 : w->nAllocBreaks * 2;
+                unsigned int *b = realloc(w->breaks, sizeof(unsigned int) * n);
+
+                if(b == NULL)
+                {
+                    renderFail(w->ctx, "realloc() failed");
+                    return start;
+                }
+
+                w->breaks       = b;
+                w->nAllocBreaks = n;
+            }
+
+            do
+            {
+                p++;
+            }
+            while(words && p < end && !isspace((unsigned char)w->text[p]));
+
+            w->breaks[nBreaks++] = p < end ? p : end;
+        }
+
+        /* Stop at the last break */
+        if(probe >= nBreaks)
+        {
+            probe = nBreaks - 1;
+
+            if((signed)probe == lo)
+            {
+                break;
+            }
+        }
+
+        if(wrapFits(w, start, w->breaks[probe], extra))
+        {
+            lo    = probe;
+            probe = (probe * 2) + 1;
+        }
+        else
+        {
+            hi = probe;
+        }
+    }
+
+    /* Binary search between the last fitting and first failing breaks */
+    while(hi - lo > 1)
+    {
+        const int mid = (lo + hi) / 2;
+
+        if(wrapFits(w, start, w->breaks[mid], extra))
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo < 0 ? start : w->breaks[lo];
+}
+
+
+/** Add a span to the lines being output by some wrapper.
+ */
+static void wrapAddLine(LineWrapper *w, unsigned int start, unsigned int len, bool hyphen)
+{
+    if(w->nLines == w->nAllocLines)
+    {
+        unsigned int  n = w->nAllocLines == 0 ? 8 : w->nAllocLines * 2;
+        LabelSpan    *l = realloc(w->lines, sizeof(LabelSpan) * n);
+
+        if(l == NULL)
+        {
+            renderFail(w->ctx, "realloc() failed");
+            return;
+        }
+
+        w->lines       = l;
+        w->nAllocLines = n;
+    }
+
+    w->lines[w->nLines].start  = start;
+    w->lines[w->nLines].len    = len;
+    w->lines[w->nLines].hyphen = hyphen;
+    w->nLines++;
+}
+
+
+/** Word wrap one line of text to fit the available width.
+ * The line is broken at whitespace where possible, with the whitespace
+ * at the break being dropped.  Words that are too long to fit on their own
+ * are hyphenated.  The resulting lines are added to the wrapper as spans.
+ *
+ * \param[in] w      The wrapper.
+ * \param[in] start  Offset of the start of the line in the wrapper text.
+ * \param[in] end    Offset of the end of the line in the wrapper text.
+ */
+static void wrapLine(LineWrapper *w, unsigned int start, unsigned int end)
+{
+    /* Text that is not wrapped never needs measuring */
+    if(w->width == UINT_MAX)
+    {
+        wrapAddLine(w, start, end - start, false);
+        return;
+    }
+
+    while(!w->ctx->failed)
+    {
+        unsigned int brk = wrapLongestFit(w, start, end, true, 0);
+
+        if(brk == end)
+        {
+            /* The rest of the line fits */
+            wrapAddLine(w, start, end - start, false);
+            return;
+        }
+        else if(brk > start)
+        {
+            /* Break at whitespace */
+            wrapAddLine(w, start, brk - start, false);
+            start = brk;
+        }
+        else
+        {
+            /* The first word is bigger than the available space, so it must
+             *  be hyphenated.  The last character that fits alongside the
+             *  hyphen is replaced by the hyphen and starts the next line.
+             */
+            const unsigned int hyphenWidth = w->ctx->mtr.textWidth(&w->ctx->mtr, "-");
+            unsigned int       wordEnd = start;
+
+            do
+            {
+                wordEnd++;
+            }
+            while(wordEnd < end && !isspace((unsigned char)w->text[wordEnd]));
+
+            brk = wrapLongestFit(w, start, wordEnd, false, hyphenWidth);
+
+            if(brk > start + 1)
+            {
+                wrapAddLine(w, start, brk - start - 1, true);
+                start = brk - 1;
+            }
+            else
+            {
+                /* Always make progress, even if nothing fits */
+                wrapAddLine(w, start, 1, wordEnd > start + 1);
+                start++;
+            }
+        }
+
+        /* Skip the whitespace at the break */
+        while(start < end && isspace((unsigned char)w->text[start]))
+        {
+            start++;
+        }
+    }
+}
+
+
+/** Compute the width available for the text of an arc label.
+ *
+ * \param[in] m         The MSC containing the arc.
+ * \param[in] arcType   The type of the arc being labelled.
+ * \param[in] startCol  Column in which the arc starts.
+ * \param[in] endCol    Column in which the arc ends, or
+ *                        MSC_BROADCAST_ENTITY for broadcast arcs.
+ * \returns  The width in pixels, or UINT_MAX if the label is not wrapped.
+ */
+static unsigned int labelWidth(RenderContext    *ctx,
+                               Msc               m,
+                               const MscArcType  arcType,
+                               int               startCol,
+                               int               endCol)
+{
+    unsigned int width;
+
+    assert(startCol >= 0 && startCol < (signed)MscGetNumEntities(m));
+    assert(endCol == MSC_BROADCAST_ENTITY ||
+           (endCol >= 0 && endCol < (signed)MscGetNumEntities(m)));
+
+    if(!isBoxArc(arcType) && !ctx->opts.wordWrapArcLabels)
+    {
+        return UINT_MAX;
+    }
+
+    if(endCol == MSC_BROADCAST_ENTITY)
+    {
+        /* This is a special case for a broadcast arc */
+        width = ctx->opts.entitySpacing * MscGetNumEntities(m);
+    }
+    else if(startCol < endCol)
+    {
+        width = ctx->opts.entitySpacing * (1 + (endCol - startCol));
+    }
+    else
+    {
+        width = ctx->opts.entitySpacing * (1 + (startCol - endCol));
+    }
+
+    /* Reduce the width due to the box borders */
+    if(isBoxArc(arcType))
+    {
+        width -= (ctx->opts.boxSpacing + ctx->opts.boxInternalBorder) * 2;
+    }
+
+    if(arcType == MSC_ARC_NOTE)
+    {
+        width -= ctx->opts.noteCorner;
+    }
+
+    return width;
+}
+
+
+/** Split a label into lines, word-wrapping if needed.
+ * This takes the literal label supplied from the input and splits it into an
+ * array of char * text lines.  Splitting is first done according to literal
+ * '\n' character sequences added by the user, then according to word wrapping
+ * to fit available space, if appropriate.
+ *
+ * The lines are found as spans of the label and then copied into \a arena,
+ * along with the width of each line as it will be drawn.
+ *
+ * \param[in]     arena      Arena from which to allocate the lines.
+ * \param[in]     label      Original label from input file, or NULL.
+ * \param[in]     width      Width available for each line, or UINT_MAX if
+ *                             the label should not be wrapped.
+ * \param[in,out] lines      Pointer to be filled with output line array.
+ * \param[in,out] lineWidth  Pointer to be filled with the width of each line.
+ * \returns  The count of lines.
+ */
+static unsigned int splitLabelLines(RenderContext  *ctx,
+                                    Arena           arena,
+                                    const char     *label,
+                                    unsigned int    width,
+                                    char         ***lines,
+                                    unsigned int  **lineWidth)
+{
+    LineWrapper  w;
+    unsigned int start, t;
+
+    *lines     = NULL;
+    *lineWidth = NULL;
+
+    if(label == NULL)
+    {
+        return 0;
+    }
+
+    memset(&w, 0, sizeof(w));
+    w.ctx   = ctx;
+    w.width = width;
+
+    /* Take a working copy of the label, which is briefly modified to measure
+     *  spans of the text.
+     */
+    w.text = strdup(label);
+    if(w.text == NULL)
+    {
+        renderFail(ctx, "strdup() failed");
+        return 0;
+    }
+
+    /* First split around user specified lines with literal '\n' */
+    start = 0;
+    while(!ctx->failed)
+    {
+        const char *nextLine = strnl(&w.text[start]);
+
+        if(nextLine)
+        {
+            const unsigned int end = nextLine - w.text;
+
+            wrapLine(&w, start, end);
+            start = end + 2;
+        }
+        else
+        {
+            wrapLine(&w, start, strlen(&w.text[start]) + start);
+            break;
+        }
+    }
+
+    /* Copy out and measure the lines */
+    if(w.nLines > 0)
+    {
+        *lines     = ArenaAlloc(arena, sizeof(char *) * w.nLines);
+        *lineWidth = ArenaAlloc(arena, sizeof(unsigned int) * w.nLines);
+
+        for(t = 0; t < w.nLines; t++)
+        {
+            char *s = NULL;
+
+            if(*lines != NULL && *lineWidth != NULL)
+            {
+                s = ArenaAlloc(arena, w.lines[t].len + (w.lines[t].hyphen ? 2 : 1));
+            }
+
+            if(s == NULL)
+            {
+                renderFail(ctx, "Out of memory splitting labels");
+                *lines     = NULL;
+                *lineWidth = NULL;
+                w.nLines   = 0;
+                break;
+            }
+
+            (*lines)[t] = s;
+            memcpy(s, &w.text[w.lines[t].start], w.lines[t].len);
+            s += w.lines[t].len;
+
+            if(w.lines[t].hyphen)
+            {
+                *s++ = '-';
+            }
+
+            *s = '\0';
+
+            (*lineWidth)[t] = ctx->mtr.textWidth(&ctx->mtr, (*lines)[t]);
+        }
+    }
+
+    free(w.text);
+    free(w.breaks);
+    free(w.lines);
+
+    return w.nLines;
+}
+
+
+/** Get the skip value in pixels for some the current arc in the Msc.
+ */
+static int getArcGradient(RenderContext *ctx, Msc m, MscArcIter *ai, const RowInfo *rowInfo, unsigned int row)
+{
+    const char   *s = MscGetArcAttrib(ai, MSC_ATTR_ARC_SKIP);
+    unsigned int  v = ctx->opts.arcGradient;
+
+    if(s != NULL && rowInfo != NULL)
+    {
+        const unsigned int rowCount = MscGetNumArcs(m) - MscGetNumParallelArcs(m);
+        unsigned int       skip;
+
+        if(sscanf(s, "%u", &skip) == 1)
+        {
+            unsigned int ystart = rowInfo[row].arcliney;
+            unsigned int yend   = rowInfo[M_Min(rowCount - 1, row + skip)].arcliney;
+
+            v += yend - ystart;
+        }
+        else
+        {
+            fprintf(stderr, "Warning: Non-integer arcskip value: %s\n", s);
+        }
+    }
+
+    return v;
+}
+
+
+/** Add a point to the output imagemap.
+ * If an imagemap is being rendered and \a url is non-NULL, this function will
+ * add a rectangle to the imagemap according to the parameters passed.
+ *
+ * \param ctx    The render context.
+ * \param url    The URL to which the imagemap area should link.
+ * \param x1     The x coordinate for the upper left point.
+ * \param y2     The y coordinate for the upper left point.
+ * \param x2     The x coordinate for the lower right point.
+ * \param y2     The y coordinate for the lower right point.
+ */
+static void ismapRect(RenderContext *ctx,
+                      const char    *url,
+                      unsigned int   x1,
+                      unsigned int   y1,
+                      unsigned int   x2,
+                      unsigned int   y2)
+{
+    if(ctx->ismap && url)
+    {
+        assert(x1 <= x2); assert(y1 <= y2);
+
+        SinkPrintf(ctx->ismap,
+                   "rect %s %d,%d %d,%d\n",
+                   url,
+                   x1, y1,
+                   x2, y2);
+    }
+#if 0
+    /* For debug render a cross onto the output */
+    ctx->drw.line(&ctx->drw, x1, y1, x2, y2);
+    ctx->drw.line(&ctx->drw, x2, y1, x1, y2);
+#endif
+}
+
+
+/** Draw an arrow pointing to the right.
+ * \param x     The x co-ordinate for the end point for the arrow head.
+ * \param y     The y co-ordinate for the end point for the arrow head.
+ * \param type  The arc type, which controls the format of the arrow head.
+ */
+static void arrowR(RenderContext *ctx,
+                   unsigned int   x,
+                   unsigned int   y,
+                   MscArcType     type)
+{
+    switch(type)
+    {
+        case MSC_ARC_SIGNAL: /* Unfilled half */
+            ctx->drw.line(&ctx->drw,
+                          x, y,
+                          x - ctx->opts.arrowWidth, y + ctx->opts.arrowHeight);
+            break;
+
+        case MSC_ARC_DOUBLE:
+        case MSC_ARC_METHOD: /* Filled */
+        case MSC_ARC_RETVAL: /* Filled, dotted arc (not rendered here) */
+            ctx->drw.filledTriangle(&ctx->drw,
+                                    x, y,
+                                    x - ctx->opts.arrowWidth, y + ctx->opts.arrowHeight,
+                                    x - ctx->opts.arrowWidth, y - ctx->opts.arrowHeight);
+            break;
+
+        case MSC_ARC_CALLBACK: /* Non-filled */
+            ctx->drw.line(&ctx->drw,
+                          x, y,
+                          x - ctx->opts.arrowWidth, y + ctx->opts.arrowHeight);
+            ctx->drw.line(&ctx->drw,
+                          x - ctx->opts.arrowWidth, y - ctx->opts.arrowHeight,
+                          x, y);
+            break;
+
+        default:
+            assert(0);
+            break;
+    }
+}
+
+
+/** Draw an arrow pointing to the left.
+ * \param x     The x co-ordinate for the end point for the arrow head.
+ * \param y     The y co-ordinate for the end point for the arrow head.
+ * \param type  The arc type, which controls the format of the arrow head.
+ */
+static void arrowL(RenderContext *ctx,
+                   unsigned int   x,
+                   unsigned int   y,
+                   MscArcType     type)
+{
+    switch(type)
+    {
+        case MSC_ARC_SIGNAL: /* Unfilled half */
+            ctx->drw.line(&ctx->drw,
+                          x, y,
+                          x + ctx->opts.arrowWidth, y + ctx->opts.arrowHeight);
+            break;
+
+        case MSC_ARC_DOUBLE:
+        case MSC_ARC_METHOD: /* Filled */
+        case MSC_ARC_RETVAL: /* Filled, dotted arc (not rendered here) */
+            ctx->drw.filledTriangle(&ctx->drw,
+                                    x, y,
+                                    x + ctx->opts.arrowWidth, y + ctx->opts.arrowHeight,
+                                    x + ctx->opts.arrowWidth, y - ctx->opts.arrowHeight);
+            break;
+
+        case MSC_ARC_CALLBACK: /* Non-filled */
+            ctx->drw.line(&ctx->drw,
+                          x, y,
+                          x + ctx->opts.arrowWidth, y + ctx->opts.arrowHeight);
+            ctx->drw.line(&ctx->drw,
+                          x, y,
+                          x + ctx->opts.arrowWidth, y - ctx->opts.arrowHeight);
+            break;
+
+        default:
+            assert(0);
+            break;
+    }
+}
+
+
+/** Render some entity text.
+ * Draw the text for some entity.
+ * \param  ctx         The render context.
+ * \param  x           The x position at which the entity text should be centered.
+ * \param  y           The y position where the text should be placed.
+ * \param  entLayout   The layout of the entity label.
+ * \param  entUrl      The URL for rendering the label as a hyperlink.  This
+ *                       maybe \a NULL if not required.
+ * \param  entId       The text identifier for the arc.
+ * \param  entIdUrl    The URL for rendering the test identifier as a hyperlink.
+ *                       This maybe \a NULL if not required.
+ * \param  entColour   The text colour name or specification for the entity text.
+ *                      If NULL, use default colouring scheme.
+ * \param  entBgColour The text background colour name or specification for the
+ *                      entity text. If NULL, use default colouring scheme.
+ */
+static void entityText(RenderContext      *ctx,
+                       unsigned int        x,
+                       unsigned int        y,
+                       const EntityLayout *entLayout,
+                       const char         *entUrl,
+                       const char         *entId,
+                       const char         *entIdUrl,
+                       const char         *entColour,
+                       const char         *entBgColour)
+{
+    if(entLayout->nLines > 0)
+    {
+        unsigned int l;
+
+        /* Adjust y to be above the writing line */
+        y -= ctx->mtr.textHeight(&ctx->mtr) * entLayout->nLines;
+
+        for(l = 0; l < entLayout->nLines; l++)
+        {
+            const char   *lineLabel = entLayout->lines[l];
+            unsigned int  width     = entLayout->lineWidth[l];
+
+            /* Push text down one line */
+            y += ctx->mtr.textHeight(&ctx->mtr);
+
+            /* Check if a URL is associated */
+            if(entUrl)
+            {
+                /* If no explict colour has been set, make URLS blue */
+                ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLUE);
+
+                /* Image map output */
+                ismapRect(ctx,
+                          entUrl,
+                          x - (width / 2), y - ctx->mtr.textHeight(&ctx->mtr),
+                          x + (width / 2), y);
+            }
+
+            /* Set to the explicit colours if directed */
+            if(entColour != NULL)
+            {
+                ctx->drw.setPen(&ctx->drw, ADrawGetColour(entColour));
+            }
+
+            if(entBgColour != NULL)
+            {
+                ctx->drw.setBgPen(&ctx->drw, ADrawGetColour(entBgColour));
+            }
+
+            /* Render text and restore pen */
+            ctx->drw.textC (&ctx->drw, x, y, lineLabel, entUrl);
+            ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+            ctx->drw.setBgPen(&ctx->drw, ADRAW_COL_WHITE);
+
+            /* Render the Id of the title, if specified and for first line only */
+            if(entId && l == 0)
+            {
+                unsigned int idwidth;
+                int          idx, idy;
+
+                idy = y - ctx->mtr.textHeight(&ctx->mtr);
+                idx = x + (width / 2);
+
+                ctx->drw.setFontSize(&ctx->drw, ADRAW_FONT_TINY);
+
+                idwidth = ctx->mtr.textWidth(&ctx->mtr, entId);
+                idy    += (ctx->mtr.textHeight(&ctx->mtr) + 1) / 2;
+
+                if(entIdUrl)
+                {
+                    ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLUE);
+                    ctx->drw.textR (&ctx->drw, idx, idy, entId, entIdUrl);
+                    ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+
+                    /* Image map output */
+                    ismapRect(ctx,
+                              entIdUrl,
+                              idx, idy - ctx->mtr.textHeight(&ctx->mtr),
+                              idx + idwidth, idy);
+                }
+                else
+                {
+                    ctx->drw.textR(&ctx->drw, idx, idy, entId, NULL);
+                }
+
+                ctx->drw.setFontSize(&ctx->drw, ADRAW_FONT_SMALL);
+            }
+        }
+    }
+}
+
+
+/** Compute the output canvas size required for some MSC.
+ * This computes the dimensions for the canvas as well as the height for each
+ * row, and the layout of each arc.
+ *
+ * \param[in]     ctx     The render context.
+ * \param[in]     m       The MSC to analyse.
+ * \param[in,out] layout  The layout to be filled with the canvas size, rows
+ *                          and arcs.
+ */
+static void computeCanvasSize(RenderContext *ctx,
+                              Msc            m,
+                              ChartLayout   *layout)
+{
+    const unsigned int rowCount = MscGetNumArcs(m) - MscGetNumParallelArcs(m);
+    const unsigned int textHeight = ctx->mtr.textHeight(&ctx->mtr);
+    RowInfo      *rowHeight;
+    ArcLayout    *arcLayout;
+    unsigned int  nextYmin, ymin, ymax, yskipmax, row;
+    MscArcIter    ai;
+
+    /* Allocate storage for the height of each row and the arcs */
+    rowHeight = ArenaZalloc(layout->arena, M_Max(rowCount, 1) * sizeof(RowInfo));
+    arcLayout = ArenaZalloc(layout->arena, M_Max(MscGetNumArcs(m), 1) * sizeof(ArcLayout));
+    if(rowHeight == NULL || arcLayout == NULL)
+    {
+        renderFail(ctx, "Out of memory computing the canvas size");
+        return;
+    }
+
+    layout->rowInfo = rowHeight;
+    layout->arcs    = arcLayout;
+    row = 0;
+
+    nextYmin = ymin = ctx->opts.entityHeadGap;
+    yskipmax = 0;
+    ymax = 0;
+
+    for(ai = MscArcIterBegin(m); !MscArcIterEnd(&ai); MscNextArc(&ai), arcLayout++)
+    {
+        const MscArcType   arcType           = MscGetArcType(&ai);
+        const int          arcGradient       = isBoxArc(arcType) ? 0 : getArcGradient(ctx, m, &ai, NULL, 0);
+
+        if(arcType == MSC_ARC_PARALLEL)
+        {
+            assert(row > 0);
+
+            row--;
+
+            ymin = rowHeight[row].ymin;
+            nextYmin = rowHeight[row].ymax;
+        }
+        else
+        {
+            /* Get the entity indices */
+            if(arcType != MSC_ARC_DISCO && arcType != MSC_ARC_DIVIDER && arcType != MSC_ARC_SPACE)
+            {
+                arcLayout->startCol = MscGetArcSourceIndex(&ai);
+                arcLayout->endCol   = MscGetArcDestIndex(&ai);
+
+                /* Check that the start column is known and the end column is
+                 *  known, or that it's a broadcast arc
+                 */
+                assert(arcLayout->startCol != MSC_INVALID_ENTITY);
+                assert(arcLayout->endCol != MSC_INVALID_ENTITY);
+            }
+            else
+            {
+                /* Discontinuity or parallel arc spans whole chart */
+                arcLayout->startCol = 0;
+                arcLayout->endCol   = MscGetNumEntities(m) - 1;
+            }
+
+            /* Work out how the label fits the gap between entities */
+            arcLayout->nLines = splitLabelLines(ctx, layout->arena,
+                                                MscGetArcAttrib(&ai, MSC_ATTR_LABEL),
+                                                labelWidth(ctx, m, arcType,
+                                                           arcLayout->startCol,
+                                                           arcLayout->endCol),
+                                                &arcLayout->lines,
+                                                &arcLayout->lineWidth);
+
+            assert(row < rowCount);
+            arcLayout->row = row;
+
+            /* Update the max line count for the row */
+            if(arcLayout->nLines > rowHeight[row].maxTextLines)
+            {
+                rowHeight[row].maxTextLines = arcLayout->nLines;
+            }
+
+            /* Compute the height of this arc */
+            if(arcType != MSC_ARC_DISCO && arcType != MSC_ARC_DIVIDER && arcType != MSC_ARC_SPACE)
+            {
+                ymax = ymin + ctx->opts.arcSpacing;
+                ymax += (M_Max(rowHeight[row].maxTextLines, 2) * textHeight);
+            }
+            else
+            {
+                ymax = ymin + ctx->opts.arcSpacing;
+                ymax += (M_Max(rowHeight[row].maxTextLines, 1) * textHeight);
+            }
+
+            /* Update next potential row start */
+            if(ymax > nextYmin)
+            {
+                nextYmin = ymax;
+            }
+
+            /* Compute the dimensions for the completed row */
+            rowHeight[row].ymin     = ymin;
+            rowHeight[row].ymax     = nextYmin - ctx->opts.arcSpacing;
+            rowHeight[row].arcliney = rowHeight[row].ymin + (rowHeight[row].ymax - rowHeight[row].ymin) / 2;
+            row++;
+
+            /* Start new row */
+            ymin = nextYmin;
+        }
+
+        /* Keep a track of where the gradient may cause the graph to end */
+        if(ymax + arcGradient > ymax)
+        {
+            yskipmax = ymax + arcGradient;
+        }
+
+    }
+
+    if(ymax < yskipmax)
+        ymax = yskipmax;
+
+    /* Now the rows are known, find the gradient with any arc skip */
+    arcLayout = layout->arcs;
+    for(ai = MscArcIterBegin(m); !MscArcIterEnd(&ai); MscNextArc(&ai), arcLayout++)
+    {
+        const MscArcType arcType = MscGetArcType(&ai);
+
+        if(arcType != MSC_ARC_PARALLEL && !isBoxArc(arcType))
+        {
+            arcLayout->gradient = getArcGradient(ctx, m, &ai, rowHeight, arcLayout->row);
+        }
+    }
+
+    /* Set the return values */
+    layout->w = MscGetNumEntities(m) * ctx->opts.entitySpacing;
+    layout->h = ymax;
+}
+
+
+/** Draw a run of the vertical line that drops from an entity.
+ *
+ * \param run        The lifeline run to draw.
+ * \param colourRef  Colour reference for the entity.
+ */
+static void entityLine(RenderContext     *ctx,
+                       const LifelineRun *run,
+                       ADrawColour        colourRef)
+{
+    const unsigned int x = (ctx->opts.entitySpacing / 2) + (ctx->opts.entitySpacing * run->entity);
+    const unsigned int ymin = run->ymin, ymax = run->ymax;
+
+    if (run->activation > 0)
+    {
+        int a;
+
+        for (a = 0; a < run->activation; a++)
+        {
+            ctx->drw.setPen(&ctx->drw, ADRAW_COL_WHITE);
+            ctx->drw.filledRectangle(&ctx->drw, x + a * (ctx->opts.activationWidth - 1) / 2, ymin, x + a * ctx->opts.activationWidth / 2, ymax);
+
+            ctx->drw.setPen(&ctx->drw, colourRef);
+            if(run->dotted)
+            {
+                ctx->drw.dottedLine(&ctx->drw, (a * ctx->opts.activationWidth / 2) + (x - ctx->opts.activationWidth / 2), ymin, (a * ctx->opts.activationWidth / 2) + (x - ctx->opts.activationWidth / 2), ymax);
+                ctx->drw.dottedLine(&ctx->drw, (a * ctx->opts.activationWidth / 2) + (x + ctx->opts.activationWidth / 2), ymin, (a * ctx->opts.activationWidth / 2) + (x + ctx->opts.activationWidth / 2), ymax);
+            }
+            else
+            {
+                ctx->drw.line(&ctx->drw, (a * ctx->opts.activationWidth / 2) + (x - ctx->opts.activationWidth / 2), ymin, (a * ctx->opts.activationWidth / 2) + (x - ctx->opts.activationWidth / 2), ymax);
+                ctx->drw.line(&ctx->drw, (a * ctx->opts.activationWidth / 2) + (x + ctx->opts.activationWidth / 2), ymin, (a * ctx->opts.activationWidth / 2) + (x + ctx->opts.activationWidth / 2), ymax);
+            }
+        }
+    }
+    else if (run->activation == 0)
+    {
+        ctx->drw.setPen(&ctx->drw, colourRef);
+
+        if(run->dotted)
+        {
+            ctx->drw.dottedLine(&ctx->drw, x, ymin, x, ymax);
+        }
+        else
+        {
+            ctx->drw.line(&ctx->drw, x, ymin, x, ymax);
+        }
+    }
+}
+
+
+/** Draw the entity lifeline runs that start at some row.
+ * Each run is drawn once, at the first row that it covers, and so spans all
+ * the following rows in which the lifeline is unchanged.
+ *
+ * \param layout  The layout holding the lifeline runs.
+ * \param next    Index of the next run to draw, which is advanced past the
+ *                  runs drawn.
+ * \param row     The row being drawn.
+ */
+static void entityLines(RenderContext     *ctx,
+                        const ChartLayout *layout,
+                        unsigned int      *next,
+                        unsigned int       row)
+{
+    const LifelineRun *run = &layout->lifelines[*next];
+
+    while(*next < layout->nLifelines && run->row == row)
+    {
+        entityLine(ctx, run, layout->entColourRef[run->entity]);
+        (*next)++;
+        run++;
+    }
+
+    ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+}
+
+
+/** Draw vertical lines and boxes stemming from entities.
+ * \param ymin          Top of the row.
+ * \param ymax          Bottom of the row.
+ * \param boxStart      Column in which the box starts.
+ * \param boxEnd        Column in which the box ends.
+ * \param boxType       The type of box to draw, MSC_ARC_BOX, MSC_ARC_RBOX etc.
+ * \param lineColour    Colour of the lines to use for rendering the box.
+ * \param bgColour      Background colour for rendering the box.
+ */
+static void arcBox(RenderContext     *ctx,
+                   unsigned int       ymin,
+                   unsigned int       ymax,
+                   unsigned int       boxStart,
+                   unsigned int       boxEnd,
+                   MscArcType         boxType,
+                   const char        *lineColour,
+                   const char        *bgColour)
+{
+    unsigned int t;
+
+    /* Ensure the start is less than or equal to the end */
+    if(boxStart > boxEnd)
+    {
+        t = boxEnd;
+        boxEnd = boxStart;
+        boxStart = t;
+    }
+
+    /* Now draw the box */
+    unsigned int x1 = (ctx->opts.entitySpacing * boxStart) + ctx->opts.boxSpacing;
+    unsigned int x2 = ctx->opts.entitySpacing * (boxEnd + 1) - ctx->opts.boxSpacing;
+    unsigned int ymid = (ymin + ymax) / 2;
+
+    /* Set colour for the background area */
+    if(bgColour != NULL)
+    {
+        ctx->drw.setPen(&ctx->drw, ADrawGetColour(bgColour));
+    }
+    else
+    {
+        ctx->drw.setPen(&ctx->drw, ADRAW_COL_WHITE);
+    }
+
+    /* Draw the background to overwrite the entity lines */
+    switch(boxType)
+    {
+        case MSC_ARC_BOX:
+            ctx->drw.filledRectangle(&ctx->drw, x1, ymin, x2, ymax);
+            break;
+
+        case MSC_ARC_RBOX:
+            ctx->drw.filledRectangle(&ctx->drw, x1 + ctx->opts.rboxArc, ymin, x2 - ctx->opts.rboxArc, ymax);
+            ctx->drw.filledRectangle(&ctx->drw, x1, ymin + ctx->opts.rboxArc, x2, ymax - ctx->opts.rboxArc);
+            ctx->drw.filledCircle(&ctx->drw, x1 + ctx->opts.rboxArc, ymin + ctx->opts.rboxArc, ctx->opts.rboxArc);
+            ctx->drw.filledCircle(&ctx->drw, x2 - ctx->opts.rboxArc, ymin + ctx->opts.rboxArc, ctx->opts.rboxArc);
+            ctx->drw.filledCircle(&ctx->drw, x1 + ctx->opts.rboxArc, ymax - ctx->opts.rboxArc, ctx->opts.rboxArc);
+            ctx->drw.filledCircle(&ctx->drw, x2 - ctx->opts.rboxArc, ymax - ctx->opts.rboxArc, ctx->opts.rboxArc);
+            break;
+
+        case MSC_ARC_NOTE:
+            ctx->drw.filledRectangle(&ctx->drw, x1, ymin, x2 - ctx->opts.noteCorner, ymax);
+            ctx->drw.filledRectangle(&ctx->drw, x1, ymin + ctx->opts.noteCorner, x2, ymax);
+            ctx->drw.filledTriangle(&ctx->drw, x2 - ctx->opts.noteCorner, ymin,
+                                          x2, ymin + ctx->opts.noteCorner,
+                                          x2 - ctx->opts.noteCorner, ymin + ctx->opts.noteCorner);
+            break;
+
+        case MSC_ARC_ABOX:
+            ctx->drw.filledRectangle(&ctx->drw, x1 + ctx->opts.aboxSlope, ymin, x2 - ctx->opts.aboxSlope, ymax);
+            ctx->drw.filledTriangle(&ctx->drw, x1 + ctx->opts.aboxSlope, ymin,
+                                          x1 + ctx->opts.aboxSlope, ymax,
+                                          x1, ymid);
+            ctx->drw.filledTriangle(&ctx->drw, x2 - ctx->opts.aboxSlope, ymin,
+                                          x2 - ctx->opts.aboxSlope, ymax,
+                                          x2, ymid);
+            break;
+
+        default:
+            assert(0);
+    }
+
+    /* Setup the colour for rendering the boxes */
+    if(lineColour)
+    {
+        ctx->drw.setPen(&ctx->drw, ADrawGetColour(lineColour));
+    }
+    else
+    {
+        ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+    }
+
+    /* Draw the outline */
+    switch(boxType)
+    {
+        case MSC_ARC_BOX:
+            ctx->drw.line(&ctx->drw, x1, ymin, x2, ymin);
+            ctx->drw.line(&ctx->drw, x1, ymax, x2, ymax);
+            ctx->drw.line(&ctx->drw, x1, ymin, x1, ymax);
+            ctx->drw.line(&ctx->drw, x2, ymin, x2, ymax);
+            break;
+
+        case MSC_ARC_NOTE:
+            ctx->drw.line(&ctx->drw, x1, ymin, x2 - ctx->opts.noteCorner, ymin);
+            ctx->drw.line(&ctx->drw, x1, ymax, x2, ymax);
+            ctx->drw.line(&ctx->drw, x1, ymin, x1, ymax);
+            ctx->drw.line(&ctx->drw, x2, ymin + ctx->opts.noteCorner, x2, ymax);
+            ctx->drw.line(&ctx->drw, x2 - ctx->opts.noteCorner, ymin,
+                                x2, ymin + ctx->opts.noteCorner);
+            ctx->drw.line(&ctx->drw, x2 - ctx->opts.noteCorner, ymin,
+                                x2 - ctx->opts.noteCorner, ymin + ctx->opts.noteCorner);
+            ctx->drw.line(&ctx->drw, x2, ymin + ctx->opts.noteCorner,
+                                x2 - ctx->opts.noteCorner, ymin + ctx->opts.noteCorner);
+            break;
+
+        case MSC_ARC_RBOX:
+            ctx->drw.line(&ctx->drw, x1 + ctx->opts.rboxArc, ymin, x2 - ctx->opts.rboxArc, ymin);
+            ctx->drw.line(&ctx->drw, x1 + ctx->opts.rboxArc, ymax, x2 - ctx->opts.rboxArc, ymax);
+            ctx->drw.line(&ctx->drw, x1, ymin + ctx->opts.rboxArc, x1, ymax - ctx->opts.rboxArc);
+            ctx->drw.line(&ctx->drw, x2, ymin + ctx->opts.rboxArc, x2, ymax - ctx->opts.rboxArc);
+
+            ctx->drw.arc(&ctx->drw, x1 + ctx->opts.rboxArc,
+                         ymin + ctx->opts.rboxArc, ctx->opts.rboxArc * 2, ctx->opts.rboxArc * 2,
+                         180, 270);
+            ctx->drw.arc(&ctx->drw, x2 - ctx->opts.rboxArc,
+                         ymin + ctx->opts.rboxArc, ctx->opts.rboxArc * 2, ctx->opts.rboxArc * 2,
+                         270, 0);
+            ctx->drw.arc(&ctx->drw, x2 - ctx->opts.rboxArc,
+                         ymax - ctx->opts.rboxArc, ctx->opts.rboxArc * 2, ctx->opts.rboxArc * 2,
+                         0, 90);
+            ctx->drw.arc(&ctx->drw, x1 + ctx->opts.rboxArc,
+                         ymax - ctx->opts.rboxArc, ctx->opts.rboxArc * 2, ctx->opts.rboxArc * 2,
+                         90, 180);
+            break;
+
+        case MSC_ARC_ABOX:
+            ctx->drw.line(&ctx->drw, x1 + ctx->opts.aboxSlope, ymin, x2 - ctx->opts.aboxSlope, ymin);
+            ctx->drw.line(&ctx->drw, x1 + ctx->opts.aboxSlope, ymax, x2 - ctx->opts.aboxSlope, ymax);
+            ctx->drw.line(&ctx->drw, x1 + ctx->opts.aboxSlope, ymin, x1, ymid);
+            ctx->drw.line(&ctx->drw, x1, ymid, x1 + ctx->opts.aboxSlope, ymax);
+            ctx->drw.line(&ctx->drw, x2 - ctx->opts.aboxSlope, ymin, x2, ymid);
+            ctx->drw.line(&ctx->drw, x2, ymid, x2 - ctx->opts.aboxSlope, ymax);
+            break;
+
+        default:
+            assert(0);
+    }
+
+    /* Restore the pen colour if needed */
+    if(lineColour)
+    {
+        ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+    }
+}
+
+
+/** Render text on an arc.
+ * Draw the text on some arc.
+ * \param ctx            The render context.
+ * \param m              The Msc for which the text is being rendered.
+ * \param outwidth       Width of the output image.
+ * \param ymid           Co-ordinate of the row on which the text should be aligned.
+ * \param startCol       The column at which the arc being labelled starts.
+ * \param endCol         The column at which the arc being labelled ends.
+ * \param arcLayout      The layout of the arc, giving the lines of text.
+ * \param arcUrl         The URL for rendering the label as a hyperlink.  This
+ *                        maybe \a NULL if not required.
+ * \param arcId          The text identifier for the arc.
+ * \param arcIdUrl       The URL for rendering the test identifier as a hyperlink.
+ *                        This maybe \a NULL if not required.
+ * \param arcTextColour  Colour for the arc text, or NULL to use default.
+ * \param arcTextColour  Colour for the arc text backgroun, or NULL to use default.
+ * \param arcType        The type of arc, used to control output semantics.
+ */
+static void arcText(RenderContext     *ctx,
+                    Msc                m,
+                    unsigned int       outwidth,
+                    unsigned int       ymid,
+                    int                ygradient,
+                    unsigned int       startCol,
+                    unsigned int       endCol,
+                    const ArcLayout   *arcLayout,
+                    const char        *arcUrl,
+                    const char        *arcId,
+                    const char        *arcIdUrl,
+                    const char        *arcTextColour,
+                    const char        *arcTextBgColour,
+                    const MscArcType   arcType)
+{
+    unsigned int l;
+    unsigned int y;
+
+    /* A single line of normal text is above the midline */
+    if(arcLayout->nLines == 1 && !isBoxArc(arcType) &&
+       arcType != MSC_ARC_DISCO && arcType != MSC_ARC_DIVIDER &&
+       arcType != MSC_ARC_SPACE)
+    {
+        y = ymid + (ygradient / 2) - ctx->mtr.textHeight(&ctx->mtr);
+    }
+    else /* Text is vertically centered on the midline */
+    {
+        int yoff = ygradient - (ctx->mtr.textHeight(&ctx->mtr) * arcLayout->nLines);
+        y = ymid + (yoff / 2);
+    }
+
+    for(l = 0; l < arcLayout->nLines; l++)
+    {
+        const char *lineLabel = arcLayout->lines[l];
+        unsigned int width = arcLayout->lineWidth[l];
+        int x = ((startCol + endCol + 1) * ctx->opts.entitySpacing) / 2;
+
+        y += ctx->mtr.textHeight(&ctx->mtr);
+
+        if(startCol != endCol || isBoxArc(arcType))
+        {
+            /* Produce central aligned text */
+            x -= width / 2;
+        }
+        else if(startCol < (MscGetNumEntities(m) / 2))
+        {
+            /* Form text to the right */
+            x += ctx->opts.textHGapPre;
+        }
+        else
+        {
+            /* Form text to the left */
+            x -= width + ctx->opts.textHGapPost;
+        }
+
+        /* Clip against edges of image */
+        if(x + width > outwidth)
+        {
+            x = outwidth - width;
+        }
+
+        if(x < 0)
+        {
+            x = 0;
+        }
+
+        /* Check if a URL is associated */
+        if(arcUrl)
+        {
+            /* Default to blue */
+            ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLUE);
+
+            /* Image map output */
+            ismapRect(ctx,
+                      arcUrl,
+                      x, y - ctx->mtr.textHeight(&ctx->mtr),
+                      x + width, y);
+        }
+
+
+        /* Set to the explicit colours if directed */
+        if(arcTextColour != NULL)
+        {
+            ctx->drw.setPen(&ctx->drw, ADrawGetColour(arcTextColour));
+        }
+
+        if(arcTextBgColour != NULL)
+        {
+            ctx->drw.setBgPen(&ctx->drw, ADrawGetColour(arcTextBgColour));
+        }
+
+        /* Render text and restore pen */
+        ctx->drw.textR (&ctx->drw, x, y, lineLabel, arcUrl);
+        ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+        ctx->drw.setBgPen(&ctx->drw, ADRAW_COL_WHITE);
+
+        /* Render the Id of the arc, if specified and for the first line*/
+        if(arcId && l == 0)
+        {
+            unsigned int idwidth;
+            int          idx, idy;
+
+            idy = y - ctx->mtr.textHeight(&ctx->mtr);
+            idx = x + width;
+
+            ctx->drw.setFontSize(&ctx->drw, ADRAW_FONT_TINY);
+
+            idwidth = ctx->mtr.textWidth(&ctx->mtr, arcId);
+            idy    += (ctx->mtr.textHeight(&ctx->mtr) + 1) / 2;
+
+            if(arcIdUrl)
+            {
+                ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLUE);
+
+                /* Image map output */
+                ismapRect(ctx,
+                          arcIdUrl,
+                          idx, idy - ctx->mtr.textHeight(&ctx->mtr),
+                          idx + idwidth, idy);
+            }
+
+            /* Render text and restore pen and font */
+            ctx->drw.textR (&ctx->drw, idx, idy, arcId, arcIdUrl);
+            ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+            ctx->drw.setFontSize(&ctx->drw, ADRAW_FONT_SMALL);
+        }
+    }
+}
+
+
+/** Render the line and arrow head for some arc.
+ * This will draw the arc line and arrow head between two columns,
+ * noting that if the start and end column are the same, an arc is
+ * rendered.
+ * \param  m           The Msc for which the text is being rendered.
+ * \param  ymin        Top of row.
+ * \param  ymax        Bottom of row.
+ * \param  ygradient   The gradient of the arc which alters the y position a
+ *                      the ending column.
+ * \param  startCol    Starting column for the arc.
+ * \param  endCol      Column at which the arc terminates.
+ * \param  startColAct Activation for starting column.
+ * \param  endColAct   Activation for ending column.
+ * \param  hasArrows   If true, draw arc arrows, otherwise omit them.
+ * \param  hasBiArrows If true, has arrows in both directions.
+ * \param  arcType     The type of the arc, which dictates its rendered style.
+ */
+static void arcLine(RenderContext    *ctx,
+                    Msc               m,
+                    unsigned int      y,
+                    unsigned int      ygradient,
+                    unsigned int      startCol,
+                    unsigned int      endCol,
+                    int               startColAct,
+                    int               endColAct,
+                    const char       *arcLineCol,
+                    bool              hasArrows,
+                    const int         hasBiArrows,
+                    const MscArcType  arcType)
+{
+    unsigned int sx = (startCol * ctx->opts.entitySpacing) + (ctx->opts.entitySpacing / 2);
+    unsigned int dx = (endCol * ctx->opts.entitySpacing) + (ctx->opts.entitySpacing / 2);
+
+    if(startColAct > 0)
+    {
+        sx += (startColAct - 1) * ctx->opts.activationWidth / 2 + (sx < dx ? ctx->opts.activationWidth / 2 : -(ctx->opts.activationWidth / 2));
+    }
+
+    if(endColAct > 0)
+    {
+        dx += (endColAct - 1) * ctx->opts.activationWidth / 2 + (sx > dx ? ctx->opts.activationWidth / 2 : -(ctx->opts.activationWidth / 2));
+    }
+
+    /* Check if an explicit line colour is requested */
+    if(arcLineCol != NULL)
+    {
+        ctx->drw.setPen(&ctx->drw, ADrawGetColour(arcLineCol));
+    }
+
+    if(startCol != endCol)
+    {
+        /* Draw the line */
+        if(arcType == MSC_ARC_RETVAL)
+        {
+            ctx->drw.dottedLine(&ctx->drw, sx, y, dx, y + ygradient);
+        }
+        else if(arcType == MSC_ARC_DOUBLE)
+        {
+            ctx->drw.line(&ctx->drw, sx, y - 1, dx, y - 1 + ygradient);
+            ctx->drw.line(&ctx->drw, sx, y + 1, dx, y + 1 + ygradient);
+        }
+        else if(arcType == MSC_ARC_LOSS)
+        {
+            signed int   span = dx - sx;
+            unsigned int mx = sx + (span / 4) * 3;
+
+            ctx->drw.line(&ctx->drw, sx, y, mx, y + ygradient);
+            hasArrows = 0;
+
+            ctx->drw.line(&ctx->drw, mx - 4, y + ygradient - 4, mx + 4, y + ygradient + 4);
+            ctx->drw.line(&ctx->drw, mx + 4, y + ygradient - 4, mx - 4, y + ygradient + 4);
+        }
+        else
+        {
+            ctx->drw.line(&ctx->drw, sx, y, dx, y + ygradient);
+        }
+
+        /* Now the arrow heads */
+        if(hasArrows)
+        {
+            if(startCol < endCol)
+            {
+                arrowR(ctx, dx, y + ygradient, arcType);
+            }
+            else
+            {
+                arrowL(ctx, dx, y + ygradient, arcType);
+            }
+
+            if(hasBiArrows)
+            {
+                if(startCol < endCol)
+                {
+                    arrowL(ctx, sx, y + ygradient, arcType);
+                }
+                else
+                {
+                    arrowR(ctx, sx, y + ygradient, arcType);
+                }
+            }
+        }
+    }
+    else if(startCol < (MscGetNumEntities(m) / 2))
+    {
+        /* Arc looping to the left */
+        if(arcType == MSC_ARC_RETVAL)
+        {
+            ctx->drw.dottedArc(&ctx->drw,
+                               sx, y + ygradient/2,
+                               ctx->opts.entitySpacing,
+                               ctx->opts.loopArcHeight + ygradient,
+                               90,
+                               270);
+        }
+        else if(arcType == MSC_ARC_DOUBLE)
+        {
+            ctx->drw.arc(&ctx->drw,
+                         sx, y - 1 + ygradient/2,
+                         ctx->opts.entitySpacing,
+                         ctx->opts.loopArcHeight + ygradient,
+                         90,
+                         270);
+            ctx->drw.arc(&ctx->drw,
+                         sx, y + 1 + ygradient/2,
+                         ctx->opts.entitySpacing,
+                         ctx->opts.loopArcHeight + ygradient,
+                         90,
+                         270);
+        }
+        else if(arcType == MSC_ARC_LOSS)
+        {
+            unsigned int px, py;
+
+            ctx->drw.arc(&ctx->drw,
+                         sx, y - 1 + ygradient/2,
+                         ctx->opts.entitySpacing - 8,
+                         ctx->opts.loopArcHeight + ygradient,
+                         180 - 45,
+                         270);
+
+            hasArrows = false;
+
+            /* Get co-ordinates of the arc end-point */
+            ADrawComputeArcPoint(sx, y - 1 + ygradient/2, ctx->opts.entitySpacing - 8,
+                                 ctx->opts.loopArcHeight + ygradient, 180 - 45,
+                                 &px, &py);
+
+            /* Draw a cross */
+            ctx->drw.line(&ctx->drw, px - 4, py - 4, px + 4, py + 4);
+            ctx->drw.line(&ctx->drw, px + 4, py - 4, px - 4, py + 4);
+        }
+        else
+        {
+            ctx->drw.arc(&ctx->drw,
+                         sx, y + ygradient/2,
+                         ctx->opts.entitySpacing - 4,
+                         ctx->opts.loopArcHeight + ygradient,
+                         90,
+                         270);
+        }
+
+        if(hasArrows)
+        {
+            arrowR(ctx, dx, y + ygradient + (ctx->opts.loopArcHeight / 2), arcType);
+        }
+    }
+    else
+    {
+        /* Arc looping to right */
+        if(arcType == MSC_ARC_RETVAL)
+        {
+            ctx->drw.dottedArc(&ctx->drw,
+                               sx, y + ygradient/2,
+                               ctx->opts.entitySpacing,
+                               ctx->opts.loopArcHeight + ygradient,
+                               270,
+                               90);
+        }
+        else if(arcType == MSC_ARC_DOUBLE)
+        {
+            ctx->drw.arc(&ctx->drw,
+                         sx, y - 1 + ygradient/2,
+                         ctx->opts.entitySpacing,
+                         ctx->opts.loopArcHeight + ygradient,
+                         270,
+                         90);
+            ctx->drw.arc(&ctx->drw,
+                         sx, y + 1 + ygradient/2,
+                         ctx->opts.entitySpacing,
+                         ctx->opts.loopArcHeight + ygradient,
+                         270,
+                         90);
+        }
+        else if(arcType == MSC_ARC_LOSS)
+        {
+            unsigned int px, py;
+
+            ctx->drw.arc(&ctx->drw,
+                         sx, y - 1 + ygradient/2,
+                         ctx->opts.entitySpacing - 8,
+                         ctx->opts.loopArcHeight + ygradient,
+                         270,
+                         45);
+
+            hasArrows = false;
+
+            /* Get co-ordinates of the arc end-point */
+            ADrawComputeArcPoint(sx, y - 1 + ygradient/2, ctx->opts.entitySpacing - 8,
+                                 ctx->opts.loopArcHeight + ygradient, 45,
+                                 &px, &py);
+
+            /* Draw a cross */
+            ctx->drw.line(&ctx->drw, px - 4, py - 4, px + 4, py + 4);
+            ctx->drw.line(&ctx->drw, px + 4, py - 4, px - 4, py + 4);
+        }
+        else
+        {
+            ctx->drw.arc(&ctx->drw,
+                         sx, y + ygradient/2,
+                         ctx->opts.entitySpacing,
+                         ctx->opts.loopArcHeight + ygradient,
+                         270,
+                         90);
+        }
+
+        if(hasArrows)
+        {
+            arrowL(ctx, dx, y + ygradient + (ctx->opts.loopArcHeight / 2), arcType);
+        }
+    }
+
+    /* Restore pen if needed */
+    if(arcLineCol != NULL)
+    {
+        ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+    }
+}
+
+
+/** Get the x position at which an arc meets the lifeline of an entity.
+ * \param  col      Column of the entity.
+ * \param  act      Activation of the entity.
+ * \param  right    If true, the arc leaves or arrives from the right.
+ */
+static unsigned int arcEndX(RenderContext *ctx,
+                            unsigned int   col,
+                            int            act,
+                            bool           right)
+{
+    unsigned int x = (col * ctx->opts.entitySpacing) + (ctx->opts.entitySpacing / 2);
+
+    if(act > 0)
+    {
+        x += (act - 1) * ctx->opts.activationWidth / 2 + (right ? ctx->opts.activationWidth / 2 : -(ctx->opts.activationWidth / 2));
+    }
+
+    return x;
+}
+
+
+/** Draw a broadcast arc.
+ * A level broadcast of a solid arc type is drawn as one line to the furthest
+ * entity on each side of the source, with an arrow head at each entity it
+ * passes.  This draws the same pixels as an arc to each entity, but with a
+ * fraction of the primitives.  Other broadcasts draw an arc to each entity.
+ *
+ * \param  y           Y co-ordinate for the arc.
+ * \param  ygradient   The gradient of the arc.
+ * \param  startCol    Column from which the broadcast is sent.
+ * \param  act         Activation of each entity.
+ * \param  arcLineCol  Colour for the arc, or NULL for the current pen.
+ * \param  hasArrows   If true, draw arc arrows, otherwise omit them.
+ * \param  hasBiArrows If true, has arrows in both directions.
+ * \param  arcType     The type of the arc, which dictates its rendered style.
+ */
+static void arcBroadcast(RenderContext    *ctx,
+                         Msc               m,
+                         unsigned int      y,
+                         unsigned int      ygradient,
+                         unsigned int      startCol,
+                         const int        *act,
+                         const char       *arcLineCol,
+                         bool              hasArrows,
+                         const int         hasBiArrows,
+                         const MscArcType  arcType)
+{
+    const unsigned int nEnt = MscGetNumEntities(m);
+    unsigned int       t;
+
+    if(ygradient != 0 ||
+       (arcType != MSC_ARC_METHOD && arcType != MSC_ARC_SIGNAL &&
+        arcType != MSC_ARC_CALLBACK && arcType != MSC_ARC_DOUBLE))
+    {
+        for(t = 0; t < nEnt; t++)
+        {
+            if(t != startCol)
+            {
+                arcLine(ctx, m, y, ygradient, startCol, t,
+                        act[startCol], act[t],
+                        arcLineCol, hasArrows, hasBiArrows, arcType);
+            }
+        }
+        return;
+    }
+
+    if(arcLineCol != NULL)
+    {
+        ctx->drw.setPen(&ctx->drw, ADrawGetColour(arcLineCol));
+    }
+
+    /* Lines to the leftmost and rightmost entities */
+    for(t = 0; t < 2; t++)
+    {
+        const unsigned int endCol = t == 0 ? 0 : nEnt - 1;
+
+        if(endCol != startCol)
+        {
+            const bool         right = endCol > startCol;
+            const unsigned int sx = arcEndX(ctx, startCol, act[startCol], right);
+            const unsigned int dx = arcEndX(ctx, endCol, act[endCol], !right);
+
+            if(arcType == MSC_ARC_DOUBLE)
+            {
+                ctx->drw.line(&ctx->drw, sx, y - 1, dx, y - 1);
+                ctx->drw.line(&ctx->drw, sx, y + 1, dx, y + 1);
+            }
+            else
+            {
+                ctx->drw.line(&ctx->drw, sx, y, dx, y);
+            }
+
+            if(hasArrows && hasBiArrows)
+            {
+                if(right)
+                {
+                    arrowL(ctx, sx, y, arcType);
+                }
+                else
+                {
+                    arrowR(ctx, sx, y, arcType);
+                }
+            }
+        }
+    }
+
+    /* Arrow heads at each entity */
+    for(t = 0; t < nEnt && hasArrows; t++)
+    {
+        if(t < startCol)
+        {
+            arrowL(ctx, arcEndX(ctx, t, act[t], true), y, arcType);
+        }
+        else if(t > startCol)
+        {
+            arrowR(ctx, arcEndX(ctx, t, act[t], false), y, arcType);
+        }
+    }
+
+    if(arcLineCol != NULL)
+    {
+        ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+    }
+}
+
+
+/** Find the range of activations for each entity over a row.
+ * An entity can be activated or deactivated part way through a row, in
+ * which case its lifeline is drawn at the lower activation and arcs meet
+ * the higher activation.
+ *
+ * \param[in]  m       The MSC.
+ * \param[in]  ai      Iterator at the first arc of the row.
+ * \param[in]  act     The activation of each entity at the start of the row.
+ * \param[out] actMin  Receives the lowest activation of each entity.
+ * \param[out] actMax  Receives the highest activation of each entity.
+ */
+static void rowActivations(Msc        m,
+                           MscArcIter ai,
+                           const int *act,
+                           int       *actMin,
+                           int       *actMax)
+{
+    unsigned int ent;
+
+    for(ent = 0; ent < MscGetNumEntities(m); ent++)
+    {
+        actMin[ent] = act[ent];
+        actMax[ent] = act[ent];
+    }
+
+    while(!MscArcIterEnd(&ai))
+    {
+        if(MscGetArcType(&ai) == MSC_ARC_ACT)
+        {
+            int col = MscGetArcSourceIndex(&ai);
+            assert(col >= 0);
+            if(act[col] >= 0)
+            {
+                actMax[col]++;
+            }
+        }
+        else if(MscGetArcType(&ai) == MSC_ARC_DEACT)
+        {
+            int col = MscGetArcSourceIndex(&ai);
+            assert(col >= 0);
+            if(act[col] > 0)
+            {
+                actMin[col]--;
+            }
+        }
+        else if(MscGetArcType(&ai) == MSC_ARC_DESTR)
+        {
+            int col = MscGetArcSourceIndex(&ai);
+            assert(col >= 0);
+            actMin[col] = -1;
+        }
+
+        MscNextArc(&ai);
+        if(MscArcIterEnd(&ai))
+            break;
+        if(MscGetArcType(&ai) != MSC_ARC_PARALLEL)
+            break;
+        MscNextArc(&ai);
+    }
+}
+
+
+/** Update the activation of an entity for some arc.
+ */
+static void updateActivation(MscArcType arcType, int col, int *act)
+{
+    if(arcType == MSC_ARC_ACT)
+    {
+        if(act[col] >= 0)
+        {
+            act[col]++;
+        }
+    }
+    else if(arcType == MSC_ARC_DEACT)
+    {
+        if(act[col] > 0)
+        {
+            act[col]--;
+        }
+    }
+    else if(arcType == MSC_ARC_DESTR)
+    {
+        act[col] = -1;
+    }
+}
+
+
+/** Add a row segment to the lifeline of some entity.
+ * The segment is merged into the open run for the entity if it continues
+ * it unchanged, otherwise a new run is opened.
+ *
+ * \param[in,out] layout    The layout to which the run is added.
+ * \param[in,out] open      Index of the open run for each entity, or UINT_MAX.
+ * \param[in,out] capacity  Number of runs allocated in \a layout.
+ * \retval false  If memory for the run could not be allocated.
+ */
+static bool addLifeline(ChartLayout  *layout,
+                        unsigned int *open,
+                        unsigned int *capacity,
+                        unsigned int  entity,
+                        unsigned int  row,
+                        unsigned int  ymin,
+                        unsigned int  ymax,
+                        int           activation,
+                        bool          dotted)
+{
+    LifelineRun *run;
+
+    /* Destroyed entities have no lifeline */
+    if(activation < 0)
+    {
+        open[entity] = UINT_MAX;
+        return true;
+    }
+
+    if(open[entity] != UINT_MAX)
+    {
+        run = &layout->lifelines[open[entity]];
+
+        /* Dotted segments are not merged, so that the dots of each row
+         *  keep their phase
+         */
+        if(run->activation == activation && !run->dotted && !dotted &&
+           run->ymax >= ymin)
+        {
+            run->ymax = M_Max(run->ymax, ymax);
+            return true;
+        }
+    }
+
+    if(layout->nLifelines == *capacity)
+    {
+        const unsigned int n = M_Max(*capacity * 2, 16);
+
+        run = ArenaRealloc(layout->arena, layout->lifelines,
+                           *capacity * sizeof(LifelineRun),
+                           n * sizeof(LifelineRun));
+        if(run == NULL)
+        {
+            return false;
+        }
+
+        layout->lifelines = run;
+        *capacity = n;
+    }
+
+    run = &layout->lifelines[layout->nLifelines];
+    run->entity     = entity;
+    run->row        = row;
+    run->ymin       = ymin;
+    run->ymax       = ymax;
+    run->activation = activation;
+    run->dotted     = dotted;
+
+    open[entity] = layout->nLifelines++;
+
+    return true;
+}
+
+
+/** Work out the runs of each entity lifeline.
+ * This walks the rows computed by computeCanvasSize(), tracking the
+ * activation of each entity, and merges each row segment of a lifeline into
+ * the run above it where nothing has changed.
+ */
+static void layoutLifelines(RenderContext *ctx,
+                            Msc            m,
+                            ChartLayout   *layout)
+{
+    const unsigned int nEnt = MscGetNumEntities(m);
+    const unsigned int rowCount = MscGetNumArcs(m) - MscGetNumParallelArcs(m);
+    const RowInfo     *rowInfo = layout->rowInfo;
+    int               *act = layout->entActivation;
+    unsigned int      *open;
+    unsigned int       capacity = 0, ent, row = 0;
+    bool               rowStart = true;
+    MscArcIter         ai;
+
+    open = ArenaAlloc(layout->arena, nEnt * sizeof(unsigned int));
+    if(open == NULL)
+    {
+        renderFail(ctx, "Out of memory laying out lifelines");
+        return;
+    }
+
+    for(ent = 0; ent < nEnt; ent++)
+    {
+        open[ent] = UINT_MAX;
+        act[ent]  = 0;
+    }
+
+    layout->lifelines  = NULL;
+    layout->nLifelines = 0;
+
+    for(ai = MscArcIterBegin(m); !MscArcIterEnd(&ai); MscNextArc(&ai))
+    {
+        const MscArcType arcType = MscGetArcType(&ai);
+
+        if(arcType == MSC_ARC_PARALLEL)
+        {
+            rowStart = false;
+            row--;
+            continue;
+        }
+
+        /* Segments are added by the first arc of each row */
+        if(rowStart)
+        {
+            rowActivations(m, ai, act, layout->entActivationMin, layout->entActivationMax);
+
+            for(ent = 0; ent < nEnt; ent++)
+            {
+                if(!addLifeline(layout, open, &capacity, ent, row,
+                                rowInfo[row].ymin,
+                                rowInfo[row].ymax + ctx->opts.arcSpacing,
+                                layout->entActivationMin[ent],
+                                arcType == MSC_ARC_DISCO))
+                {
+                    renderFail(ctx, "Out of memory laying out lifelines");
+                    return;
+                }
+            }
+        }
+
+        if(arcType == MSC_ARC_ACT || arcType == MSC_ARC_DEACT || arcType == MSC_ARC_DESTR)
+        {
+            updateActivation(arcType, MscGetArcSourceIndex(&ai), act);
+        }
+
+        row++;
+        rowStart = true;
+    }
+
+    /* Extend the lifelines to the bottom, past any arc skip */
+    if(rowCount > 0)
+    {
+        for(ent = 0; ent < nEnt; ent++)
+        {
+            if(!addLifeline(layout, open, &capacity, ent, rowCount,
+                            rowInfo[rowCount - 1].ymax, layout->h,
+                            act[ent], false))
+            {
+                renderFail(ctx, "Out of memory laying out lifelines");
+                return;
+            }
+        }
+    }
+}
+
+
+/** Perform post-parsing validation of the MSC.
+ * This checks the passed MSC for various rules which can't easily be tested
+ * at parse time.
+ */
+static bool checkMsc(Msc m)
+{
+    MscArcIter ai;
+
+    /* Check all arc entites are known */
+    for(ai = MscArcIterBegin(m); !MscArcIterEnd(&ai); MscNextArc(&ai))
+    {
+        const MscArcType arcType  = MscGetArcType(&ai);
+
+        if(arcType != MSC_ARC_PARALLEL && arcType != MSC_ARC_DISCO &&
+           arcType != MSC_ARC_DIVIDER && arcType != MSC_ARC_SPACE)
+        {
+            /* Check the start column is valid */
+            if(MscGetArcSourceIndex(&ai) == MSC_INVALID_ENTITY)
+            {
+                fprintf(stderr, "Error detected at line %u: Unknown source entity '%s'.\n",
+                        MscGetArcInputLine(&ai), MscGetArcSource(&ai));
+                return false;
+            }
+
+            if(MscGetArcDestIndex(&ai) == MSC_INVALID_ENTITY)
+            {
+                fprintf(stderr, "Error detected at line %u: Unknown destination entity '%s'.\n",
+                        MscGetArcInputLine(&ai), MscGetArcDest(&ai));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/** Adjust the layout options to suit some MSC and compute its layout.
+ * The text metrics in \a ctx must be open so that text can be measured.
+ *
+ * \param[in]     ctx     The render context.
+ * \param[in]     m       The MSC to lay out.
+ * \param[in,out] layout  The layout to fill, which must have an arena.
+ */
+static void layoutMsc(RenderContext *ctx,
+                      Msc            m,
+                      ChartLayout   *layout)
+{
+    const unsigned int nEnt = MscGetNumEntities(m);
+    unsigned int  col;
+    MscEntityIter ei;
+    float         f;
+
+    /* Compute ideal canvas size, which may use text metrics */
+    if(MscGetOptAsFloat(m, MSC_OPT_WIDTH, &f))
+    {
+        ctx->opts.idealCanvasWidth = f;
+    }
+    else if(MscGetOptAsFloat(m, MSC_OPT_HSCALE, &f))
+    {
+        ctx->opts.idealCanvasWidth *= f;
+    }
+
+    /* Set the arc gradient if needed */
+    if(MscGetOptAsFloat(m, MSC_OPT_ARCGRADIENT, &f))
+    {
+        ctx->opts.arcGradient = (int)f;
+        ctx->opts.arcSpacing += ctx->opts.arcGradient;
+    }
+
+    /* Check if word wrapping on arcs other than boxes should be used */
+    MscGetOptAsBoolean(m, MSC_OPT_WORDWRAPARCS, &ctx->opts.wordWrapArcLabels);
+
+    /* Work out the entitySpacing */
+    if(ctx->opts.idealCanvasWidth / nEnt > ctx->opts.entitySpacing)
+    {
+        ctx->opts.entitySpacing = ctx->opts.idealCanvasWidth / nEnt;
+    }
+
+    /* Allocate the entity layout and the scratch used when drawing */
+    layout->entities         = ArenaZalloc(layout->arena, nEnt * sizeof(EntityLayout));
+    layout->entColourRef     = ArenaAlloc(layout->arena, nEnt * sizeof(ADrawColour));
+    layout->entActivation    = ArenaAlloc(layout->arena, nEnt * sizeof(int));
+    layout->entActivationMin = ArenaAlloc(layout->arena, nEnt * sizeof(int));
+    layout->entActivationMax = ArenaAlloc(layout->arena, nEnt * sizeof(int));
+    if(layout->entities == NULL || layout->entColourRef == NULL ||
+       layout->entActivation == NULL || layout->entActivationMin == NULL ||
+       layout->entActivationMax == NULL)
+    {
+        renderFail(ctx, "Out of memory laying out entities");
+        return;
+    }
+
+    /* Split the entity labels and work out the entityHeadGap */
+    ei = MscEntityIterBegin(m);
+    for(col = 0; col < nEnt; col++)
+    {
+        EntityLayout *ent  = &layout->entities[col];
+        const char   *line = MscGetEntAttrib(&ei, MSC_ATTR_LABEL);
+        unsigned int  gap;
+
+        ent->nLines = splitLabelLines(ctx, layout->arena, line, UINT_MAX,
+                                      &ent->lines, &ent->lineWidth);
+
+        /* Get the required gap, allowing a line below the label */
+        gap = (ent->nLines + 1) * ctx->mtr.textHeight(&ctx->mtr);
+        if(gap > ctx->opts.entityHeadGap)
+        {
+            ctx->opts.entityHeadGap = gap;
+        }
+
+        /* Get the colours */
+        line = MscGetEntAttrib(&ei, MSC_ATTR_LINE_COLOUR);
+        if(line != NULL)
+        {
+            layout->entColourRef[col] = ADrawGetColour(line);
+        }
+        else
+        {
+            layout->entColourRef[col] = ADRAW_COL_BLACK;
+        }
+
+        MscNextEntity(&ei);
+    }
+
+    /* Work out the width and height of the canvas */
+    if(!ctx->failed)
+    {
+        computeCanvasSize(ctx, m, layout);
+    }
+
+    /* Work out the runs of the entity lifelines */
+    if(!ctx->failed)
+    {
+        layoutLifelines(ctx, m, layout);
+    }
+}
+
+
+/** Print the computed row information for debug.
+ */
+static void printRowInfo(Msc m, const RowInfo *rowInfo)
+{
+    unsigned int t;
+
+    printf("\nRow heights:\n");
+
+    for(t = 0; t < MscGetNumArcs(m) - MscGetNumParallelArcs(m); t++)
+    {
+        printf(" %3u: min=%u arcliney=%u max=%u maxTextLines=%u\n",
+               t, rowInfo[t].ymin, rowInfo[t].arcliney, rowInfo[t].ymax, rowInfo[t].maxTextLines);
+    }
+}
+
+
+/** Draw some MSC.
+ * The drawing context in \a ctx must be open with the dimensions computed
+ * by layoutMsc().  The layout is only read, other than the scratch space
+ * that it provides for tracking activations.
+ *
+ * \param[in] ctx     The render context.
+ * \param[in] m       The MSC to draw.
+ * \param[in] layout  The layout computed by layoutMsc().
+ */
+static void drawMsc(RenderContext     *ctx,
+                    Msc                m,
+                    const ChartLayout *layout)
+{
+    const unsigned int rowCount = MscGetNumArcs(m) - MscGetNumParallelArcs(m);
+    const RowInfo     *rowInfo = layout->rowInfo;
+    const ArcLayout   *arcLayout;
+    const ADrawColour *entColourRef = layout->entColourRef;
+    int               *entActivation = layout->entActivation;
+    int               *entActivationMin = layout->entActivationMin;
+    int               *entActivationMax = layout->entActivationMax;
+    unsigned int       row, col, nextLine = 0;
+    bool               addLines;
+    MscEntityIter      ei;
+    MscArcIter         ai;
+
+    /* Draw the entity headings */
+    ei = MscEntityIterBegin(m);
+    for(col = 0; col < MscGetNumEntities(m); col++)
+    {
+        unsigned int x = (ctx->opts.entitySpacing / 2) + (ctx->opts.entitySpacing * col);
+
+        /* Titles */
+        entityText(ctx,
+                   x,
+                   ctx->opts.entityHeadGap - (ctx->mtr.textHeight(&ctx->mtr) / 2),
+                   &layout->entities[col],
+                   MscGetEntAttrib(&ei, MSC_ATTR_URL),
+                   MscGetEntAttrib(&ei, MSC_ATTR_ID),
+                   MscGetEntAttrib(&ei, MSC_ATTR_IDURL),
+                   MscGetEntAttrib(&ei, MSC_ATTR_TEXT_COLOUR),
+                   MscGetEntAttrib(&ei, MSC_ATTR_TEXT_BGCOLOUR));
+
+        /* Initialize activations */
+        entActivation[col] = 0;
+
+        MscNextEntity(&ei);
+    }
+
+    /* Draw the arcs */
+    addLines = true;
+    row = 0;
+    arcLayout = layout->arcs;
+
+    for(ai = MscArcIterBegin(m); !MscArcIterEnd(&ai); MscNextArc(&ai), arcLayout++)
+    {
+        const MscArcType   arcType           = MscGetArcType(&ai);
+        const char        *arcUrl            = MscGetArcAttrib(&ai, MSC_ATTR_URL);
+        const char        *arcId             = MscGetArcAttrib(&ai, MSC_ATTR_ID);
+        const char        *arcIdUrl          = MscGetArcAttrib(&ai, MSC_ATTR_IDURL);
+        const char        *arcTextColour     = MscGetArcAttrib(&ai, MSC_ATTR_TEXT_COLOUR);
+        const char        *arcTextBgColour   = MscGetArcAttrib(&ai, MSC_ATTR_TEXT_BGCOLOUR);
+        const char        *arcLineColour     = MscGetArcAttrib(&ai, MSC_ATTR_LINE_COLOUR);
+        const int          arcGradient       = arcLayout->gradient;
+        const int          arcHasArrows      = MscGetArcAttrib(&ai, MSC_ATTR_NO_ARROWS) == NULL;
+        const int          arcHasBiArrows    = MscGetArcAttrib(&ai, MSC_ATTR_BI_ARROWS) != NULL;
+        int                startCol = arcLayout->startCol;
+        int                endCol   = arcLayout->endCol;
+
+        if(arcType == MSC_ARC_PARALLEL)
+        {
+            addLines = false;
+
+            /* Rewind the row */
+            assert(row > 0);
+            row--;
+        }
+        else
+        {
+            const unsigned int ymin = rowInfo[row].ymin;
+            const unsigned int ymid = rowInfo[row].arcliney;
+            const unsigned int ymax = rowInfo[row].ymax;
+
+            /* Find all activations and deactivations in the row, and draw
+             *  the lifelines that start at the row
+             */
+            if(addLines)
+            {
+                rowActivations(m, ai, entActivation, entActivationMin, entActivationMax);
+                entityLines(ctx, layout, &nextLine, row);
+            }
+
+#if 0
+            /* For debug, mark the row spacing */
+            ctx->drw.line(&ctx->drw, 0, ymin, 10, ymin);
+            ctx->drw.line(&ctx->drw, 0, ymid, 5, ymid);
+            ctx->drw.line(&ctx->drw, 0, ymax, 10, ymax);
+#endif
+            assert(arcLayout->row == row);
+
+            /* Check for entity colouring if not set explicity on the arc */
+            if(arcType != MSC_ARC_DISCO && arcType != MSC_ARC_DIVIDER && arcType != MSC_ARC_SPACE)
+            {
+                if(arcTextColour == NULL)
+                {
+                    arcTextColour = MscGetEntIdxAttrib(m, startCol, MSC_ATTR_ARC_TEXT_COLOUR);
+                }
+
+                if(arcTextBgColour == NULL)
+                {
+                    arcTextBgColour = MscGetEntIdxAttrib(m, startCol, MSC_ATTR_ARC_TEXT_BGCOLOUR);
+                }
+
+                if(arcLineColour == NULL)
+                {
+                    arcLineColour = MscGetEntIdxAttrib(m, startCol, MSC_ATTR_ARC_LINE_COLOUR);
+                }
+            }
+
+            /* Check if this is a broadcast message */
+            if(endCol == MSC_BROADCAST_ENTITY)
+            {
+                arcBroadcast(ctx, m, ymid, arcGradient, startCol,
+                             entActivationMax, arcLineColour, arcHasArrows,
+                             arcHasBiArrows, arcType);
+
+                /* Fix up the start/end columns to span chart */
+                startCol = 0;
+                endCol   = MscGetNumEntities(m) - 1;
+            }
+            else
+            {
+                /* Check if it is a box, discontinuity arc etc... */
+                if(isBoxArc(arcType))
+                {
+                    arcBox(ctx, ymin, ymax, startCol, endCol, arcType, arcLineColour, arcTextBgColour);
+                }
+                else if(arcType == MSC_ARC_DISCO)
+                {
+                    /* Only the dotted lifelines, drawn with the row */
+                }
+                else if(arcType == MSC_ARC_DIVIDER || arcType == MSC_ARC_SPACE)
+                {
+                    /* Dividers also have a horizontal line at the middle */
+                    if(arcType == MSC_ARC_DIVIDER)
+                    {
+                        const unsigned int margin = ctx->opts.entitySpacing / 4;
+
+                        if(arcLineColour != NULL)
+                        {
+                            ctx->drw.setPen(&ctx->drw, ADrawGetColour(arcLineColour));
+                        }
+
+                        /* Draw line through middle of text */
+                        ctx->drw.dottedLine(&ctx->drw,
+                                            margin, ymid,
+                                            (MscGetNumEntities(m) * ctx->opts.entitySpacing) - margin,  ymid);
+
+                        if(arcLineColour != NULL)
+                        {
+                            ctx->drw.setPen(&ctx->drw, ADRAW_COL_BLACK);
+                        }
+                    }
+                }
+                else if(arcType == MSC_ARC_ACT)
+                {
+                    unsigned int x;
+
+                    updateActivation(arcType, startCol, entActivation);
+
+                    x = (startCol * ctx->opts.entitySpacing) + (ctx->opts.entitySpacing / 2) + ((entActivation[startCol] - 1) * ctx->opts.activationWidth / 2);
+
+                    ctx->drw.setPen(&ctx->drw, ADRAW_COL_WHITE);
+                    ctx->drw.filledRectangle(&ctx->drw, x - ctx->opts.activationWidth / 2, ymid, x + ctx->opts.activationWidth / 2, ymax + ctx->opts.arcSpacing);
+
+                    ctx->drw.setPen(&ctx->drw, entColourRef[startCol]);
+                    ctx->drw.line(&ctx->drw, x - ctx->opts.activationWidth / 2, ymid, x + ctx->opts.activationWidth / 2, ymid);
+                    ctx->drw.line(&ctx->drw, x - ctx->opts.activationWidth / 2, ymid, x - ctx->opts.activationWidth / 2, ymax + ctx->opts.arcSpacing);
+                    ctx->drw.line(&ctx->drw, x + ctx->opts.activationWidth / 2, ymid, x + ctx->opts.activationWidth / 2, ymax + ctx->opts.arcSpacing);
+                }
+                else if(arcType == MSC_ARC_DEACT)
+                {
+                    unsigned int x;
+
+                    updateActivation(arcType, startCol, entActivation);
+
+                    x = (startCol * ctx->opts.entitySpacing) + (ctx->opts.entitySpacing / 2) + (entActivation[startCol] * ctx->opts.activationWidth / 2);
+
+                    ctx->drw.setPen(&ctx->drw, ADRAW_COL_WHITE);
+                    ctx->drw.filledRectangle(&ctx->drw, x - ctx->opts.activationWidth / 2, ymin, x + ctx->opts.activationWidth / 2, ymid);
+
+                    ctx->drw.setPen(&ctx->drw, entColourRef[startCol]);
+                    ctx->drw.line(&ctx->drw, x - ctx->opts.activationWidth / 2, ymid, x + ctx->opts.activationWidth / 2, ymid);
+                    ctx->drw.line(&ctx->drw, x - ctx->opts.activationWidth / 2, ymin, x - ctx->opts.activationWidth / 2, ymid);
+                    ctx->drw.line(&ctx->drw, x + ctx->opts.activationWidth / 2, ymin, x + ctx->opts.activationWidth / 2, ymid);
+                }
+                else if(arcType == MSC_ARC_DESTR)
+                {
+                    unsigned int x = (startCol * ctx->opts.entitySpacing) + (ctx->opts.entitySpacing / 2);
+
+                    updateActivation(arcType, startCol, entActivation);
+
+                    ctx->drw.setPen(&ctx->drw, entColourRef[startCol]);
+                    ctx->drw.line(&ctx->drw, x, ymin, x, ymid);
+                    ctx->drw.line(&ctx->drw, x - ctx->opts.activationWidth / 2, ymid - ctx->opts.activationWidth / 2, x + ctx->opts.activationWidth / 2, ymid + ctx->opts.activationWidth / 2);
+                    ctx->drw.line(&ctx->drw, x - ctx->opts.activationWidth / 2, ymid + ctx->opts.activationWidth / 2, x + ctx->opts.activationWidth / 2, ymid - ctx->opts.activationWidth / 2);
+                }
+                else
+                {
+                    arcLine(ctx, m, ymid, arcGradient, startCol, endCol,
+                            entActivationMax[startCol], entActivationMax[endCol],
+                            arcLineColour, arcHasArrows, arcHasBiArrows, arcType);
+                }
+            }
+
+            /* All may have text */
+            if(arcLayout->nLines > 0)
+            {
+                arcText(ctx, m, layout->w, ymid, arcGradient,
+                        startCol, endCol, arcLayout,
+                        arcUrl, arcId, arcIdUrl,
+                        arcTextColour, arcTextBgColour, arcType);
+            }
+
+            /* Advance the row */
+            row++;
+            addLines = true;
+        }
+    }
+
+    /* Skip arcs may require the entity lines to be extended */
+    if(rowCount > 0)
+    {
+        entityLines(ctx, layout, &nextLine, rowCount);
+    }
+}
+
+
+/** Get the drawing backend type used for some output format.
+ * An ismap has no image of its own, but its areas are placed using the
+ * PNG text metrics; ADRAW_FMT_PNG is returned for it and the chart is drawn
+ * to the null backend by the caller.
+ * \retval false  If the format is not known.
+ */
+static bool getOutputType(MscRenderFormat format, ADrawOutputType *type)
+{
+    switch(format)
+    {
+        case MSC_RENDER_PNG:   *type = ADRAW_FMT_PNG; return true;
+        case MSC_RENDER_EPS:   *type = ADRAW_FMT_EPS; return true;
+        case MSC_RENDER_SVG:   *type = ADRAW_FMT_SVG; return true;
+        case MSC_RENDER_SVGZ:  *type = ADRAW_FMT_SVGZ; return true;
+        case MSC_RENDER_PDF:   *type = ADRAW_FMT_PDF; return true;
+        case MSC_RENDER_ISMAP: *type = ADRAW_FMT_PNG; return true; /* URLs for the PNG */
+        default:
+            fprintf(stderr, "Unknown output format %d\n", format);
+            return false;
+    }
+}
+
+
+/** Get the drawing backend options for some render options.
+ */
+static void getDrawOpts(const MscRenderOpts *opts, ADrawOpts *drawOpts)
+{
+    memset(drawOpts, 0, sizeof(*drawOpts));
+
+    switch(opts->pngColour)
+    {
+        case MSC_RENDER_PNG_PALETTE:   drawOpts->pngColour = ADRAW_PNG_PALETTE; break;
+        case MSC_RENDER_PNG_QUANTISED: drawOpts->pngColour = ADRAW_PNG_QUANTISED; break;
+        default:                       drawOpts->pngColour = ADRAW_PNG_TRUECOLOUR; break;
+    }
+
+    switch(opts->pngFilter)
+    {
+        case MSC_RENDER_PNG_FILTER_NONE:     drawOpts->pngFilter = ADRAW_PNG_FILTER_NONE; break;
+        case MSC_RENDER_PNG_FILTER_SUB:      drawOpts->pngFilter = ADRAW_PNG_FILTER_SUB; break;
+        case MSC_RENDER_PNG_FILTER_UP:       drawOpts->pngFilter = ADRAW_PNG_FILTER_UP; break;
+        case MSC_RENDER_PNG_FILTER_AVERAGE:  drawOpts->pngFilter = ADRAW_PNG_FILTER_AVERAGE; break;
+        case MSC_RENDER_PNG_FILTER_PAETH:    drawOpts->pngFilter = ADRAW_PNG_FILTER_PAETH; break;
+        case MSC_RENDER_PNG_FILTER_ADAPTIVE: drawOpts->pngFilter = ADRAW_PNG_FILTER_ADAPTIVE; break;
+        default:                             drawOpts->pngFilter = ADRAW_PNG_FILTER_DEFAULT; break;
+    }
+
+    drawOpts->pngLevel   = opts->pngLevel;
+    drawOpts->svgCompact = opts->svgCompact;
+
+    /* A quantised palette is computed from the whole image, while others
+     *  are split into bands if that lets several threads draw them
+     */
+    if(opts->pngColour != MSC_RENDER_PNG_QUANTISED)
+    {
+        drawOpts->pngBandHeight = opts->pngBandHeight;
+
+        if(drawOpts->pngBandHeight == 0 && opts->jobs > 1)
+        {
+            drawOpts->pngBandHeight = PARALLEL_BAND_HEIGHT;
+        }
+    }
+}
+
+
+/** Split a chart into bands of rows for drawing.
+ * Bands end where some row of the chart starts if possible, so that fewer
+ *  arcs and boxes are drawn in more than one band.
+ *
+ * \param[in]     m           The MSC.
+ * \param[in]     layout      The layout of the MSC.
+ * \param[in]     bandHeight  The most rows in a band.
+ * \param[in,out] nBands      Pointer to be filled with the count of bands.
+ * \returns  The last row of each band, which must be free()'d, or NULL if
+ *            memory was exhausted.
+ */
+static unsigned int *getBands(Msc                m,
+                              const ChartLayout *layout,
+                              unsigned int       bandHeight,
+                              unsigned int      *nBands)
+{
+    const unsigned int rowCount = MscGetNumArcs(m) - MscGetNumParallelArcs(m);
+    const unsigned int minHeight = (bandHeight + 1) / 2;
+    const RowInfo     *rowInfo = layout->rowInfo;
+    unsigned int      *bandEnd;
+    unsigned int       start = 0, row = 0, r, n = 0;
+
+    assert(bandHeight > 0);
+
+    bandEnd = malloc(sizeof(unsigned int) * (layout->h / minHeight + 1));
+    if(bandEnd == NULL)
+    {
+        return NULL;
+    }
+
+    while(start < layout->h)
+    {
+        unsigned int end = layout->h;
+
+        /* Find the last row starting in the second half of a full band */
+        if(layout->h - start > bandHeight)
+        {
+            end = start + bandHeight;
+
+            while(row < rowCount && rowInfo[row].ymin <= start)
+            {
+                row++;
+            }
+
+            for(r = row; r < rowCount && rowInfo[r].ymin <= start + bandHeight; r++)
+            {
+                if(rowInfo[r].ymin >= start + minHeight)
+                {
+                    end = rowInfo[r].ymin;
+                }
+            }
+        }
+
+        bandEnd[n++] = end - 1;
+        start = end;
+    }
+
+    *nBands = n;
+
+    return bandEnd;
+}
+
+
+/** Open the text metrics for some output type and lay out a chart.
+ * If this succeeds, endRender() must be called once drawing is complete.
+ * Layout errors are recorded in \a ctx.
+ *
+ * \param[in,out] ctx     The render context to initialise.
+ * \param[in]     m       The MSC to lay out.
+ * \param[in]     opts    Options for the render.
+ * \param[in]     type    The output type for which text is measured.
+ * \param[in,out] layout  The layout to fill.
+ * \retval false  If the metrics could not be opened.
+ */
+static bool beginRender(RenderContext       *ctx,
+                        Msc                  m,
+                        const MscRenderOpts *opts,
+                        ADrawOutputType      type,
+                        ChartLayout         *layout)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->opts     = gDefaultOpts;
+    ctx->fontName = opts->fontName ? opts->fontName : "helvetica";
+
+    /* Text is measured for both layout and drawing, so share the widths.
+     *  Without a cache, the widths are just measured each time.
+     */
+    ctx->textCache = ADrawTextCacheCreate();
+
+    /* Layout only needs text metrics */
+    if(!ADrawOpenMetrics(ctx->fontName, type, ctx->textCache, &ctx->mtr))
+    {
+        fprintf(stderr, "Failed to create text metrics\n");
+        ADrawTextCacheDestroy(ctx->textCache);
+        return false;
+    }
+
+    /* Lay out the chart once, retaining the results for drawing */
+    memset(layout, 0, sizeof(*layout));
+    layout->arena = ArenaCreate();
+    if(layout->arena == NULL)
+    {
+        renderFail(ctx, "Out of memory laying out the chart");
+    }
+    else
+    {
+        layoutMsc(ctx, m, layout);
+    }
+
+    if(!ctx->failed && opts->printRowInfo)
+    {
+        printRowInfo(m, layout->rowInfo);
+    }
+
+    return true;
+}
+
+
+/** Release the text metrics and layout opened by beginRender().
+ */
+static void endRender(RenderContext       *ctx,
+                      const MscRenderOpts *opts,
+                      ChartLayout         *layout)
+{
+    if(!ctx->mtr.close(&ctx->mtr))
+    {
+        ctx->failed = true;
+    }
+
+    if(ctx->textCache != NULL && opts->printRowInfo)
+    {
+        unsigned long hits, misses;
+
+        ADrawTextCacheStats(ctx->textCache, &hits, &misses);
+        printf("Text width cache: %lu hits, %lu misses\n", hits, misses);
+    }
+
+    ADrawTextCacheDestroy(ctx->textCache);
+
+    if(layout->arena != NULL)
+    {
+        ArenaDestroy(layout->arena);
+    }
+}
+
+
+#ifdef HAVE_PTHREAD_H
+
+/** The bands of a PNG being drawn by several threads.
+ */
+typedef struct
+{
+    const ReplayJob *job;
+
+    /** The context writing the PNG. */
+    struct ADrawTag *image;
+
+    /** The next band to draw, guarded by \a lock. */
+    pthread_mutex_t  lock;
+    unsigned int     nextBand;
+}
+BandQueue;
+
+
+/** A thread drawing bands for replayBands().
+ */
+typedef struct
+{
+    pthread_t    thread;
+    BandQueue   *queue;
+
+    /** Set if all of the thread's bands were drawn successfully. */
+    bool         ok;
+}
+BandWorker;
+
+
+/** pthread entry point for drawing bands.
+ * Each thread opens its own metrics and band context, then draws bands in
+ * the order they are taken from the queue until none remain.
+ */
+static void *bandThread(void *arg)
+{
+    BandWorker      *w = arg;
+    BandQueue       *q = w->queue;
+    const ReplayJob *job = q->job;
+    ADrawTextCache  *textCache = ADrawTextCacheCreate();
+    ADrawMetrics     mtr;
+    ADraw            drw;
+
+    w->ok = false;
+
+    if(!ADrawOpenMetrics(job->fontName, job->type, textCache, &mtr))
+    {
+        fprintf(stderr, "Failed to create text metrics\n");
+    }
+    else
+    {
+        if(!ADrawOpenBand(q->image, &mtr, &drw))
+        {
+            fprintf(stderr, "Error: Failed to create band context\n");
+        }
+        else
+        {
+            unsigned int t, ymin;
+
+            w->ok = true;
+            while(w->ok)
+            {
+                pthread_mutex_lock(&q->lock);
+                t = q->nextBand < job->nBands ? q->nextBand++ : job->nBands;
+                pthread_mutex_unlock(&q->lock);
+
+                if(t == job->nBands)
+                {
+                    break;
+                }
+
+                ymin  = t > 0 ? job->bandEnd[t - 1] + 1 : 0;
+                w->ok = drw.setBand(&drw, ymin, job->bandEnd[t]) &&
+                        ADrawListReplayBand(job->list, &drw, ymin, job->bandEnd[t]);
+            }
+
+            if(!drw.close(&drw))
+            {
+                w->ok = false;
+            }
+        }
+
+        if(!mtr.close(&mtr))
+        {
+            w->ok = false;
+        }
+    }
+
+    ADrawTextCacheDestroy(textCache);
+
+    return NULL;
+}
+
+
+/** Draw the bands of a PNG on several threads.
+ * Bands are written in order by whichever thread drew them, so the PNG is
+ *  the same as if the bands were drawn in turn.
+ *
+ * \param[in] job    The output, giving the bands and count of threads.
+ * \param[in] image  The context writing the PNG, which isn't drawn to.
+ * \retval false  If some band could not be drawn.
+ */
+static bool replayBands(const ReplayJob *job, struct ADrawTag *image)
+{
+    const unsigned int threads = M_Min(job->threads, job->nBands);
+    BandWorker        *worker = malloc(sizeof(BandWorker) * threads);
+    BandQueue          queue;
+    unsigned int       t, started;
+    bool               ok = true;
+
+    if(worker == NULL)
+    {
+        fprintf(stderr, "Out of memory drawing bands\n");
+        return false;
+    }
+
+    queue.job      = job;
+    queue.image    = image;
+    queue.nextBand = 0;
+    pthread_mutex_init(&queue.lock, NULL);
+
+    for(t = 0; t < threads; t++)
+    {
+        worker[t].queue = &queue;
+    }
+
+    /* Start the extra threads, with this thread also drawing bands */
+    for(started = 1; started < threads; started++)
+    {
+        if(pthread_create(&worker[started].thread, NULL, bandThread, &worker[started]) != 0)
+        {
+            break;
+        }
+    }
+
+    bandThread(&worker[0]);
+
+    for(t = 1; t < started; t++)
+    {
+        pthread_join(worker[t].thread, NULL);
+    }
+
+    for(t = 0; t < started; t++)
+    {
+        ok = ok && worker[t].ok;
+    }
+
+    pthread_mutex_destroy(&queue.lock);
+    free(worker);
+
+    return ok;
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+
+/** Draw a recorded display list to some output.
+ * This opens its own text metrics, so that several outputs can be drawn
+ * concurrently from the same list.
+ *
+ * \param[in,out] job  The output to draw, whose \a ok is set to the result.
+ */
+static void replayOutput(ReplayJob *job)
+{
+    ADrawTextCache *textCache = ADrawTextCacheCreate();
+    ADrawMetrics    mtr;
+    ADraw           drw;
+
+    job->ok = false;
+
+    if(!ADrawOpenMetrics(job->fontName, job->type, textCache, &mtr))
+    {
+        fprintf(stderr, "Failed to create text metrics\n");
+    }
+    else
+    {
+        ADrawOpts drawOpts = *job->drawOpts;
+
+        /* A palette image drawn in bands needs all its colours up front */
+        drawOpts.colours = ADrawListGetColours(job->list, &drawOpts.nColours);
+
+        if(!ADrawOpen(job->w, job->h, job->out, job->fontName, job->type, &mtr,
+                      &drawOpts, &drw))
+        {
+            fprintf(stderr, "Error: Failed to create output context\n");
+        }
+        else if(drw.setBand != NULL)
+        {
+            unsigned int ymin = 0, t;
+
+#ifdef HAVE_PTHREAD_H
+            if(job->threads > 1 && job->nBands > 1)
+            {
+                job->ok = replayBands(job, &drw);
+            }
+            else
+#endif
+            {
+                /* Draw each band from just the parts of the list that reach it */
+                job->ok = job->nBands > 0;
+                for(t = 0; job->ok && t < job->nBands; t++)
+                {
+                    job->ok = drw.setBand(&drw, ymin, job->bandEnd[t]) &&
+                              ADrawListReplayBand(job->list, &drw, ymin, job->bandEnd[t]);
+                    ymin = job->bandEnd[t] + 1;
+                }
+            }
+
+            if(!drw.close(&drw))
+            {
+                job->ok = false;
+            }
+        }
+        else
+        {
+            job->ok = ADrawListReplay(job->list, &drw);
+
+            if(!drw.close(&drw))
+            {
+                job->ok = false;
+            }
+        }
+
+        if(!mtr.close(&mtr))
+        {
+            job->ok = false;
+        }
+    }
+
+    ADrawTextCacheDestroy(textCache);
+}
+
+
+/** Draw a chart to PNG in bands.
+ * The chart is recorded to a display list, and the parts of the list that
+ *  reach each band are then replayed to draw it.
+ *
+ * \param[in] ctx       The render context, whose drawing is not yet open.
+ * \param[in] m         The MSC to draw.
+ * \param[in] layout    The layout computed by layoutMsc().
+ * \param[in] drawOpts  Options for the PNG backend, giving the band height.
+ * \param[in] threads   Count of threads that may draw the bands.
+ * \param[in] out       The sink to write.
+ */
+static void drawBanded(RenderContext     *ctx,
+                       Msc                m,
+                       const ChartLayout *layout,
+                       const ADrawOpts   *drawOpts,
+                       unsigned int       threads,
+                       Sink               out)
+{
+    ADrawList    *list = ADrawListCreate();
+    unsigned int *bandEnd;
+    ReplayJob     job;
+
+    if(list == NULL)
+    {
+        renderFail(ctx, "Out of memory creating display list");
+        return;
+    }
+
+    if(!ADrawOpenList(list, &ctx->mtr, &ctx->drw))
+    {
+        renderFail(ctx, "Failed to create display list");
+    }
+    else
+    {
+        drawMsc(ctx, m, layout);
+
+        if(!ctx->drw.close(&ctx->drw))
+        {
+            ctx->failed = true;
+        }
+    }
+
+    if(!ctx->failed)
+    {
+        job.out      = out;
+        job.type     = ADRAW_FMT_PNG;
+        job.fontName = ctx->fontName;
+        job.drawOpts = drawOpts;
+        job.list     = list;
+        job.w        = layout->w;
+        job.h        = layout->h;
+        job.bandEnd  = bandEnd = getBands(m, layout, drawOpts->pngBandHeight, &job.nBands);
+        job.threads  = threads;
+
+        if(bandEnd == NULL)
+        {
+            renderFail(ctx, "Out of memory splitting chart into bands");
+        }
+        else
+        {
+            replayOutput(&job);
+            if(!job.ok)
+            {
+                ctx->failed = true;
+            }
+        }
+
+        free(bandEnd);
+    }
+
+    ADrawListDestroy(list);
+}
+
+#ifdef HAVE_PTHREAD_H
+
+/** A thread drawing some share of the outputs for MscRenderMulti().
+ */
+typedef struct
+{
+    pthread_t    thread;
+
+    /** All the outputs. */
+    ReplayJob   *job;
+    unsigned int nJobs;
+
+    /** Index of the first output for this thread, and the step to the next. */
+    unsigned int first, step;
+}
+ReplayWorker;
+
+
+/** pthread entry point for drawing outputs.
+ */
+static void *replayThread(void *arg)
+{
+    ReplayWorker *w = arg;
+    unsigned int  t;
+
+    for(t = w->first; t < w->nJobs; t += w->step)
+    {
+        replayOutput(&w->job[t]);
+    }
+
+    return NULL;
+}
+
+
+/** Draw outputs on several threads.
+ *
+ * \param[in,out] job      The outputs to draw.
+ * \param[in]     nJobs    Count of outputs in \a job.
+ * \param[in]     threads  Count of threads to use, including this one.
+ */
+static void replayParallel(ReplayJob *job, unsigned int nJobs, unsigned int threads)
+{
+    ReplayWorker *worker = malloc(sizeof(ReplayWorker) * threads);
+    unsigned int  t, started;
+
+    if(worker == NULL)
+    {
+        for(t = 0; t < nJobs; t++)
+        {
+            replayOutput(&job[t]);
+        }
+        return;
+    }
+
+    for(t = 0; t < threads; t++)
+    {
+        worker[t].job   = job;
+        worker[t].nJobs = nJobs;
+        worker[t].first = t;
+        worker[t].step  = threads;
+    }
+
+    /* Start the extra threads, the first share is drawn on this thread */
+    for(started = 1; started < threads; started++)
+    {
+        if(pthread_create(&worker[started].thread, NULL, replayThread, &worker[started]) != 0)
+        {
+            break;
+        }
+    }
+
+    /* Draw the shares of any threads that could not be started here */
+    for(t = started; t < threads; t++)
+    {
+        replayThread(&worker[t]);
+    }
+
+    replayThread(&worker[0]);
+
+    for(t = 1; t < started; t++)
+    {
+        pthread_join(worker[t].thread, NULL);
+    }
+
+    free(worker);
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+bool MscRenderInit(void)
+{
+    return ADrawInit();
+}
+
+
+bool MscRenderGetFormat(const char *name, MscRenderFormat *format)
+{
+    static const struct
+    {
+        const char     *name;
+        MscRenderFormat format;
+    }
+    formatMap[] =
+    {
+        { "png",   MSC_RENDER_PNG },
+        { "eps",   MSC_RENDER_EPS },
+        { "svg",   MSC_RENDER_SVG },
+        { "svgz",  MSC_RENDER_SVGZ },
+        { "pdf",   MSC_RENDER_PDF },
+        { "ismap", MSC_RENDER_ISMAP }
+    };
+
+    unsigned int t;
+
+    for(t = 0; t < sizeof(formatMap) / sizeof(formatMap[0]); t++)
+    {
+        if(strcmp(name, formatMap[t].name) == 0)
+        {
+            *format = formatMap[t].format;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool MscRender(Msc m, const MscRenderOpts *opts, FILE *out)
+{
+    Sink s;
+    bool r;
+
+    assert(out != NULL);
+
+    s = SinkCreateFile(out);
+    if(s == NULL)
+    {
+        fprintf(stderr, "Out of memory creating output sink\n");
+        return false;
+    }
+
+    r = MscRenderToSink(m, opts, s);
+
+    return SinkDestroy(s) && r;
+}
+
+
+bool MscRenderToSink(Msc m, const MscRenderOpts *opts, Sink out)
+{
+    RenderContext    ctx;
+    ADrawOutputType  outType, drawType;
+    ADrawOpts        drawOpts;
+    ChartLayout      layout;
+    unsigned int    *pageEnd = NULL;
+
+    assert(m != NULL); assert(opts != NULL); assert(out != NULL);
+
+    /* Check the MSC is good */
+    if(!checkMsc(m) || !getOutputType(opts->format, &outType))
+    {
+        return false;
+    }
+
+    if(!beginRender(&ctx, m, opts, outType, &layout))
+    {
+        return false;
+    }
+
+    /* An ismap is written from the layout while drawing to nothing */
+    if(opts->format == MSC_RENDER_ISMAP)
+    {
+        ctx.ismap = out;
+        drawType  = ADRAW_FMT_NULL;
+    }
+    else
+    {
+        drawType  = outType;
+    }
+
+    getDrawOpts(opts, &drawOpts);
+
+    /* Long charts are split into pages, each ending between rows if possible */
+    if(!ctx.failed && drawType == ADRAW_FMT_PDF && layout.h > PDF_PAGE_HEIGHT)
+    {
+        pageEnd = getBands(m, &layout, PDF_PAGE_HEIGHT, &drawOpts.nPdfPages);
+        if(pageEnd == NULL)
+        {
+            renderFail(&ctx, "Out of memory splitting chart into pages");
+        }
+
+        drawOpts.pdfPageEnd = pageEnd;
+    }
+
+    if(!ctx.failed && drawType == ADRAW_FMT_PNG &&
+       drawOpts.pngBandHeight > 0 && drawOpts.pngBandHeight < layout.h)
+    {
+        drawBanded(&ctx, m, &layout, &drawOpts, opts->jobs, out);
+    }
+    else if(!ctx.failed)
+    {
+        /* Open the output at its final size */
+        if(!ADrawOpen(layout.w, layout.h, out, ctx.fontName, drawType, &ctx.mtr,
+                      &drawOpts, &ctx.drw))
+        {
+            renderFail(&ctx, "Failed to create output context");
+        }
+        else
+        {
+            drawMsc(&ctx, m, &layout);
+
+            if(!ctx.drw.close(&ctx.drw))
+            {
+                ctx.failed = true;
+            }
+        }
+    }
+
+    endRender(&ctx, opts, &layout);
+    free(pageEnd);
+
+    /* Check that all the output was written */
+    if(!SinkFlush(out))
+    {
+        renderFail(&ctx, "Failed to write output");
+    }
+
+    return !ctx.failed;
+}
+
+
+bool MscRenderMulti(Msc                    m,
+                    const MscRenderOpts   *opts,
+                    const MscRenderOutput *outputs,
+                    unsigned int           nOutputs)
+{
+    ADrawOutputType *outType;
+    ADrawOpts        drawOpts;
+    ADrawList      **list;
+    ReplayJob       *job;
+    unsigned int    *bandEnd = NULL, *pageEnd = NULL;
+    unsigned int     nLists = 0, nJobs = 0, nBands = 0, firstJob, t, u;
+    bool             ok = true;
+
+    assert(m != NULL); assert(opts != NULL); assert(outputs != NULL);
+
+    /* A single output can be drawn directly */
+    if(nOutputs == 1)
+    {
+        MscRenderOpts o = *opts;
+
+        o.format = outputs[0].format;
+        return MscRenderToSink(m, &o, outputs[0].out);
+    }
+
+    /* Check the MSC is good, and that each format is only given once */
+    if(!checkMsc(m))
+    {
+        return false;
+    }
+
+    for(t = 0; t < nOutputs; t++)
+    {
+        for(u = t + 1; u < nOutputs; u++)
+        {
+            if(outputs[t].format == outputs[u].format)
+            {
+                fprintf(stderr, "Output format %d requested more than once\n", outputs[t].format);
+                return false;
+            }
+        }
+    }
+
+    outType = malloc(sizeof(ADrawOutputType) * nOutputs);
+    list    = malloc(sizeof(ADrawList *) * nOutputs);
+    job     = malloc(sizeof(ReplayJob) * nOutputs);
+    if(!outType || !list || !job)
+    {
+        fprintf(stderr, "Out of memory rendering outputs\n");
+        ok = false;
+    }
+
+    for(t = 0; ok && t < nOutputs; t++)
+    {
+        ok = getOutputType(outputs[t].format, &outType[t]);
+    }
+
+    getDrawOpts(opts, &drawOpts);
+
+    /* Lay out and draw the chart once for each set of text metrics */
+    for(t = 0; ok && t < nOutputs; t++)
+    {
+        const ADrawOutputType metricsType = ADrawGetMetricsType(outType[t]);
+        RenderContext         ctx;
+        ChartLayout           layout;
+
+        /* Check if an earlier output shares the metrics */
+        for(u = 0; u < t; u++)
+        {
+            if(ADrawGetMetricsType(outType[u]) == metricsType)
+            {
+                break;
+            }
+        }
+
+        if(u < t)
+        {
+            continue;
+        }
+
+        list[nLists] = ADrawListCreate();
+        if(list[nLists] == NULL)
+        {
+            fprintf(stderr, "Out of memory creating display list\n");
+            ok = false;
+            break;
+        }
+
+        if(!beginRender(&ctx, m, opts, metricsType, &layout))
+        {
+            ADrawListDestroy(list[nLists]);
+            ok = false;
+            break;
+        }
+
+        /* Image maps are written while drawing, other outputs are replayed */
+        firstJob = nJobs;
+        for(u = t; u < nOutputs; u++)
+        {
+            if(ADrawGetMetricsType(outType[u]) != metricsType)
+            {
+                continue;
+            }
+
+            if(outputs[u].format == MSC_RENDER_ISMAP)
+            {
+                ctx.ismap = outputs[u].out;
+            }
+            else
+            {
+                job[nJobs].out      = outputs[u].out;
+                job[nJobs].type     = outType[u];
+                job[nJobs].fontName = ctx.fontName;
+                job[nJobs].drawOpts = &drawOpts;
+                job[nJobs].list     = list[nLists];
+                job[nJobs].w        = layout.w;
+                job[nJobs].h        = layout.h;
+                job[nJobs].bandEnd  = NULL;
+                job[nJobs].nBands   = 0;
+                job[nJobs].threads  = 1;
+                job[nJobs].ok       = false;
+
+                /* Only one PNG can be given, so only it needs bands */
+                if(!ctx.failed && outType[u] == ADRAW_FMT_PNG &&
+                   drawOpts.pngBandHeight > 0 && drawOpts.pngBandHeight < layout.h)
+                {
+                    bandEnd = getBands(m, &layout, drawOpts.pngBandHeight, &nBands);
+                    if(bandEnd == NULL)
+                    {
+                        renderFail(&ctx, "Out of memory splitting chart into bands");
+                    }
+
+                    job[nJobs].bandEnd = bandEnd;
+                    job[nJobs].nBands  = nBands;
+                }
+
+                /* Only PDF output reads its pages from the shared options */
+                if(!ctx.failed && outType[u] == ADRAW_FMT_PDF &&
+                   layout.h > PDF_PAGE_HEIGHT)
+                {
+                    pageEnd = getBands(m, &layout, PDF_PAGE_HEIGHT, &drawOpts.nPdfPages);
+                    if(pageEnd == NULL)
+                    {
+                        renderFail(&ctx, "Out of memory splitting chart into pages");
+                    }
+
+                    drawOpts.pdfPageEnd = pageEnd;
+                }
+
+                nJobs++;
+            }
+        }
+
+        if(!ctx.failed)
+        {
+            bool opened;
+
+            /* Nothing need be recorded if only an image map uses the layout */
+            if(nJobs == firstJob)
+            {
+                opened = ADrawOpen(layout.w, layout.h, NULL, ctx.fontName,
+                                   ADRAW_FMT_NULL, &ctx.mtr, NULL, &ctx.drw);
+            }
+            else
+            {
+                opened = ADrawOpenList(list[nLists], &ctx.mtr, &ctx.drw);
+            }
+
+            if(!opened)
+            {
+                renderFail(&ctx, "Failed to create display list");
+            }
+            else
+            {
+                drawMsc(&ctx, m, &layout);
+
+                if(!ctx.drw.close(&ctx.drw))
+                {
+                    ctx.failed = true;
+                }
+            }
+        }
+
+        nLists++;
+
+        endRender(&ctx, opts, &layout);
+        ok = !ctx.failed;
+    }
+
+    /* Draw each output from its list */
+    if(ok)
+    {
+        /* Threads not needed for other outputs can share drawing the PNG */
+        for(t = 0; t < nJobs; t++)
+        {
+            if(job[t].bandEnd != NULL && opts->jobs > nJobs)
+            {
+                job[t].threads = opts->jobs - nJobs + 1;
+            }
+        }
+
+#ifdef HAVE_PTHREAD_H
+        if(opts->jobs > 1 && nJobs > 1)
+        {
+            replayParallel(job, nJobs, M_Min(opts->jobs, nJobs));
+        }
+        else
+#endif
+        {
+            for(t = 0; t < nJobs; t++)
+            {
+                replayOutput(&job[t]);
+            }
+        }
+
+        for(t = 0; t < nJobs; t++)
+        {
+            ok = ok && job[t].ok;
+        }
+    }
+
+    for(t = 0; t < nLists; t++)
+    {
+        ADrawListDestroy(list[t]);
+    }
+
+    free(bandEnd);
+    free(pageEnd);
+    free(outType);
+    free(list);
+    free(job);
+
+    /* Check that all the output was written */
+    for(t = 0; t < nOutputs; t++)
+    {
+        if(!SinkFlush(outputs[t].out))
+        {
+            fprintf(stderr, "Error: Failed to write output\n");
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+
+bool MscRenderToBuffer(Msc                  m,
+                       const MscRenderOpts *opts,
+                       char               **outBuf,
+                       size_t              *outLen)
+{
+    Sink s;
+
+    assert(outBuf != NULL); assert(outLen != NULL);
+
+    *outBuf = NULL;
+    *outLen = 0;
+
+    /* Render straight into memory, which is then handed to the caller */
+    s = SinkCreateBuffer();
+    if(s == NULL)
+    {
+        fprintf(stderr, "Out of memory creating output buffer\n");
+        return false;
+    }
+
+    if(MscRenderToSink(m, opts, s))
+    {
+        *outBuf = SinkTakeBuffer(s, outLen);
+        if(*outBuf == NULL)
+        {
+            fprintf(stderr, "Out of memory returning rendered output\n");
+        }
+    }
+
+    SinkDestroy(s);
+
+    return *outBuf != NULL;
+}
+
+/* END OF FILE */
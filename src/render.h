@@ -0,0 +1,247 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * The message sequence chart rendering API.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ ***************************************************************************/
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "msc.h"
+#include "sink.h"
+
+/***************************************************************************
+ * Types
+ ***************************************************************************/
+
+/** Output formats that can be rendered.
+ */
+typedef enum MscRenderFormatTag
+{
+    /** Portable Network Graphics. */
+    MSC_RENDER_PNG,
+
+    /** Encapsulated Postscript. */
+    MSC_RENDER_EPS,
+
+    /** Scalable Vector Graphics. */
+    MSC_RENDER_SVG,
+
+    /** Server side image map giving the URLs for the PNG output. */
+    MSC_RENDER_ISMAP,
+
+    /** Scalable Vector Graphics, gzip compressed. */
+    MSC_RENDER_SVGZ,
+
+    /** Portable Document Format, split into pages if the chart is long. */
+    MSC_RENDER_PDF
+}
+MscRenderFormat;
+
+
+/** How PNG output is drawn and stored.
+ */
+typedef enum MscRenderPngColourTag
+{
+    /** True colour with anti-aliasing. */
+    MSC_RENDER_PNG_TRUECOLOUR = 0,
+
+    /** An indexed colour palette without anti-aliasing, which needs a
+     * quarter of the memory to draw.
+     */
+    MSC_RENDER_PNG_PALETTE,
+
+    /** Drawn in true colour with anti-aliasing, then stored as a palette. */
+    MSC_RENDER_PNG_QUANTISED
+}
+MscRenderPngColour;
+
+
+/** Row filters for PNG output, as defined by the PNG specification.
+ */
+typedef enum MscRenderPngFilterTag
+{
+    /** Adaptive filtering for true colour, and none for palettes. */
+    MSC_RENDER_PNG_FILTER_DEFAULT = 0,
+    MSC_RENDER_PNG_FILTER_NONE,
+    MSC_RENDER_PNG_FILTER_SUB,
+    MSC_RENDER_PNG_FILTER_UP,
+    MSC_RENDER_PNG_FILTER_AVERAGE,
+    MSC_RENDER_PNG_FILTER_PAETH,
+
+    /** Pick the filter for each row that is likely to compress best. */
+    MSC_RENDER_PNG_FILTER_ADAPTIVE
+}
+MscRenderPngFilter;
+
+
+/** Per-call rendering options.
+ * Nothing in the rendering library is stored between calls, so these
+ * options fully describe how a chart is to be rendered.
+ */
+typedef struct MscRenderOptsTag
+{
+    /** The output format to generate. */
+    MscRenderFormat format;
+
+    /** Font used for PNG output when built with FreeType.
+     * This must be a fontconfig font specifier, or NULL to use the default.
+     */
+    const char     *fontName;
+
+    /** If true, dump the computed row layout to stdout for debug. */
+    bool            printRowInfo;
+
+    /** Maximum number of threads that may draw a chart.  MscRenderMulti()
+     * draws outputs in parallel, and the bands of a PNG are shared between
+     * any threads not drawing other outputs.  A PNG is drawn in bands of
+     * 256 rows for this if \a pngBandHeight isn't given.  0 or 1 draws
+     * everything in turn.
+     */
+    unsigned int    jobs;
+
+    /** How PNG output is drawn and stored. */
+    MscRenderPngColour pngColour;
+
+    /** zlib compression level for PNG output, from 1 for the fastest to 9
+     * for the smallest, or 0 for the zlib default.
+     */
+    unsigned int    pngLevel;
+
+    /** The row filter for PNG output. */
+    MscRenderPngFilter pngFilter;
+
+    /** If non-zero, PNG output is drawn in horizontal bands of at most this
+     * many rows, so that memory use is bounded by the band rather than the
+     * chart height.  This is not used for MSC_RENDER_PNG_QUANTISED.
+     */
+    unsigned int    pngBandHeight;
+
+    /** If true, SVG output is made smaller by giving fonts and colours in
+     * a style sheet, joining lines into paths and reusing arrow heads.
+     */
+    bool            svgCompact;
+}
+MscRenderOpts;
+
+
+/** An output to be generated by MscRenderMulti().
+ */
+typedef struct MscRenderOutputTag
+{
+    /** The output format to generate. */
+    MscRenderFormat format;
+
+    /** The sink to which output is written. */
+    Sink            out;
+}
+MscRenderOutput;
+
+/***************************************************************************
+ * Functions
+ ***************************************************************************/
+
+/** Initialise the rendering library.
+ * This must be called once before rendering from multiple threads, after
+ * which MscRender(), MscRenderToSink() and MscRenderToBuffer() may be
+ * called concurrently for different charts.
+ *
+ * \retval true  If the library was initialised successfully.
+ */
+bool MscRenderInit(void);
+
+/** Get the output format corresponding to some name.
+ *
+ * \param[in]     name    The format name, e.g. "png" or "svg".
+ * \param[in,out] format  Pointer to be filled with the format.
+ * \retval true  If the name was recognised.
+ */
+bool MscRenderGetFormat(const char *name, MscRenderFormat *format);
+
+/** Render some MSC to an open file.
+ * The MSC is checked, laid out and then drawn to \a out.  The file is
+ * flushed but not closed, and errors are written to stderr.
+ *
+ * If \a opts gives more than one job, the bands of a PNG may be drawn on
+ * separate threads, in which case MscRenderInit() must have been called.
+ *
+ * \param[in] m     The MSC to render.
+ * \param[in] opts  Options for this render.
+ * \param[in] out   The file to which output is written.
+ * \retval true  If the output was rendered successfully.
+ */
+bool MscRender(Msc m, const MscRenderOpts *opts, FILE *out);
+
+/** Render some MSC to a sink.
+ * This is as MscRender(), but writes to \a out, which is flushed but not
+ * destroyed.  A sink created with SinkCreateBuffer() or SinkCreateFd() lets
+ * the output be collected in memory or written to a socket without going
+ * through a file.
+ *
+ * \param[in] m     The MSC to render.
+ * \param[in] opts  Options for this render.
+ * \param[in] out   The sink to which output is written.
+ * \retval true  If the output was rendered successfully.
+ */
+bool MscRenderToSink(Msc m, const MscRenderOpts *opts, Sink out);
+
+/** Render some MSC to several formats at once.
+ * The chart is laid out and drawn once for each distinct set of text
+ * metrics needed by the outputs, with the drawing recorded to a display
+ * list that is then replayed to each output.  PNG and ismap outputs share
+ * one layout, as do EPS, SVG, SVGZ and PDF.  The format in \a opts is
+ * ignored, and each format may only be given once.
+ *
+ * If \a opts gives more than one job, outputs and the bands of a PNG may
+ * be drawn on separate threads, in which case MscRenderInit() must have
+ * been called.
+ *
+ * \param[in] m         The MSC to render.
+ * \param[in] opts      Options for this render.
+ * \param[in] outputs   The outputs to generate.
+ * \param[in] nOutputs  Count of outputs in \a outputs.
+ * \retval true  If all the outputs were rendered successfully.
+ */
+bool MscRenderMulti(Msc                    m,
+                    const MscRenderOpts   *opts,
+                    const MscRenderOutput *outputs,
+                    unsigned int           nOutputs);
+
+/** Render some MSC into memory.
+ * This is as MscRender(), but returns the rendered output in a buffer.
+ *
+ * \param[in]     m       The MSC to render.
+ * \param[in]     opts    Options for this render.
+ * \param[in,out] outBuf  Pointer to be filled with the output buffer, which
+ *                         is owned by the caller and must be free()'d.
+ * \param[in,out] outLen  Pointer to be filled with the output length.
+ * \retval true  If the output was rendered successfully, otherwise \a *outBuf
+ *                is set to NULL.
+ */
+bool MscRenderToBuffer(Msc                  m,
+                       const MscRenderOpts *opts,
+                       char               **outBuf,
+                       size_t              *outLen);
+
+#endif /* RENDER_H */
+
+/* END OF FILE */
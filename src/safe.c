@@ -1,117 +1,163 @@
-/***************************************************************************
- *
- * $Id$
- *
- * This file is part of timgen, a timing diagram renderer.
- * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
- *
- * This program is free software; you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation; either version 2 of the License, or
- *  (at your option) any later version.
- *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program; if not, write to the Free Software
- * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
- **************************************************************************/
-
-#define FILE_NAME SAFE
-
-/*****************************************************************************
- * Header Files
- *****************************************************************************/
-
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-
-/*****************************************************************************
- * Preprocessor Macros & Constants
- *****************************************************************************/
-
-/*****************************************************************************
- * Typedefs
- *****************************************************************************/
-
-/*****************************************************************************
- * Local Variable Definitions
- *****************************************************************************/
-
-/*****************************************************************************
- * Global Variable Definitions
- *****************************************************************************/
-
-/*****************************************************************************
- * Local Function Definitions
- *****************************************************************************/
-
-static void checkNotNull(void *p, const char *message)
-{
-    if(!p)
-    {
-        fprintf(stderr, "Fatal error: %s\n", message);
-        exit(EXIT_FAILURE);
-    }
-}
-
-/*****************************************************************************
- * Global Function Definitions
- *****************************************************************************/
-
-void *realloc_s(void *ptr, size_t size)
-{
-    void *r = realloc(ptr, size);
-
-    checkNotNull(r, "realloc() failed");
-
-    return r;
-}
-
-void *malloc_s(size_t size)
-{
-    void *r = malloc(size);
-
-    checkNotNull(r, "malloc() failed");
-
-    return r;
-}
-
-void *zalloc_s(size_t size)
-{
-    void *r = malloc(size);
-
-    checkNotNull(r, "malloc() failed");
-    memset(r, 0, size);
-
-    return r;
-}
-
-char *strdup_s(const char *s)
-{
-    char *r = strdup(s);
-
-    checkNotNull(r, "strdup() failed");
-
-    return r;
-}
-
-const char *getenv_s(const char *name)
-{
-    char *r = getenv(name);
-
-    if(r == NULL) r = "";
-
-    return r;
-}
-
-/*****************************************************************************
- * Unit Test Support
- *****************************************************************************/
-
-
-/* END OF FILE */
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * This file is part of timgen, a timing diagram renderer.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+#define FILE_NAME SAFE
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "safe.h"
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Local Variable Definitions
+ *****************************************************************************/
+
+/** The hooks used for blockalloc_s() and blockfree_s(), or NULL. */
+static SafeAllocHooks  gHooks;
+static SafeAllocHooks *gHooksSet = NULL;
+
+/*****************************************************************************
+ * Global Variable Definitions
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Local Function Definitions
+ *****************************************************************************/
+
+static void checkNotNull(void *p, const char *message)
+{
+    if(!p)
+    {
+        fprintf(stderr, "Fatal error: %s\n", message);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*****************************************************************************
+ * Global Function Definitions
+ *****************************************************************************/
+
+void *realloc_s(void *ptr, size_t size)
+{
+    void *r = realloc(ptr, size);
+
+    checkNotNull(r, "realloc() failed");
+
+    return r;
+}
+
+void *malloc_s(size_t size)
+{
+    void *r = malloc(size);
+
+    checkNotNull(r, "malloc() failed");
+
+    return r;
+}
+
+void *zalloc_s(size_t size)
+{
+    void *r = malloc(size);
+
+    checkNotNull(r, "malloc() failed");
+    memset(r, 0, size);
+
+    return r;
+}
+
+char *strdup_s(const char *s)
+{
+    char *r = strdup(s);
+
+    checkNotNull(r, "strdup() failed");
+
+    return r;
+}
+
+void SafeSetAllocHooks(const SafeAllocHooks *hooks)
+{
+    if(hooks != NULL)
+    {
+        gHooks    = *hooks;
+        gHooksSet = &gHooks;
+    }
+    else
+    {
+        gHooksSet = NULL;
+    }
+}
+
+void *blockalloc_s(size_t size)
+{
+    void *r;
+
+    if(gHooksSet != NULL)
+    {
+        r = gHooksSet->alloc(size, gHooksSet->user);
+    }
+    else
+    {
+        r = malloc(size);
+    }
+
+    return r;
+}
+
+void blockfree_s(void *block, size_t size)
+{
+    if(gHooksSet != NULL)
+    {
+        gHooksSet->release(block, size, gHooksSet->user);
+    }
+    else
+    {
+        free(block);
+    }
+}
+
+const char *getenv_s(const char *name)
+{
+    char *r = getenv(name);
+
+    if(r == NULL) r = "";
+
+    return r;
+}
+
+/*****************************************************************************
+ * Unit Test Support
+ *****************************************************************************/
+
+
+/* END OF FILE */
@@ -1,54 +1,102 @@
-/***************************************************************************
- *
- * $Id$
- *
- * This file is part of mscgen, a message sequence chart renderer.
- * Copyright (C) 2005 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
- *
- * This program is free software; you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation; either version 2 of the License, or
- *  (at your option) any later version.
- *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program; if not, write to the Free Software
- * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
- **************************************************************************/
-
-#ifndef SAFE_H
-#define SAFE_H
-
-/*****************************************************************************
- * Header Files
- *****************************************************************************/
-
-/*****************************************************************************
- * Preprocessor Macros & Constants
- *****************************************************************************/
-
-/*****************************************************************************
- * Typedefs
- *****************************************************************************/
-
-/*****************************************************************************
- * Global Variable Declarations
- *****************************************************************************/
-
-/*****************************************************************************
- * Global Function Declarations
- *****************************************************************************/
-
-void *realloc_s(void *ptr, size_t size);
-void *malloc_s(size_t size);
-void *zalloc_s(size_t size);
-char *strdup_s(const char *s);
-const char *getenv_s(const char *name);
-
-/*#pragma GCC poison malloc strdup calloc*/
-
-#endif /* SAFE_H */
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * This file is part of mscgen, a message sequence chart renderer.
+ * Copyright (C) 2005 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+#ifndef SAFE_H
+#define SAFE_H
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stddef.h>
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/** Hooks for supplying the backing memory of arenas.
+ * Arenas hold parsed charts, and the layout and text width cache made for
+ * each render.  Embedders may install these hooks to place that memory
+ * where they choose, such as a pool or a region with a fixed budget.
+ *
+ * If a hook returns NULL, the parse or render needing the memory fails and
+ * reports an error, rather than the process exiting.  A text width cache
+ * that can't get memory just measures text again.
+ *
+ * The hooks are process-global, and are called concurrently from every
+ * thread that parses or renders charts, such as the workers of --batch and
+ * --serve.  They must therefore be thread safe.
+ */
+typedef struct SafeAllocHooksTag
+{
+    /** Allocate a block of \a size bytes, or return NULL on failure.
+     * The block must be aligned suitably for any type, as with malloc().
+     */
+    void *(*alloc)(size_t size, void *user);
+
+    /** Release a block previously returned by \a alloc. */
+    void  (*release)(void *block, size_t size, void *user);
+
+    /** Passed to each hook. */
+    void  *user;
+}
+SafeAllocHooks;
+
+/*****************************************************************************
+ * Global Variable Declarations
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Global Function Declarations
+ *****************************************************************************/
+
+void *realloc_s(void *ptr, size_t size);
+void *malloc_s(size_t size);
+void *zalloc_s(size_t size);
+char *strdup_s(const char *s);
+const char *getenv_s(const char *name);
+
+/** Set the hooks used by blockalloc_s() and blockfree_s().
+ * This must be called before any charts are parsed, and not while any
+ * charts allocated with other hooks remain.
+ *
+ * \param[in] hooks  The hooks to use, or NULL to use malloc() and free().
+ */
+void  SafeSetAllocHooks(const SafeAllocHooks *hooks);
+
+/** Allocate a large block of backing memory via the allocation hooks.
+ * Unlike malloc_s(), this returns NULL on failure so that callers can
+ * report the error.
+ */
+void *blockalloc_s(size_t size);
+
+/** Release a block from blockalloc_s(), giving the size requested.
+ */
+void  blockfree_s(void *block, size_t size);
+
+/*#pragma GCC poison malloc strdup calloc*/
+
+#endif /* SAFE_H */
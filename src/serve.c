@@ -0,0 +1,500 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * This file is part of mscgen, a message sequence chart renderer.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+/***************************************************************************
+ * Include Files
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#define SERVE_SOCKET
+#endif
+#include "serve.h"
+#include "render.h"
+#include "sink.h"
+#include "msc.h"
+
+/***************************************************************************
+ * Macro definitions
+ ***************************************************************************/
+
+/** Largest chart source that will be accepted in a request. */
+#define SERVE_MAX_INPUT (16 * 1024 * 1024)
+
+/***************************************************************************
+ * Types
+ ***************************************************************************/
+
+/** A connection from which requests are read and answered.
+ */
+typedef struct ServeConnTag
+{
+    /** File descriptor from which requests are read. */
+    int                  in;
+
+    /** Sink to which responses are written. */
+    Sink                 out;
+
+    /** Options for each render, before applying the request options. */
+    const MscRenderOpts *defOpts;
+
+    /** Input buffer. */
+    char                 buf[4096];
+
+    /** Index of the next unread byte in \a buf. */
+    size_t               pos;
+
+    /** Count of valid bytes in \a buf. */
+    size_t               len;
+}
+ServeConn;
+
+/***************************************************************************
+ * Functions
+ ***************************************************************************/
+
+/** Refill the input buffer for some connection.
+ * \retval true  If more input was read, otherwise the input is closed.
+ */
+static bool fillBuf(ServeConn *c)
+{
+    ssize_t r;
+
+    do
+    {
+        r = read(c->in, c->buf, sizeof(c->buf));
+    }
+    while(r == -1 && errno == EINTR);
+
+    if(r <= 0)
+    {
+        return false;
+    }
+
+    c->pos = 0;
+    c->len = r;
+
+    return true;
+}
+
+
+/** Read a single newline terminated line from some connection.
+ * The newline is removed from the returned string.
+ *
+ * \retval true  If a complete line was read.
+ */
+static bool readLine(ServeConn *c, char *line, size_t lineLen)
+{
+    size_t l = 0;
+
+    for(;;)
+    {
+        char ch;
+
+        if(c->pos == c->len && !fillBuf(c))
+        {
+            return false;
+        }
+
+        ch = c->buf[c->pos++];
+        if(ch == '\n')
+        {
+            line[l] = '\0';
+            return true;
+        }
+
+        /* Reject overlong lines, which are not valid requests */
+        if(l + 1 >= lineLen)
+        {
+            return false;
+        }
+
+        line[l++] = ch;
+    }
+}
+
+
+/** Read an exact number of bytes from some connection.
+ * If \a dst is NULL, the bytes are read and discarded.
+ *
+ * \retval true  If all bytes were read.
+ */
+static bool readBytes(ServeConn *c, char *dst, size_t n)
+{
+    while(n > 0)
+    {
+        size_t l;
+
+        if(c->pos == c->len && !fillBuf(c))
+        {
+            return false;
+        }
+
+        l = c->len - c->pos;
+        if(l > n)
+        {
+            l = n;
+        }
+
+        if(dst)
+        {
+            memcpy(dst, &c->buf[c->pos], l);
+            dst += l;
+        }
+
+        c->pos += l;
+        n      -= l;
+    }
+
+    return true;
+}
+
+
+/** Send a response on some connection.
+ *
+ * \param c       The connection.
+ * \param status  The status, either "OK" or "ERROR".
+ * \param data    The response body.
+ * \param len     Length of \a data in bytes.
+ * \retval true  If the response was sent.
+ */
+static bool respond(ServeConn *c, const char *status, const char *data, size_t len)
+{
+    char header[64];
+    int  l;
+
+    l = snprintf(header, sizeof(header), "%s %lu\n", status, (unsigned long)len);
+
+    SinkWrite(c->out, header, l);
+    SinkWrite(c->out, data, len);
+
+    return SinkFlush(c->out);
+}
+
+
+/** Send an error response on some connection.
+ */
+static bool respondError(ServeConn *c, const char *message)
+{
+    return respond(c, "ERROR", message, strlen(message));
+}
+
+
+/** Read and answer a single request.
+ * \retval true  If the connection should continue to be served.
+ */
+static bool handleRequest(ServeConn *c)
+{
+    MscRenderOpts opts = *c->defOpts;
+    char          header[512], type[16], message[600];
+    const char   *opt;
+    unsigned long len;
+    char         *in, *out;
+    size_t        outLen;
+    Msc           m;
+    int           off;
+    bool          r;
+
+    if(!readLine(c, header, sizeof(header)))
+    {
+        return false;
+    }
+
+    /* Parse the header; the connection cannot continue if this is bad */
+    if(sscanf(header, "%15s %lu%n", type, &len, &off) != 2)
+    {
+        respondError(c, "Malformed request header");
+        return false;
+    }
+
+    if(len > SERVE_MAX_INPUT)
+    {
+        respondError(c, "Request too large");
+        return false;
+    }
+
+    /* Read the chart, allocating a byte extra so that empty charts are
+     *  answered by the parser rather than a failed malloc(0)
+     */
+    in = malloc(len + 1);
+    if(!in)
+    {
+        respondError(c, "Out of memory");
+        return false;
+    }
+
+    if(!readBytes(c, in, len))
+    {
+        free(in);
+        return false;
+    }
+
+    /* Check the request options */
+    opt = &header[off];
+    while(*opt == ' ')
+    {
+        opt++;
+    }
+
+    if(*opt != '\0')
+    {
+        if(strncmp(opt, "font=", 5) == 0)
+        {
+            opts.fontName = opt + 5;
+        }
+        else
+        {
+            snprintf(message, sizeof(message), "Unknown request option '%s'", opt);
+            free(in);
+            return respondError(c, message);
+        }
+    }
+
+    if(!MscRenderGetFormat(type, &opts.format))
+    {
+        snprintf(message, sizeof(message), "Unknown output format '%s'", type);
+        free(in);
+        return respondError(c, message);
+    }
+
+    /* Parse and render; detailed errors go to stderr */
+    m = MscParseBuffer(in, len);
+    free(in);
+    if(!m)
+    {
+        return respondError(c, "Failed to parse chart");
+    }
+
+    if(!MscRenderToBuffer(m, &opts, &out, &outLen))
+    {
+        MscFree(m);
+        return respondError(c, "Failed to render chart");
+    }
+
+    MscFree(m);
+
+    r = respond(c, "OK", out, outLen);
+    free(out);
+
+    return r;
+}
+
+
+/** Serve requests on some connection until it is closed.
+ */
+static void serveConn(ServeConn *c)
+{
+    while(handleRequest(c))
+        ;
+}
+
+#ifdef SERVE_SOCKET
+
+/** Serve a connection accepted on the socket, then close and free it.
+ */
+static void *socketConn(void *arg)
+{
+    ServeConn *c = arg;
+
+    serveConn(c);
+    SinkDestroy(c->out);
+    close(c->in);
+    free(c);
+
+    return NULL;
+}
+
+
+/** Listen on a Unix domain socket and serve each connection.
+ * With threads, each connection is served on its own thread so that
+ * many clients can render at once.
+ *
+ * \retval false  If the socket could not be created.
+ */
+static bool serveSocket(const char *path, const MscRenderOpts *defOpts)
+{
+    struct sockaddr_un sa;
+    struct stat        st;
+    int                s;
+
+    if(strlen(path) >= sizeof(sa.sun_path))
+    {
+        fprintf(stderr, "Socket path '%s' is too long\n", path);
+        return false;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+
+    s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(s == -1)
+    {
+        perror("socket() failed");
+        return false;
+    }
+
+    /* Replace any stale socket left by an earlier server */
+    if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        unlink(path);
+    }
+
+    if(bind(s, (struct sockaddr *)&sa, sizeof(sa)) == -1 || listen(s, 16) == -1)
+    {
+        fprintf(stderr, "Failed to listen on '%s': %s\n", path, strerror(errno));
+        close(s);
+        return false;
+    }
+
+    for(;;)
+    {
+        ServeConn *c;
+        int        fd;
+
+        fd = accept(s, NULL, NULL);
+        if(fd == -1)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            perror("accept() failed");
+            break;
+        }
+
+        c = calloc(1, sizeof(ServeConn));
+        if(c)
+        {
+            c->out = SinkCreateFd(fd);
+        }
+
+        if(!c || !c->out)
+        {
+            fprintf(stderr, "Out of memory accepting connection\n");
+            free(c);
+            close(fd);
+            continue;
+        }
+
+        c->in      = fd;
+        c->defOpts = defOpts;
+
+#ifdef HAVE_PTHREAD_H
+        {
+            pthread_attr_t attr;
+            pthread_t      thread;
+            int            r;
+
+            pthread_attr_init(&attr);
+            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+            r = pthread_create(&thread, &attr, socketConn, c);
+            pthread_attr_destroy(&attr);
+
+            if(r != 0)
+            {
+                fprintf(stderr, "Warning: Failed to start connection thread: %s\n", strerror(r));
+                socketConn(c);
+            }
+        }
+#else
+        socketConn(c);
+#endif
+    }
+
+    close(s);
+
+    return false;
+}
+
+#endif /* SERVE_SOCKET */
+
+bool Serve(const char *addr, const MscRenderOpts *defOpts)
+{
+#ifdef SIGPIPE
+    /* Clients going away should not stop the server */
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    /* Load fonts and setup the backends once for all requests */
+    if(!MscRenderInit())
+    {
+        return false;
+    }
+
+    if(strcmp(addr, "-") == 0)
+    {
+        ServeConn *c = calloc(1, sizeof(ServeConn));
+
+        if(c)
+        {
+            c->out = SinkCreateFd(STDOUT_FILENO);
+        }
+
+        if(!c || !c->out)
+        {
+            fprintf(stderr, "Out of memory\n");
+            free(c);
+            return false;
+        }
+
+        c->in      = STDIN_FILENO;
+        c->defOpts = defOpts;
+
+        serveConn(c);
+        SinkDestroy(c->out);
+        free(c);
+
+        return true;
+    }
+#ifdef SERVE_SOCKET
+    else
+    {
+        return serveSocket(addr, defOpts);
+    }
+#else
+    else
+    {
+        fprintf(stderr, "Serving on a socket is not supported on this platform\n");
+        return false;
+    }
+#endif
+}
+
+/* END OF FILE */
@@ -0,0 +1,60 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * This file is part of mscgen, a message sequence chart renderer.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+#ifndef SERVE_H
+#define SERVE_H
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stdbool.h>
+#include "render.h"
+
+/*****************************************************************************
+ * Global Function Declarations
+ *****************************************************************************/
+
+/** Run mscgen as a render server.
+ * Requests are read and answered until the input is closed, or forever if
+ * listening on a socket.  Each request is a header line followed by the
+ * chart source:
+ *
+ *   <type> <length> [font=<font>]\n<length bytes of chart>
+ *
+ * Each response is a header line followed by the rendered output, or by a
+ * message if the chart could not be rendered:
+ *
+ *   OK <length>\n<length bytes of output>
+ *   ERROR <length>\n<length bytes of message>
+ *
+ * \param[in] addr      The path of a Unix domain socket on which to listen,
+ *                       or "-" to serve requests from stdin to stdout.
+ * \param[in] defOpts   Options used for each request, except the format and
+ *                       any options given in the request itself.
+ * \returns  false if the server could not be started.
+ */
+bool Serve(const char *addr, const MscRenderOpts *defOpts);
+
+#endif /* SERVE_H */
+
+/* END OF FILE */
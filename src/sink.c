@@ -0,0 +1,400 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * Output sinks.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include "sink.h"
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/** Size of the buffer in which output is gathered before being passed on.
+ * Writes at least this large bypass the buffer.
+ */
+#define SINK_BUF_SIZE     (64 * 1024)
+
+/** Size of the first allocation for a memory buffer sink. */
+#define SINK_BUF_INITIAL  4096
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/** A function to which a sink passes its output.
+ *
+ * \param[in] arg  The argument given when the sink was created.
+ * \param[in] buf  The output.
+ * \param[in] len  Count of bytes at \a buf, which is never 0.
+ * \retval false  If the output could not be written.
+ */
+typedef bool (*SinkWriteFn)(void *arg, const void *buf, size_t len);
+
+struct SinkTag
+{
+    /** Function to which output is passed, or NULL for a memory buffer. */
+    SinkWriteFn  write;
+    void        *arg;
+
+    /** The file written by a file sink, or NULL. */
+    FILE        *f;
+
+    /** Set once a write has failed. */
+    bool         failed;
+
+    /** The buffered output, and the size of \a buf. */
+    char        *buf;
+    size_t       len, size;
+};
+
+/*****************************************************************************
+ * Local Functions
+ *****************************************************************************/
+
+/** Write output to the FILE given as \a arg.
+ */
+static bool fileWrite(void *arg, const void *buf, size_t len)
+{
+    return fwrite(buf, 1, len, (FILE *)arg) == len;
+}
+
+
+/** Write output to the file descriptor given as \a arg.
+ */
+static bool fdWrite(void *arg, const void *buf, size_t len)
+{
+    const int   fd = (int)(intptr_t)arg;
+    const char *b = buf;
+
+    while(len > 0)
+    {
+        ssize_t r = write(fd, b, len);
+
+        if(r < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        b   += r;
+        len -= r;
+    }
+
+    return true;
+}
+
+
+/** Create a sink passing its output to some function.
+ */
+static Sink createSink(SinkWriteFn fn, void *arg, FILE *f)
+{
+    Sink s = malloc(sizeof(struct SinkTag));
+
+    if(s == NULL)
+    {
+        return NULL;
+    }
+
+    s->write  = fn;
+    s->arg    = arg;
+    s->f      = f;
+    s->failed = false;
+    s->len    = 0;
+    s->size   = fn != NULL ? SINK_BUF_SIZE : SINK_BUF_INITIAL;
+    s->buf    = malloc(s->size);
+    if(s->buf == NULL)
+    {
+        free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+
+/** Pass the buffered output of a sink on to its write function.
+ */
+static void flushBuf(Sink s)
+{
+    if(s->len > 0)
+    {
+        if(!s->failed && !s->write(s->arg, s->buf, s->len))
+        {
+            s->failed = true;
+        }
+
+        s->len = 0;
+    }
+}
+
+
+/** Ensure a memory buffer sink has space for \a n more bytes and a nul.
+ */
+static bool reserve(Sink s, size_t n)
+{
+    if(s->len + n + 1 > s->size)
+    {
+        size_t size = s->size * 2;
+        char  *buf;
+
+        if(size < s->len + n + 1)
+        {
+            size = s->len + n + 1;
+        }
+
+        buf = realloc(s->buf, size);
+        if(buf == NULL)
+        {
+            s->failed = true;
+            return false;
+        }
+
+        s->buf  = buf;
+        s->size = size;
+    }
+
+    return true;
+}
+
+/*****************************************************************************
+ * Global Functions
+ *****************************************************************************/
+
+Sink SinkCreateBuffer(void)
+{
+    return createSink(NULL, NULL, NULL);
+}
+
+
+Sink SinkCreateFile(FILE *f)
+{
+    return createSink(fileWrite, f, f);
+}
+
+
+Sink SinkCreateFd(int fd)
+{
+    return createSink(fdWrite, (void *)(intptr_t)fd, NULL);
+}
+
+
+bool SinkWrite(Sink s, const void *buf, size_t len)
+{
+    if(s->failed || len == 0)
+    {
+        return !s->failed;
+    }
+
+    if(s->write == NULL)
+    {
+        /* Memory buffers are written in place */
+        if(!reserve(s, len))
+        {
+            return false;
+        }
+    }
+    else if(s->len + len > s->size)
+    {
+        flushBuf(s);
+
+        /* Large writes bypass the buffer */
+        if(len >= s->size)
+        {
+            if(!s->failed && !s->write(s->arg, buf, len))
+            {
+                s->failed = true;
+            }
+
+            return !s->failed;
+        }
+    }
+
+    memcpy(&s->buf[s->len], buf, len);
+    s->len += len;
+
+    return true;
+}
+
+
+int SinkVPrintf(Sink s, const char *fmt, va_list ap)
+{
+    va_list aq;
+    int     n;
+
+    if(s->failed)
+    {
+        return -1;
+    }
+
+    /* Try formatting straight into the buffer */
+    va_copy(aq, ap);
+    n = vsnprintf(&s->buf[s->len], s->size - s->len, fmt, aq);
+    va_end(aq);
+
+    if(n < 0)
+    {
+        s->failed = true;
+        return n;
+    }
+
+    /* Make space and try again if it didn't fit, counting the nul */
+    if((size_t)n >= s->size - s->len)
+    {
+        if(s->write == NULL)
+        {
+            if(!reserve(s, n))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            flushBuf(s);
+            if(s->failed)
+            {
+                return -1;
+            }
+        }
+
+        if((size_t)n < s->size - s->len)
+        {
+            vsnprintf(&s->buf[s->len], s->size - s->len, fmt, ap);
+        }
+        else
+        {
+            /* Longer than the whole buffer, so format it separately */
+            char *t = malloc(n + 1);
+
+            if(t == NULL)
+            {
+                s->failed = true;
+                return -1;
+            }
+
+            vsnprintf(t, n + 1, fmt, ap);
+            SinkWrite(s, t, n);
+            free(t);
+
+            return s->failed ? -1 : n;
+        }
+    }
+
+    s->len += n;
+
+    return n;
+}
+
+
+int SinkPrintf(Sink s, const char *fmt, ...)
+{
+    va_list ap;
+    int     n;
+
+    va_start(ap, fmt);
+    n = SinkVPrintf(s, fmt, ap);
+    va_end(ap);
+
+    return n;
+}
+
+
+bool SinkFlush(Sink s)
+{
+    if(s->write != NULL)
+    {
+        flushBuf(s);
+    }
+
+    if(s->f != NULL && (fflush(s->f) != 0 || ferror(s->f)))
+    {
+        s->failed = true;
+    }
+
+    return !s->failed;
+}
+
+
+char *SinkTakeBuffer(Sink s, size_t *len)
+{
+    char *buf;
+
+    *len = 0;
+
+    if(s->write != NULL || s->failed)
+    {
+        return NULL;
+    }
+
+    /* Hand over the buffer, replacing it with an empty one */
+    buf = s->buf;
+    s->buf = malloc(SINK_BUF_INITIAL);
+    if(s->buf == NULL)
+    {
+        s->buf = buf;
+        return NULL;
+    }
+
+    buf[s->len] = '\0';
+    *len = s->len;
+
+    s->len  = 0;
+    s->size = SINK_BUF_INITIAL;
+
+    return buf;
+}
+
+
+bool SinkDestroy(Sink s)
+{
+    bool ok;
+
+    if(s == NULL)
+    {
+        return true;
+    }
+
+    ok = SinkFlush(s);
+
+    free(s->buf);
+    free(s);
+
+    return ok;
+}
+
+/* END OF FILE */
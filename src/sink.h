@@ -0,0 +1,126 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * Output sinks.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+
+#ifndef SINK_H
+#define SINK_H
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/** A destination for rendered output.
+ * Output is either kept in a growable memory buffer, or gathered in a large
+ * buffer and passed on in big writes to a FILE or a file descriptor.  Once a write fails, later writes are discarded and the failure
+ * is reported when the sink is flushed or destroyed.
+ *
+ * A sink is not thread safe, but different threads may write to it in turn
+ * if they are otherwise synchronised.
+ */
+typedef struct SinkTag *Sink;
+
+/*****************************************************************************
+ * Global Variable Declarations
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Global Function Declarations
+ *****************************************************************************/
+
+/** Create a sink collecting output in memory.
+ * The output is retrieved with SinkTakeBuffer().
+ *
+ * \returns  The sink, or NULL if memory was exhausted.
+ */
+Sink  SinkCreateBuffer(void);
+
+/** Create a sink writing to an open file.
+ * SinkFlush() also flushes \a f, which is not closed when the sink is
+ * destroyed.
+ */
+Sink  SinkCreateFile(FILE *f);
+
+/** Create a sink writing to an open file descriptor.
+ * Writes are retried until complete, and \a fd is not closed when the sink
+ * is destroyed.
+ */
+Sink  SinkCreateFd(int fd);
+
+/** Write some bytes to a sink.
+ *
+ * \retval false  If this or an earlier write failed.
+ */
+bool  SinkWrite(Sink s, const void *buf, size_t len);
+
+/** Write formatted output to a sink, as fprintf().
+ *
+ * \returns  The count of bytes written, or a negative value on failure.
+ */
+int   SinkPrintf(Sink s, const char *fmt, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+/** Write formatted output to a sink, as vfprintf().
+ */
+int   SinkVPrintf(Sink s, const char *fmt, va_list ap);
+
+/** Pass any buffered output on from a sink.
+ *
+ * \retval false  If any write to the sink has failed.
+ */
+bool  SinkFlush(Sink s);
+
+/** Take the output collected by a sink created with SinkCreateBuffer().
+ * The buffer is nul terminated, though \a len does not count the nul, and
+ * the sink is left empty.
+ *
+ * \param[in]     s    The sink.
+ * \param[in,out] len  Pointer to be filled with the length of the output.
+ * \returns  The output, which is owned by the caller and must be free()'d,
+ *            or NULL if the sink is not a buffer or a write failed.
+ */
+char *SinkTakeBuffer(Sink s, size_t *len);
+
+/** Flush and release a sink.
+ *
+ * \retval false  If any write to the sink has failed.
+ */
+bool  SinkDestroy(Sink s);
+
+#endif /* SINK_H */
+
+/* END OF FILE */
@@ -29,18 +29,52 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
+#include <zlib.h>
 #include "adraw_int.h"
 #include "safe.h"
 #include "utf8.h"
 
+/***************************************************************************
+ * Manifest Constants
+ ***************************************************************************/
+
+/** Size of the buffer in which output is gathered before writing. */
+#define SVG_BUF_SIZE 16384
+
+/** Maximum number of colours given classes in compact output. */
+#define SVG_MAX_CLASSES 64
+
+/** Class index used for an element drawn in its default colour. */
+#define SVG_NO_CLASS UINT_MAX
+
+/** Maximum number of triangles defined for reuse in compact output. */
+#define SVG_MAX_SHAPES 16
+
+/***************************************************************************
+ * Macros
+ ***************************************************************************/
+
+/** Write a string literal, whose length is known at compile time. */
+#define svgPutLit(context, lit) svgPutN(context, lit, sizeof(lit) - 1)
+
 /***************************************************************************
  * Local types
  ***************************************************************************/
 
 typedef struct SvgContextTag
 {
-    /** Output file. */
-    FILE        *of;
+    /** Output sink. */
+    Sink         out;
+
+    /** Set if writing to \a out has failed. */
+    bool         failed;
+
+    /** Count of bytes in \a buf. */
+    size_t       bufLen;
+
+    /** Output waiting to be written to \a out. */
+    char         buf[SVG_BUF_SIZE];
 
     /** Current pen colour name. */
     const char  *penColName;
@@ -48,10 +82,57 @@ typedef struct SvgContextTag
     /** Current background pen colour name. */
     const char  *penBgColName;
 
+    /** Storage for \a penColName if given as an RGB value. */
+    char         penColBuf[10];
+
+    /** Storage for \a penBgColName if given as an RGB value. */
+    char         penBgColBuf[10];
+
     int          fontPoints;
+
+    /** If true, write the compact form of SVG described by ADrawOpts. */
+    bool         compact;
+
+    /** Current pen and background pen colours. */
+    ADrawColour  penCol, penBgCol;
+
+    /** Colours for which compact output has defined classes.  The classes
+     *  for the colour at index i are named si for strokes and fi for fills.
+     */
+    ADrawColour  classCol[SVG_MAX_CLASSES];
+    unsigned int nClasses;
+
+    /** Triangles defined for reuse in compact output, given as the offsets
+     *  of the second and third points from the first.  The triangle at
+     *  index i has the id ai.
+     */
+    int          shape[SVG_MAX_SHAPES][4];
+    unsigned int nShapes;
+
+    /** If true, compact output has a path of solid lines open, which lines
+     *  of the same colour are added to until something else is drawn.
+     */
+    bool         pathOpen;
+
+    /** The current point of the open path. */
+    unsigned int pathX, pathY;
+
+    /** If true, output is gzip compressed through \a z into \a zbuf. */
+    bool         gzip;
+    z_stream     z;
+    unsigned char zbuf[SVG_BUF_SIZE];
 }
 SvgContext;
 
+/** State for measuring text without producing output.
+ */
+typedef struct SvgMetricsTag
+{
+    /** Point size of the current font. */
+    int          fontPoints;
+}
+SvgMetrics;
+
 typedef struct
 {
     int capheight, xheight, ascender, descender;
@@ -114,131 +195,893 @@ static SvgContext *getSvgCtx(struct ADrawTag *ctx)
     return (SvgContext *)ctx->internal;
 }
 
-/** Get the context pointer from an ADraw structure.
+/** Compress some output, writing the compressed data as it is produced.
+ */
+static void svgDeflate(SvgContext *context, const char *s, size_t n, int flush)
+{
+    context->z.next_in  = (Bytef *)s;
+    context->z.avail_in = n;
+
+    do
+    {
+        size_t len;
+        int    r;
+
+        context->z.next_out  = context->zbuf;
+        context->z.avail_out = sizeof(context->zbuf);
+
+        r = deflate(&context->z, flush);
+        if(r == Z_STREAM_ERROR)
+        {
+            context->failed = true;
+            return;
+        }
+
+        len = sizeof(context->zbuf) - context->z.avail_out;
+        if(!SinkWrite(context->out, context->zbuf, len))
+        {
+            context->failed = true;
+        }
+    }
+    while(context->z.avail_out == 0);
+}
+
+
+/** Write some output to the sink, compressing it if needed.
+ */
+static void svgWrite(SvgContext *context, const char *s, size_t n)
+{
+    if(context->gzip)
+    {
+        svgDeflate(context, s, n, Z_NO_FLUSH);
+    }
+    else if(!SinkWrite(context->out, s, n))
+    {
+        context->failed = true;
+    }
+}
+
+
+/** Write out any buffered output.
+ */
+static void svgFlush(SvgContext *context)
+{
+    if(context->bufLen > 0)
+    {
+        svgWrite(context, context->buf, context->bufLen);
+        context->bufLen = 0;
+    }
+}
+
+
+/** Write some number of bytes to the output.
+ */
+static void svgPutN(SvgContext *context, const char *s, size_t n)
+{
+    if(context->bufLen + n > SVG_BUF_SIZE)
+    {
+        svgFlush(context);
+
+        /* Large strings bypass the buffer */
+        if(n > SVG_BUF_SIZE)
+        {
+            svgWrite(context, s, n);
+            return;
+        }
+    }
+
+    memcpy(&context->buf[context->bufLen], s, n);
+    context->bufLen += n;
+}
+
+
+/** Write a nul terminated string to the output.
+ */
+static void svgPuts(SvgContext *context, const char *s)
+{
+    svgPutN(context, s, strlen(s));
+}
+
+
+/** Write an unsigned integer in decimal, as printf("%u").
+ */
+static void svgPutU(SvgContext *context, unsigned int v)
+{
+    char  digits[12];
+    char *d = &digits[sizeof(digits)];
+
+    do
+    {
+        *--d = '0' + (v % 10);
+        v /= 10;
+    }
+    while(v != 0);
+
+    svgPutN(context, d, &digits[sizeof(digits)] - d);
+}
+
+
+/** Write an unsigned integer in lower case hex, as printf("%x").
+ */
+static void svgPutX(SvgContext *context, unsigned int v)
+{
+    static const char hex[] = "0123456789abcdef";
+    char  digits[8];
+    char *d = &digits[sizeof(digits)];
+
+    do
+    {
+        *--d = hex[v & 0xf];
+        v >>= 4;
+    }
+    while(v != 0);
+
+    svgPutN(context, d, &digits[sizeof(digits)] - d);
+}
+
+
+/** Write an attribute with an unsigned value.
+ * \param attr  The attribute name and opening quote, e.g. " x=\"".
+ */
+static void svgPutAttrU(SvgContext *context, const char *attr, unsigned int v)
+{
+    svgPuts(context, attr);
+    svgPutU(context, v);
+    svgPutLit(context, "\"");
+}
+
+
+/** Write an x,y pair, as used in polygon points.
+ */
+static void svgPutPoint(SvgContext *context, unsigned int x, unsigned int y)
+{
+    svgPutU(context, x);
+    svgPutLit(context, ",");
+    svgPutU(context, y);
+}
+
+
+/** Get the SVG name of some colour, or NULL if it has no name.
+ */
+static const char *svgColour(ADrawColour col)
+{
+    switch(col)
+    {
+        case ADRAW_COL_WHITE:
+            return "white";
+
+        case ADRAW_COL_BLACK:
+            return "black";
+
+        case ADRAW_COL_BLUE:
+            return "blue";
+
+        case ADRAW_COL_RED:
+            return "red";
+
+        case ADRAW_COL_GREEN:
+            return "green";
+
+        default:
+            return NULL;
+    }
+}
+
+
+/** Write a signed number, as used in path data and points.
+ * A separating space is needed between numbers, but a minus sign will do.
+ *
+ * \param first  If true, the number follows a command letter and needs no
+ *                separator.
+ */
+static void svgPutPathI(SvgContext *context, int v, bool first)
+{
+    if(v < 0)
+    {
+        svgPutLit(context, "-");
+        svgPutU(context, -(unsigned int)v);
+    }
+    else
+    {
+        if(!first)
+        {
+            svgPutLit(context, " ");
+        }
+        svgPutU(context, v);
+    }
+}
+
+
+/** Write a colour as its name, or as an RGB value if it has no name.
  */
-static FILE *getSvgFile(struct ADrawTag *ctx)
+static void svgPutColour(SvgContext *context, ADrawColour col)
 {
-    return getSvgCtx(ctx)->of;
+    const char *name = svgColour(col);
+
+    if(name != NULL)
+    {
+        svgPuts(context, name);
+    }
+    else
+    {
+        static const char hex[] = "0123456789ABCDEF";
+        char         rgb[6];
+        unsigned int t;
+
+        for(t = 0; t < 6; t++)
+        {
+            rgb[t] = hex[(col >> (20 - t * 4)) & 0xf];
+        }
+
+        svgPutLit(context, "#");
+        svgPutN(context, rgb, sizeof(rgb));
+    }
 }
 
-static const char *getSvgPen(struct ADrawTag *ctx)
+/** Given a font metric measurement, return device dependent units.
+ * Font metric data is stored as 1/1000th of a point, and therefore
+ * needs to be multiplied by the font point size and divided by
+ * 1000 to give a value in device dependent units.
+ */
+static int pointSpace(int fontPoints, long thousanths)
+{
+    return ((thousanths * fontPoints) + 500) / 1000;
+}
+
+
+/** Given a font metric measurement, return device dependent units.
+ * This scales the measurement by the current font size of the context.
+ */
+static int getSpace(struct ADrawTag *ctx, long thousanths)
+{
+    return pointSpace(getSvgCtx(ctx)->fontPoints, thousanths);
+}
+
+
+/** Get the point size of some font size.
+ */
+static int getFontPoints(ADrawFontSize size)
+{
+    switch(size)
+    {
+        case ADRAW_FONT_TINY:
+            return 8;
+
+        case ADRAW_FONT_SMALL:
+            return 12;
+
+        default:
+            assert(0);
+            return 12;
+    }
+}
+
+
+/** Measure the width of some text at some point size.
+ */
+static unsigned int measureWidth(int fontPoints, const char *string)
+{
+    unsigned long width = 0;
+
+    while(*string != '\0')
+    {
+        int           i = *string & 0xff;
+        unsigned long w = SvgHelvetica.widths[i];
+
+        /* Ignore undefined characters */
+        width += w > 0 ? w : 0;
+
+        string++;
+    }
+
+    return pointSpace(fontPoints, width);
+}
+
+
+/** Compute a point on an ellipse.
+ * This computes the point on an ellipse.
+ *
+ * \param[in] cx,cy   Center of the ellipse.
+ * \param[in] w,h     Ellipse width and height.
+ * \param[in] a       Angle in degrees.
+ * \param[in,out] x,y Pointer to be populated with result co-ordinates.
+ */
+static void arcPoint(float         cx,
+                     float         cy,
+                     float         w,
+                     float         h,
+                     float         a,
+                     unsigned int *x,
+                     unsigned int *y)
+{
+    float rad = (a * M_PI) / 180.0f;
+
+    /* Compute point, noting this is for SVG co-ordinate system */
+    *x = round(cx + ((w / 2.0f) * cos(rad)));
+    *y = round(cy + ((h / 2.0f) * sin(rad)));
+}
+
+
+/** Check if a character may be written to SVG text as it is.
+ */
+static bool isPlain(char c)
+{
+    return c != '\0' && (c & 0x80) == 0 &&
+           c != '<' && c != '>' && c != '"' && c != '&';
+}
+
+
+/** Write out a line of text, escaping special characters.
+ * Runs of characters that need no escaping are copied in one go.
+ */
+static void writeEscaped(SvgContext *context, const char *string)
+{
+    while(*string != '\0')
+    {
+        const char   *run = string;
+        unsigned int  code, bytes;
+
+        while(isPlain(*string))
+        {
+            string++;
+        }
+
+        svgPutN(context, run, string - run);
+
+        switch(*string)
+        {
+            case '\0': return;
+            case '<': svgPutLit(context, "&lt;"); break;
+            case '>': svgPutLit(context, "&gt;"); break;
+            case '"': svgPutLit(context, "&quot;"); break;
+            case '&': svgPutLit(context, "&amp;"); break;
+            default:
+                if(Utf8Decode(string, &code, &bytes))
+                {
+                    svgPutLit(context, "&#x");
+                    svgPutX(context, code);
+                    svgPutLit(context, ";");
+                    string += bytes - 1;
+                }
+                else
+                {
+                    svgPutN(context, string, 1);
+                }
+                break;
+        }
+
+        string++;
+    }
+}
+
+
+/***************************************************************************
+ * Compact output
+ ***************************************************************************/
+
+/** Get the class for some colour in compact output.
+ * A class is defined for each colour when it is first used, which must be
+ * before the element using it is started.
+ *
+ * \param col  The colour of the element.
+ * \param def  The colour that the element has by default.
+ * \returns    The class index, SVG_NO_CLASS if \a col is the default, or
+ *              SVG_MAX_CLASSES if there are too many colours for classes.
+ */
+static unsigned int svgColourClass(SvgContext *context,
+                                   ADrawColour col,
+                                   ADrawColour def)
+{
+    unsigned int t;
+
+    if(col == def)
+    {
+        return SVG_NO_CLASS;
+    }
+
+    for(t = 0; t < context->nClasses; t++)
+    {
+        if(context->classCol[t] == col)
+        {
+            return t;
+        }
+    }
+
+    if(t == SVG_MAX_CLASSES)
+    {
+        return SVG_MAX_CLASSES;
+    }
+
+    context->classCol[context->nClasses++] = col;
+
+    svgPutLit(context, "<style type=\"text/css\">.s");
+    svgPutU(context, t);
+    svgPutLit(context, "{stroke:");
+    svgPutColour(context, col);
+    svgPutLit(context, "}.f");
+    svgPutU(context, t);
+    svgPutLit(context, "{fill:");
+    svgPutColour(context, col);
+    svgPutLit(context, "}</style>\n");
+
+    return t;
+}
+
+
+/** Write the class attribute of an element in compact output.
+ *
+ * \param type   's' if the element is stroked, or 'f' if it is filled.
+ * \param cls    The colour class from svgColourClass().
+ * \param col    The colour, given as a style if it has no class.
+ * \param extra  Other classes for the element, or NULL.
+ */
+static void svgPutClass(SvgContext  *context,
+                        char         type,
+                        unsigned int cls,
+                        ADrawColour  col,
+                        const char  *extra)
+{
+    if(cls == SVG_MAX_CLASSES)
+    {
+        /* A style overrides the style sheet, where an attribute wouldn't */
+        if(type == 's')
+        {
+            svgPutLit(context, " style=\"stroke:");
+        }
+        else
+        {
+            svgPutLit(context, " style=\"fill:");
+        }
+        svgPutColour(context, col);
+        svgPutLit(context, "\"");
+
+        cls = SVG_NO_CLASS;
+    }
+
+    if(cls != SVG_NO_CLASS || extra != NULL)
+    {
+        svgPutLit(context, " class=\"");
+        if(cls != SVG_NO_CLASS)
+        {
+            svgPutN(context, &type, 1);
+            svgPutU(context, cls);
+            if(extra != NULL)
+            {
+                svgPutLit(context, " ");
+            }
+        }
+        if(extra != NULL)
+        {
+            svgPuts(context, extra);
+        }
+        svgPutLit(context, "\"");
+    }
+}
+
+
+/** End any open path in compact output.
+ * This must be done before any other element is written.
+ */
+static void svgEndPath(SvgContext *context)
+{
+    if(context->pathOpen)
+    {
+        svgPutLit(context, "\"/>\n");
+        context->pathOpen = false;
+    }
+}
+
+
+/** Move to a point to start drawing a line or arc in compact output.
+ * Solid lines are added to the open path, if any, with the move given
+ * relative to its current point.  Dotted lines each get their own path,
+ * so that the dots of each start from its first point.
+ */
+static void svgPathMove(SvgContext  *context,
+                        unsigned int x,
+                        unsigned int y,
+                        bool         dotted)
+{
+    if(dotted)
+    {
+        svgEndPath(context);
+    }
+
+    if(!context->pathOpen)
+    {
+        const unsigned int cls = svgColourClass(context, context->penCol, ADRAW_COL_BLACK);
+
+        svgPutLit(context, "<path");
+        svgPutClass(context, 's', cls, context->penCol, dotted ? "d" : NULL);
+        svgPutLit(context, " d=\"M");
+        svgPutU(context, x);
+        svgPutLit(context, " ");
+        svgPutU(context, y);
+
+        context->pathOpen = true;
+    }
+    else if(x != context->pathX || y != context->pathY)
+    {
+        svgPutLit(context, "m");
+        svgPutPathI(context, x - context->pathX, true);
+        svgPutPathI(context, y - context->pathY, false);
+    }
+
+    context->pathX = x;
+    context->pathY = y;
+}
+
+
+/** Add a line from the current point to the open path in compact output.
+ */
+static void svgPathLine(SvgContext  *context,
+                        unsigned int x,
+                        unsigned int y)
+{
+    if(y == context->pathY)
+    {
+        svgPutLit(context, "h");
+        svgPutPathI(context, x - context->pathX, true);
+    }
+    else if(x == context->pathX)
+    {
+        svgPutLit(context, "v");
+        svgPutPathI(context, y - context->pathY, true);
+    }
+    else
+    {
+        svgPutLit(context, "l");
+        svgPutPathI(context, x - context->pathX, true);
+        svgPutPathI(context, y - context->pathY, false);
+    }
+
+    context->pathX = x;
+    context->pathY = y;
+}
+
+
+/** Write a filled rectangle in compact output.
+ * Rectangles are white unless given a class, as they are most often the
+ * background of text.
+ */
+static void svgCompactRect(SvgContext  *context,
+                           ADrawColour  col,
+                           unsigned int x1,
+                           unsigned int y1,
+                           unsigned int x2,
+                           unsigned int y2)
+{
+    unsigned int cls;
+
+    svgEndPath(context);
+    cls = svgColourClass(context, col, ADRAW_COL_WHITE);
+
+    svgPutAttrU(context, "<rect x=\"", x1 < x2 ? x1 : x2);
+    svgPutAttrU(context, " y=\"", y1 < y2 ? y1 : y2);
+    svgPutAttrU(context, " width=\"", x1 < x2 ? x2 - x1 : x1 - x2);
+    svgPutAttrU(context, " height=\"", y1 < y2 ? y2 - y1 : y1 - y2);
+    svgPutClass(context, 'f', cls, col, NULL);
+    svgPutLit(context, "/>\n");
+}
+
+
+/** Write a filled triangle in compact output.
+ * Each shape of triangle, such as an arrow head, is defined once and then
+ * used at each position it is drawn.
+ */
+static void svgCompactTriangle(SvgContext  *context,
+                               unsigned int x1,
+                               unsigned int y1,
+                               unsigned int x2,
+                               unsigned int y2,
+                               unsigned int x3,
+                               unsigned int y3)
+{
+    const int    d[4] = { x2 - x1, y2 - y1, x3 - x1, y3 - y1 };
+    unsigned int cls, t;
+
+    svgEndPath(context);
+
+    for(t = 0; t < context->nShapes; t++)
+    {
+        if(memcmp(context->shape[t], d, sizeof(d)) == 0)
+        {
+            break;
+        }
+    }
+
+    /* Draw the triangle as it is if there are too many shapes */
+    if(t == SVG_MAX_SHAPES)
+    {
+        cls = svgColourClass(context, context->penCol, ADRAW_COL_BLACK);
+
+        svgPutLit(context, "<polygon");
+        svgPutClass(context, 'f', cls, context->penCol, NULL);
+        svgPutLit(context, " points=\"");
+        svgPutPoint(context, x1, y1);
+        svgPutLit(context, " ");
+        svgPutPoint(context, x2, y2);
+        svgPutLit(context, " ");
+        svgPutPoint(context, x3, y3);
+        svgPutLit(context, "\"/>\n");
+        return;
+    }
+
+    /* Define the shape with the first point at the origin */
+    if(t == context->nShapes)
+    {
+        memcpy(context->shape[t], d, sizeof(d));
+        context->nShapes++;
+
+        svgPutLit(context, "<defs><polygon id=\"a");
+        svgPutU(context, t);
+        svgPutLit(context, "\" points=\"0,0 ");
+        svgPutPathI(context, d[0], true);
+        svgPutLit(context, ",");
+        svgPutPathI(context, d[1], true);
+        svgPutLit(context, " ");
+        svgPutPathI(context, d[2], true);
+        svgPutLit(context, ",");
+        svgPutPathI(context, d[3], true);
+        svgPutLit(context, "\"/></defs>\n");
+    }
+
+    cls = svgColourClass(context, context->penCol, ADRAW_COL_BLACK);
+
+    svgPutLit(context, "<use xlink:href=\"#a");
+    svgPutU(context, t);
+    svgPutLit(context, "\"");
+    svgPutAttrU(context, " x=\"", x1);
+    svgPutAttrU(context, " y=\"", y1);
+    svgPutClass(context, 'f', cls, context->penCol, NULL);
+    svgPutLit(context, "/>\n");
+}
+
+
+/***************************************************************************
+ * Output
+ ***************************************************************************/
+
+static void svgRect(SvgContext   *context,
+                    const char   *colour,
+                    unsigned int  x1,
+                    unsigned int  y1,
+                    unsigned int  x2,
+                    unsigned int  y2)
 {
-    return getSvgCtx(ctx)->penColName;
+    svgPutLit(context, "<polygon fill=\"");
+    svgPuts(context, colour);
+    svgPutLit(context, "\" points=\"");
+    svgPutPoint(context, x1, y1);
+    svgPutLit(context, " ");
+    svgPutPoint(context, x2, y1);
+    svgPutLit(context, " ");
+    svgPutPoint(context, x2, y2);
+    svgPutLit(context, " ");
+    svgPutPoint(context, x1, y2);
+    svgPutLit(context, "\"/>\n");
 }
 
-static const char *getSvgBgPen(struct ADrawTag *ctx)
-{
-    return getSvgCtx(ctx)->penBgColName;
-}
 
-/** Given a font metric measurement, return device dependent units.
- * Font metric data is stored as 1/1000th of a point, and therefore
- * needs to be multiplied by the font point size and divided by
- * 1000 to give a value in device dependent units.
+/** Write a line, optionally dotted.
  */
-static int getSpace(struct ADrawTag *ctx, long thousanths)
+static void svgLine(SvgContext   *context,
+                    unsigned int  x1,
+                    unsigned int  y1,
+                    unsigned int  x2,
+                    unsigned int  y2,
+                    bool          dotted)
 {
-    return ((thousanths * getSvgCtx(ctx)->fontPoints) + 500) / 1000;
+    if(context->compact)
+    {
+        svgPathMove(context, x1, y1, dotted);
+        svgPathLine(context, x2, y2);
+        if(dotted)
+        {
+            svgEndPath(context);
+        }
+        return;
+    }
+
+    svgPutAttrU(context, "<line x1=\"", x1);
+    svgPutAttrU(context, " y1=\"", y1);
+    svgPutAttrU(context, " x2=\"", x2);
+    svgPutAttrU(context, " y2=\"", y2);
+    svgPutLit(context, " stroke=\"");
+    svgPuts(context, context->penColName);
+    if(dotted)
+    {
+        svgPutLit(context, "\" stroke-dasharray=\"2,2\"/>\n");
+    }
+    else
+    {
+        svgPutLit(context, "\"/>\n");
+    }
 }
 
 
-/** Compute a point on an ellipse.
- * This computes the point on an ellipse.
- *
- * \param[in] cx,cy   Center of the ellipse.
- * \param[in] w,h     Ellipse width and height.
- * \param[in] a       Angle in degrees.
- * \param[in,out] x,y Pointer to be populated with result co-ordinates.
+/** Write a line of text over a background box in compact output.
+ * The font and text colour come from the style sheet, and classes are only
+ * given for tiny text, the text anchor and colours other than black.
+ * The parameters are as svgText().
  */
-static void arcPoint(float         cx,
-                     float         cy,
-                     float         w,
-                     float         h,
-                     float         a,
-                     unsigned int *x,
-                     unsigned int *y)
+static void svgCompactText(struct ADrawTag *ctx,
+                           unsigned int     x1,
+                           unsigned int     x2,
+                           unsigned int     x,
+                           unsigned int     y,
+                           const char      *anchor,
+                           const char      *string,
+                           const char      *url)
 {
-    float rad = (a * M_PI) / 180.0f;
+    SvgContext  *context = getSvgCtx(ctx);
+    const int    height = getSpace(ctx, SvgHelvetica.ascender - SvgHelvetica.descender);
+    char         extra[4];
+    unsigned int cls, n = 0;
 
-    /* Compute point, noting this is for SVG co-ordinate system */
-    *x = round(cx + ((w / 2.0f) * cos(rad)));
-    *y = round(cy + ((h / 2.0f) * sin(rad)));
-}
+    svgCompactRect(context, context->penBgCol, x1, y - height + 1, x2, y - 1);
 
+    y += getSpace(ctx, SvgHelvetica.descender);
 
-/** Write out a line of text, escaping special characters.
- */
-static void writeEscaped(struct ADrawTag *ctx, const char *string)
-{
-    FILE *f = getSvgFile(ctx);
+    /* Find the classes for the text */
+    cls = svgColourClass(context, context->penCol, ADRAW_COL_BLACK);
 
-    while(*string != '\0')
+    if(context->fontPoints != getFontPoints(ADRAW_FONT_SMALL))
     {
-        unsigned int code, bytes;
+        extra[n++] = 't';
+    }
 
-        switch(*string)
+    if(anchor)
+    {
+        if(n > 0)
         {
-            case '<': fprintf(f, "&lt;"); break;
-            case '>': fprintf(f, "&gt;"); break;
-            case '"': fprintf(f, "&quot;"); break;
-            case '&': fprintf(f, "&amp;"); break;
-            default:
-                if(Utf8Decode(string, &code, &bytes))
-                {
-                    fprintf(f, "&#x%x;", code);
-                    string += bytes - 1;
-                }
-                else
-                {
-                    fputc(*string, f);
-                }
-                break;
-
+            extra[n++] = ' ';
         }
+        extra[n++] = strcmp(anchor, "middle") == 0 ? 'm' : 'e';
+    }
 
-        string++;
+    extra[n] = '\0';
+
+    if(url)
+    {
+        svgPutLit(context, "<a xlink:href=\"");
+        svgPuts(context, url);
+        svgPutLit(context, "\">");
     }
-}
 
+    svgPutAttrU(context, "<text x=\"", x);
+    svgPutAttrU(context, " y=\"", y);
+    svgPutAttrU(context, " textLength=\"", ctx->textWidth(ctx, string));
+    svgPutClass(context, 'f', cls, context->penCol, n > 0 ? extra : NULL);
+    svgPutLit(context, ">");
+    writeEscaped(context, string);
+    svgPutLit(context, "</text>\n");
+
+    if(url)
+    {
+        svgPutLit(context, "</a>");
+    }
+}
 
 
-static void svgRect(struct ADrawTag *ctx,
-                    const char      *colour,
+/** Write a line of text over a background box.
+ *
+ * \param ctx     The drawing context.
+ * \param x1,x2   The horizontal extent of the background box.
+ * \param x       The x position of the text anchor.
+ * \param y       The y position of the text base.
+ * \param anchor  The text-anchor attribute value, or NULL for the start.
+ * \param string  The text to write.
+ * \param url     A URL to link from the text, or NULL.
+ */
+static void svgText(struct ADrawTag *ctx,
                     unsigned int     x1,
-                    unsigned int     y1,
                     unsigned int     x2,
-                    unsigned int     y2)
+                    unsigned int     x,
+                    unsigned int     y,
+                    const char      *anchor,
+                    const char      *string,
+                    const char      *url)
 {
-    fprintf(getSvgFile(ctx),
-            "<polygon fill=\"%s\" points=\"%u,%u %u,%u %u,%u %u,%u\"/>\n",
-            colour,
-            x1, y1,
-            x2, y1,
-            x2, y2,
-            x1, y2);
-}
+    SvgContext *context = getSvgCtx(ctx);
+    const int   height = getSpace(ctx, SvgHelvetica.ascender - SvgHelvetica.descender);
 
-static const char *svgColour(ADrawColour col)
-{
-    switch(col)
+    if(context->compact)
     {
-        case ADRAW_COL_WHITE:
-            return "white";
+        svgCompactText(ctx, x1, x2, x, y, anchor, string, url);
+        return;
+    }
 
-        case ADRAW_COL_BLACK:
-            return "black";
+    svgRect(context, context->penBgColName, x1, y - height + 1, x2, y - 1);
 
-        case ADRAW_COL_BLUE:
-            return "blue";
+    y += getSpace(ctx, SvgHelvetica.descender);
 
-        case ADRAW_COL_RED:
-            return "red";
+    if(url)
+    {
+        svgPutLit(context, "<a xlink:href=\"");
+        svgPuts(context, url);
+        svgPutLit(context, "\">");
+    }
 
-        case ADRAW_COL_GREEN:
-            return "green";
+    svgPutAttrU(context, "<text x=\"", x);
+    svgPutAttrU(context, " y=\"", y);
+    svgPutAttrU(context, " textLength=\"", ctx->textWidth(ctx, string));
+    svgPutAttrU(context, " font-family=\"Helvetica\" font-size=\"", context->fontPoints);
+    svgPutLit(context, " fill=\"");
+    svgPuts(context, context->penColName);
+    svgPutLit(context, "\"");
+    if(anchor)
+    {
+        svgPutLit(context, " text-anchor=\"");
+        svgPuts(context, anchor);
+        svgPutLit(context, "\"");
+    }
+    svgPutLit(context, ">");
+    writeEscaped(context, string);
+    svgPutLit(context, "</text>\n");
 
-        default:
-            return NULL;
+    if(url)
+    {
+        svgPutLit(context, "</a>");
+    }
+}
+
+
+/** Write an elliptical arc, optionally dotted.
+ */
+static void svgArc(SvgContext   *context,
+                   unsigned int  cx,
+                   unsigned int  cy,
+                   unsigned int  w,
+                   unsigned int  h,
+                   unsigned int  s,
+                   unsigned int  e,
+                   bool          dotted)
+{
+    unsigned int sx, sy, ex, ey;
+
+    /* Get start and end x,y */
+    arcPoint(cx, cy, w, h, s, &sx, &sy);
+    arcPoint(cx, cy, w, h, e, &ex, &ey);
+
+    if(context->compact)
+    {
+        svgPathMove(context, sx, sy, dotted);
+        svgPutLit(context, "a");
+        svgPutU(context, w / 2);
+        svgPutLit(context, " ");
+        svgPutU(context, h / 2);
+        svgPutLit(context, " 0 0 1");
+        svgPutPathI(context, ex - sx, false);
+        svgPutPathI(context, ey - sy, false);
+
+        context->pathX = ex;
+        context->pathY = ey;
+
+        if(dotted)
+        {
+            svgEndPath(context);
+        }
+        return;
+    }
+
+    svgPutLit(context, "<path d=\"M ");
+    svgPutU(context, sx);
+    svgPutLit(context, " ");
+    svgPutU(context, sy);
+    svgPutLit(context, " A");
+    svgPutPoint(context, w / 2, h / 2);
+    svgPutLit(context, " 0 0,1 ");
+    svgPutPoint(context, ex, ey);
+    svgPutLit(context, "\" stroke=\"");
+    svgPuts(context, context->penColName);
+    if(dotted)
+    {
+        svgPutLit(context, "\" fill=\"none\" stroke-dasharray=\"2,2\"/>");
+    }
+    else
+    {
+        svgPutLit(context, "\" fill=\"none\"/>");
     }
 }
 
@@ -250,20 +1093,7 @@ static const char *svgColour(ADrawColour col)
 unsigned int SvgTextWidth(struct ADrawTag *ctx,
                           const char *string)
 {
-    unsigned long width = 0;
-
-    while(*string != '\0')
-    {
-        int           i = *string & 0xff;
-        unsigned long w = SvgHelvetica.widths[i];
-
-        /* Ignore undefined characters */
-        width += w > 0 ? w : 0;
-
-        string++;
-    }
-
-    return getSpace(ctx, width);
+    return measureWidth(getSvgCtx(ctx)->fontPoints, string);
 }
 
 
@@ -279,10 +1109,7 @@ void SvgLine(struct ADrawTag *ctx,
              unsigned int     x2,
              unsigned int     y2)
 {
-    fprintf(getSvgFile(ctx),
-            "<line x1=\"%u\" y1=\"%u\" x2=\"%u\" y2=\"%u\" stroke=\"%s\"/>\n",
-            x1, y1, x2, y2, getSvgPen(ctx));
-
+    svgLine(getSvgCtx(ctx), x1, y1, x2, y2, false);
 }
 
 
@@ -292,9 +1119,7 @@ void SvgDottedLine(struct ADrawTag *ctx,
                    unsigned int     x2,
                    unsigned int     y2)
 {
-    fprintf(getSvgFile(ctx),
-            "<line x1=\"%u\" y1=\"%u\" x2=\"%u\" y2=\"%u\" stroke=\"%s\" stroke-dasharray=\"2,2\"/>\n",
-            x1, y1, x2, y2, getSvgPen(ctx));
+    svgLine(getSvgCtx(ctx), x1, y1, x2, y2, true);
 }
 
 
@@ -304,27 +1129,7 @@ void SvgTextR(struct ADrawTag *ctx,
               const char      *string,
               const char      *url)
 {
-    SvgContext *context = getSvgCtx(ctx);
-
-    svgRect(ctx, getSvgBgPen(ctx), x - 2, y - SvgTextHeight(ctx) + 1, x + SvgTextWidth(ctx, string), y - 1);
-
-    y += getSpace(ctx, SvgHelvetica.descender);
-
-    if(url)
-    {
-        fprintf(getSvgFile(ctx), "<a xlink:href=\"%s\">", url);
-    }
-
-    fprintf(getSvgFile(ctx),
-            "<text x=\"%u\" y=\"%u\" textLength=\"%u\" font-family=\"Helvetica\" font-size=\"%u\" fill=\"%s\">",
-            x - 1, y, SvgTextWidth(ctx, string), context->fontPoints, context->penColName);
-    writeEscaped(ctx, string);
-    fprintf(getSvgFile(ctx), "</text>\n");
-
-    if(url)
-    {
-        fprintf(getSvgFile(ctx), "</a>");
-    }
+    svgText(ctx, x - 2, x + ctx->textWidth(ctx, string), x - 1, y, NULL, string, url);
 }
 
 
@@ -334,27 +1139,7 @@ void SvgTextL(struct ADrawTag *ctx,
               const char      *string,
               const char      *url)
 {
-    SvgContext *context = getSvgCtx(ctx);
-
-    svgRect(ctx, getSvgBgPen(ctx), x - (SvgTextWidth(ctx, string) + 2), y - SvgTextHeight(ctx) + 1, x, y - 1);
-
-    y += getSpace(ctx, SvgHelvetica.descender);
-
-    if(url)
-    {
-        fprintf(getSvgFile(ctx), "<a xlink:href=\"%s\">", url);
-    }
-
-    fprintf(getSvgFile(ctx),
-            "<text x=\"%u\" y=\"%u\" textLength=\"%u\" font-family=\"Helvetica\" font-size=\"%u\" fill=\"%s\" text-anchor=\"end\">",
-            x, y, SvgTextWidth(ctx, string), context->fontPoints, context->penColName);
-    writeEscaped(ctx, string);
-    fprintf(getSvgFile(ctx), "</text>\n");
-
-    if(url)
-    {
-        fprintf(getSvgFile(ctx), "</a>");
-    }
+    svgText(ctx, x - (ctx->textWidth(ctx, string) + 2), x, x, y, "end", string, url);
 }
 
 
@@ -364,28 +1149,9 @@ void SvgTextC(struct ADrawTag *ctx,
               const char      *string,
               const char      *url)
 {
-    SvgContext  *context = getSvgCtx(ctx);
-    unsigned int hw = SvgTextWidth(ctx, string) / 2;
-
-    svgRect(ctx, getSvgBgPen(ctx), x - (hw + 2), y - SvgTextHeight(ctx) + 1, x + hw, y - 1);
-
-    y += getSpace(ctx, SvgHelvetica.descender);
+    unsigned int hw = ctx->textWidth(ctx, string) / 2;
 
-    if(url)
-    {
-        fprintf(getSvgFile(ctx), "<a xlink:href=\"%s\">", url);
-    }
-
-    fprintf(getSvgFile(ctx),
-            "<text x=\"%u\" y=\"%u\" textLength=\"%u\" font-family=\"Helvetica\" font-size=\"%u\" fill=\"%s\" text-anchor=\"middle\">",
-            x, y, SvgTextWidth(ctx, string), context->fontPoints, context->penColName);
-    writeEscaped(ctx, string);
-    fprintf(getSvgFile(ctx), "</text>\n");
-
-    if(url)
-    {
-        fprintf(getSvgFile(ctx), "</a>");
-    }
+    svgText(ctx, x - (hw + 2), x + hw, x, y, "middle", string, url);
 }
 
 
@@ -397,13 +1163,23 @@ void SvgFilledTriangle(struct ADrawTag *ctx,
                        unsigned int x3,
                        unsigned int y3)
 {
+    SvgContext *context = getSvgCtx(ctx);
+
+    if(context->compact)
+    {
+        svgCompactTriangle(context, x1, y1, x2, y2, x3, y3);
+        return;
+    }
 
-    fprintf(getSvgFile(ctx),
-            "<polygon fill=\"%s\" points=\"%u,%u %u,%u %u,%u\"/>\n",
-            getSvgPen(ctx),
-            x1, y1,
-            x2, y2,
-            x3, y3);
+    svgPutLit(context, "<polygon fill=\"");
+    svgPuts(context, context->penColName);
+    svgPutLit(context, "\" points=\"");
+    svgPutPoint(context, x1, y1);
+    svgPutLit(context, " ");
+    svgPutPoint(context, x2, y2);
+    svgPutLit(context, " ");
+    svgPutPoint(context, x3, y3);
+    svgPutLit(context, "\"/>\n");
 }
 
 
@@ -412,10 +1188,28 @@ void SvgFilledCircle(struct ADrawTag *ctx,
                      unsigned int y,
                      unsigned int r)
 {
-    fprintf(getSvgFile(ctx),
-            "<circle fill=\"%s\" cx=\"%u\" cy=\"%u\" r=\"%u\"/>\n",
-            getSvgPen(ctx),
-            x, y, r);
+    SvgContext *context = getSvgCtx(ctx);
+
+    if(context->compact)
+    {
+        unsigned int cls;
+
+        svgEndPath(context);
+        cls = svgColourClass(context, context->penCol, ADRAW_COL_BLACK);
+
+        svgPutLit(context, "<circle");
+        svgPutClass(context, 'f', cls, context->penCol, NULL);
+    }
+    else
+    {
+        svgPutLit(context, "<circle fill=\"");
+        svgPuts(context, context->penColName);
+        svgPutLit(context, "\"");
+    }
+    svgPutAttrU(context, " cx=\"", x);
+    svgPutAttrU(context, " cy=\"", y);
+    svgPutAttrU(context, " r=\"", r);
+    svgPutLit(context, "/>\n");
 }
 
 
@@ -425,7 +1219,16 @@ void SvgFilledRectangle(struct ADrawTag *ctx,
                         unsigned int x2,
                         unsigned int y2)
 {
-    svgRect(ctx, getSvgPen(ctx), x1, y1, x2, y2);
+    SvgContext *context = getSvgCtx(ctx);
+
+    if(context->compact)
+    {
+        svgCompactRect(context, context->penCol, x1, y1, x2, y2);
+    }
+    else
+    {
+        svgRect(context, context->penColName, x1, y1, x2, y2);
+    }
 }
 
 
@@ -437,15 +1240,7 @@ void SvgArc(struct ADrawTag *ctx,
             unsigned int s,
             unsigned int e)
 {
-    unsigned int sx, sy, ex, ey;
-
-    /* Get start and end x,y */
-    arcPoint(cx, cy, w, h, s, &sx, &sy);
-    arcPoint(cx, cy, w, h, e, &ex, &ey);
-
-    fprintf(getSvgFile(ctx),
-            "<path d=\"M %u %u A%u,%u 0 0,1 %u,%u\" stroke=\"%s\" fill=\"none\"/>",
-            sx, sy, w / 2, h / 2,  ex, ey, getSvgPen(ctx));
+    svgArc(getSvgCtx(ctx), cx, cy, w, h, s, e, false);
 }
 
 
@@ -457,31 +1252,30 @@ void SvgDottedArc(struct ADrawTag *ctx,
                   unsigned int s,
                   unsigned int e)
 {
-    unsigned int sx, sy, ex, ey;
-
-    /* Get start and end x,y */
-    arcPoint(cx, cy, w, h, s, &sx, &sy);
-    arcPoint(cx, cy, w, h, e, &ex, &ey);
-
-    fprintf(getSvgFile(ctx),
-            "<path d=\"M %u %u A%u,%u 0 0,1 %u,%u\" stroke=\"%s\" fill=\"none\" stroke-dasharray=\"2,2\"/>",
-            sx, sy, w / 2, h / 2,  ex, ey, getSvgPen(ctx));
+    svgArc(getSvgCtx(ctx), cx, cy, w, h, s, e, true);
 }
 
 
 void SvgSetPen(struct ADrawTag *ctx,
                ADrawColour      col)
 {
-    static char colCmd[10];
+    SvgContext *context = getSvgCtx(ctx);
+
+    /* The open path is drawn with the old pen */
+    if(context->compact && col != context->penCol)
+    {
+        svgEndPath(context);
+    }
 
-    getSvgCtx(ctx)->penColName = svgColour(col);
-    if(getSvgCtx(ctx)->penColName == NULL)
+    context->penCol     = col;
+    context->penColName = svgColour(col);
+    if(context->penColName == NULL)
     {
-        /* Print the RGB value into the local storage */
-        sprintf(colCmd, "#%06X", col);
+        /* Print the RGB value into the context storage */
+        sprintf(context->penColBuf, "#%06X", col);
 
-        /* Now set the colour name to the local store */
-        getSvgCtx(ctx)->penColName = colCmd;
+        /* Now set the colour name to the stored value */
+        context->penColName = context->penColBuf;
     }
 }
 
@@ -489,16 +1283,17 @@ void SvgSetPen(struct ADrawTag *ctx,
 void SvgSetBgPen(struct ADrawTag *ctx,
                  ADrawColour      col)
 {
-    static char colCmd[10];
+    SvgContext *context = getSvgCtx(ctx);
 
-    getSvgCtx(ctx)->penBgColName = svgColour(col);
-    if(getSvgCtx(ctx)->penBgColName == NULL)
+    context->penBgCol     = col;
+    context->penBgColName = svgColour(col);
+    if(context->penBgColName == NULL)
     {
-        /* Print the RGB value into the local storage */
-        sprintf(colCmd, "#%06X", col);
+        /* Print the RGB value into the context storage */
+        sprintf(context->penBgColBuf, "#%06X", col);
 
-        /* Now set the colour name to the local store */
-        getSvgCtx(ctx)->penBgColName = colCmd;
+        /* Now set the colour name to the stored value */
+        context->penBgColName = context->penBgColBuf;
     }
 }
 
@@ -508,69 +1303,73 @@ void SvgSetFontSize(struct ADrawTag *ctx,
 {
     SvgContext *context = getSvgCtx(ctx);
 
-    switch(size)
-    {
-        case ADRAW_FONT_TINY:
-            context->fontPoints = 8;
-            break;
-
-        case ADRAW_FONT_SMALL:
-            context->fontPoints = 12;
-            break;
-
-        default:
-            assert(0);
-    }
-
+    context->fontPoints = getFontPoints(size);
 }
 
 
 bool SvgClose(struct ADrawTag *ctx)
 {
     SvgContext *context = getSvgCtx(ctx);
+    bool        ok;
 
     /* Close the SVG */
-    fprintf(context->of, "</svg>\n");
+    svgEndPath(context);
+    svgPutLit(context, "</svg>\n");
+    svgFlush(context);
 
-    /* Close the output file */
-    if(context->of != stdout)
+    if(context->gzip)
     {
-        fclose(context->of);
+        svgDeflate(context, NULL, 0, Z_FINISH);
+        deflateEnd(&context->z);
     }
 
+    ok = !context->failed;
+
     /* Free and destroy context */
     free(context);
     ctx->internal = NULL;
 
-    return true;
+    return ok;
 }
 
 
 bool SvgInit(unsigned int     w,
              unsigned int     h,
-             const char      *file,
+             Sink             out,
+             const ADrawOpts *opts,
+             bool             gzip,
              struct ADrawTag *outContext)
 {
     SvgContext *context;
 
     /* Create context */
-    context = outContext->internal = malloc_s(sizeof(SvgContext));
+    context = outContext->internal = malloc(sizeof(SvgContext));
     if(context == NULL)
     {
+        fprintf(stderr, "SvgInit: Failed to allocate context\n");
         return false;
     }
 
-    /* Open the output file */
-    if(strcmp(file, "-") == 0)
-    {
-        context->of = stdout;
-    }
-    else
+    context->out      = out;
+    context->failed   = false;
+    context->bufLen   = 0;
+    context->compact  = opts != NULL && opts->svgCompact;
+    context->nClasses = 0;
+    context->nShapes  = 0;
+    context->pathOpen = false;
+    context->penCol   = ADRAW_COL_BLACK;
+    context->gzip     = gzip;
+
+    /* Write a gzip stream, rather than zlib's own format */
+    if(gzip)
     {
-        context->of = fopen(file, "wb");
-        if(!context->of)
+        memset(&context->z, 0, sizeof(context->z));
+        if(deflateInit2(&context->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         {
-            fprintf(stderr, "SvgInit: Failed to open output file '%s': %s\n", file, strerror(errno));
+            fprintf(stderr, "SvgInit: Failed to initialise zlib\n");
+            free(context);
+            outContext->internal = NULL;
             return false;
         }
     }
@@ -582,16 +1381,39 @@ bool SvgInit(unsigned int     w,
     /* Default to small font */
     SvgSetFontSize(outContext, ADRAW_FONT_SMALL);
 
-    fprintf(context->of, "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
-                         " \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n");
-
-    fprintf(context->of, "<svg version=\"1.1\"\n"
-                         " width=\"%upx\" height=\"%upx\"\n"
-                         " viewBox=\"0 0 %u %u\"\n"
-                         " xmlns=\"http://www.w3.org/2000/svg\" shape-rendering=\"crispEdges\"\n"
-                         " stroke-width=\"1\" text-rendering=\"geometricPrecision\"\n"
-                         " xmlns:xlink=\"http://www.w3.org/1999/xlink\">\n",
-                         w, h, w, h);
+    svgPutLit(context, "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
+                       " \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n");
+
+    svgPutLit(context, "<svg version=\"1.1\"\n width=\"");
+    svgPutU(context, w);
+    svgPutLit(context, "px\" height=\"");
+    svgPutU(context, h);
+    svgPutLit(context, "px\"\n viewBox=\"0 0 ");
+    svgPutU(context, w);
+    svgPutLit(context, " ");
+    svgPutU(context, h);
+    svgPutLit(context, "\"\n"
+                       " xmlns=\"http://www.w3.org/2000/svg\" shape-rendering=\"crispEdges\"\n"
+                       " stroke-width=\"1\" text-rendering=\"geometricPrecision\"\n"
+                       " xmlns:xlink=\"http://www.w3.org/1999/xlink\">\n");
+
+    /* Compact output gives the usual attributes in a style sheet */
+    if(context->compact)
+    {
+        svgPutLit(context, "<style type=\"text/css\">"
+                           "path{fill:none;stroke:black}"
+                           "text{font-family:Helvetica;font-size:");
+        svgPutU(context, getFontPoints(ADRAW_FONT_SMALL));
+        svgPutLit(context, "px}"
+                           "rect{fill:white}"
+                           ".d{stroke-dasharray:2,2}"
+                           ".t{font-size:");
+        svgPutU(context, getFontPoints(ADRAW_FONT_TINY));
+        svgPutLit(context, "px}"
+                           ".m{text-anchor:middle}"
+                           ".e{text-anchor:end}"
+                           "</style>\n");
+    }
 
     /* Now fill in the function pointers */
     outContext->line            = SvgLine;
@@ -614,4 +1436,54 @@ bool SvgInit(unsigned int     w,
     return true;
 }
 
+
+static unsigned int SvgMetricsTextWidth(ADrawMetrics *ctx, const char *string)
+{
+    return measureWidth(((SvgMetrics *)ctx->internal)->fontPoints, string);
+}
+
+
+static int SvgMetricsTextHeight(ADrawMetrics *ctx)
+{
+    return pointSpace(((SvgMetrics *)ctx->internal)->fontPoints,
+                      SvgHelvetica.ascender - SvgHelvetica.descender);
+}
+
+
+static void SvgMetricsSetFontSize(ADrawMetrics *ctx, ADrawFontSize size)
+{
+    ((SvgMetrics *)ctx->internal)->fontPoints = getFontPoints(size);
+}
+
+
+static bool SvgMetricsClose(ADrawMetrics *ctx)
+{
+    free(ctx->internal);
+    ctx->internal = NULL;
+
+    return true;
+}
+
+
+bool SvgMetricsInit(ADrawMetrics *outMetrics)
+{
+    SvgMetrics *metrics;
+
+    metrics = outMetrics->internal = malloc(sizeof(SvgMetrics));
+    if(metrics == NULL)
+    {
+        fprintf(stderr, "SvgMetricsInit: Failed to allocate context\n");
+        return false;
+    }
+
+    metrics->fontPoints = getFontPoints(ADRAW_FONT_SMALL);
+
+    outMetrics->textWidth   = SvgMetricsTextWidth;
+    outMetrics->textHeight  = SvgMetricsTextHeight;
+    outMetrics->setFontSize = SvgMetricsSetFontSize;
+    outMetrics->close       = SvgMetricsClose;
+
+    return true;
+}
+
 /* END OF FILE */
@@ -0,0 +1,193 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * String interning symbol table.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stdbool.h>
+#include <string.h>
+#include "arena.h"
+#include "symtab.h"
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/** Initial number of slots in the table, which must be a power of 2. */
+#define SYMTAB_MIN_SIZE 64
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/** A slot in the symbol table.
+ */
+typedef struct
+{
+    /** The interned string, or NULL if the slot is unused. */
+    const char   *str;
+
+    /** Length of the string, excluding the terminator. */
+    size_t        len;
+
+    /** Hash of the string, kept to speed comparisons and regrowth. */
+    unsigned int  hash;
+}
+SymTabSlot;
+
+struct SymTabTag
+{
+    Arena         arena;
+
+    /** Open addressed table of slots, never more than half full. */
+    SymTabSlot   *slot;
+    unsigned int  size;
+    unsigned int  used;
+};
+
+/*****************************************************************************
+ * Local Function Definitions
+ *****************************************************************************/
+
+/** Double the size of the table, rehashing all strings.
+ * The old slots are left in the arena, which costs at most as much
+ * memory as the final table.
+ *
+ * \retval false  If the new slots could not be allocated, in which case the
+ *                 table is unchanged.
+ */
+static bool grow(SymTab t)
+{
+    SymTabSlot  *old     = t->slot;
+    unsigned int oldSize = t->size;
+    SymTabSlot  *slot;
+    unsigned int i;
+
+    slot = ArenaZalloc(t->arena, sizeof(SymTabSlot) * oldSize * 2);
+    if(slot == NULL)
+    {
+        return false;
+    }
+
+    t->size = oldSize * 2;
+    t->slot = slot;
+
+    for(i = 0; i < oldSize; i++)
+    {
+        if(old[i].str != NULL)
+        {
+            unsigned int h = old[i].hash & (t->size - 1);
+
+            while(t->slot[h].str != NULL)
+            {
+                h = (h + 1) & (t->size - 1);
+            }
+
+            t->slot[h] = old[i];
+        }
+    }
+
+    return true;
+}
+
+/*****************************************************************************
+ * Global Function Definitions
+ *****************************************************************************/
+
+SymTab SymTabCreate(Arena arena)
+{
+    SymTab t = ArenaAlloc(arena, sizeof(struct SymTabTag));
+
+    if(t == NULL)
+    {
+        return NULL;
+    }
+
+    t->arena = arena;
+    t->size  = SYMTAB_MIN_SIZE;
+    t->used  = 0;
+    t->slot  = ArenaZalloc(arena, sizeof(SymTabSlot) * t->size);
+
+    return t->slot != NULL ? t : NULL;
+}
+
+
+const char *SymTabIntern(SymTab t, const char *s, size_t len)
+{
+    const unsigned int hash = SymTabHash(s, len);
+    unsigned int       h    = hash & (t->size - 1);
+    char              *str;
+
+    while(t->slot[h].str != NULL)
+    {
+        const SymTabSlot *slot = &t->slot[h];
+
+        if(slot->hash == hash && slot->len == len && memcmp(slot->str, s, len) == 0)
+        {
+            return slot->str;
+        }
+
+        h = (h + 1) & (t->size - 1);
+    }
+
+    /* Not found, so add a copy */
+    str = ArenaAlloc(t->arena, len + 1);
+    if(str == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(str, s, len);
+    str[len] = '\0';
+
+    t->slot[h].str  = str;
+    t->slot[h].len  = len;
+    t->slot[h].hash = hash;
+
+    /* Keep the table at most half full, so that probes always end */
+    if(++t->used * 2 > t->size && !grow(t))
+    {
+        return NULL;
+    }
+
+    return str;
+}
+
+
+unsigned int SymTabHash(const char *s, size_t len)
+{
+    unsigned int h = 2166136261u;
+
+    while(len > 0)
+    {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+        s++;
+        len--;
+    }
+
+    return h;
+}
+
+/* END OF FILE */
@@ -0,0 +1,80 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * String interning symbol table.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+/*****************************************************************************
+ * Header Files
+ *****************************************************************************/
+
+#include <stddef.h>
+#include "arena.h"
+
+/*****************************************************************************
+ * Preprocessor Macros & Constants
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Typedefs
+ *****************************************************************************/
+
+/** A table of interned strings.
+ * Each distinct string is stored once, so interned strings can be compared
+ * by pointer.  The table and its strings are held in an arena, and are
+ * released with it.
+ */
+typedef struct SymTabTag *SymTab;
+
+/*****************************************************************************
+ * Global Variable Declarations
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Global Function Declarations
+ *****************************************************************************/
+
+/** Create an empty symbol table in some arena.
+ *
+ * \returns  The table, or NULL if the arena is exhausted.
+ */
+SymTab        SymTabCreate(Arena arena);
+
+/** Intern a string.
+ *
+ * \param[in] t    The symbol table.
+ * \param[in] s    The string, which need not be NUL terminated.
+ * \param[in] len  The length of \a s.
+ * \returns The single copy of the string held in the table, or NULL if the
+ *           arena is exhausted, after which the table must not be used.
+ */
+const char   *SymTabIntern(SymTab t, const char *s, size_t len);
+
+/** Compute the hash value used for some string.
+ * This is the 32-bit FNV-1a hash, and may also be used by other tables.
+ */
+unsigned int  SymTabHash(const char *s, size_t len);
+
+#endif /* SYMTAB_H */
+
+/* END OF FILE */
@@ -48,11 +48,18 @@ void Usage(void)
 {
     printf(
 "Usage: mscgen -T <type> [-o <file>] [-i] <infile>\n"
+"       mscgen -T <type> --batch <listfile> [-j <jobs>]\n"
+"       mscgen --serve <socket>\n"
 "       mscgen -l\n"
 "\n"
 "Where:\n"
 " -T <type>   Specifies the output file type, which maybe one of 'png', 'eps',\n"
-"             'svg' or 'ismap'\n"
+"             'svg', 'svgz', 'pdf' or 'ismap', where 'svgz' is gzip compressed\n"
+"              SVG.  Long charts are split into several pages for 'pdf'.\n"
+"              Several types may be given separated by commas, such as\n"
+"              'png,svg,ismap', in which case the chart is parsed and laid\n"
+"              out once and each output is named <file>.<type> after the -o\n"
+"              file or input file.\n"
 " -i <infile> The file from which to read input.  If omitted or specified as\n"
 "              '-', input will be read from stdin.  The '-i' flag maybe\n"
 "              omitted if <infile> is specified as the last option on the\n"
@@ -66,6 +73,44 @@ void Usage(void)
 "              compatible with fontconfig (see 'fc-list'), and overrides the\n"
 "              MSCGEN_FONT environment variable if also set.\n"
 #endif
+" --png-palette\n"
+"             Draw PNG output with a palette of up to 256 colours and without\n"
+"              anti-aliasing, giving smaller files which are faster to write.\n"
+" --png-quantise\n"
+"             Draw PNG output anti-aliased, then reduce it to a palette of up\n"
+"              to 256 colours before writing.\n"
+" --png-level <level>\n"
+"             zlib compression level for PNG output, from 1 (fastest) to 9\n"
+"              (smallest).\n"
+" --png-filter <filter>\n"
+"             PNG row filter, one of 'none', 'sub', 'up', 'average', 'paeth'\n"
+"              or 'adaptive'.  This defaults to 'adaptive' for full colour\n"
+"              images and 'none' for palette images.\n"
+" --png-band <rows>\n"
+"             Draw PNG output in bands of at most <rows> rows, holding only one\n"
+"              band in memory at a time.  This cannot be used with\n"
+"              --png-quantise.\n"
+" --svg-compact\n"
+"             Write smaller SVG output, giving fonts and colours in a style\n"
+"              sheet, joining lines into paths and reusing arrow heads.\n"
+" --batch <listfile>\n"
+"             Render each input file named in <listfile>, one per line, to\n"
+"              <infile>.<type>.  If <listfile> is '-', the list is read from\n"
+"              stdin.  The result for each file is printed to stdout.\n"
+" -j <jobs>   Number of charts to render in parallel in batch mode.  This\n"
+"              defaults to the number of processors, and is further limited\n"
+"              by the jobserver when run from 'make -j'.  When rendering a\n"
+"              single chart, this is the number of threads drawing its\n"
+"              outputs, with PNG output drawn in bands that are shared\n"
+"              between the threads.\n"
+" --serve <socket>\n"
+"             Run as a server, rendering charts sent to the named Unix domain\n"
+"              socket.  If <socket> is '-', requests are read from stdin and\n"
+"              responses written to stdout.  Each request is a line giving\n"
+"              '<type> <length> [font=<font>]' followed by <length> bytes of\n"
+"              input.  Each response is a line giving 'OK <length>' or\n"
+"              'ERROR <length>' followed by <length> bytes of output or an\n"
+"              error message.\n"
 " -p          Print parsed msc output (for parser debug).\n"
 " -l          Display program licence and exit.\n"
 "\n"
@@ -0,0 +1,212 @@
+/***************************************************************************
+ *
+ * $Id$
+ *
+ * This file is part of mscgen, a message sequence chart renderer.
+ * Copyright (C) 2010 Michael C McTernan, Michael.McTernan.2001@cs.bris.ac.uk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ **************************************************************************/
+
+/* Test helper which decodes PNG files with libgd, so that the output of
+ *  the PNG encoder is checked by an independent decoder.
+ *
+ *   pngcmp <file>                 Check that <file> decodes.
+ *   pngcmp <file> <reference>     Also check that both files decode to
+ *                                  the same pixels.
+ *   pngcmp -a <file> <reference>  Check that the palette image <file>,
+ *                                  drawn without anti-aliasing, matches
+ *                                  <reference> except where <reference>
+ *                                  has an anti-aliased pixel.
+ */
+
+/***************************************************************************
+ * Include Files
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#ifndef REMOVE_PNG_OUTPUT
+#include <gd.h>
+#endif
+
+/***************************************************************************
+ * Macro definitions
+ ***************************************************************************/
+
+/** Exit status telling the test harness that the test was skipped. */
+#define PNGCMP_SKIP 77
+
+/***************************************************************************
+ * Local Functions
+ ***************************************************************************/
+
+#ifndef REMOVE_PNG_OUTPUT
+
+/** Decode a PNG file.
+ *
+ * \returns  The image, or NULL if the file could not be opened or decoded,
+ *            in which case an error has been printed.
+ */
+static gdImagePtr loadPng(const char *name)
+{
+    gdImagePtr im = NULL;
+    FILE      *f = fopen(name, "rb");
+
+    if(f == NULL)
+    {
+        perror(name);
+        return NULL;
+    }
+
+    im = gdImageCreateFromPng(f);
+    fclose(f);
+
+    if(im == NULL)
+    {
+        fprintf(stderr, "%s: Failed to decode PNG\n", name);
+    }
+
+    return im;
+}
+
+
+/** Check if some colour is in the palette of an image.
+ */
+static bool inPalette(gdImagePtr im, int c)
+{
+    int i;
+
+    for(i = 0; i < gdImageColorsTotal(im); i++)
+    {
+        if(gdTrueColorAlpha(gdImageRed(im, i), gdImageGreen(im, i),
+                            gdImageBlue(im, i), gdImageAlpha(im, i)) == c)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/** Compare the pixels of two images.
+ * Palette and truecolour images are compared by the colour of each pixel,
+ *  not by palette index.
+ *
+ * If \a aa is set, \a a is a palette image drawn without anti-aliasing
+ *  and \a b is the same chart drawn anti-aliased.  Pixels may then differ
+ *  where \a b has a colour that is not in the palette of \a a, since those
+ *  are the blended colours of anti-aliased edges.  Any other difference,
+ *  such as a mis-packed row of palette indices, is an error.
+ *
+ * \retval false  If the images differ, in which case the first difference
+ *                 has been printed.
+ */
+static bool samePixels(gdImagePtr a, const char *aName,
+                       gdImagePtr b, const char *bName,
+                       bool       aa)
+{
+    int x, y;
+
+    if(aa && gdImageTrueColor(a))
+    {
+        fprintf(stderr, "%s is not a palette image\n", aName);
+        return false;
+    }
+
+    if(gdImageSX(a) != gdImageSX(b) || gdImageSY(a) != gdImageSY(b))
+    {
+        fprintf(stderr, "%s is %dx%d but %s is %dx%d\n",
+                aName, gdImageSX(a), gdImageSY(a),
+                bName, gdImageSX(b), gdImageSY(b));
+        return false;
+    }
+
+    for(y = 0; y < gdImageSY(a); y++)
+    {
+        for(x = 0; x < gdImageSX(a); x++)
+        {
+            const int ca = gdImageGetTrueColorPixel(a, x, y);
+            const int cb = gdImageGetTrueColorPixel(b, x, y);
+
+            if(ca != cb && !(aa && !inPalette(a, cb)))
+            {
+                fprintf(stderr, "%s differs from %s at (%d,%d): %08x != %08x\n",
+                        aName, bName, x, y, ca, cb);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+#endif /* REMOVE_PNG_OUTPUT */
+
+/***************************************************************************
+ * Global Functions
+ ***************************************************************************/
+
+int main(const int argc, const char *argv[])
+{
+#ifndef REMOVE_PNG_OUTPUT
+    const bool aa = argc > 1 && strcmp(argv[1], "-a") == 0;
+    const int  nFiles = aa ? argc - 2 : argc - 1;
+    const char **file = aa ? &argv[2] : &argv[1];
+    gdImagePtr im, ref;
+    int        r;
+
+    if(nFiles < 1 || nFiles > 2 || (aa && nFiles != 2))
+    {
+        fprintf(stderr, "Usage: %s [-a] <file.png> [<reference.png>]\n", argv[0]);
+        return 2;
+    }
+
+    im = loadPng(file[0]);
+    if(im == NULL)
+    {
+        return 1;
+    }
+
+    if(nFiles == 1)
+    {
+        gdImageDestroy(im);
+        return 0;
+    }
+
+    ref = loadPng(file[1]);
+    if(ref == NULL)
+    {
+        gdImageDestroy(im);
+        return 1;
+    }
+
+    r = samePixels(im, file[0], ref, file[1], aa) ? 0 : 1;
+
+    gdImageDestroy(ref);
+    gdImageDestroy(im);
+
+    return r;
+#else
+    return PNGCMP_SKIP;
+#endif
+}
+
+/* END OF FILE */
@@ -25,12 +25,156 @@ if [ "$?" = "0" ] ; then
   NO_PNG=1
 fi
 
+# Check the structure of a PDF file, using qpdf if it is installed.
+#  Otherwise check the header and trailer, that startxref gives the offset
+#  of the cross-reference table and that each entry in the table gives the
+#  offset of its object.  The page count is printed.
+checkpdf()
+{
+    if which qpdf > /dev/null 2>&1 ; then
+        qpdf --check $1 > /dev/null || return 1
+    fi
+    [ "`head -c 5 $1`" == "%PDF-" ] || return 1
+    [ "`tail -n 1 $1`" == "%%EOF" ] || return 1
+    XREF=`tail -n 2 $1 | head -n 1`
+    [ "`tail -c +$((XREF + 1)) $1 | head -n 1`" == xref ] || return 1
+    N=0
+    while read OFF GEN USE ; do
+        if [ "$USE" == n ] ; then
+            [ "`tail -c +$((10#$OFF + 1)) $1 | head -n 1`" == "$N 0 obj" ] || return 1
+        fi
+        N=$((N + 1))
+    done <<< "`tail -c +$((XREF + 1)) $1 | sed -n '3,/^trailer/p' | grep -v '^trailer'`"
+    [ $N -gt 1 ] || return 1
+    PAGES=`grep -a -o '/Type /Pages /Count [0-9]*' $1 | cut -d ' ' -f 4`
+    [ "$PAGES" == "`grep -a -c '/Type /Page /Parent' $1`" ] || return 1
+    echo $PAGES
+}
+
 for F in `cd $srcdir && ls *.msc` ; do
     echo "$F"
     [ "$NO_PNG" == 1 ] || $VALGRIND $top_builddir/src/mscgen -T png -i $srcdir/$F -o $F.png || exit $?
     $VALGRIND $top_builddir/src/mscgen -T svg -i $srcdir/$F -o $F.svg || exit $?
     $VALGRIND $top_builddir/src/mscgen -T eps -i $srcdir/$F -o $F.eps || exit $?
+    $VALGRIND $top_builddir/src/mscgen -T pdf -i $srcdir/$F -o $F.pdf || exit $?
+    checkpdf $F.pdf > /dev/null || { echo "$F.pdf is not a valid PDF" ; exit 1 ; }
     $VALGRIND $top_builddir/src/mscgen -T ismap -i $srcdir/$F -o $F.ismap || exit $?
 done
 
+# testinput9 is taller than a page, so must be split across pages
+[ "`checkpdf testinput9.msc.pdf`" -gt 1 ] || exit 1
+
+# Exercise the PNG encoder options, decoding the output with libgd.  The
+#  filter and compression level must not change the pixels, and palette
+#  output may only differ from truecolour output at anti-aliased edges.
+if [ "$NO_PNG" != 1 ] ; then
+    for F in `cd $srcdir && ls *.msc` ; do
+        echo "$F PNG options"
+        $top_builddir/test/pngcmp $F.png || exit $?
+        $VALGRIND $top_builddir/src/mscgen -T png --png-palette -i $srcdir/$F -o $F.palette.png || exit $?
+        $top_builddir/test/pngcmp -a $F.palette.png $F.png || exit $?
+        $VALGRIND $top_builddir/src/mscgen -T png --png-quantise -i $srcdir/$F -o $F.quantise.png || exit $?
+        $top_builddir/test/pngcmp $F.quantise.png || exit $?
+        for L in 1 9 ; do
+            $VALGRIND $top_builddir/src/mscgen -T png --png-level $L -i $srcdir/$F -o $F.level.png || exit $?
+            $top_builddir/test/pngcmp $F.level.png $F.png || exit $?
+        done
+        for P in none sub up average paeth adaptive ; do
+            $VALGRIND $top_builddir/src/mscgen -T png --png-filter $P -i $srcdir/$F -o $F.filter.png || exit $?
+            $top_builddir/test/pngcmp $F.filter.png $F.png || exit $?
+            $VALGRIND $top_builddir/src/mscgen -T png --png-palette --png-filter $P -i $srcdir/$F -o $F.filter.png || exit $?
+            $top_builddir/test/pngcmp $F.filter.png $F.palette.png || exit $?
+        done
+    done
+fi
+
+# Banded PNG rendering must match rendering the whole canvas at once
+if [ "$NO_PNG" != 1 ] ; then
+    for F in `cd $srcdir && ls *.msc` ; do
+        for B in 7 1 ; do
+            echo "$F PNG band $B"
+            $VALGRIND $top_builddir/src/mscgen -T png --png-band $B -i $srcdir/$F -o $F.band.png || exit $?
+            cmp $F.band.png $F.png || exit $?
+            $VALGRIND $top_builddir/src/mscgen -T png --png-palette --png-band $B -i $srcdir/$F -o $F.band.png || exit $?
+            cmp $F.band.png $F.palette.png || exit $?
+        done
+    done
+fi
+
+# Threaded PNG rendering must match serial rendering
+if [ "$NO_PNG" != 1 ] ; then
+    for F in `cd $srcdir && ls *.msc` ; do
+        echo "$F PNG -j 4"
+        $VALGRIND $top_builddir/src/mscgen -T png -j 4 -i $srcdir/$F -o $F.j4.png || exit $?
+        cmp $F.j4.png $F.png || exit $?
+    done
+fi
+
+# Compressed SVG must decompress to the plain SVG output
+for F in `cd $srcdir && ls *.msc` ; do
+    echo "$F svgz"
+    $VALGRIND $top_builddir/src/mscgen -T svgz -i $srcdir/$F -o $F.svgz || exit $?
+    gzip -t $F.svgz || exit $?
+    gzip -dc $F.svgz | cmp - $F.svg || exit $?
+    echo "$F --svg-compact"
+    $VALGRIND $top_builddir/src/mscgen -T svg --svg-compact -i $srcdir/$F -o $F.compact.svg || exit $?
+    $VALGRIND $top_builddir/src/mscgen -T svgz --svg-compact -i $srcdir/$F -o $F.compact.svgz || exit $?
+    gzip -t $F.compact.svgz || exit $?
+    gzip -dc $F.compact.svgz | cmp - $F.compact.svg || exit $?
+done
+
+# Render each chart to several types at once, which must match the single
+#  renders
+rm -rf multi && mkdir multi || exit $?
+TYPES="svg svgz eps pdf ismap"
+[ "$NO_PNG" == 1 ] || TYPES="png $TYPES"
+for F in `cd $srcdir && ls *.msc` ; do
+    echo "$F multiple types"
+    $VALGRIND $top_builddir/src/mscgen -T `echo $TYPES | tr ' ' ','` -i $srcdir/$F -o multi/$F || exit $?
+    for T in $TYPES ; do
+        if [ "$T" == svgz ] ; then
+            gzip -dc multi/${F%.msc}.svgz | cmp - $F.svg || exit $?
+        else
+            cmp multi/${F%.msc}.$T $F.$T || exit $?
+        fi
+    done
+done
+
+# Render copies of the charts in a batch, which must match the single renders
+rm -rf batch && mkdir batch || exit $?
+for F in `cd $srcdir && ls *.msc` ; do
+    cp $srcdir/$F batch/$F || exit $?
+done
+
+for T in png svg ; do
+    [ "$T" == png ] && [ "$NO_PNG" == 1 ] && continue
+    echo "batch -T $T"
+    ls batch/*.msc | $VALGRIND $top_builddir/src/mscgen -T $T --batch - -j 2 > /dev/null || exit $?
+    for F in `cd $srcdir && ls *.msc` ; do
+        cmp batch/${F%.msc}.$T $F.$T || exit $?
+    done
+done
+
+# Render charts through one --serve connection, which writes its answers
+#  through a file descriptor sink.  Each answer must match the single render
+#  to a file, and testinput9 gives outputs larger than the sink's buffer.
+TYPES="svg eps pdf ismap"
+[ "$NO_PNG" == 1 ] || TYPES="png $TYPES"
+for F in testinput1.msc testinput9.msc ; do
+    echo "serve $F"
+    for T in $TYPES ; do
+        echo "$T $((`wc -c < $srcdir/$F`))" ; cat $srcdir/$F
+    done | $VALGRIND $top_builddir/src/mscgen --serve - > serve.out || exit $?
+    POS=1
+    for T in $TYPES ; do
+        read STATUS LEN <<< "`tail -c +$POS serve.out | head -n 1`"
+        [ "$STATUS" == OK ] || exit 1
+        POS=$((POS + ${#STATUS} + ${#LEN} + 2))
+        tail -c +$POS serve.out | head -c $LEN > serve.$T
+        POS=$((POS + LEN))
+        cmp serve.$T $F.$T || exit $?
+    done
+    [ $POS -eq $((`wc -c < serve.out` + 1)) ] || exit 1
+done
+
 # END OF SCRIPT